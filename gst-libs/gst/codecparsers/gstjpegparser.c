@@ -233,15 +233,19 @@ gst_jpeg_scan_for_marker_code (const guint8 * data, gsize size, guint offset)
   g_return_val_if_fail (data != NULL, -1);
   g_return_val_if_fail (size > offset, -1);
 
+  /* 0xff bytes are rare in entropy coded data, let memchr() skip over
+     the rest of it */
   for (i = offset; i < size - 1;) {
-    if (data[i] != 0xff)
-      i++;
-    else {
-      const guint8 v = data[i + 1];
-      if (v >= 0xc0 && v <= 0xfe)
-        return i;
-      i += 2;
-    }
+    const guint8 *p = memchr (&data[i], 0xff, size - 1 - i);
+    guint8 v;
+
+    if (!p)
+      break;
+    i = p - data;
+    v = data[i + 1];
+    if (v >= 0xc0 && v <= 0xfe)
+      return i;
+    i += 2;
   }
   return -1;
 }
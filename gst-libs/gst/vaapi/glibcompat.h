@@ -72,6 +72,20 @@ g_clear_object_inline(volatile GObject **object_ptr)
 #define g_static_rec_mutex_lock(mutex)  g_rec_mutex_lock(mutex)
 #undef  g_static_rec_mutex_unlock
 #define g_static_rec_mutex_unlock(m)    g_rec_mutex_unlock(m)
+
+#define GStaticRWLock                   GRWLock
+#undef  g_static_rw_lock_init
+#define g_static_rw_lock_init(lock)     g_rw_lock_init(lock)
+#undef  g_static_rw_lock_free
+#define g_static_rw_lock_free(lock)     g_rw_lock_clear(lock)
+#undef  g_static_rw_lock_reader_lock
+#define g_static_rw_lock_reader_lock(l) g_rw_lock_reader_lock(l)
+#undef  g_static_rw_lock_reader_unlock
+#define g_static_rw_lock_reader_unlock(l) g_rw_lock_reader_unlock(l)
+#undef  g_static_rw_lock_writer_lock
+#define g_static_rw_lock_writer_lock(l) g_rw_lock_writer_lock(l)
+#undef  g_static_rw_lock_writer_unlock
+#define g_static_rw_lock_writer_unlock(l) g_rw_lock_writer_unlock(l)
 #endif
 
 #endif /* GLIB_COMPAT_H */
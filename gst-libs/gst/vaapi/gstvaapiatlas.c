@@ -0,0 +1,387 @@
+/*
+ *  gstvaapiatlas.c - Rectangle packer for shared subpicture images
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* The atlas is a shelf packer: rectangles are laid out left to right
+ * on horizontal shelves stacked from the top. Each shelf keeps a list
+ * of free horizontal spans, so released rectangles leave holes that
+ * later rectangles of a similar height fill, without moving the ones
+ * still in use. Trailing empty shelves are dropped, so that the next
+ * rectangles can open shelves of a different height.
+ */
+
+#include "sysdeps.h"
+#include <glib.h>
+#include "gstvaapiatlas.h"
+
+/* Shelf heights are rounded up to this, so that shelves can be shared
+   by rectangles of slightly different heights */
+#define SHELF_HEIGHT_ALIGN      8
+
+/* Rectangles are only put on shelves up to this factor taller than
+   them, unless no other shelf has room */
+#define SHELF_HEIGHT_SLACK      2
+
+typedef struct _AtlasSpan AtlasSpan;
+struct _AtlasSpan {
+    guint               x;
+    guint               width;
+};
+
+typedef struct _AtlasShelf AtlasShelf;
+struct _AtlasShelf {
+    guint               y;
+    guint               height;
+    guint               num_rects;
+    GArray             *spans;          /* free spans, sorted by x */
+};
+
+struct _GstVaapiAtlas {
+    guint               width;
+    guint               height;
+    GPtrArray          *shelves;        /* sorted by y */
+    guint               used_height;
+    guint               used_area;
+    guint               num_rects;
+};
+
+static AtlasShelf *
+atlas_shelf_new(guint y, guint height, guint width)
+{
+    AtlasShelf *shelf;
+    AtlasSpan span;
+
+    shelf = g_slice_new(AtlasShelf);
+    if (!shelf)
+        return NULL;
+
+    shelf->y         = y;
+    shelf->height    = height;
+    shelf->num_rects = 0;
+    shelf->spans     = g_array_new(FALSE, FALSE, sizeof(AtlasSpan));
+
+    span.x     = 0;
+    span.width = width;
+    g_array_append_val(shelf->spans, span);
+    return shelf;
+}
+
+static void
+atlas_shelf_free(AtlasShelf *shelf)
+{
+    g_array_free(shelf->spans, TRUE);
+    g_slice_free(AtlasShelf, shelf);
+}
+
+/* Returns the index of the first free span that fits, or -1 */
+static gint
+atlas_shelf_find_span(AtlasShelf *shelf, guint width)
+{
+    guint i;
+
+    for (i = 0; i < shelf->spans->len; i++) {
+        if (g_array_index(shelf->spans, AtlasSpan, i).width >= width)
+            return i;
+    }
+    return -1;
+}
+
+static void
+atlas_shelf_alloc_span(AtlasShelf *shelf, guint index, guint width, guint *px)
+{
+    AtlasSpan * const span = &g_array_index(shelf->spans, AtlasSpan, index);
+
+    *px = span->x;
+    span->x     += width;
+    span->width -= width;
+    if (span->width == 0)
+        g_array_remove_index(shelf->spans, index);
+    shelf->num_rects++;
+}
+
+/* Gives the span back and merges it with its free neighbours */
+static void
+atlas_shelf_release_span(AtlasShelf *shelf, guint x, guint width)
+{
+    AtlasSpan *prev, *next, span;
+    guint i;
+
+    for (i = 0; i < shelf->spans->len; i++) {
+        if (g_array_index(shelf->spans, AtlasSpan, i).x > x)
+            break;
+    }
+
+    prev = i > 0 ? &g_array_index(shelf->spans, AtlasSpan, i - 1) : NULL;
+    next = i < shelf->spans->len ?
+        &g_array_index(shelf->spans, AtlasSpan, i) : NULL;
+
+    if (prev && prev->x + prev->width == x) {
+        prev->width += width;
+        if (next && prev->x + prev->width == next->x) {
+            prev->width += next->width;
+            g_array_remove_index(shelf->spans, i);
+        }
+    }
+    else if (next && x + width == next->x) {
+        next->x      = x;
+        next->width += width;
+    }
+    else {
+        span.x     = x;
+        span.width = width;
+        g_array_insert_val(shelf->spans, i, span);
+    }
+    shelf->num_rects--;
+}
+
+/**
+ * gst_vaapi_atlas_new:
+ * @width: the atlas width, in pixels
+ * @height: the atlas height, in pixels
+ *
+ * Creates a new atlas to pack rectangles into a @width x @height
+ * image.
+ *
+ * Return value: the newly allocated #GstVaapiAtlas
+ */
+GstVaapiAtlas *
+gst_vaapi_atlas_new(guint width, guint height)
+{
+    GstVaapiAtlas *atlas;
+
+    g_return_val_if_fail(width > 0, NULL);
+    g_return_val_if_fail(height > 0, NULL);
+
+    atlas = g_slice_new0(GstVaapiAtlas);
+    if (!atlas)
+        return NULL;
+
+    atlas->width   = width;
+    atlas->height  = height;
+    atlas->shelves = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)atlas_shelf_free);
+    return atlas;
+}
+
+/**
+ * gst_vaapi_atlas_free:
+ * @atlas: a #GstVaapiAtlas
+ *
+ * Destroys the @atlas.
+ */
+void
+gst_vaapi_atlas_free(GstVaapiAtlas *atlas)
+{
+    if (!atlas)
+        return;
+
+    g_ptr_array_free(atlas->shelves, TRUE);
+    g_slice_free(GstVaapiAtlas, atlas);
+}
+
+/**
+ * gst_vaapi_atlas_reset:
+ * @atlas: a #GstVaapiAtlas
+ *
+ * Releases all the rectangles allocated from @atlas at once.
+ */
+void
+gst_vaapi_atlas_reset(GstVaapiAtlas *atlas)
+{
+    g_return_if_fail(atlas != NULL);
+
+    g_ptr_array_set_size(atlas->shelves, 0);
+    atlas->used_height = 0;
+    atlas->used_area   = 0;
+    atlas->num_rects   = 0;
+}
+
+/**
+ * gst_vaapi_atlas_alloc:
+ * @atlas: a #GstVaapiAtlas
+ * @width: the requested width
+ * @height: the requested height
+ * @rect: return location for the allocated rectangle
+ *
+ * Finds room for a @width x @height rectangle in @atlas. The
+ * rectangles already allocated are never moved.
+ *
+ * Return value: %TRUE on success, %FALSE if @atlas is full
+ */
+gboolean
+gst_vaapi_atlas_alloc(
+    GstVaapiAtlas      *atlas,
+    guint               width,
+    guint               height,
+    GstVaapiRectangle  *rect
+)
+{
+    AtlasShelf *shelf, *best_shelf = NULL, *loose_shelf = NULL;
+    guint i, shelf_height, max_height;
+    gint span, best_span = -1, loose_span = -1;
+
+    g_return_val_if_fail(atlas != NULL, FALSE);
+    g_return_val_if_fail(rect != NULL, FALSE);
+
+    if (width == 0 || height == 0)
+        return FALSE;
+    if (width > atlas->width || height > atlas->height)
+        return FALSE;
+
+    /* Look for the shortest shelf with room, keeping apart the ones
+       that would waste too much height */
+    max_height = height * SHELF_HEIGHT_SLACK;
+    for (i = 0; i < atlas->shelves->len; i++) {
+        shelf = g_ptr_array_index(atlas->shelves, i);
+        if (shelf->height < height)
+            continue;
+        span = atlas_shelf_find_span(shelf, width);
+        if (span < 0)
+            continue;
+        if (shelf->height <= max_height) {
+            if (!best_shelf || shelf->height < best_shelf->height) {
+                best_shelf = shelf;
+                best_span  = span;
+            }
+        }
+        else if (!loose_shelf || shelf->height < loose_shelf->height) {
+            loose_shelf = shelf;
+            loose_span  = span;
+        }
+    }
+
+    /* Otherwise, open a new shelf, or fall back to a taller one */
+    if (!best_shelf) {
+        shelf_height = (height + SHELF_HEIGHT_ALIGN - 1) / SHELF_HEIGHT_ALIGN;
+        shelf_height = MIN(shelf_height * SHELF_HEIGHT_ALIGN, atlas->height);
+        if (atlas->used_height + shelf_height <= atlas->height) {
+            shelf = atlas_shelf_new(atlas->used_height, shelf_height,
+                                    atlas->width);
+            if (!shelf)
+                return FALSE;
+            g_ptr_array_add(atlas->shelves, shelf);
+            atlas->used_height += shelf_height;
+            best_shelf = shelf;
+            best_span  = 0;
+        }
+        else {
+            best_shelf = loose_shelf;
+            best_span  = loose_span;
+        }
+    }
+    if (!best_shelf)
+        return FALSE;
+
+    atlas_shelf_alloc_span(best_shelf, best_span, width, &rect->x);
+    rect->y      = best_shelf->y;
+    rect->width  = width;
+    rect->height = height;
+
+    atlas->used_area += width * height;
+    atlas->num_rects++;
+    return TRUE;
+}
+
+/**
+ * gst_vaapi_atlas_release:
+ * @atlas: a #GstVaapiAtlas
+ * @rect: a rectangle allocated with gst_vaapi_atlas_alloc()
+ *
+ * Gives the room used by @rect back to @atlas.
+ */
+void
+gst_vaapi_atlas_release(GstVaapiAtlas *atlas, const GstVaapiRectangle *rect)
+{
+    AtlasShelf *shelf = NULL;
+    guint i;
+
+    g_return_if_fail(atlas != NULL);
+    g_return_if_fail(rect != NULL);
+
+    for (i = 0; i < atlas->shelves->len; i++) {
+        shelf = g_ptr_array_index(atlas->shelves, i);
+        if (shelf->y == rect->y)
+            break;
+    }
+    g_return_if_fail(i < atlas->shelves->len);
+    g_return_if_fail(shelf->num_rects > 0);
+
+    atlas_shelf_release_span(shelf, rect->x, rect->width);
+    atlas->used_area -= rect->width * rect->height;
+    atlas->num_rects--;
+
+    /* Drop trailing empty shelves */
+    while (atlas->shelves->len > 0) {
+        i = atlas->shelves->len - 1;
+        shelf = g_ptr_array_index(atlas->shelves, i);
+        if (shelf->num_rects > 0)
+            break;
+        atlas->used_height = shelf->y;
+        g_ptr_array_remove_index(atlas->shelves, i);
+    }
+}
+
+/**
+ * gst_vaapi_atlas_get_num_rects:
+ * @atlas: a #GstVaapiAtlas
+ *
+ * Return value: the number of rectangles allocated from @atlas
+ */
+guint
+gst_vaapi_atlas_get_num_rects(GstVaapiAtlas *atlas)
+{
+    g_return_val_if_fail(atlas != NULL, 0);
+
+    return atlas->num_rects;
+}
+
+/**
+ * gst_vaapi_atlas_get_used_height:
+ * @atlas: a #GstVaapiAtlas
+ *
+ * Return value: the height of the shelves currently in use, i.e. the
+ *   number of rows of the atlas image that may hold rectangles
+ */
+guint
+gst_vaapi_atlas_get_used_height(GstVaapiAtlas *atlas)
+{
+    g_return_val_if_fail(atlas != NULL, 0);
+
+    return atlas->used_height;
+}
+
+/**
+ * gst_vaapi_atlas_get_efficiency:
+ * @atlas: a #GstVaapiAtlas
+ *
+ * Computes the packing efficiency of @atlas, i.e. the area of the
+ * allocated rectangles relative to the area of the shelves in use.
+ *
+ * Return value: the packing efficiency, between 0 and 1
+ */
+gdouble
+gst_vaapi_atlas_get_efficiency(GstVaapiAtlas *atlas)
+{
+    g_return_val_if_fail(atlas != NULL, 0.0);
+
+    if (!atlas->used_height)
+        return 0.0;
+    return (gdouble)atlas->used_area / (atlas->width * atlas->used_height);
+}
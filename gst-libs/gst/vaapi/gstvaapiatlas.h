@@ -0,0 +1,62 @@
+/*
+ *  gstvaapiatlas.h - Rectangle packer for shared subpicture images
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_ATLAS_H
+#define GST_VAAPI_ATLAS_H
+
+#include <gst/vaapi/gstvaapitypes.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiAtlas           GstVaapiAtlas;
+
+GstVaapiAtlas *
+gst_vaapi_atlas_new(guint width, guint height);
+
+void
+gst_vaapi_atlas_free(GstVaapiAtlas *atlas);
+
+void
+gst_vaapi_atlas_reset(GstVaapiAtlas *atlas);
+
+gboolean
+gst_vaapi_atlas_alloc(
+    GstVaapiAtlas      *atlas,
+    guint               width,
+    guint               height,
+    GstVaapiRectangle  *rect
+);
+
+void
+gst_vaapi_atlas_release(GstVaapiAtlas *atlas, const GstVaapiRectangle *rect);
+
+guint
+gst_vaapi_atlas_get_num_rects(GstVaapiAtlas *atlas);
+
+guint
+gst_vaapi_atlas_get_used_height(GstVaapiAtlas *atlas);
+
+gdouble
+gst_vaapi_atlas_get_efficiency(GstVaapiAtlas *atlas);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_ATLAS_H */
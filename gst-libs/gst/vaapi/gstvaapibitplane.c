@@ -0,0 +1,306 @@
+/*
+ *  gstvaapibitplane.c - VC-1 bitplane packing kernels
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapicpu.h"
+#include "gstvaapibitplane.h"
+
+#if GST_VAAPI_CPU_HAS_X86
+# include <immintrin.h>
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+# include <arm_neon.h>
+#endif
+
+/* Offsets a plane row, which may be NULL */
+#define PLANE_OFFSET(p, i) ((p) ? (p) + (i) : NULL)
+
+/* Merges the flags of macroblock @i into a nibble */
+static inline guint8
+merge_flags(const guint8 *p0, const guint8 *p1, const guint8 *p2, guint i)
+{
+    guint8 v = 0;
+
+    if (p0)
+        v |= p0[i];
+    if (p1)
+        v |= p1[i] << 1;
+    if (p2)
+        v |= p2[i] << 2;
+    return v;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Generic C implementation                                          --- */
+/* ------------------------------------------------------------------------- */
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+static inline guint64
+load_flags(const guint8 *p, guint i)
+{
+    guint64 v = 0;
+
+    if (p)
+        memcpy(&v, p + i, sizeof(v));
+    return v;
+}
+#endif
+
+static void
+pack_row_c(guint8 *dst, const guint8 *p0, const guint8 *p1,
+    const guint8 *p2, guint n)
+{
+    guint i = 0;
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    /* 8 macroblocks per 64-bit word. The flag bytes are shifted within
+       their own byte, then each 16-bit word, that holds macroblocks 2k
+       and 2k+1, is folded into a byte */
+    for (; i + 8 <= n; i += 8) {
+        guint64 v;
+        guint32 w;
+
+        v = load_flags(p0, i) |
+            ((load_flags(p1, i) & G_GUINT64_CONSTANT(0x7f7f7f7f7f7f7f7f)) << 1) |
+            ((load_flags(p2, i) & G_GUINT64_CONSTANT(0x3f3f3f3f3f3f3f3f)) << 2);
+        v = ((v & G_GUINT64_CONSTANT(0x000f000f000f000f)) << 4) |
+            ((v >> 8) & G_GUINT64_CONSTANT(0x00ff00ff00ff00ff));
+        v = (v | (v >> 8))  & G_GUINT64_CONSTANT(0x0000ffff0000ffff);
+        v = (v | (v >> 16)) & G_GUINT64_CONSTANT(0x00000000ffffffff);
+        w = v;
+        memcpy(dst + i / 2, &w, sizeof(w));
+    }
+#endif
+
+    for (; i + 1 < n; i += 2)
+        dst[i / 2] = (merge_flags(p0, p1, p2, i) << 4) |
+            merge_flags(p0, p1, p2, i + 1);
+    if (i < n)
+        dst[i / 2] = merge_flags(p0, p1, p2, i) << 4;
+}
+
+static const GstVaapiBitPlaneFuncs g_bitplane_funcs_c = {
+    "c",
+    pack_row_c,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- x86 implementation                                                --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_X86
+
+#define SSE2    GST_VAAPI_CPU_TARGET("sse2")
+
+static SSE2 inline __m128i
+load_flags_sse2(const guint8 *p, guint i)
+{
+    return p ? _mm_loadu_si128((const __m128i *)(p + i)) : _mm_setzero_si128();
+}
+
+/* Packs 16 macroblocks into the low order bytes of 8 16-bit words */
+static SSE2 inline __m128i
+pack_flags_sse2(const guint8 *p0, const guint8 *p1, const guint8 *p2,
+    guint i)
+{
+    __m128i v, b, c;
+
+    b = load_flags_sse2(p1, i);
+    c = load_flags_sse2(p2, i);
+    c = _mm_add_epi8(c, c);
+    v = _mm_or_si128(load_flags_sse2(p0, i),
+                     _mm_add_epi8(b, b));
+    v = _mm_or_si128(v, _mm_add_epi8(c, c));
+    return _mm_or_si128(
+        _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x000f)), 4),
+        _mm_srli_epi16(v, 8));
+}
+
+static SSE2 void
+pack_row_sse2(guint8 *dst, const guint8 *p0, const guint8 *p1,
+    const guint8 *p2, guint n)
+{
+    guint i;
+
+    for (i = 0; i + 32 <= n; i += 32)
+        _mm_storeu_si128((__m128i *)(dst + i / 2), _mm_packus_epi16(
+            pack_flags_sse2(p0, p1, p2, i),
+            pack_flags_sse2(p0, p1, p2, i + 16)));
+    pack_row_c(dst + i / 2, PLANE_OFFSET(p0, i), PLANE_OFFSET(p1, i),
+        PLANE_OFFSET(p2, i), n - i);
+}
+
+#undef SSE2
+
+static const GstVaapiBitPlaneFuncs g_bitplane_funcs_sse2 = {
+    "sse2",
+    pack_row_sse2,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_X86 */
+
+/* ------------------------------------------------------------------------- */
+/* --- ARM implementation                                                --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_NEON
+
+/* Splits 32 macroblocks into even and odd ones */
+static inline uint8x16x2_t
+load_flags_neon(const guint8 *p, guint i)
+{
+    uint8x16x2_t v;
+
+    if (p)
+        return vld2q_u8(p + i);
+    v.val[0] = vdupq_n_u8(0);
+    v.val[1] = v.val[0];
+    return v;
+}
+
+static void
+pack_row_neon(guint8 *dst, const guint8 *p0, const guint8 *p1,
+    const guint8 *p2, guint n)
+{
+    uint8x16x2_t a, b, c;
+    uint8x16_t even, odd;
+    guint i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        a = load_flags_neon(p0, i);
+        b = load_flags_neon(p1, i);
+        c = load_flags_neon(p2, i);
+        even = vorrq_u8(vorrq_u8(a.val[0], vshlq_n_u8(b.val[0], 1)),
+                        vshlq_n_u8(c.val[0], 2));
+        odd  = vorrq_u8(vorrq_u8(a.val[1], vshlq_n_u8(b.val[1], 1)),
+                        vshlq_n_u8(c.val[1], 2));
+        vst1q_u8(dst + i / 2, vorrq_u8(vshlq_n_u8(even, 4), odd));
+    }
+    pack_row_c(dst + i / 2, PLANE_OFFSET(p0, i), PLANE_OFFSET(p1, i),
+        PLANE_OFFSET(p2, i), n - i);
+}
+
+static const GstVaapiBitPlaneFuncs g_bitplane_funcs_neon = {
+    "neon",
+    pack_row_neon,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_NEON */
+
+/* ------------------------------------------------------------------------- */
+/* --- Dispatch                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_bitplane_get_funcs_for_flags:
+ * @cpu_flags: a set of #GstVaapiCpuFlags
+ *
+ * Selects the fastest kernels that only use the SIMD extensions
+ * listed in @cpu_flags.
+ *
+ * Return value: the #GstVaapiBitPlaneFuncs for @cpu_flags
+ */
+const GstVaapiBitPlaneFuncs *
+gst_vaapi_bitplane_get_funcs_for_flags(guint cpu_flags)
+{
+#if GST_VAAPI_CPU_HAS_X86
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSE2)
+        return &g_bitplane_funcs_sse2;
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_NEON)
+        return &g_bitplane_funcs_neon;
+#endif
+    return &g_bitplane_funcs_c;
+}
+
+/**
+ * gst_vaapi_bitplane_get_funcs:
+ *
+ * Selects the fastest kernels for this CPU.
+ *
+ * Return value: the #GstVaapiBitPlaneFuncs to use
+ */
+const GstVaapiBitPlaneFuncs *
+gst_vaapi_bitplane_get_funcs(void)
+{
+    return gst_vaapi_bitplane_get_funcs_for_flags(gst_vaapi_cpu_get_flags());
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Packing                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_bitplane_pack:
+ * @funcs: the kernels to use, or %NULL for the fastest ones
+ * @dst: the VA bitplane buffer, of (@width * @height + 1) / 2 bytes
+ * @planes: the three planes of macroblock flags, or %NULL for absent
+ *   planes
+ * @width: the picture width, in macroblocks
+ * @height: the picture height, in macroblocks
+ * @stride: the distance between two rows of @planes, in bytes
+ *
+ * Packs the VC-1 bitplanes of a picture into the layout VA-API
+ * expects: one nibble per macroblock in raster order, with bit 0 from
+ * @planes[0], bit 1 from @planes[1] and bit 2 from @planes[2]. The
+ * first macroblock of a pair goes to the high order nibble.
+ *
+ * Every byte of @dst is written without being read first, since the
+ * buffer is usually mapped from the driver.
+ */
+void
+gst_vaapi_bitplane_pack(
+    const GstVaapiBitPlaneFuncs *funcs,
+    guint8                      *dst,
+    const guint8                *planes[3],
+    guint                        width,
+    guint                        height,
+    guint                        stride
+)
+{
+    const guint8 *p0, *p1, *p2;
+    guint x, y, n;
+    guint8 last = 0;
+
+    if (!funcs)
+        funcs = gst_vaapi_bitplane_get_funcs();
+
+    for (y = 0, n = 0; y < height; y++, n += width) {
+        p0 = PLANE_OFFSET(planes[0], y * stride);
+        p1 = PLANE_OFFSET(planes[1], y * stride);
+        p2 = PLANE_OFFSET(planes[2], y * stride);
+
+        /* A row that begins at an odd macroblock completes the last
+           byte of the previous row, from the nibble kept aside */
+        x = 0;
+        if ((n & 1) && width > 0) {
+            dst[n / 2] = (last << 4) | merge_flags(p0, p1, p2, 0);
+            x = 1;
+        }
+        funcs->pack_row(dst + (n + x) / 2, PLANE_OFFSET(p0, x),
+            PLANE_OFFSET(p1, x), PLANE_OFFSET(p2, x), width - x);
+
+        if (((n + width) & 1) && width > 0)
+            last = merge_flags(p0, p1, p2, width - 1);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ *  gstvaapibitplane.h - VC-1 bitplane packing kernels
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_BITPLANE_H
+#define GST_VAAPI_BITPLANE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiBitPlaneFuncs           GstVaapiBitPlaneFuncs;
+
+/**
+ * GstVaapiBitPlaneFuncs:
+ * @name: name of the implementation, e.g. "sse2"
+ * @pack_row: merges the @n macroblock flags of up to three planes into
+ *   nibbles, bit 0 from @p0, bit 1 from @p1 and bit 2 from @p2. A
+ *   %NULL plane reads as zeros. Byte k of @dst receives the nibbles of
+ *   macroblocks 2k (high order) and 2k+1 (low order). If @n is odd,
+ *   the low order nibble of the last byte is zero
+ *
+ * VC-1 bitplane packing kernels. All implementations produce
+ * bit-exact results, and only write to @dst, which may be uncached.
+ */
+struct _GstVaapiBitPlaneFuncs {
+    const gchar *name;
+
+    void (*pack_row)(guint8 *dst, const guint8 *p0, const guint8 *p1,
+                     const guint8 *p2, guint n);
+};
+
+G_GNUC_INTERNAL
+const GstVaapiBitPlaneFuncs *
+gst_vaapi_bitplane_get_funcs(void);
+
+G_GNUC_INTERNAL
+const GstVaapiBitPlaneFuncs *
+gst_vaapi_bitplane_get_funcs_for_flags(guint cpu_flags);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_bitplane_pack(
+    const GstVaapiBitPlaneFuncs *funcs,
+    guint8                      *dst,
+    const guint8                *planes[3],
+    guint                        width,
+    guint                        height,
+    guint                        stride
+);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_BITPLANE_H */
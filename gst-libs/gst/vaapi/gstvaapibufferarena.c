@@ -0,0 +1,377 @@
+/*
+ *  gstvaapibufferarena.c - VA buffer recycling arena
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapibufferarena.h"
+#include "gstvaapiutils.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Slice data buffers are allocated by power-of-two size classes,
+   starting from this size */
+#define SLICE_DATA_MIN_SIZE             4096
+
+/* Maximum number of idle VA buffers kept per (type, size) class */
+#define MAX_CACHED_BUFFERS_PER_CLASS    64
+
+typedef struct _BufferClass BufferClass;
+struct _BufferClass {
+    int                 type;
+    guint               size;
+    GQueue              free_buffers;
+};
+
+typedef struct _BufferInfo BufferInfo;
+struct _BufferInfo {
+    BufferClass        *klass;
+    guint               is_mapped       : 1;
+};
+
+struct _GstVaapiBufferArena {
+    VADisplay           display;
+    VAContextID         context;
+    GPtrArray          *classes;
+    GHashTable         *buffers;
+    GstVaapiBufferArenaStats stats;
+};
+
+static void
+buffer_class_free(BufferClass *klass, VADisplay dpy)
+{
+    VABufferID buf_id;
+
+    while (!g_queue_is_empty(&klass->free_buffers)) {
+        buf_id = GPOINTER_TO_UINT(g_queue_pop_head(&klass->free_buffers));
+        vaDestroyBuffer(dpy, buf_id);
+    }
+    g_slice_free(BufferClass, klass);
+}
+
+static void
+buffer_info_free(BufferInfo *info)
+{
+    g_slice_free(BufferInfo, info);
+}
+
+/* Parameter buffers have a fixed size per codec, so they are recycled
+   on an exact size basis. Slice data buffers are rounded up */
+static guint
+get_size_class(int type, guint size)
+{
+    guint size_class;
+
+    if (type != VASliceDataBufferType || size > G_MAXUINT / 2)
+        return size;
+
+    for (size_class = SLICE_DATA_MIN_SIZE; size_class < size; size_class <<= 1)
+        ;
+    return size_class;
+}
+
+static BufferClass *
+ensure_buffer_class(GstVaapiBufferArena *arena, int type, guint size)
+{
+    BufferClass *klass;
+    guint i;
+
+    for (i = 0; i < arena->classes->len; i++) {
+        klass = g_ptr_array_index(arena->classes, i);
+        if (klass->type == type && klass->size == size)
+            return klass;
+    }
+
+    klass = g_slice_new(BufferClass);
+    if (!klass)
+        return NULL;
+
+    klass->type = type;
+    klass->size = size;
+    g_queue_init(&klass->free_buffers);
+    g_ptr_array_add(arena->classes, klass);
+    return klass;
+}
+
+/**
+ * gst_vaapi_buffer_arena_new:
+ * @dpy: a VADisplay
+ * @ctx: the VA context all buffers are bound to
+ *
+ * Creates a new arena that recycles VA buffers created for @ctx.
+ * Buffers released to the arena are kept per buffer type and size
+ * class, and handed out again instead of destroying and re-creating
+ * them for each picture.
+ *
+ * The arena is not thread-safe and is meant to be owned by a single
+ * decoder.
+ *
+ * Return value: the newly allocated #GstVaapiBufferArena
+ */
+GstVaapiBufferArena *
+gst_vaapi_buffer_arena_new(VADisplay dpy, VAContextID ctx)
+{
+    GstVaapiBufferArena *arena;
+
+    arena = g_slice_new0(GstVaapiBufferArena);
+    if (!arena)
+        return NULL;
+
+    arena->display = dpy;
+    arena->context = ctx;
+
+    arena->classes = g_ptr_array_new();
+    if (!arena->classes)
+        goto error;
+
+    arena->buffers = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, (GDestroyNotify)buffer_info_free);
+    if (!arena->buffers)
+        goto error;
+    return arena;
+
+error:
+    gst_vaapi_buffer_arena_free(arena);
+    return NULL;
+}
+
+/**
+ * gst_vaapi_buffer_arena_free:
+ * @arena: a #GstVaapiBufferArena
+ *
+ * Destroys all idle VA buffers held by @arena, and the arena itself.
+ * Buffers still in use are no longer tracked and will be destroyed
+ * when they are released.
+ */
+void
+gst_vaapi_buffer_arena_free(GstVaapiBufferArena *arena)
+{
+    guint i;
+
+    if (!arena)
+        return;
+
+    GST_DEBUG("buffer arena: %u hits, %u misses, %u destroyed",
+              arena->stats.hits, arena->stats.misses, arena->stats.destroyed);
+
+    if (arena->classes) {
+        for (i = 0; i < arena->classes->len; i++)
+            buffer_class_free(g_ptr_array_index(arena->classes, i),
+                              arena->display);
+        g_ptr_array_free(arena->classes, TRUE);
+        arena->classes = NULL;
+    }
+
+    if (arena->buffers) {
+        g_hash_table_destroy(arena->buffers);
+        arena->buffers = NULL;
+    }
+    g_slice_free(GstVaapiBufferArena, arena);
+}
+
+/**
+ * gst_vaapi_buffer_arena_create_buffer:
+ * @arena: a #GstVaapiBufferArena
+ * @type: the VA buffer type
+ * @size: the requested VA buffer size, in bytes
+ * @data: optional data to initialize the buffer with
+ * @buf_id_ptr: return location for the VA buffer id
+ * @mapped_data: optional return location for the mapped buffer data
+ *
+ * Gets a VA buffer of the specified @type that holds at least @size
+ * bytes. An idle buffer of the same type and size class is reused if
+ * possible, otherwise a new one is created. Reused parameter buffers
+ * are cleared if no @data is supplied, just like newly created ones.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_buffer_arena_create_buffer(
+    GstVaapiBufferArena *arena,
+    int                  type,
+    guint                size,
+    gconstpointer        data,
+    VABufferID          *buf_id_ptr,
+    gpointer            *mapped_data
+)
+{
+    BufferClass *klass;
+    BufferInfo *info;
+    VABufferID buf_id;
+    VAStatus status;
+    gboolean needs_init;
+    gpointer buf;
+
+    g_return_val_if_fail(arena != NULL, FALSE);
+    g_return_val_if_fail(buf_id_ptr != NULL, FALSE);
+
+    klass = ensure_buffer_class(arena, type, get_size_class(type, size));
+    if (!klass)
+        return FALSE;
+
+    if (!g_queue_is_empty(&klass->free_buffers)) {
+        buf_id = GPOINTER_TO_UINT(g_queue_pop_head(&klass->free_buffers));
+        info = g_hash_table_lookup(arena->buffers, GUINT_TO_POINTER(buf_id));
+        needs_init = data || type != VASliceDataBufferType;
+        arena->stats.hits++;
+    }
+    else {
+        info = g_slice_new(BufferInfo);
+        if (!info)
+            return FALSE;
+        info->klass = klass;
+        info->is_mapped = FALSE;
+
+        status = vaCreateBuffer(arena->display, arena->context, type,
+            klass->size, 1, klass->size == size ? (gpointer)data : NULL,
+            &buf_id);
+        if (!vaapi_check_status(status, "vaCreateBuffer()")) {
+            buffer_info_free(info);
+            return FALSE;
+        }
+        g_hash_table_insert(arena->buffers, GUINT_TO_POINTER(buf_id), info);
+        needs_init = data && klass->size != size;
+        arena->stats.misses++;
+    }
+
+    if (needs_init || mapped_data) {
+        buf = vaapi_map_buffer(arena->display, buf_id);
+        if (!buf)
+            goto error;
+
+        if (data && needs_init)
+            memcpy(buf, data, size);
+        else if (needs_init)
+            memset(buf, 0, size);
+
+        if (mapped_data)
+            *mapped_data = buf;
+        else
+            vaapi_unmap_buffer(arena->display, buf_id, NULL);
+    }
+    info->is_mapped = mapped_data != NULL;
+
+    *buf_id_ptr = buf_id;
+    return TRUE;
+
+error:
+    g_hash_table_remove(arena->buffers, GUINT_TO_POINTER(buf_id));
+    vaapi_destroy_buffer(arena->display, &buf_id);
+    arena->stats.destroyed++;
+    return FALSE;
+}
+
+/**
+ * gst_vaapi_buffer_arena_unmap_buffer:
+ * @arena: a #GstVaapiBufferArena
+ * @buf_id: the VA buffer to unmap
+ * @pbuf: optional pointer to the mapped data, reset to %NULL
+ *
+ * Unmaps the VA buffer @buf_id, e.g. prior to vaRenderPicture().
+ */
+void
+gst_vaapi_buffer_arena_unmap_buffer(
+    GstVaapiBufferArena *arena,
+    VABufferID           buf_id,
+    gpointer            *pbuf
+)
+{
+    BufferInfo *info;
+
+    g_return_if_fail(arena != NULL);
+
+    info = g_hash_table_lookup(arena->buffers, GUINT_TO_POINTER(buf_id));
+    if (info)
+        info->is_mapped = FALSE;
+    vaapi_unmap_buffer(arena->display, buf_id, pbuf);
+}
+
+/**
+ * gst_vaapi_buffer_arena_destroy_buffer:
+ * @arena: a #GstVaapiBufferArena
+ * @buf_id_ptr: pointer to the VA buffer id to release
+ *
+ * Releases the VA buffer pointed to by @buf_id_ptr back to @arena, so
+ * that it can be reused by a subsequent picture. The buffer is really
+ * destroyed if it was not created by @arena, or if enough idle buffers
+ * of that class are already available. On return, @buf_id_ptr is
+ * reset to %VA_INVALID_ID.
+ */
+void
+gst_vaapi_buffer_arena_destroy_buffer(
+    GstVaapiBufferArena *arena,
+    VABufferID          *buf_id_ptr
+)
+{
+    BufferInfo *info;
+    VABufferID buf_id;
+
+    g_return_if_fail(arena != NULL);
+
+    if (!buf_id_ptr || *buf_id_ptr == VA_INVALID_ID)
+        return;
+
+    buf_id = *buf_id_ptr;
+    info = g_hash_table_lookup(arena->buffers, GUINT_TO_POINTER(buf_id));
+    if (!info || g_queue_get_length(&info->klass->free_buffers) >=
+        MAX_CACHED_BUFFERS_PER_CLASS) {
+        if (info)
+            g_hash_table_remove(arena->buffers, GUINT_TO_POINTER(buf_id));
+        vaapi_destroy_buffer(arena->display, buf_id_ptr);
+        arena->stats.destroyed++;
+        return;
+    }
+
+    /* Buffers handed out mapped may not have been unmapped yet, e.g.
+       if the picture was dropped before being decoded */
+    if (info->is_mapped) {
+        vaapi_unmap_buffer(arena->display, buf_id, NULL);
+        info->is_mapped = FALSE;
+    }
+    g_queue_push_tail(&info->klass->free_buffers, GUINT_TO_POINTER(buf_id));
+    *buf_id_ptr = VA_INVALID_ID;
+}
+
+/**
+ * gst_vaapi_buffer_arena_get_stats:
+ * @arena: a #GstVaapiBufferArena
+ * @stats: return location for the #GstVaapiBufferArenaStats
+ *
+ * Retrieves the usage statistics of @arena.
+ */
+void
+gst_vaapi_buffer_arena_get_stats(
+    GstVaapiBufferArena      *arena,
+    GstVaapiBufferArenaStats *stats
+)
+{
+    guint i;
+
+    g_return_if_fail(arena != NULL);
+    g_return_if_fail(stats != NULL);
+
+    *stats = arena->stats;
+    stats->cached = 0;
+    for (i = 0; i < arena->classes->len; i++) {
+        BufferClass * const klass = g_ptr_array_index(arena->classes, i);
+        stats->cached += g_queue_get_length(&klass->free_buffers);
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ *  gstvaapibufferarena.h - VA buffer recycling arena
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_BUFFER_ARENA_H
+#define GST_VAAPI_BUFFER_ARENA_H
+
+#include <glib.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiBufferArena             GstVaapiBufferArena;
+typedef struct _GstVaapiBufferArenaStats        GstVaapiBufferArenaStats;
+
+/**
+ * GstVaapiBufferArenaStats:
+ * @hits: number of buffer requests served from a recycled VA buffer
+ * @misses: number of buffer requests that needed vaCreateBuffer()
+ * @destroyed: number of VA buffers actually destroyed
+ * @cached: number of idle VA buffers currently held by the arena
+ *
+ * Usage statistics of a #GstVaapiBufferArena.
+ */
+struct _GstVaapiBufferArenaStats {
+    guint       hits;
+    guint       misses;
+    guint       destroyed;
+    guint       cached;
+};
+
+G_GNUC_INTERNAL
+GstVaapiBufferArena *
+gst_vaapi_buffer_arena_new(VADisplay dpy, VAContextID ctx);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_arena_free(GstVaapiBufferArena *arena);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_buffer_arena_create_buffer(
+    GstVaapiBufferArena *arena,
+    int                  type,
+    guint                size,
+    gconstpointer        data,
+    VABufferID          *buf_id_ptr,
+    gpointer            *mapped_data
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_arena_unmap_buffer(
+    GstVaapiBufferArena *arena,
+    VABufferID           buf_id,
+    gpointer            *pbuf
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_arena_destroy_buffer(
+    GstVaapiBufferArena *arena,
+    VABufferID          *buf_id_ptr
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_buffer_arena_get_stats(
+    GstVaapiBufferArena      *arena,
+    GstVaapiBufferArenaStats *stats
+);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_BUFFER_ARENA_H */
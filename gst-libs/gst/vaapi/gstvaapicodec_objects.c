@@ -141,7 +141,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE(GstVaapiIqMatrix,
 static void
 gst_vaapi_iq_matrix_destroy(GstVaapiIqMatrix *iq_matrix)
 {
-    vaapi_destroy_buffer(GET_VA_DISPLAY(iq_matrix), &iq_matrix->param_id);
+    gst_vaapi_decoder_destroy_buffer(GET_DECODER(iq_matrix),
+                                     &iq_matrix->param_id);
     iq_matrix->param = NULL;
 }
 
@@ -151,13 +152,14 @@ gst_vaapi_iq_matrix_create(
     const GstVaapiCodecObjectConstructorArgs *args
 )
 {
-    return vaapi_create_buffer(GET_VA_DISPLAY(iq_matrix),
-                               GET_VA_CONTEXT(iq_matrix),
-                               VAIQMatrixBufferType,
-                               args->param_size,
-                               args->param,
-                               &iq_matrix->param_id,
-                               &iq_matrix->param);
+    return gst_vaapi_decoder_create_buffer(
+        GET_DECODER(iq_matrix),
+        VAIQMatrixBufferType,
+        args->param_size,
+        args->param,
+        &iq_matrix->param_id,
+        &iq_matrix->param
+    );
 }
 
 static void
@@ -200,7 +202,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE(GstVaapiBitPlane,
 static void
 gst_vaapi_bitplane_destroy(GstVaapiBitPlane *bitplane)
 {
-    vaapi_destroy_buffer(GET_VA_DISPLAY(bitplane), &bitplane->data_id);
+    gst_vaapi_decoder_destroy_buffer(GET_DECODER(bitplane),
+                                     &bitplane->data_id);
     bitplane->data = NULL;
 }
 
@@ -210,13 +213,14 @@ gst_vaapi_bitplane_create(
     const GstVaapiCodecObjectConstructorArgs *args
 )
 {
-    return vaapi_create_buffer(GET_VA_DISPLAY(bitplane),
-                               GET_VA_CONTEXT(bitplane),
-                               VABitPlaneBufferType,
-                               args->param_size,
-                               args->param,
-                               &bitplane->data_id,
-                               (void **)&bitplane->data);
+    return gst_vaapi_decoder_create_buffer(
+        GET_DECODER(bitplane),
+        VABitPlaneBufferType,
+        args->param_size,
+        args->param,
+        &bitplane->data_id,
+        (void **)&bitplane->data
+    );
 }
 
 static void
@@ -256,7 +260,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE(GstVaapiHuffmanTable,
 static void
 gst_vaapi_huffman_table_destroy(GstVaapiHuffmanTable *huf_table)
 {
-    vaapi_destroy_buffer(GET_VA_DISPLAY(huf_table), &huf_table->param_id);
+    gst_vaapi_decoder_destroy_buffer(GET_DECODER(huf_table),
+                                     &huf_table->param_id);
     huf_table->param = NULL;
 }
 
@@ -266,13 +271,14 @@ gst_vaapi_huffman_table_create(
     const GstVaapiCodecObjectConstructorArgs *args
 )
 {
-    return vaapi_create_buffer(GET_VA_DISPLAY(huf_table),
-                               GET_VA_CONTEXT(huf_table),
-                               VAHuffmanTableBufferType,
-                               args->param_size,
-                               args->param,
-                               &huf_table->param_id,
-                               (void **)&huf_table->param);
+    return gst_vaapi_decoder_create_buffer(
+        GET_DECODER(huf_table),
+        VAHuffmanTableBufferType,
+        args->param_size,
+        args->param,
+        &huf_table->param_id,
+        (void **)&huf_table->param
+    );
 }
 
 static void
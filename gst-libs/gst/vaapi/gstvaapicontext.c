@@ -27,6 +27,7 @@
 
 #include "sysdeps.h"
 #include <assert.h>
+#include <string.h>
 #include "gstvaapicompat.h"
 #include "gstvaapicontext.h"
 #include "gstvaapisurface.h"
@@ -34,6 +35,7 @@
 #include "gstvaapisurfacepool.h"
 #include "gstvaapiimage.h"
 #include "gstvaapisubpicture.h"
+#include "gstvaapiatlas.h"
 #include "gstvaapiutils.h"
 #include "gstvaapi_priv.h"
 
@@ -47,12 +49,21 @@ G_DEFINE_TYPE(GstVaapiContext, gst_vaapi_context, GST_VAAPI_TYPE_OBJECT)
                                  GST_VAAPI_TYPE_CONTEXT,	\
                                  GstVaapiContextPrivate))
 
+/* Overlay rectangles up to this size share a single subpicture image */
+#define OVERLAY_ATLAS_MAX_RECT_WIDTH    512
+#define OVERLAY_ATLAS_MAX_RECT_HEIGHT   128
+#define OVERLAY_ATLAS_WIDTH             1024
+#define OVERLAY_ATLAS_HEIGHT            1024
+
 typedef struct _GstVaapiOverlayRectangle GstVaapiOverlayRectangle;
 struct _GstVaapiOverlayRectangle {
     GstVaapiContext    *context;
     GstVaapiSubpicture *subpicture;
     GstVaapiRectangle   rect;
+    GstVaapiRectangle   atlas_rect;
     guint               seq_num;
+    guint               in_atlas        : 1;
+    guint               is_associated   : 1;
 };
 
 /* XXX: optimize for the effective number of reference frames */
@@ -61,12 +72,22 @@ struct _GstVaapiContextPrivate {
     GPtrArray          *surfaces;
     GstVaapiVideoPool  *surfaces_pool;
     GPtrArray          *overlay;
+    GstVaapiAtlas      *overlay_atlas;
+    GstVaapiImage      *overlay_atlas_image;
+    guint               overlay_atlas_uploads;
+    guint               overlay_uploads;
+    guint               overlay_uploads_saved;
+    guint               overlay_moves;
+    guint               overlay_unchanged;
+    guint               overlay_rate_saved;
+    gint64              overlay_rate_time;
     GstVaapiProfile     profile;
     GstVaapiEntrypoint  entrypoint;
     guint               width;
     guint               height;
     guint               ref_frames;
     guint               is_constructed  : 1;
+    guint               use_overlay_atlas : 1;
 };
 
 enum {
@@ -127,9 +148,151 @@ overlay_rectangle_destroy(GstVaapiOverlayRectangle *overlay)
         g_object_unref(overlay->subpicture);
         overlay->subpicture = NULL;
     }
+    if (overlay->in_atlas)
+        gst_vaapi_atlas_release(priv->overlay_atlas, &overlay->atlas_rect);
     g_slice_free(GstVaapiOverlayRectangle, overlay);
 }
 
+/* Associates the overlay subpicture to all the context surfaces */
+static gboolean
+overlay_rectangle_associate(GstVaapiOverlayRectangle *overlay)
+{
+    GstVaapiContextPrivate * const priv = overlay->context->priv;
+    guint i;
+
+    for (i = 0; i < priv->surfaces->len; i++) {
+        GstVaapiSurface * const surface = g_ptr_array_index(priv->surfaces, i);
+        if (!gst_vaapi_surface_associate_subpicture(surface,
+                 overlay->subpicture,
+                 overlay->in_atlas ? &overlay->atlas_rect : NULL,
+                 &overlay->rect))
+            return FALSE;
+    }
+    overlay->is_associated = TRUE;
+    return TRUE;
+}
+
+/* Deassociates the overlay subpicture from all the context surfaces */
+static void
+overlay_rectangle_deassociate(GstVaapiOverlayRectangle *overlay)
+{
+    GstVaapiContextPrivate * const priv = overlay->context->priv;
+    guint i;
+
+    for (i = 0; i < priv->surfaces->len; i++) {
+        GstVaapiSurface * const surface = g_ptr_array_index(priv->surfaces, i);
+        gst_vaapi_surface_deassociate_subpicture(surface, overlay->subpicture);
+    }
+    overlay->is_associated = FALSE;
+}
+
+static gboolean
+ensure_overlay_atlas(GstVaapiContext *context)
+{
+    GstVaapiContextPrivate * const priv = context->priv;
+    GstVaapiImageFormat format;
+
+    if (!priv->overlay_atlas) {
+        priv->overlay_atlas =
+            gst_vaapi_atlas_new(OVERLAY_ATLAS_WIDTH, OVERLAY_ATLAS_HEIGHT);
+        if (!priv->overlay_atlas)
+            return FALSE;
+    }
+
+    if (!priv->overlay_atlas_image) {
+        /* Same format as gst_vaapi_subpicture_new_from_overlay_rectangle() */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+        format = GST_VAAPI_IMAGE_BGRA;
+#else
+        format = GST_VAAPI_IMAGE_ARGB;
+#endif
+        priv->overlay_atlas_image = gst_vaapi_image_new(
+            GST_VAAPI_OBJECT_DISPLAY(context),
+            format,
+            OVERLAY_ATLAS_WIDTH, OVERLAY_ATLAS_HEIGHT
+        );
+        if (!priv->overlay_atlas_image)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+destroy_overlay_atlas(GstVaapiContext *context)
+{
+    GstVaapiContextPrivate * const priv = context->priv;
+
+    if (priv->overlay_atlas_image) {
+        if (gst_vaapi_image_is_mapped(priv->overlay_atlas_image))
+            gst_vaapi_image_unmap(priv->overlay_atlas_image);
+        g_object_unref(priv->overlay_atlas_image);
+        priv->overlay_atlas_image = NULL;
+    }
+
+    if (priv->overlay_atlas) {
+        gst_vaapi_atlas_free(priv->overlay_atlas);
+        priv->overlay_atlas = NULL;
+    }
+}
+
+/* Packs small overlay rectangles into the shared atlas image, and binds
+   them to a subpicture of that image. The atlas image is left mapped
+   until all rectangles of the composition are uploaded */
+static gboolean
+overlay_rectangle_upload_to_atlas(
+    GstVaapiOverlayRectangle *overlay,
+    GstVideoOverlayRectangle *rect
+)
+{
+    GstVaapiContext * const context = overlay->context;
+    GstVaapiContextPrivate * const priv = context->priv;
+    GstBuffer *buffer;
+    guint8 *dst;
+    const guint8 *src;
+    guint width, height, stride, dst_stride, y;
+
+    if (!priv->use_overlay_atlas)
+        return FALSE;
+
+    buffer = gst_video_overlay_rectangle_get_pixels_unscaled_argb(
+        rect,
+        &width, &height, &stride,
+        GST_VIDEO_OVERLAY_FORMAT_FLAG_NONE
+    );
+    if (!buffer)
+        return FALSE;
+    if (width > OVERLAY_ATLAS_MAX_RECT_WIDTH ||
+        height > OVERLAY_ATLAS_MAX_RECT_HEIGHT)
+        return FALSE;
+
+    if (!ensure_overlay_atlas(context))
+        return FALSE;
+    if (!gst_vaapi_atlas_alloc(priv->overlay_atlas, width, height,
+                               &overlay->atlas_rect))
+        return FALSE;
+    overlay->in_atlas = TRUE;
+
+    if (!gst_vaapi_image_is_mapped(priv->overlay_atlas_image) &&
+        !gst_vaapi_image_map(priv->overlay_atlas_image))
+        return FALSE;
+
+    dst_stride = gst_vaapi_image_get_pitch(priv->overlay_atlas_image, 0);
+    dst = gst_vaapi_image_get_plane(priv->overlay_atlas_image, 0) +
+        overlay->atlas_rect.y * dst_stride + overlay->atlas_rect.x * 4;
+    src = GST_BUFFER_DATA(buffer);
+    for (y = 0; y < height; y++) {
+        memcpy(dst, src, width * 4);
+        dst += dst_stride;
+        src += stride;
+    }
+
+    overlay->subpicture = gst_vaapi_subpicture_new(priv->overlay_atlas_image);
+    if (!overlay->subpicture)
+        return FALSE;
+    priv->overlay_atlas_uploads++;
+    return TRUE;
+}
+
 static void
 destroy_overlay_cb(gpointer data, gpointer user_data)
 {
@@ -166,6 +329,7 @@ gst_vaapi_context_destroy_surfaces(GstVaapiContext *context)
     GstVaapiContextPrivate * const priv = context->priv;
 
     gst_vaapi_context_destroy_overlay(context);
+    destroy_overlay_atlas(context);
 
     if (priv->surfaces) {
         g_ptr_array_foreach(priv->surfaces, unref_surface_cb, NULL);
@@ -512,16 +676,26 @@ gst_vaapi_context_init(GstVaapiContext *context)
 {
     GstVaapiContextPrivate *priv = GST_VAAPI_CONTEXT_GET_PRIVATE(context);
 
-    context->priv       = priv;
-    priv->config_id     = VA_INVALID_ID;
-    priv->surfaces      = NULL;
-    priv->surfaces_pool = NULL;
-    priv->overlay       = NULL;
-    priv->profile       = 0;
-    priv->entrypoint    = 0;
-    priv->width         = 0;
-    priv->height        = 0;
-    priv->ref_frames    = 0;
+    context->priv               = priv;
+    priv->config_id             = VA_INVALID_ID;
+    priv->surfaces              = NULL;
+    priv->surfaces_pool         = NULL;
+    priv->overlay               = NULL;
+    priv->overlay_atlas         = NULL;
+    priv->overlay_atlas_image   = NULL;
+    priv->overlay_atlas_uploads = 0;
+    priv->overlay_uploads       = 0;
+    priv->overlay_uploads_saved = 0;
+    priv->overlay_unchanged     = 0;
+    priv->overlay_moves         = 0;
+    priv->overlay_rate_saved    = 0;
+    priv->overlay_rate_time     = 0;
+    priv->profile               = 0;
+    priv->entrypoint            = 0;
+    priv->width                 = 0;
+    priv->height                = 0;
+    priv->ref_frames            = 0;
+    priv->use_overlay_atlas     = TRUE;
 }
 
 /**
@@ -605,7 +779,8 @@ gst_vaapi_context_new_full(GstVaapiDisplay *display, GstVaapiContextInfo *cip)
  * @height: coded height from the bitstream
  *
  * Resets @context to the specified codec @profile and @entrypoint.
- * The surfaces will be reallocated if the coded size changed.
+ * The surfaces, and the underlying VA context, will be reallocated if
+ * the coded size changed.
  *
  * Return value: %TRUE on success
  */
@@ -637,7 +812,9 @@ gst_vaapi_context_reset(
  *
  * Resets @context to the configuration specified by @cip, thus
  * including profile, entry-point, encoded size and maximum number of
- * reference frames reported by the bitstream.
+ * reference frames reported by the bitstream. A new VA context is
+ * created if the codec or the size changed, with new surfaces in the
+ * latter case.
  *
  * Return value: %TRUE on success
  */
@@ -648,15 +825,20 @@ gst_vaapi_context_reset_full(GstVaapiContext *context, GstVaapiContextInfo *cip)
     gboolean size_changed, codec_changed;
 
     size_changed = priv->width != cip->width || priv->height != cip->height;
+    codec_changed = priv->profile != cip->profile || priv->entrypoint != cip->entrypoint;
+
+    /* The VA context is created for a picture size and with the surfaces
+       as render targets, so it goes away with them, and first */
+    if (size_changed || codec_changed)
+        gst_vaapi_context_destroy(context);
+
     if (size_changed) {
         gst_vaapi_context_destroy_surfaces(context);
         priv->width  = cip->width;
         priv->height = cip->height;
     }
 
-    codec_changed = priv->profile != cip->profile || priv->entrypoint != cip->entrypoint;
     if (codec_changed) {
-        gst_vaapi_context_destroy(context);
         priv->profile    = cip->profile;
         priv->entrypoint = cip->entrypoint;
     }
@@ -664,7 +846,7 @@ gst_vaapi_context_reset_full(GstVaapiContext *context, GstVaapiContextInfo *cip)
     if (size_changed && !gst_vaapi_context_create_surfaces(context))
         return FALSE;
 
-    if (codec_changed && !gst_vaapi_context_create(context))
+    if ((size_changed || codec_changed) && !gst_vaapi_context_create(context))
         return FALSE;
 
     priv->is_constructed = TRUE;
@@ -810,6 +992,26 @@ gst_vaapi_context_get_surface_count(GstVaapiContext *context)
     return gst_vaapi_video_pool_get_size(context->priv->surfaces_pool);
 }
 
+/**
+ * gst_vaapi_context_wait_surface:
+ * @context: a #GstVaapiContext
+ * @timeout: the maximum time to wait, in microseconds
+ *
+ * Waits until a free surface is available in the pool, i.e. until a
+ * surface is released through gst_vaapi_context_put_surface(), or
+ * until @timeout microseconds have elapsed.
+ *
+ * Return value: %TRUE if a free surface is available
+ */
+gboolean
+gst_vaapi_context_wait_surface(GstVaapiContext *context, guint64 timeout)
+{
+    g_return_val_if_fail(GST_VAAPI_IS_CONTEXT(context), FALSE);
+
+    return gst_vaapi_video_pool_wait_object(context->priv->surfaces_pool,
+                                            timeout);
+}
+
 /**
  * gst_vaapi_context_put_surface:
  * @context: a #GstVaapiContext
@@ -857,6 +1059,25 @@ gst_vaapi_context_find_surface_by_id(GstVaapiContext *context, GstVaapiID id)
     return NULL;
 }
 
+static inline void
+get_render_rectangle(GstVideoOverlayRectangle *rect, GstVaapiRectangle *r)
+{
+    gst_video_overlay_rectangle_get_render_rectangle(
+        rect,
+        (gint *)&r->x,
+        (gint *)&r->y,
+        &r->width,
+        &r->height
+    );
+}
+
+static inline gboolean
+equal_rectangles(const GstVaapiRectangle *a, const GstVaapiRectangle *b)
+{
+    return (a->x == b->x && a->y == b->y &&
+            a->width == b->width && a->height == b->height);
+}
+
 /* Check if composition changed */
 static gboolean
 gst_vaapi_context_composition_changed(
@@ -867,6 +1088,7 @@ gst_vaapi_context_composition_changed(
     GstVaapiContextPrivate * const priv = context->priv;
     GstVaapiOverlayRectangle *overlay;
     GstVideoOverlayRectangle *rect;
+    GstVaapiRectangle render_rect;
     guint i, n_rectangles;
 
     if (!priv->overlay || !composition)
@@ -883,10 +1105,67 @@ gst_vaapi_context_composition_changed(
         g_return_val_if_fail(overlay, TRUE);
         if (overlay->seq_num != gst_video_overlay_rectangle_get_seqnum(rect))
             return TRUE;
+        get_render_rectangle(rect, &render_rect);
+        if (!equal_rectangles(&overlay->rect, &render_rect))
+            return TRUE;
     }
     return FALSE;
 }
 
+/* Extracts the overlay rectangle with the specified seqnum, if any */
+static GstVaapiOverlayRectangle *
+steal_overlay_rectangle(GPtrArray *overlays, guint seq_num)
+{
+    GstVaapiOverlayRectangle *overlay;
+    guint i;
+
+    if (!overlays)
+        return NULL;
+
+    for (i = 0; i < overlays->len; i++) {
+        overlay = g_ptr_array_index(overlays, i);
+        if (overlay && overlay->seq_num == seq_num) {
+            g_ptr_array_index(overlays, i) = NULL;
+            return overlay;
+        }
+    }
+    return NULL;
+}
+
+/* Logs the number of subpicture uploads saved per second */
+static void
+update_overlay_stats(GstVaapiContext *context, guint num_saved)
+{
+    GstVaapiContextPrivate * const priv = context->priv;
+    gint64 now, elapsed;
+
+    priv->overlay_uploads_saved += num_saved;
+    priv->overlay_rate_saved    += num_saved;
+
+    now = g_get_monotonic_time();
+    if (!priv->overlay_rate_time)
+        priv->overlay_rate_time = now;
+    elapsed = now - priv->overlay_rate_time;
+    if (elapsed < G_USEC_PER_SEC)
+        return;
+
+    GST_DEBUG("overlay: %.1f uploads saved per second "
+              "(%u uploads, %u saved, %u moves, %u unchanged compositions "
+              "in total)",
+              (gdouble)priv->overlay_rate_saved * G_USEC_PER_SEC / elapsed,
+              priv->overlay_uploads, priv->overlay_uploads_saved,
+              priv->overlay_moves, priv->overlay_unchanged);
+    if (priv->overlay_atlas)
+        GST_DEBUG("overlay atlas: %u rectangles, %u rows, "
+                  "%.1f%% packing efficiency, %u uploads in total",
+                  gst_vaapi_atlas_get_num_rects(priv->overlay_atlas),
+                  gst_vaapi_atlas_get_used_height(priv->overlay_atlas),
+                  100.0 * gst_vaapi_atlas_get_efficiency(priv->overlay_atlas),
+                  priv->overlay_atlas_uploads);
+    priv->overlay_rate_saved = 0;
+    priv->overlay_rate_time  = now;
+}
+
 /**
  * gst_vaapi_context_apply_composition:
  * @context: a #GstVaapiContext
@@ -897,6 +1176,12 @@ gst_vaapi_context_composition_changed(
  * have associated himself. A %NULL @composition will also clear all
  * the existing subpictures.
  *
+ * Only the rectangles that were not part of the previous composition,
+ * as identified by their seqnum, are uploaded to new subpictures. The
+ * other ones are kept as is, or only moved if their render rectangle
+ * changed. Small rectangles are packed into a single image shared by
+ * their subpictures, see gst_vaapi_context_set_overlay_atlas().
+ *
  * Return value: %TRUE if all composition planes could be applied,
  *   %FALSE otherwise
  */
@@ -910,7 +1195,11 @@ gst_vaapi_context_apply_composition(
     GstVideoOverlayRectangle *rect;
     GstVaapiOverlayRectangle *overlay = NULL;
     GstVaapiDisplay *display;
-    guint i, j, n_rectangles;
+    GstVaapiOverlayRectangle **reused_overlay;
+    GstVaapiRectangle render_rect;
+    GPtrArray *old_overlay;
+    guint i, n_rectangles, num_saved = 0;
+    gboolean success = FALSE;
 
     g_return_val_if_fail(GST_VAAPI_IS_CONTEXT(context), FALSE);
 
@@ -922,54 +1211,204 @@ gst_vaapi_context_apply_composition(
     if (!display)
         return FALSE;
 
-    if (!gst_vaapi_context_composition_changed(context, composition))
+    /* An unchanged composition was never uploaded again, so its
+       rectangles are not counted as saved uploads */
+    if (!gst_vaapi_context_composition_changed(context, composition)) {
+        if (priv->overlay) {
+            priv->overlay_unchanged++;
+            update_overlay_stats(context, 0);
+        }
         return TRUE;
-    gst_vaapi_context_destroy_overlay(context);
+    }
 
-    if (!composition)
+    if (!composition) {
+        gst_vaapi_context_destroy_overlay(context);
         return TRUE;
-    if (!gst_vaapi_context_create_overlay(context))
-        return FALSE;
+    }
 
+    /* Pick the rectangles of the previous composition that are reused,
+       and release the other ones first, so that their room in the atlas
+       is available to the new rectangles */
     n_rectangles = gst_video_overlay_composition_n_rectangles(composition);
+    reused_overlay = g_new0(GstVaapiOverlayRectangle *, n_rectangles);
     for (i = 0; i < n_rectangles; i++) {
         rect = gst_video_overlay_composition_get_rectangle(composition, i);
+        reused_overlay[i] = steal_overlay_rectangle(priv->overlay,
+            gst_video_overlay_rectangle_get_seqnum(rect));
+    }
+
+    old_overlay = priv->overlay;
+    priv->overlay = NULL;
+    if (old_overlay) {
+        g_ptr_array_foreach(old_overlay, destroy_overlay_cb, NULL);
+        g_ptr_array_free(old_overlay, TRUE);
+    }
+    if (!gst_vaapi_context_create_overlay(context))
+        goto end;
+
+    for (i = 0; i < n_rectangles; i++) {
+        rect = gst_video_overlay_composition_get_rectangle(composition, i);
+        get_render_rectangle(rect, &render_rect);
+
+        overlay = reused_overlay[i];
+        if (overlay) {
+            reused_overlay[i] = NULL;
+            num_saved++;
+            g_ptr_array_add(priv->overlay, overlay);
+            if (equal_rectangles(&overlay->rect, &render_rect))
+                continue;
+            /* Moved, associated again below */
+            priv->overlay_moves++;
+            overlay_rectangle_deassociate(overlay);
+            overlay->rect = render_rect;
+            continue;
+        }
 
         overlay = overlay_rectangle_new(context);
         if (!overlay) {
             GST_WARNING("could not create VA overlay rectangle");
-            return FALSE;
+            goto end;
         }
         overlay->seq_num = gst_video_overlay_rectangle_get_seqnum(rect);
+        overlay->rect    = render_rect;
 
-        overlay->subpicture = gst_vaapi_subpicture_new_from_overlay_rectangle(
-            display,
-            rect
-        );
+        if (!overlay_rectangle_upload_to_atlas(overlay, rect)) {
+            if (overlay->subpicture) {
+                g_object_unref(overlay->subpicture);
+                overlay->subpicture = NULL;
+            }
+            if (overlay->in_atlas) {
+                gst_vaapi_atlas_release(priv->overlay_atlas,
+                    &overlay->atlas_rect);
+                overlay->in_atlas = FALSE;
+            }
+            overlay->subpicture =
+                gst_vaapi_subpicture_new_from_overlay_rectangle(display, rect);
+        }
         if (!overlay->subpicture) {
             overlay_rectangle_destroy(overlay);
-            return FALSE;
+            goto end;
         }
+        priv->overlay_uploads++;
+        g_ptr_array_add(priv->overlay, overlay);
+    }
 
-        gst_video_overlay_rectangle_get_render_rectangle(
-            rect,
-            (gint *)&overlay->rect.x,
-            (gint *)&overlay->rect.y,
-            &overlay->rect.width,
-            &overlay->rect.height
-        );
+    /* The atlas image must be unmapped before it is used for rendering */
+    if (priv->overlay_atlas_image &&
+        gst_vaapi_image_is_mapped(priv->overlay_atlas_image) &&
+        !gst_vaapi_image_unmap(priv->overlay_atlas_image))
+        goto end;
 
-        for (j = 0; j < priv->surfaces->len; j++) {
-            GstVaapiSurface * const surface =
-                g_ptr_array_index(priv->surfaces, j);
-            if (!gst_vaapi_surface_associate_subpicture(surface,
-                         overlay->subpicture, NULL, &overlay->rect)) {
-                GST_WARNING("could not render overlay rectangle %p", rect);
-                overlay_rectangle_destroy(overlay);
-                return FALSE;
-            }
+    for (i = 0; i < priv->overlay->len; i++) {
+        overlay = g_ptr_array_index(priv->overlay, i);
+        if (overlay->is_associated)
+            continue;
+        if (!overlay_rectangle_associate(overlay)) {
+            GST_WARNING("could not render overlay rectangle %u", i);
+            goto end;
         }
-        g_ptr_array_add(priv->overlay, overlay);
     }
-    return TRUE;
+    success = TRUE;
+
+end:
+    for (i = 0; i < n_rectangles; i++)
+        overlay_rectangle_destroy(reused_overlay[i]);
+    g_free(reused_overlay);
+    update_overlay_stats(context, num_saved);
+    return success;
+}
+
+/**
+ * gst_vaapi_context_get_overlay_stats:
+ * @context: a #GstVaapiContext
+ * @pnum_uploads: return location for the number of subpicture uploads,
+ *   or %NULL
+ * @pnum_uploads_saved: return location for the number of subpicture
+ *   uploads avoided by reusing the subpicture of a previous
+ *   composition, or %NULL
+ * @pnum_moves: return location for the number of subpictures moved
+ *   without being uploaded again, or %NULL
+ * @pnum_unchanged: return location for the number of compositions
+ *   identical to the previous one, and thus left as is, or %NULL
+ *
+ * Retrieves the statistics of gst_vaapi_context_apply_composition()
+ * since @context was created. Only the rectangles of a changed
+ * composition that are kept from the previous one count as saved
+ * uploads, unchanged compositions are counted apart.
+ */
+void
+gst_vaapi_context_get_overlay_stats(
+    GstVaapiContext *context,
+    guint           *pnum_uploads,
+    guint           *pnum_uploads_saved,
+    guint           *pnum_moves,
+    guint           *pnum_unchanged
+)
+{
+    GstVaapiContextPrivate *priv;
+
+    g_return_if_fail(GST_VAAPI_IS_CONTEXT(context));
+
+    priv = context->priv;
+    if (pnum_uploads)
+        *pnum_uploads = priv->overlay_uploads;
+    if (pnum_uploads_saved)
+        *pnum_uploads_saved = priv->overlay_uploads_saved;
+    if (pnum_moves)
+        *pnum_moves = priv->overlay_moves;
+    if (pnum_unchanged)
+        *pnum_unchanged = priv->overlay_unchanged;
+}
+
+/**
+ * gst_vaapi_context_set_overlay_atlas:
+ * @context: a #GstVaapiContext
+ * @enabled: %TRUE to pack small overlay rectangles together
+ *
+ * Enables or disables the packing of small overlay rectangles into a
+ * single VA image, shared by their subpictures. This saves the VA image
+ * and buffer of each rectangle, and uploads all the new rectangles of
+ * a composition with a single mapping. This is enabled by default and
+ * only applies to the rectangles uploaded afterwards.
+ */
+void
+gst_vaapi_context_set_overlay_atlas(GstVaapiContext *context, gboolean enabled)
+{
+    g_return_if_fail(GST_VAAPI_IS_CONTEXT(context));
+
+    context->priv->use_overlay_atlas = enabled;
+}
+
+/**
+ * gst_vaapi_context_get_overlay_atlas_stats:
+ * @context: a #GstVaapiContext
+ * @pnum_rects: return location for the number of overlay rectangles
+ *   currently packed into the atlas, or %NULL
+ * @pefficiency: return location for the packing efficiency of the
+ *   atlas, between 0 and 1, or %NULL
+ *
+ * Retrieves the state of the atlas of small overlay rectangles.
+ *
+ * Return value: the number of overlay rectangles uploaded into the
+ *   atlas since @context was created
+ */
+guint
+gst_vaapi_context_get_overlay_atlas_stats(
+    GstVaapiContext *context,
+    guint           *pnum_rects,
+    gdouble         *pefficiency
+)
+{
+    GstVaapiContextPrivate *priv;
+
+    g_return_val_if_fail(GST_VAAPI_IS_CONTEXT(context), 0);
+
+    priv = context->priv;
+    if (pnum_rects)
+        *pnum_rects = priv->overlay_atlas ?
+            gst_vaapi_atlas_get_num_rects(priv->overlay_atlas) : 0;
+    if (pefficiency)
+        *pefficiency = priv->overlay_atlas ?
+            gst_vaapi_atlas_get_efficiency(priv->overlay_atlas) : 0.0;
+    return priv->overlay_atlas_uploads;
 }
@@ -149,6 +149,9 @@ gst_vaapi_context_get_surface(GstVaapiContext *context);
 guint
 gst_vaapi_context_get_surface_count(GstVaapiContext *context);
 
+gboolean
+gst_vaapi_context_wait_surface(GstVaapiContext *context, guint64 timeout);
+
 void
 gst_vaapi_context_put_surface(GstVaapiContext *context, GstVaapiSurface *surface);
 
@@ -161,6 +164,25 @@ gst_vaapi_context_apply_composition(
     GstVideoOverlayComposition *composition
 );
 
+void
+gst_vaapi_context_get_overlay_stats(
+    GstVaapiContext *context,
+    guint           *pnum_uploads,
+    guint           *pnum_uploads_saved,
+    guint           *pnum_moves,
+    guint           *pnum_unchanged
+);
+
+void
+gst_vaapi_context_set_overlay_atlas(GstVaapiContext *context, gboolean enabled);
+
+guint
+gst_vaapi_context_get_overlay_atlas_stats(
+    GstVaapiContext *context,
+    guint           *pnum_rects,
+    gdouble         *pefficiency
+);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_CONTEXT_H */
@@ -0,0 +1,71 @@
+/*
+ *  gstvaapicpu.c - CPU features detection
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include "gstvaapicpu.h"
+
+/* Set once the flags are determined, so that zero flags are cached too */
+#define CPU_FLAGS_DETECTED ((gsize)1 << 31)
+
+static guint
+detect_cpu_flags(void)
+{
+    guint flags = 0;
+
+#if GST_VAAPI_CPU_HAS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        flags |= GST_VAAPI_CPU_FLAG_SSE2;
+    if (__builtin_cpu_supports("ssse3"))
+        flags |= GST_VAAPI_CPU_FLAG_SSSE3;
+    if (__builtin_cpu_supports("sse4.1"))
+        flags |= GST_VAAPI_CPU_FLAG_SSE4_1;
+    if (__builtin_cpu_supports("avx2"))
+        flags |= GST_VAAPI_CPU_FLAG_AVX2;
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+    flags |= GST_VAAPI_CPU_FLAG_NEON;
+#endif
+    return flags;
+}
+
+/**
+ * gst_vaapi_cpu_get_flags:
+ *
+ * Determines the SIMD extensions available on this CPU, and for
+ * which optimized code was built. The GST_VAAPI_DISABLE_SIMD
+ * environment variable can be set to only use the generic C code.
+ *
+ * Return value: the set of usable #GstVaapiCpuFlags
+ */
+guint
+gst_vaapi_cpu_get_flags(void)
+{
+    static gsize g_cpu_flags = 0;
+
+    if (g_once_init_enter(&g_cpu_flags)) {
+        gsize flags = CPU_FLAGS_DETECTED;
+        if (!g_getenv("GST_VAAPI_DISABLE_SIMD"))
+            flags |= detect_cpu_flags();
+        g_once_init_leave(&g_cpu_flags, flags);
+    }
+    return g_cpu_flags & ~CPU_FLAGS_DETECTED;
+}
@@ -0,0 +1,72 @@
+/*
+ *  gstvaapicpu.h - CPU features detection
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_CPU_H
+#define GST_VAAPI_CPU_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* x86 SIMD code is compiled with per-function target attributes, so
+   that the rest of the library does not depend on these extensions */
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+# define GST_VAAPI_CPU_HAS_X86 1
+# define GST_VAAPI_CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+# define GST_VAAPI_CPU_HAS_X86 0
+#endif
+
+/* NEON code is only built if the compiler targets it by default */
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+# define GST_VAAPI_CPU_HAS_NEON 1
+#else
+# define GST_VAAPI_CPU_HAS_NEON 0
+#endif
+
+/**
+ * GstVaapiCpuFlags:
+ * @GST_VAAPI_CPU_FLAG_SSE2: x86 SSE2 instructions
+ * @GST_VAAPI_CPU_FLAG_SSSE3: x86 SSSE3 instructions
+ * @GST_VAAPI_CPU_FLAG_AVX2: x86 AVX2 instructions
+ * @GST_VAAPI_CPU_FLAG_NEON: ARM NEON instructions
+ * @GST_VAAPI_CPU_FLAG_SSE4_1: x86 SSE4.1 instructions
+ *
+ * The set of SIMD extensions the optimized code paths may use.
+ */
+typedef enum {
+    GST_VAAPI_CPU_FLAG_SSE2     = 1 << 0,
+    GST_VAAPI_CPU_FLAG_SSSE3    = 1 << 1,
+    GST_VAAPI_CPU_FLAG_AVX2     = 1 << 2,
+    GST_VAAPI_CPU_FLAG_NEON     = 1 << 3,
+    GST_VAAPI_CPU_FLAG_SSE4_1   = 1 << 4,
+} GstVaapiCpuFlags;
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_cpu_get_flags(void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_CPU_H */
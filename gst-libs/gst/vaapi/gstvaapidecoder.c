@@ -100,6 +100,26 @@ pop_buffer(GstVaapiDecoder *decoder)
     return buffer;
 }
 
+static GstVaapiDecoderStatus
+decode_buffer(GstVaapiDecoder *decoder, GstBuffer *buffer)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    GstVaapiDecoderStatus status;
+    GstClockTime start;
+    guint64 stage_time;
+
+    if (G_LIKELY(!priv->stage_stats))
+        return GST_VAAPI_DECODER_GET_CLASS(decoder)->decode(decoder, buffer);
+
+    /* Parsing is what remains once the other stages are accounted for */
+    stage_time = priv->stage_time;
+    start = gst_util_get_timestamp();
+    status = GST_VAAPI_DECODER_GET_CLASS(decoder)->decode(decoder, buffer);
+    gst_vaapi_decoder_stage_record(decoder, GST_VAAPI_DECODER_STAGE_PARSE,
+        gst_util_get_timestamp() - start - (priv->stage_time - stage_time));
+    return status;
+}
+
 static GstVaapiDecoderStatus
 decode_step(GstVaapiDecoder *decoder)
 {
@@ -111,17 +131,22 @@ decode_step(GstVaapiDecoder *decoder)
     if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
         return status;
 
+    GST_VAAPI_TRACE_BEGIN("decode_step", 0);
     do {
         buffer = pop_buffer(decoder);
         if (!buffer)
-            return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+            break;
 
-        status = GST_VAAPI_DECODER_GET_CLASS(decoder)->decode(decoder, buffer);
+        status = decode_buffer(decoder, buffer);
         GST_DEBUG("decode frame (status = %d)", status);
         if (status != GST_VAAPI_DECODER_STATUS_SUCCESS && GST_BUFFER_IS_EOS(buffer))
             status = GST_VAAPI_DECODER_STATUS_END_OF_STREAM;
         gst_buffer_unref(buffer);
     } while (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA);
+    GST_VAAPI_TRACE_END("decode_step", 0);
+
+    if (!buffer)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
     return status;
 }
 
@@ -221,12 +246,30 @@ gst_vaapi_decoder_finalize(GObject *object)
         priv->caps = NULL;
     }
 
+    if (priv->buffer_arena) {
+        gst_vaapi_buffer_arena_free(priv->buffer_arena);
+        priv->buffer_arena = NULL;
+    }
+
+    if (priv->va_buffers) {
+        g_array_free(priv->va_buffers, TRUE);
+        priv->va_buffers = NULL;
+    }
+
+    if (priv->num_pictures > 0)
+        GST_DEBUG("%u pictures decoded, %.2f VA submission calls per picture",
+                  priv->num_pictures,
+                  (gdouble)priv->num_va_calls / priv->num_pictures);
+
     if (priv->context) {
         g_object_unref(priv->context);
         priv->context = NULL;
         priv->va_context = VA_INVALID_ID;
     }
- 
+
+    g_free(priv->stage_stats);
+    priv->stage_stats = NULL;
+
     if (priv->buffers) {
         clear_queue(priv->buffers, (GDestroyNotify)destroy_buffer);
         g_queue_free(priv->buffers);
@@ -341,6 +384,10 @@ gst_vaapi_decoder_init(GstVaapiDecoder *decoder)
     priv->va_display            = NULL;
     priv->context               = NULL;
     priv->va_context            = VA_INVALID_ID;
+    priv->buffer_arena          = NULL;
+    priv->va_buffers            = g_array_new(FALSE, FALSE, sizeof(VABufferID));
+    priv->num_pictures          = 0;
+    priv->num_va_calls          = 0;
     priv->caps                  = NULL;
     priv->codec                 = 0;
     priv->codec_data            = NULL;
@@ -352,7 +399,11 @@ gst_vaapi_decoder_init(GstVaapiDecoder *decoder)
     priv->par_d                 = 0;
     priv->buffers               = g_queue_new();
     priv->surfaces              = g_queue_new();
+    priv->stage_stats           = NULL;
+    priv->stage_time            = 0;
+    priv->stage_depth           = 0;
     priv->is_interlaced         = FALSE;
+    priv->no_batch_render       = FALSE;
 }
 
 /**
@@ -432,6 +483,134 @@ gst_vaapi_decoder_get_surface(
     return proxy;
 }
 
+/**
+ * gst_vaapi_decoder_wait_surface:
+ * @decoder: a #GstVaapiDecoder
+ * @timeout: the maximum time to wait, in microseconds
+ *
+ * Waits until a VA surface is available for decoding, or until
+ * @timeout microseconds have elapsed. This is useful when
+ * gst_vaapi_decoder_get_surface() returned
+ * %GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE: the calling thread is
+ * woken up as soon as a decoded surface is released to the pool, so
+ * that decoding can resume right away instead of polling.
+ *
+ * Return value: %TRUE if a surface is available, or if the decoder
+ *   has no context yet
+ */
+gboolean
+gst_vaapi_decoder_wait_surface(GstVaapiDecoder *decoder, guint64 timeout)
+{
+    GstVaapiContext *context;
+
+    g_return_val_if_fail(GST_VAAPI_IS_DECODER(decoder), FALSE);
+
+    context = decoder->priv->context;
+    if (!context)
+        return TRUE;
+    return gst_vaapi_context_wait_surface(context, timeout);
+}
+
+/**
+ * gst_vaapi_decoder_set_stage_timing:
+ * @decoder: a #GstVaapiDecoder
+ * @enable: %TRUE to time the decoding stages
+ *
+ * Enables or disables the timing of the decoding stages, see
+ * #GstVaapiDecoderStage. Enabling stage timing resets the statistics.
+ * This must not be called while a buffer is being decoded. Stage
+ * timing is disabled by default, and then costs a single test per
+ * stage.
+ */
+void
+gst_vaapi_decoder_set_stage_timing(GstVaapiDecoder *decoder, gboolean enable)
+{
+    GstVaapiDecoderPrivate *priv;
+    guint i;
+
+    g_return_if_fail(GST_VAAPI_IS_DECODER(decoder));
+
+    priv = decoder->priv;
+    g_free(priv->stage_stats);
+    priv->stage_stats = NULL;
+    priv->stage_time  = 0;
+    priv->stage_depth = 0;
+
+    if (!enable)
+        return;
+
+    priv->stage_stats = g_new0(GstVaapiDecoderStageStats,
+                               GST_VAAPI_DECODER_STAGE_COUNT);
+    for (i = 0; i < GST_VAAPI_DECODER_STAGE_COUNT; i++)
+        priv->stage_stats[i].min_time = G_MAXUINT64;
+}
+
+/**
+ * gst_vaapi_decoder_get_stage_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @stage: a #GstVaapiDecoderStage
+ * @stats: return location for the statistics
+ *
+ * Retrieves the latency statistics of the decoding @stage since stage
+ * timing was enabled with gst_vaapi_decoder_set_stage_timing(). If the
+ * stage was never run, @stats min_time is zero.
+ *
+ * Return value: %TRUE on success, %FALSE if stage timing is disabled
+ */
+gboolean
+gst_vaapi_decoder_get_stage_stats(
+    GstVaapiDecoder           *decoder,
+    GstVaapiDecoderStage       stage,
+    GstVaapiDecoderStageStats *stats
+)
+{
+    GstVaapiDecoderPrivate *priv;
+
+    g_return_val_if_fail(GST_VAAPI_IS_DECODER(decoder), FALSE);
+    g_return_val_if_fail(stage < GST_VAAPI_DECODER_STAGE_COUNT, FALSE);
+    g_return_val_if_fail(stats != NULL, FALSE);
+
+    priv = decoder->priv;
+    if (!priv->stage_stats)
+        return FALSE;
+
+    *stats = priv->stage_stats[stage];
+    if (stats->count == 0)
+        stats->min_time = 0;
+    return TRUE;
+}
+
+/**
+ * gst_vaapi_decoder_get_submit_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @num_pictures: return location for the number of pictures submitted
+ *   to the VA driver, or %NULL
+ * @num_va_calls: return location for the number of vaBeginPicture(),
+ *   vaRenderPicture() and vaEndPicture() calls made to submit them, or
+ *   %NULL
+ *
+ * Retrieves the number of VA submission calls made since @decoder was
+ * created, so that @num_va_calls / @num_pictures gives the average
+ * number of calls per picture. All buffers of a picture are normally
+ * submitted with a single vaRenderPicture() call, i.e. three calls per
+ * picture, or one vaRenderPicture() call per buffer if the VA driver
+ * rejects batches.
+ */
+void
+gst_vaapi_decoder_get_submit_stats(
+    GstVaapiDecoder *decoder,
+    guint           *num_pictures,
+    guint           *num_va_calls
+)
+{
+    g_return_if_fail(GST_VAAPI_IS_DECODER(decoder));
+
+    if (num_pictures)
+        *num_pictures = decoder->priv->num_pictures;
+    if (num_va_calls)
+        *num_va_calls = decoder->priv->num_va_calls;
+}
+
 void
 gst_vaapi_decoder_set_picture_size(
     GstVaapiDecoder    *decoder,
@@ -547,10 +726,24 @@ gst_vaapi_decoder_ensure_context(
 )
 {
     GstVaapiDecoderPrivate * const priv = decoder->priv;
+    gboolean context_changed;
+    guint width, height;
 
     gst_vaapi_decoder_set_picture_size(decoder, cip->width, cip->height);
 
     if (priv->context) {
+        /* VA buffers are bound to the VA context they were created for,
+           and reset_full() recreates it on any codec or size change.
+           Destroy them while that context still exists */
+        gst_vaapi_context_get_size(priv->context, &width, &height);
+        context_changed =
+            gst_vaapi_context_get_profile(priv->context) != cip->profile ||
+            gst_vaapi_context_get_entrypoint(priv->context) != cip->entrypoint ||
+            width != cip->width || height != cip->height;
+        if (context_changed && priv->buffer_arena) {
+            gst_vaapi_buffer_arena_free(priv->buffer_arena);
+            priv->buffer_arena = NULL;
+        }
         if (!gst_vaapi_context_reset_full(priv->context, cip))
             return FALSE;
     }
@@ -559,7 +752,21 @@ gst_vaapi_decoder_ensure_context(
         if (!priv->context)
             return FALSE;
     }
+
+    /* Any other path to a new VA context must not reuse the buffers */
+    if (priv->buffer_arena &&
+        priv->va_context != gst_vaapi_context_get_id(priv->context)) {
+        gst_vaapi_buffer_arena_free(priv->buffer_arena);
+        priv->buffer_arena = NULL;
+    }
     priv->va_context = gst_vaapi_context_get_id(priv->context);
+
+    if (!priv->buffer_arena) {
+        priv->buffer_arena =
+            gst_vaapi_buffer_arena_new(priv->va_display, priv->va_context);
+        if (!priv->buffer_arena)
+            return FALSE;
+    }
     return TRUE;
 }
 
@@ -599,3 +806,79 @@ gst_vaapi_decoder_check_status(GstVaapiDecoder *decoder)
         return GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE;
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
+
+gboolean
+gst_vaapi_decoder_create_buffer(
+    GstVaapiDecoder *decoder,
+    int              type,
+    guint            size,
+    gconstpointer    data,
+    VABufferID      *buf_id_ptr,
+    gpointer        *mapped_data
+)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+
+    if (!priv->buffer_arena)
+        return vaapi_create_buffer(priv->va_display, priv->va_context,
+                                   type, size, data, buf_id_ptr, mapped_data);
+
+    return gst_vaapi_buffer_arena_create_buffer(priv->buffer_arena,
+        type, size, data, buf_id_ptr, mapped_data);
+}
+
+void
+gst_vaapi_decoder_unmap_buffer(
+    GstVaapiDecoder *decoder,
+    VABufferID       buf_id,
+    gpointer        *pbuf
+)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+
+    if (!priv->buffer_arena) {
+        vaapi_unmap_buffer(priv->va_display, buf_id, pbuf);
+        return;
+    }
+    gst_vaapi_buffer_arena_unmap_buffer(priv->buffer_arena, buf_id, pbuf);
+}
+
+void
+gst_vaapi_decoder_destroy_buffer(GstVaapiDecoder *decoder, VABufferID *buf_id_ptr)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+
+    if (!priv->buffer_arena) {
+        vaapi_destroy_buffer(priv->va_display, buf_id_ptr);
+        return;
+    }
+    gst_vaapi_buffer_arena_destroy_buffer(priv->buffer_arena, buf_id_ptr);
+}
+
+void
+gst_vaapi_decoder_stage_record(
+    GstVaapiDecoder     *decoder,
+    GstVaapiDecoderStage stage,
+    GstClockTime         duration
+)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    GstVaapiDecoderStageStats * const stats = &priv->stage_stats[stage];
+    guint bin;
+
+    if (stage != GST_VAAPI_DECODER_STAGE_PARSE)
+        priv->stage_time += duration;
+
+    stats->count++;
+    stats->total_time += duration;
+    stats->min_time    = MIN(stats->min_time, duration);
+    stats->max_time    = MAX(stats->max_time, duration);
+
+    if (duration == 0)
+        bin = 0;
+    else if (duration > G_MAXUINT32)
+        bin = GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS - 1;
+    else
+        bin = g_bit_storage((guint32)duration);
+    stats->histogram[MIN(bin, GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS - 1)]++;
+}
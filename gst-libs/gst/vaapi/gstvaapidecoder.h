@@ -89,6 +89,55 @@ typedef enum {
     GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN = -1
 } GstVaapiDecoderStatus;
 
+/**
+ * GstVaapiDecoderStage:
+ * @GST_VAAPI_DECODER_STAGE_PARSE: Bitstream framing and header parsing,
+ *   i.e. the time spent decoding that is not accounted to another stage.
+ * @GST_VAAPI_DECODER_STAGE_FILL: Filling of VA parameter buffers.
+ * @GST_VAAPI_DECODER_STAGE_SUBMIT: Submission of a picture to the VA driver.
+ * @GST_VAAPI_DECODER_STAGE_OUTPUT: Bumping of decoded pictures to the output
+ *   queue.
+ * @GST_VAAPI_DECODER_STAGE_COUNT: Number of stages.
+ *
+ * Decoding stages reported by gst_vaapi_decoder_get_stage_stats().
+ */
+typedef enum {
+    GST_VAAPI_DECODER_STAGE_PARSE = 0,
+    GST_VAAPI_DECODER_STAGE_FILL,
+    GST_VAAPI_DECODER_STAGE_SUBMIT,
+    GST_VAAPI_DECODER_STAGE_OUTPUT,
+    GST_VAAPI_DECODER_STAGE_COUNT
+} GstVaapiDecoderStage;
+
+/**
+ * GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS:
+ *
+ * Number of bins of #GstVaapiDecoderStageStats histograms.
+ */
+#define GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS 32
+
+typedef struct _GstVaapiDecoderStageStats       GstVaapiDecoderStageStats;
+
+/**
+ * GstVaapiDecoderStageStats:
+ * @count: number of times the stage was run
+ * @total_time: total time spent in the stage, in nanoseconds
+ * @min_time: shortest run, in nanoseconds
+ * @max_time: longest run, in nanoseconds
+ * @histogram: number of runs per duration, where bin 0 counts runs
+ *   shorter than 1 ns and bin i > 0 counts runs of 2^(i-1) ns to
+ *   2^i ns; the last bin also counts all longer runs
+ *
+ * Latency statistics of a decoding stage.
+ */
+struct _GstVaapiDecoderStageStats {
+    guint64     count;
+    guint64     total_time;
+    guint64     min_time;
+    guint64     max_time;
+    guint       histogram[GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS];
+};
+
 /**
  * GstVaapiDecoder:
  *
@@ -128,6 +177,26 @@ gst_vaapi_decoder_get_surface(
     GstVaapiDecoderStatus *pstatus
 );
 
+gboolean
+gst_vaapi_decoder_wait_surface(GstVaapiDecoder *decoder, guint64 timeout);
+
+void
+gst_vaapi_decoder_set_stage_timing(GstVaapiDecoder *decoder, gboolean enable);
+
+gboolean
+gst_vaapi_decoder_get_stage_stats(
+    GstVaapiDecoder           *decoder,
+    GstVaapiDecoderStage       stage,
+    GstVaapiDecoderStageStats *stats
+);
+
+void
+gst_vaapi_decoder_get_submit_stats(
+    GstVaapiDecoder *decoder,
+    guint           *num_pictures,
+    guint           *num_va_calls
+);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_H */
@@ -31,6 +31,7 @@
 #include "gstvaapidecoder_h264.h"
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapistartcode.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 
@@ -251,9 +252,19 @@ G_DEFINE_TYPE(GstVaapiDecoderH264,
 #define TOP_FIELD       0
 #define BOTTOM_FIELD    1
 
+/* Number of slots of the PicNum and LongTermPicNum indexes. This is a
+   power of two larger than twice the maximum number of references */
+#define REF_INDEX_SIZE  64
+
+typedef struct _GstVaapiRefIndexEntry GstVaapiRefIndexEntry;
+struct _GstVaapiRefIndexEntry {
+    gint32                      key;
+    GstVaapiPictureH264        *picture;
+};
+
 struct _GstVaapiDecoderH264Private {
     GstAdapter                 *adapter;
-    GstBuffer                  *sub_buffer;
+    GstVaapiStartCodeScanner    scanner;
     GstH264NalParser           *parser;
     GstH264SPS                 *sps;
     GstH264SPS                  last_sps;
@@ -264,14 +275,27 @@ struct _GstVaapiDecoderH264Private {
     guint                       dpb_count;
     guint                       dpb_size;
     GstVaapiProfile             profile;
-    GstVaapiPictureH264        *short_ref[32];
+    GstVaapiPictureH264        *short_ref[32];          // sorted by POC
     guint                       short_ref_count;
-    GstVaapiPictureH264        *long_ref[32];
+    GstVaapiPictureH264        *long_ref[32];           // sorted by LongTermFrameIdx
     guint                       long_ref_count;
-    GstVaapiPictureH264        *RefPicList0[32];
+    GstVaapiRefIndexEntry       short_ref_index[REF_INDEX_SIZE]; // by PicNum
+    GstVaapiRefIndexEntry       long_ref_index[REF_INDEX_SIZE];  // by LongTermPicNum
+    GstVaapiPictureH264        *RefPicList0[33];
     guint                       RefPicList0_count;
-    GstVaapiPictureH264        *RefPicList1[32];
+    GstVaapiPictureH264        *RefPicList1[33];
     guint                       RefPicList1_count;
+    GstVaapiPictureH264        *RefPicList0_init[32];   // initial lists, before
+    guint                       RefPicList0_init_count; // modification, for the
+    GstVaapiPictureH264        *RefPicList1_init[32];   // current picture
+    guint                       RefPicList1_init_count;
+    GstVaapiPictureType         RefPicList_init_type;
+    GstVaapiPictureType         RefPicList_type;        // lists of the last slice
+    guint                       RefPicList_num_refs[2];
+    guint                       num_slices;
+    guint                       num_ref_lists_built;
+    guint                       num_ref_lists_copied;
+    guint                       num_ref_lists_reused;
     guint                       nal_length_size;
     guint                       width;
     guint                       height;
@@ -294,6 +318,8 @@ struct _GstVaapiDecoderH264Private {
     guint                       is_opened               : 1;
     guint                       is_avc                  : 1;
     guint                       has_context             : 1;
+    guint                       has_RefPicList_init     : 1;
+    guint                       has_RefPicList          : 1;
 };
 
 static gboolean
@@ -389,7 +415,9 @@ static gboolean
 dpb_bump(GstVaapiDecoderH264 *decoder)
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
+    GstVaapiDecoder * const base_decoder = GST_VAAPI_DECODER_CAST(decoder);
     guint i, lowest_poc_index;
+    GstClockTime start;
     gboolean success;
 
     for (i = 0; i < priv->dpb_count; i++) {
@@ -399,6 +427,8 @@ dpb_bump(GstVaapiDecoderH264 *decoder)
     if (i == priv->dpb_count)
         return FALSE;
 
+    start = gst_vaapi_decoder_stage_begin(base_decoder);
+
     lowest_poc_index = i++;
     for (; i < priv->dpb_count; i++) {
         GstVaapiPictureH264 * const picture = priv->dpb[i];
@@ -409,6 +439,8 @@ dpb_bump(GstVaapiDecoderH264 *decoder)
     success = dpb_output(decoder, priv->dpb[lowest_poc_index]);
     if (!GST_VAAPI_PICTURE_IS_REFERENCE(priv->dpb[lowest_poc_index]))
         dpb_remove_index(decoder, lowest_poc_index);
+    gst_vaapi_decoder_stage_end(base_decoder, GST_VAAPI_DECODER_STAGE_OUTPUT,
+        start);
     return success;
 }
 
@@ -521,15 +553,18 @@ gst_vaapi_decoder_h264_close(GstVaapiDecoderH264 *decoder)
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
 
+    if (priv->num_slices > 0)
+        GST_DEBUG("%u slices: %u reference picture lists built, "
+                  "%u copied, %u reused from the previous slice",
+                  priv->num_slices, priv->num_ref_lists_built,
+                  priv->num_ref_lists_copied, priv->num_ref_lists_reused);
+
     gst_vaapi_picture_replace(&priv->current_picture, NULL);
     clear_references(decoder, priv->short_ref, &priv->short_ref_count);
     clear_references(decoder, priv->long_ref,  &priv->long_ref_count );
     clear_references(decoder, priv->dpb,       &priv->dpb_count      );
-
-    if (priv->sub_buffer) {
-        gst_buffer_unref(priv->sub_buffer);
-        priv->sub_buffer = NULL;
-    }
+    priv->has_RefPicList_init = FALSE;
+    priv->has_RefPicList      = FALSE;
 
     if (priv->parser) {
         gst_h264_nal_parser_free(priv->parser);
@@ -541,6 +576,7 @@ gst_vaapi_decoder_h264_close(GstVaapiDecoderH264 *decoder)
         g_object_unref(priv->adapter);
         priv->adapter = NULL;
     }
+    gst_vaapi_start_code_scanner_clear(&priv->scanner);
 }
 
 static gboolean
@@ -553,6 +589,7 @@ gst_vaapi_decoder_h264_open(GstVaapiDecoderH264 *decoder, GstBuffer *buffer)
     priv->adapter = gst_adapter_new();
     if (!priv->adapter)
         return FALSE;
+    gst_vaapi_start_code_scanner_init(&priv->scanner, NULL);
 
     priv->parser = gst_h264_nal_parser_new();
     if (!priv->parser)
@@ -950,58 +987,44 @@ init_picture_poc(
     picture->poc = MIN(pic->TopFieldOrderCnt, pic->BottomFieldOrderCnt);
 }
 
-static int
-compare_picture_pic_num_dec(const void *a, const void *b)
-{
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
-
-    return picB->pic_num - picA->pic_num;
-}
-
-static int
-compare_picture_long_term_pic_num_inc(const void *a, const void *b)
-{
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
-
-    return picA->long_term_pic_num - picB->long_term_pic_num;
-}
-
-static int
-compare_picture_poc_dec(const void *a, const void *b)
-{
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
-
-    return picB->poc - picA->poc;
-}
-
-static int
-compare_picture_poc_inc(const void *a, const void *b)
-{
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
-
-    return picA->poc - picB->poc;
-}
-
-static int
-compare_picture_frame_num_wrap_dec(const void *a, const void *b)
+/* Sorts a small reference list by insertion, with the sort key inlined.
+   The lists are built from the short-term and long-term references that
+   are kept sorted, so they are mostly in order already */
+#define SORT_REF_LIST(list, n, key, op) do {                    \
+        guint i_, j_;                                           \
+        for (i_ = 1; i_ < (n); i_++) {                          \
+            GstVaapiPictureH264 * const pic_ = (list)[i_];      \
+            for (j_ = i_; j_ > 0 &&                             \
+                     !((list)[j_ - 1]->key op pic_->key); j_--) \
+                (list)[j_] = (list)[j_ - 1];                    \
+            (list)[j_] = pic_;                                  \
+        }                                                       \
+    } while (0)
+
+/* Looks up a reference picture by PicNum or LongTermPicNum */
+static GstVaapiPictureH264 *
+ref_index_lookup(GstVaapiRefIndexEntry *index, gint32 key)
 {
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
+    guint i;
 
-    return picB->frame_num_wrap - picA->frame_num_wrap;
+    for (i = key & (REF_INDEX_SIZE - 1); index[i].picture;
+         i = (i + 1) & (REF_INDEX_SIZE - 1)) {
+        if (index[i].key == key)
+            return index[i].picture;
+    }
+    return NULL;
 }
 
-static int
-compare_picture_long_term_frame_idx_inc(const void *a, const void *b)
+static void
+ref_index_add(GstVaapiRefIndexEntry *index, gint32 key, GstVaapiPictureH264 *pic)
 {
-    const GstVaapiPictureH264 * const picA = *(GstVaapiPictureH264 **)a;
-    const GstVaapiPictureH264 * const picB = *(GstVaapiPictureH264 **)b;
+    guint i;
 
-    return picA->info.frame_idx - picB->info.frame_idx;
+    for (i = key & (REF_INDEX_SIZE - 1); index[i].picture;
+         i = (i + 1) & (REF_INDEX_SIZE - 1))
+        ;
+    index[i].key     = key;
+    index[i].picture = pic;
 }
 
 /* 8.2.4.1 - Decoding process for picture numbers */
@@ -1021,6 +1044,7 @@ init_picture_refs_pic_num(
 
     GST_DEBUG("decode picture numbers");
 
+    memset(priv->short_ref_index, 0, sizeof(priv->short_ref_index));
     for (i = 0; i < priv->short_ref_count; i++) {
         GstVaapiPictureH264 * const pic = priv->short_ref[i];
 
@@ -1039,8 +1063,10 @@ init_picture_refs_pic_num(
             else
                 pic->pic_num = 2 * pic->frame_num_wrap;
         }
+        ref_index_add(priv->short_ref_index, pic->pic_num, pic);
     }
 
+    memset(priv->long_ref_index, 0, sizeof(priv->long_ref_index));
     for (i = 0; i < priv->long_ref_count; i++) {
         GstVaapiPictureH264 * const pic = priv->long_ref[i];
 
@@ -1053,11 +1079,71 @@ init_picture_refs_pic_num(
             else
                 pic->long_term_pic_num = 2 * pic->info.frame_idx;
         }
+        ref_index_add(priv->long_ref_index, pic->long_term_pic_num, pic);
     }
 }
 
-#define SORT_REF_LIST(list, n, compare_func) \
-    qsort(list, n, sizeof(*(list)), compare_picture_##compare_func)
+/* Returns the number of short-term references with a POC lower than
+   @poc, or also equal to @poc if @inclusive is set. The short-term
+   references are sorted by increasing POC */
+static guint
+split_short_refs_by_poc(
+    GstVaapiDecoderH264 *decoder,
+    gint32               poc,
+    gboolean             inclusive
+)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+    guint lo = 0, hi = priv->short_ref_count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (priv->short_ref[mid]->poc < poc ||
+            (inclusive && priv->short_ref[mid]->poc == poc))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Appends the short-term references [@start, @end[ in increasing POC
+   order if @end > @start, or ]@end, @start] in decreasing POC order */
+static guint
+append_short_refs(
+    GstVaapiDecoderH264  *decoder,
+    GstVaapiPictureH264 **ref_list,
+    gint                  start,
+    gint                  end
+)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+    guint n = 0;
+    gint i;
+
+    if (start <= end) {
+        for (i = start; i < end; i++)
+            ref_list[n++] = priv->short_ref[i];
+    }
+    else {
+        for (i = start; i > end; i--)
+            ref_list[n++] = priv->short_ref[i];
+    }
+    return n;
+}
+
+/* Appends the long-term references, which are sorted by increasing
+   LongTermFrameIdx, hence by increasing LongTermPicNum in frames */
+static guint
+append_long_refs(GstVaapiDecoderH264 *decoder, GstVaapiPictureH264 **ref_list)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+    guint i;
+
+    for (i = 0; i < priv->long_ref_count; i++)
+        ref_list[i] = priv->long_ref[i];
+    return i;
+}
 
 static void
 init_picture_refs_p_slice(
@@ -1068,7 +1154,7 @@ init_picture_refs_p_slice(
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
     GstVaapiPictureH264 **ref_list;
-    guint i;
+    guint n;
 
     GST_DEBUG("decode reference picture list for P and SP slices");
 
@@ -1076,18 +1162,15 @@ init_picture_refs_p_slice(
         /* 8.2.4.2.1 - P and SP slices in frames */
         if (priv->short_ref_count > 0) {
             ref_list = priv->RefPicList0;
-            for (i = 0; i < priv->short_ref_count; i++)
-                ref_list[i] = priv->short_ref[i];
-            SORT_REF_LIST(ref_list, i, pic_num_dec);
-            priv->RefPicList0_count += i;
+            n = append_short_refs(decoder, ref_list,
+                priv->short_ref_count - 1, -1);
+            SORT_REF_LIST(ref_list, n, pic_num, >);
+            priv->RefPicList0_count += n;
         }
 
         if (priv->long_ref_count > 0) {
             ref_list = &priv->RefPicList0[priv->RefPicList0_count];
-            for (i = 0; i < priv->long_ref_count; i++)
-                ref_list[i] = priv->long_ref[i];
-            SORT_REF_LIST(ref_list, i, long_term_pic_num_inc);
-            priv->RefPicList0_count += i;
+            priv->RefPicList0_count += append_long_refs(decoder, ref_list);
         }
     }
     else {
@@ -1100,20 +1183,16 @@ init_picture_refs_p_slice(
         // XXX: handle second field if current field is marked as
         // "used for short-term reference"
         if (priv->short_ref_count > 0) {
-            for (i = 0; i < priv->short_ref_count; i++)
-                short_ref[i] = priv->short_ref[i];
-            SORT_REF_LIST(short_ref, i, frame_num_wrap_dec);
-            short_ref_count = i;
+            n = append_short_refs(decoder, short_ref,
+                priv->short_ref_count - 1, -1);
+            SORT_REF_LIST(short_ref, n, frame_num_wrap, >);
+            short_ref_count = n;
         }
 
         // XXX: handle second field if current field is marked as
         // "used for long-term reference"
-        if (priv->long_ref_count > 0) {
-            for (i = 0; i < priv->long_ref_count; i++)
-                long_ref[i] = priv->long_ref[i];
-            SORT_REF_LIST(long_ref, i, long_term_frame_idx_inc);
-            long_ref_count = i;
-        }
+        if (priv->long_ref_count > 0)
+            long_ref_count = append_long_refs(decoder, long_ref);
 
         // XXX: handle 8.2.4.2.5
     }
@@ -1128,7 +1207,7 @@ init_picture_refs_b_slice(
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
     GstVaapiPictureH264 **ref_list;
-    guint i, n;
+    guint n;
 
     GST_DEBUG("decode reference picture list for B slices");
 
@@ -1137,60 +1216,40 @@ init_picture_refs_b_slice(
 
         /* RefPicList0 */
         if (priv->short_ref_count > 0) {
-            // 1. Short-term references
+            // 1. Short-term references, POC < current POC in decreasing
+            // order, then POC >= current POC in increasing order
+            n = split_short_refs_by_poc(decoder, picture->poc, FALSE);
             ref_list = priv->RefPicList0;
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc < picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_dec);
-            priv->RefPicList0_count += n;
-
+            priv->RefPicList0_count +=
+                append_short_refs(decoder, ref_list, n - 1, -1);
             ref_list = &priv->RefPicList0[priv->RefPicList0_count];
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc >= picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_inc);
-            priv->RefPicList0_count += n;
+            priv->RefPicList0_count +=
+                append_short_refs(decoder, ref_list, n, priv->short_ref_count);
         }
 
         if (priv->long_ref_count > 0) {
             // 2. Long-term references
             ref_list = &priv->RefPicList0[priv->RefPicList0_count];
-            for (n = 0, i = 0; i < priv->long_ref_count; i++)
-                ref_list[n++] = priv->long_ref[i];
-            SORT_REF_LIST(ref_list, n, long_term_pic_num_inc);
-            priv->RefPicList0_count += n;
+            priv->RefPicList0_count += append_long_refs(decoder, ref_list);
         }
 
         /* RefPicList1 */
         if (priv->short_ref_count > 0) {
-            // 1. Short-term references
+            // 1. Short-term references, POC > current POC in increasing
+            // order, then POC <= current POC in decreasing order
+            n = split_short_refs_by_poc(decoder, picture->poc, TRUE);
             ref_list = priv->RefPicList1;
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc > picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_inc);
-            priv->RefPicList1_count += n;
-
+            priv->RefPicList1_count +=
+                append_short_refs(decoder, ref_list, n, priv->short_ref_count);
             ref_list = &priv->RefPicList1[priv->RefPicList1_count];
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc <= picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_dec);
-            priv->RefPicList1_count += n;
+            priv->RefPicList1_count +=
+                append_short_refs(decoder, ref_list, n - 1, -1);
         }
 
         if (priv->long_ref_count > 0) {
             // 2. Long-term references
             ref_list = &priv->RefPicList1[priv->RefPicList1_count];
-            for (n = 0, i = 0; i < priv->long_ref_count; i++)
-                ref_list[n++] = priv->long_ref[i];
-            SORT_REF_LIST(ref_list, n, long_term_pic_num_inc);
-            priv->RefPicList1_count += n;
+            priv->RefPicList1_count += append_long_refs(decoder, ref_list);
         }
     }
     else {
@@ -1202,51 +1261,25 @@ init_picture_refs_b_slice(
         GstVaapiPictureH264 *long_ref[32];
         guint long_ref_count = 0;
 
-        /* refFrameList0ShortTerm */
-        if (priv->short_ref_count > 0) {
-            ref_list = short_ref0;
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc <= picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_dec);
-            short_ref0_count += n;
-
-            ref_list = &short_ref0[short_ref0_count];
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc > picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_inc);
-            short_ref0_count += n;
-        }
-
-        /* refFrameList1ShortTerm */
         if (priv->short_ref_count > 0) {
-            ref_list = short_ref1;
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc > picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_inc);
-            short_ref1_count += n;
-
-            ref_list = &short_ref1[short_ref1_count];
-            for (n = 0, i = 0; i < priv->short_ref_count; i++) {
-                if (priv->short_ref[i]->poc <= picture->poc)
-                    ref_list[n++] = priv->short_ref[i];
-            }
-            SORT_REF_LIST(ref_list, n, poc_dec);
-            short_ref1_count += n;
+            n = split_short_refs_by_poc(decoder, picture->poc, TRUE);
+
+            /* refFrameList0ShortTerm */
+            short_ref0_count +=
+                append_short_refs(decoder, short_ref0, n - 1, -1);
+            short_ref0_count += append_short_refs(decoder,
+                &short_ref0[short_ref0_count], n, priv->short_ref_count);
+
+            /* refFrameList1ShortTerm */
+            short_ref1_count += append_short_refs(decoder,
+                short_ref1, n, priv->short_ref_count);
+            short_ref1_count += append_short_refs(decoder,
+                &short_ref1[short_ref1_count], n - 1, -1);
         }
 
         /* refFrameListLongTerm */
-        if (priv->long_ref_count > 0) {
-            for (i = 0; i < priv->long_ref_count; i++)
-                long_ref[i] = priv->long_ref[i];
-            SORT_REF_LIST(long_ref, i, long_term_frame_idx_inc);
-            long_ref_count = i;
-        }
+        if (priv->long_ref_count > 0)
+            long_ref_count = append_long_refs(decoder, long_ref);
 
         // XXX: handle 8.2.4.2.5
     }
@@ -1292,14 +1325,42 @@ remove_reference_at(
 
     g_return_val_if_fail(index < num_pictures, FALSE);
 
+    /* Keep the remaining references in order */
     GST_VAAPI_PICTURE_FLAG_UNSET(pictures[index], GST_VAAPI_PICTURE_FLAG_REFERENCE);
-    if (index != --num_pictures)
-        gst_vaapi_picture_replace(&pictures[index], pictures[num_pictures]);
-    gst_vaapi_picture_replace(&pictures[num_pictures], NULL);
+    gst_vaapi_picture_replace(&pictures[index], NULL);
+    num_pictures--;
+    memmove(&pictures[index], &pictures[index + 1],
+            (num_pictures - index) * sizeof(pictures[0]));
+    pictures[num_pictures] = NULL;
     *picture_count = num_pictures;
     return TRUE;
 }
 
+/* Inserts a new reference, keeping the short-term references sorted by
+   POC and the long-term references by LongTermFrameIdx */
+static void
+insert_reference(
+    GstVaapiDecoderH264  *decoder,
+    GstVaapiPictureH264 **pictures,
+    guint                *picture_count,
+    GstVaapiPictureH264  *picture
+)
+{
+    guint i = *picture_count;
+
+    if (picture->is_long_term) {
+        for (; i > 0 && pictures[i - 1]->info.frame_idx > picture->info.frame_idx; i--)
+            pictures[i] = pictures[i - 1];
+    }
+    else {
+        for (; i > 0 && pictures[i - 1]->poc > picture->poc; i--)
+            pictures[i] = pictures[i - 1];
+    }
+    pictures[i] = NULL;
+    gst_vaapi_picture_replace(&pictures[i], picture);
+    *picture_count += 1;
+}
+
 static gint
 find_short_term_reference(GstVaapiDecoderH264 *decoder, gint32 pic_num)
 {
@@ -1346,7 +1407,6 @@ exec_picture_refs_modification_1(
     GstVaapiPictureH264 **ref_list;
     guint *ref_list_count_ptr, ref_list_count, ref_list_idx = 0;
     guint i, j, n, num_refs;
-    gint found_ref_idx;
     gint32 MaxPicNum, CurrPicNum, picNumPred;
 
     GST_DEBUG("modification process of reference picture list %u", list);
@@ -1411,9 +1471,8 @@ exec_picture_refs_modification_1(
             // (8-37)
             for (j = num_refs; j > ref_list_idx; j--)
                 ref_list[j] = ref_list[j - 1];
-            found_ref_idx = find_short_term_reference(decoder, picNum);
             ref_list[ref_list_idx++] =
-                found_ref_idx >= 0 ? priv->short_ref[found_ref_idx] : NULL;
+                ref_index_lookup(priv->short_ref_index, picNum);
             n = ref_list_idx;
             for (j = ref_list_idx; j <= num_refs; j++) {
                 gint32 PicNumF;
@@ -1431,10 +1490,8 @@ exec_picture_refs_modification_1(
 
             for (j = num_refs; j > ref_list_idx; j--)
                 ref_list[j] = ref_list[j - 1];
-            found_ref_idx =
-                find_long_term_reference(decoder, l->value.long_term_pic_num);
-            ref_list[ref_list_idx++] =
-                found_ref_idx >= 0 ? priv->long_ref[found_ref_idx] : NULL;
+            ref_list[ref_list_idx++] = ref_index_lookup(priv->long_ref_index,
+                l->value.long_term_pic_num);
             n = ref_list_idx;
             for (j = ref_list_idx; j <= num_refs; j++) {
                 gint32 LongTermPicNumF;
@@ -1485,46 +1542,133 @@ init_picture_refs(
 )
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
-    GstVaapiPicture * const base_picture = &picture->base;
-    guint i, num_refs;
 
     init_picture_refs_pic_num(decoder, picture, slice_hdr);
 
-    priv->RefPicList0_count = 0;
-    priv->RefPicList1_count = 0;
+    /* The initial lists only depend on the references and on the slice
+       type, they are built for the first slice of each type */
+    priv->has_RefPicList_init = FALSE;
+    priv->has_RefPicList      = FALSE;
+    return TRUE;
+}
 
-    switch (base_picture->type) {
-    case GST_VAAPI_PICTURE_TYPE_P:
-    case GST_VAAPI_PICTURE_TYPE_SP:
-        init_picture_refs_p_slice(decoder, picture, slice_hdr);
-        break;
-    case GST_VAAPI_PICTURE_TYPE_B:
-        init_picture_refs_b_slice(decoder, picture, slice_hdr);
-        break;
-    default:
-        break;
+static GstVaapiPictureType
+get_slice_refs_type(GstH264SliceHdr *slice_hdr)
+{
+    if (GST_H264_IS_B_SLICE(slice_hdr))
+        return GST_VAAPI_PICTURE_TYPE_B;
+    if (GST_H264_IS_P_SLICE(slice_hdr) || GST_H264_IS_SP_SLICE(slice_hdr))
+        return GST_VAAPI_PICTURE_TYPE_P;
+    return GST_VAAPI_PICTURE_TYPE_I;
+}
+
+static inline gboolean
+has_picture_refs_modification(GstH264SliceHdr *slice_hdr)
+{
+    return (slice_hdr->ref_pic_list_modification_flag_l0 ||
+            slice_hdr->ref_pic_list_modification_flag_l1);
+}
+
+/* Pads the list with empty entries up to num_refs, plus the extra entry
+   used by the modification process */
+static void
+pad_ref_list(GstVaapiPictureH264 **ref_list, guint *ref_list_count, guint num_refs)
+{
+    guint i;
+
+    *ref_list_count = MIN(*ref_list_count, num_refs);
+    for (i = *ref_list_count; i <= num_refs && i < 33; i++)
+        ref_list[i] = NULL;
+}
+
+/* 8.2.4 - Decoding process for reference picture lists construction */
+static gboolean
+init_slice_refs(
+    GstVaapiDecoderH264 *decoder,
+    GstVaapiPictureH264 *picture,
+    GstH264SliceHdr     *slice_hdr
+)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+    const GstVaapiPictureType type = get_slice_refs_type(slice_hdr);
+    guint i, num_refs[2];
+
+    priv->num_slices++;
+
+    num_refs[0] = 1 + slice_hdr->num_ref_idx_l0_active_minus1;
+    num_refs[1] = 1 + slice_hdr->num_ref_idx_l1_active_minus1;
+
+    if (type == GST_VAAPI_PICTURE_TYPE_I) {
+        priv->RefPicList0_count = 0;
+        priv->RefPicList1_count = 0;
+        priv->has_RefPicList    = FALSE;
+        return TRUE;
+    }
+
+    /* Same lists as the previous slice of the picture */
+    if (priv->has_RefPicList && priv->RefPicList_type == type &&
+        priv->RefPicList_num_refs[0] == num_refs[0] &&
+        (type != GST_VAAPI_PICTURE_TYPE_B ||
+         priv->RefPicList_num_refs[1] == num_refs[1]) &&
+        !has_picture_refs_modification(slice_hdr)) {
+        priv->num_ref_lists_reused++;
+        return TRUE;
+    }
+
+    if (priv->has_RefPicList_init && priv->RefPicList_init_type == type) {
+        memcpy(priv->RefPicList0, priv->RefPicList0_init,
+               priv->RefPicList0_init_count * sizeof(priv->RefPicList0[0]));
+        priv->RefPicList0_count = priv->RefPicList0_init_count;
+        memcpy(priv->RefPicList1, priv->RefPicList1_init,
+               priv->RefPicList1_init_count * sizeof(priv->RefPicList1[0]));
+        priv->RefPicList1_count = priv->RefPicList1_init_count;
+        priv->num_ref_lists_copied++;
     }
+    else {
+        priv->RefPicList0_count = 0;
+        priv->RefPicList1_count = 0;
+        if (type == GST_VAAPI_PICTURE_TYPE_B)
+            init_picture_refs_b_slice(decoder, picture, slice_hdr);
+        else
+            init_picture_refs_p_slice(decoder, picture, slice_hdr);
+
+        memcpy(priv->RefPicList0_init, priv->RefPicList0,
+               priv->RefPicList0_count * sizeof(priv->RefPicList0[0]));
+        priv->RefPicList0_init_count = priv->RefPicList0_count;
+        memcpy(priv->RefPicList1_init, priv->RefPicList1,
+               priv->RefPicList1_count * sizeof(priv->RefPicList1[0]));
+        priv->RefPicList1_init_count = priv->RefPicList1_count;
+        priv->RefPicList_init_type   = type;
+        priv->has_RefPicList_init    = TRUE;
+        priv->num_ref_lists_built++;
+    }
+
+    /* The initial lists are truncated to num_ref_idx_lX_active_minus1 + 1
+       entries before they are modified (8.2.4.2) */
+    pad_ref_list(priv->RefPicList0, &priv->RefPicList0_count, num_refs[0]);
+    pad_ref_list(priv->RefPicList1, &priv->RefPicList1_count, num_refs[1]);
 
     exec_picture_refs_modification(decoder, picture, slice_hdr);
 
-    switch (base_picture->type) {
+    switch (type) {
     case GST_VAAPI_PICTURE_TYPE_B:
-        num_refs = 1 + slice_hdr->num_ref_idx_l1_active_minus1;
-        for (i = priv->RefPicList1_count; i < num_refs; i++)
+        for (i = priv->RefPicList1_count; i < num_refs[1]; i++)
             priv->RefPicList1[i] = NULL;
-        priv->RefPicList1_count = num_refs;
+        priv->RefPicList1_count = num_refs[1];
 
         // fall-through
-    case GST_VAAPI_PICTURE_TYPE_P:
-    case GST_VAAPI_PICTURE_TYPE_SP:
-        num_refs = 1 + slice_hdr->num_ref_idx_l0_active_minus1;
-        for (i = priv->RefPicList0_count; i < num_refs; i++)
-            priv->RefPicList0[i] = NULL;
-        priv->RefPicList0_count = num_refs;
-        break;
     default:
+        for (i = priv->RefPicList0_count; i < num_refs[0]; i++)
+            priv->RefPicList0[i] = NULL;
+        priv->RefPicList0_count = num_refs[0];
         break;
     }
+
+    /* Lists modified by this slice cannot be reused by the next one */
+    priv->has_RefPicList         = !has_picture_refs_modification(slice_hdr);
+    priv->RefPicList_type        = type;
+    priv->RefPicList_num_refs[0] = num_refs[0];
+    priv->RefPicList_num_refs[1] = num_refs[1];
     return TRUE;
 }
 
@@ -1740,7 +1884,6 @@ static gboolean
 exec_ref_pic_marking(GstVaapiDecoderH264 *decoder, GstVaapiPictureH264 *picture)
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
-    GstVaapiPictureH264 **picture_ptr;
 
     if (!GST_VAAPI_PICTURE_IS_REFERENCE(picture))
         return TRUE;
@@ -1759,10 +1902,9 @@ exec_ref_pic_marking(GstVaapiDecoderH264 *decoder, GstVaapiPictureH264 *picture)
     }
 
     if (picture->is_long_term)
-        picture_ptr = &priv->long_ref[priv->long_ref_count++];
+        insert_reference(decoder, priv->long_ref, &priv->long_ref_count, picture);
     else
-        picture_ptr = &priv->short_ref[priv->short_ref_count++];
-    gst_vaapi_picture_replace(picture_ptr, picture);
+        insert_reference(decoder, priv->short_ref, &priv->short_ref_count, picture);
     return TRUE;
 }
 
@@ -1920,10 +2062,13 @@ static GstVaapiDecoderStatus
 decode_picture(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu, GstH264SliceHdr *slice_hdr)
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
+    GstVaapiDecoder * const base_decoder = GST_VAAPI_DECODER_CAST(decoder);
     GstVaapiPictureH264 *picture;
     GstVaapiDecoderStatus status;
     GstH264PPS * const pps = slice_hdr->pps;
     GstH264SPS * const sps = pps->sequence;
+    GstClockTime start;
+    gboolean success;
 
     status = ensure_context(decoder, sps);
     if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
@@ -1958,7 +2103,12 @@ decode_picture(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu, GstH264SliceH
 
     if (!init_picture(decoder, picture, slice_hdr, nalu))
         return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
-    if (!fill_picture(decoder, picture, slice_hdr, nalu))
+
+    start = gst_vaapi_decoder_stage_begin(base_decoder);
+    success = fill_picture(decoder, picture, slice_hdr, nalu);
+    gst_vaapi_decoder_stage_end(base_decoder, GST_VAAPI_DECODER_STAGE_FILL,
+        start);
+    if (!success)
         return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
@@ -1966,7 +2116,15 @@ decode_picture(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu, GstH264SliceH
 static gboolean
 decode_picture_end(GstVaapiDecoderH264 *decoder, GstVaapiPictureH264 *picture)
 {
-    if (!fill_quant_matrix(decoder, picture))
+    GstVaapiDecoder * const base_decoder = GST_VAAPI_DECODER_CAST(decoder);
+    GstClockTime start;
+    gboolean success;
+
+    start = gst_vaapi_decoder_stage_begin(base_decoder);
+    success = fill_quant_matrix(decoder, picture);
+    gst_vaapi_decoder_stage_end(base_decoder, GST_VAAPI_DECODER_STAGE_FILL,
+        start);
+    if (!success)
         return FALSE;
     if (!exit_picture(decoder, picture))
         return FALSE;
@@ -2149,11 +2307,14 @@ static GstVaapiDecoderStatus
 decode_slice(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu)
 {
     GstVaapiDecoderH264Private * const priv = decoder->priv;
+    GstVaapiDecoder * const base_decoder = GST_VAAPI_DECODER_CAST(decoder);
     GstVaapiDecoderStatus status;
     GstVaapiPictureH264 *picture;
     GstVaapiSliceH264 *slice = NULL;
     GstH264SliceHdr *slice_hdr;
     GstH264ParserResult result;
+    GstClockTime start;
+    gboolean success;
 
     GST_DEBUG("slice (%u bytes)", nalu->size);
 
@@ -2176,7 +2337,9 @@ decode_slice(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu)
     }
 
     if (slice_hdr->first_mb_in_slice == 0) {
+        GST_VAAPI_TRACE_BEGIN("h264.decode_picture", 0);
         status = decode_picture(decoder, nalu, slice_hdr);
+        GST_VAAPI_TRACE_END("h264.decode_picture", 0);
         if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
             goto error;
     }
@@ -2185,7 +2348,15 @@ decode_slice(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu)
     priv->mb_x = slice_hdr->first_mb_in_slice % priv->mb_width;
     priv->mb_y = slice_hdr->first_mb_in_slice / priv->mb_width; // FIXME: MBAFF or field
 
-    if (!fill_slice(decoder, slice, nalu)) {
+    if (!init_slice_refs(decoder, picture, slice_hdr)) {
+        status = GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+        goto error;
+    }
+    start = gst_vaapi_decoder_stage_begin(base_decoder);
+    success = fill_slice(decoder, slice, nalu);
+    gst_vaapi_decoder_stage_end(base_decoder, GST_VAAPI_DECODER_STAGE_FILL,
+        start);
+    if (!success) {
         status = GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
         goto error;
     }
@@ -2210,6 +2381,118 @@ error:
     return status;
 }
 
+static inline void
+flush_input(GstVaapiDecoderH264 *decoder, guint size)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+
+    gst_adapter_flush(priv->adapter, size);
+    if (!priv->is_avc)
+        gst_vaapi_start_code_scanner_flush(&priv->scanner, size);
+}
+
+/* Locates the next complete NAL unit at the head of the adapter.
+   @nal_size_ptr receives the number of bytes to flush once the NAL
+   unit is decoded, and @buf_size_ptr the number of bytes the parser
+   needs to see (byte-stream NAL units are delimited by the next start
+   code). Start codes are located by the scanner as the input buffers
+   arrive, so every input byte is scanned only once */
+static GstVaapiDecoderStatus
+get_nal_unit_size(
+    GstVaapiDecoderH264 *decoder,
+    guint               *nal_size_ptr,
+    guint               *buf_size_ptr
+)
+{
+    GstVaapiDecoderH264Private * const priv = decoder->priv;
+    const guint8 *buf;
+    guint i, size, nal_size;
+    gint ofs;
+
+    size = gst_adapter_available(priv->adapter);
+
+    if (priv->is_avc) {
+        if (size < priv->nal_length_size)
+            return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+        buf = gst_adapter_peek(priv->adapter, priv->nal_length_size);
+        for (i = 0, nal_size = 0; i < priv->nal_length_size; i++)
+            nal_size = (nal_size << 8) | buf[i];
+        nal_size += priv->nal_length_size;
+        if (size < nal_size)
+            return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+        *nal_size_ptr = nal_size;
+        *buf_size_ptr = nal_size;
+        return GST_VAAPI_DECODER_STATUS_SUCCESS;
+    }
+
+    /* Synchronize to the first start code */
+    ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 0);
+    if (ofs < 0) {
+        // Keep the last two bytes, they could start a start code
+        if (size > 2)
+            flush_input(decoder, size - 2);
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+    }
+    if (ofs > 0)
+        flush_input(decoder, ofs);
+
+    ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 3);
+    if (ofs < 0)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+    /* The parser only recognizes the next start code along with the
+       byte that follows it */
+    if (gst_adapter_available(priv->adapter) < ofs + 4)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+    *nal_size_ptr = ofs;
+    *buf_size_ptr = ofs + 4;
+    return GST_VAAPI_DECODER_STATUS_SUCCESS;
+}
+
+static GstVaapiDecoderStatus
+decode_nalu(GstVaapiDecoderH264 *decoder, GstH264NalUnit *nalu)
+{
+    GstVaapiDecoderStatus status;
+
+    switch (nalu->type) {
+    case GST_H264_NAL_SLICE_IDR:
+        /* fall-through. IDR specifics are handled in init_picture() */
+    case GST_H264_NAL_SLICE:
+        GST_VAAPI_TRACE_BEGIN("h264.decode_slice", 0);
+        status = decode_slice(decoder, nalu);
+        GST_VAAPI_TRACE_END("h264.decode_slice", 0);
+        break;
+    case GST_H264_NAL_SPS:
+        status = decode_sps(decoder, nalu);
+        break;
+    case GST_H264_NAL_PPS:
+        status = decode_pps(decoder, nalu);
+        break;
+    case GST_H264_NAL_SEI:
+        status = decode_sei(decoder, nalu);
+        break;
+    case GST_H264_NAL_SEQ_END:
+        status = decode_sequence_end(decoder);
+        break;
+    case GST_H264_NAL_AU_DELIMITER:
+        /* skip all Access Unit NALs */
+        status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+        break;
+    case GST_H264_NAL_FILLER_DATA:
+        /* skip all Filler Data NALs */
+        status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+        break;
+    default:
+        GST_DEBUG("unsupported NAL unit type %d", nalu->type);
+        status = GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
+        break;
+    }
+    return status;
+}
+
 static GstVaapiDecoderStatus
 decode_buffer(GstVaapiDecoderH264 *decoder, GstBuffer *buffer)
 {
@@ -2217,92 +2500,52 @@ decode_buffer(GstVaapiDecoderH264 *decoder, GstBuffer *buffer)
     GstVaapiDecoderStatus status;
     GstH264ParserResult result;
     GstH264NalUnit nalu;
-    guchar *buf;
-    guint buf_size, ofs;
+    const guint8 *buf;
+    guint buf_size, nal_size;
 
     buf      = GST_BUFFER_DATA(buffer);
     buf_size = GST_BUFFER_SIZE(buffer);
     if (!buf && buf_size == 0)
         return decode_sequence_end(decoder);
 
-    gst_buffer_ref(buffer);
-    gst_adapter_push(priv->adapter, buffer);
+    gst_adapter_push(priv->adapter, gst_buffer_ref(buffer));
+    if (!priv->is_avc)
+        gst_vaapi_start_code_scanner_push(&priv->scanner, buf, buf_size);
 
-    if (priv->sub_buffer) {
-        buffer = gst_buffer_merge(priv->sub_buffer, buffer);
-        if (!buffer)
-            return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
-        gst_buffer_unref(priv->sub_buffer);
-        priv->sub_buffer = NULL;
-    }
-
-    buf      = GST_BUFFER_DATA(buffer);
-    buf_size = GST_BUFFER_SIZE(buffer);
-    ofs      = 0;
     do {
+        status = get_nal_unit_size(decoder, &nal_size, &buf_size);
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+            break;
+
+        /* The adapter only assembles (copies) the NAL unit if it
+           straddles input buffers. Slice data is then copied once
+           more, straight into the VA slice data buffer */
+        buf = gst_adapter_peek(priv->adapter, buf_size);
         if (priv->is_avc) {
             result = gst_h264_parser_identify_nalu_avc(
                 priv->parser,
-                buf, ofs, buf_size, priv->nal_length_size,
+                buf, 0, buf_size, priv->nal_length_size,
                 &nalu
             );
         }
         else {
             result = gst_h264_parser_identify_nalu(
                 priv->parser,
-                buf, ofs, buf_size,
+                buf, 0, buf_size,
                 &nalu
             );
         }
         status = get_status(result);
 
-        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
-            priv->sub_buffer = gst_buffer_create_sub(buffer, ofs, buf_size - ofs);
-            break;
-        }
-        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+        /* Keep the NAL unit until the parser sees all of it */
+        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
             break;
+        if (status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+            status = decode_nalu(decoder, &nalu);
 
-        ofs = nalu.offset - ofs;
-        if (gst_adapter_available(priv->adapter) >= ofs)
-            gst_adapter_flush(priv->adapter, ofs);
-
-        switch (nalu.type) {
-        case GST_H264_NAL_SLICE_IDR:
-            /* fall-through. IDR specifics are handled in init_picture() */
-        case GST_H264_NAL_SLICE:
-            status = decode_slice(decoder, &nalu);
-            break;
-        case GST_H264_NAL_SPS:
-            status = decode_sps(decoder, &nalu);
-            break;
-        case GST_H264_NAL_PPS:
-            status = decode_pps(decoder, &nalu);
-            break;
-        case GST_H264_NAL_SEI:
-            status = decode_sei(decoder, &nalu);
-            break;
-        case GST_H264_NAL_SEQ_END:
-            status = decode_sequence_end(decoder);
-            break;
-        case GST_H264_NAL_AU_DELIMITER:
-            /* skip all Access Unit NALs */
-            status = GST_VAAPI_DECODER_STATUS_SUCCESS;
-            break;
-        case GST_H264_NAL_FILLER_DATA:
-            /* skip all Filler Data NALs */
-            status = GST_VAAPI_DECODER_STATUS_SUCCESS;
-            break;
-        default:
-            GST_DEBUG("unsupported NAL unit type %d", nalu.type);
-            status = GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
-            break;
-        }
-
-        if (gst_adapter_available(priv->adapter) >= nalu.size)
-            gst_adapter_flush(priv->adapter, nalu.size);
-        ofs = nalu.offset + nalu.size;
-    } while (status == GST_VAAPI_DECODER_STATUS_SUCCESS && ofs < buf_size);
+        /* The next NAL unit starts right at the next start code */
+        flush_input(decoder, nal_size);
+    } while (status == GST_VAAPI_DECODER_STATUS_SUCCESS);
     return status;
 }
 
@@ -2454,6 +2697,10 @@ gst_vaapi_decoder_h264_init(GstVaapiDecoderH264 *decoder)
     priv->long_ref_count        = 0;
     priv->RefPicList0_count     = 0;
     priv->RefPicList1_count     = 0;
+    priv->num_slices            = 0;
+    priv->num_ref_lists_built   = 0;
+    priv->num_ref_lists_copied  = 0;
+    priv->num_ref_lists_reused  = 0;
     priv->nal_length_size       = 0;
     priv->width                 = 0;
     priv->height                = 0;
@@ -2462,7 +2709,6 @@ gst_vaapi_decoder_h264_init(GstVaapiDecoderH264 *decoder)
     priv->mb_width              = 0;
     priv->mb_height             = 0;
     priv->adapter               = NULL;
-    priv->sub_buffer            = NULL;
     priv->field_poc[0]          = 0;
     priv->field_poc[1]          = 0;
     priv->poc_msb               = 0;
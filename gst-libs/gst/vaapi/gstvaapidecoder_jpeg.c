@@ -26,11 +26,13 @@
 
 #include "sysdeps.h"
 #include <string.h>
+#include <gst/base/gstadapter.h>
 #include <gst/codecparsers/gstjpegparser.h>
 #include "gstvaapicompat.h"
 #include "gstvaapidecoder_jpeg.h"
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapijpegmarker.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 
@@ -46,30 +48,287 @@ G_DEFINE_TYPE(GstVaapiDecoderJpeg,
                                  GST_VAAPI_TYPE_DECODER_JPEG,   \
                                  GstVaapiDecoderJpegPrivate))
 
+typedef enum {
+    JPEG_FRAMER_STATE_SCAN = 0,         /* looking for the next marker */
+    JPEG_FRAMER_STATE_LENGTH,           /* reading a segment length */
+    JPEG_FRAMER_STATE_SKIP,             /* skipping a segment payload */
+} JpegFramerState;
+
+/* Splits the input into JPEG images. The segments of the image being
+   received are recorded as its bytes are pushed, so no byte is scanned
+   twice, whatever the input buffers boundaries are */
+typedef struct _GstJpegFramer GstJpegFramer;
+struct _GstJpegFramer {
+    const GstVaapiJpegMarkerFuncs *funcs;
+    GArray                     *segments;       /* GstJpegMarkerSegment */
+    guint                       state;
+    guint                       offset;         /* adapter bytes scanned */
+    guint                       frame_offset;   /* adapter offset of SOI */
+    guint                       marker_offset;  /* adapter offset of marker */
+    guint                       length;
+    guint                       length_bytes;
+    guint                       skip_size;
+    guint8                      marker;
+    guint                       has_soi         : 1;
+    guint                       has_ff          : 1;
+};
+
+/* VA parameters built from the DHT or DQT segments of an image. MJPEG
+   streams usually carry the same tables in every image, so they are
+   only parsed and converted again when the segment bytes change */
+typedef struct _GstJpegTableCache GstJpegTableCache;
+struct _GstJpegTableCache {
+    GByteArray                 *segments;       /* of the current image */
+    GByteArray                 *key;            /* segments param is for */
+    gpointer                    param;
+    guint                       param_size;
+    guint                       is_valid        : 1;
+};
+
 struct _GstVaapiDecoderJpegPrivate {
     GstVaapiProfile             profile;
     guint                       width;
     guint                       height;
     GstVaapiPicture            *current_picture;
+    GstAdapter                 *adapter;
+    GstJpegFramer               framer;
     GstJpegFrameHdr             frame_hdr;
     GstJpegHuffmanTables        huf_tables;
     GstJpegQuantTables          quant_tables;
-    gboolean                    has_huf_table;
-    gboolean                    has_quant_table;
+    GstJpegTableCache           huf_cache;
+    GstJpegTableCache           quant_cache;
+    guint                       num_table_hits;
+    guint                       num_table_misses;
     guint                       mcu_restart;
     guint                       is_opened       : 1;
     guint                       profile_changed : 1;
+    guint                       size_changed    : 1;
     guint                       is_constructed  : 1;
 };
 
-typedef struct _GstJpegScanSegment GstJpegScanSegment;
-struct _GstJpegScanSegment {
-    guint                       header_offset;
-    guint                       header_size;
-    guint                       data_offset;
-    guint                       data_size;
-    guint                       is_valid        : 1;
-};
+static void
+jpeg_framer_reset(GstJpegFramer *framer)
+{
+    g_array_set_size(framer->segments, 0);
+    framer->state       = JPEG_FRAMER_STATE_SCAN;
+    framer->has_soi     = FALSE;
+    framer->has_ff      = FALSE;
+}
+
+static void
+jpeg_framer_init(GstJpegFramer *framer)
+{
+    framer->funcs       = gst_vaapi_jpeg_marker_get_funcs();
+    framer->segments    = g_array_new(FALSE, FALSE,
+                                      sizeof(GstJpegMarkerSegment));
+    framer->offset      = 0;
+    jpeg_framer_reset(framer);
+}
+
+static void
+jpeg_framer_clear(GstJpegFramer *framer)
+{
+    if (framer->segments) {
+        g_array_free(framer->segments, TRUE);
+        framer->segments = NULL;
+    }
+    framer->offset = 0;
+}
+
+/* Records a segment, relative to the SOI marker. @offset is the adapter
+   offset of the segment payload, which follows the marker */
+static void
+jpeg_framer_add_segment(GstJpegFramer *framer, guint8 marker, guint offset,
+    guint size)
+{
+    GstJpegMarkerSegment seg;
+
+    seg.marker = marker;
+    seg.offset = offset - framer->frame_offset;
+    seg.size   = size;
+    g_array_append_val(framer->segments, seg);
+}
+
+/* Handles the marker at adapter @offset. Returns TRUE once the image
+   is complete */
+static gboolean
+jpeg_framer_handle_marker(GstJpegFramer *framer, guint offset, guint8 marker)
+{
+    if (marker == GST_JPEG_MARKER_SOI) {
+        if (framer->has_soi)
+            GST_WARNING("missing EOI marker, dropping incomplete image");
+        g_array_set_size(framer->segments, 0);
+        framer->has_soi      = TRUE;
+        framer->frame_offset = offset;
+        jpeg_framer_add_segment(framer, marker, offset + 2, 0);
+        return FALSE;
+    }
+
+    /* Skip anything before the first image */
+    if (!framer->has_soi)
+        return FALSE;
+
+    if (marker == GST_JPEG_MARKER_EOI) {
+        jpeg_framer_add_segment(framer, marker, offset + 2, 0);
+        return TRUE;
+    }
+
+    /* All the other markers that can be found start a segment that
+       begins with its length */
+    framer->state         = JPEG_FRAMER_STATE_LENGTH;
+    framer->marker        = marker;
+    framer->marker_offset = offset;
+    framer->length        = 0;
+    framer->length_bytes  = 0;
+    return FALSE;
+}
+
+/* Scans @buf, the next @buf_size bytes pushed into the adapter, up to
+   the end of the first complete image if any. Returns the number of
+   bytes consumed */
+static guint
+jpeg_framer_scan(GstJpegFramer *framer, const guint8 *buf, guint buf_size,
+    gboolean *got_frame_ptr)
+{
+    gboolean got_frame = FALSE;
+    guint i = 0, n;
+
+    while (i < buf_size && !got_frame) {
+        switch (framer->state) {
+        case JPEG_FRAMER_STATE_SCAN:
+            /* Marker split across two input buffers */
+            if (framer->has_ff) {
+                framer->has_ff = FALSE;
+                if (GST_VAAPI_JPEG_IS_MARKER(buf[i])) {
+                    got_frame = jpeg_framer_handle_marker(framer,
+                        framer->offset + i - 1, buf[i]);
+                    i++;
+                    break;
+                }
+            }
+
+            /* Stuffed bytes and restart markers are skipped over, so
+               an entropy coded segment is scanned in one go */
+            n = framer->funcs->find(buf + i, buf_size - i);
+            if (n < buf_size - i) {
+                got_frame = jpeg_framer_handle_marker(framer,
+                    framer->offset + i + n, buf[i + n + 1]);
+                i += n + 2;
+                break;
+            }
+            framer->has_ff = buf[buf_size - 1] == 0xff;
+            i = buf_size;
+            break;
+        case JPEG_FRAMER_STATE_LENGTH:
+            framer->length = (framer->length << 8) | buf[i++];
+            if (++framer->length_bytes < 2)
+                break;
+            if (framer->length < 2) {
+                GST_WARNING("invalid length for marker 0x%02x, dropping image",
+                            framer->marker);
+                jpeg_framer_reset(framer);
+                break;
+            }
+            jpeg_framer_add_segment(framer, framer->marker,
+                framer->marker_offset + 2, framer->length);
+            framer->skip_size = framer->length - 2;
+            framer->state     = framer->skip_size > 0 ?
+                JPEG_FRAMER_STATE_SKIP : JPEG_FRAMER_STATE_SCAN;
+            break;
+        case JPEG_FRAMER_STATE_SKIP:
+            n = MIN(framer->skip_size, buf_size - i);
+            framer->skip_size -= n;
+            i += n;
+            if (framer->skip_size == 0)
+                framer->state = JPEG_FRAMER_STATE_SCAN;
+            break;
+        }
+    }
+    framer->offset += i;
+    *got_frame_ptr = got_frame;
+    return i;
+}
+
+static void
+jpeg_table_cache_init(GstJpegTableCache *cache, guint param_size)
+{
+    cache->segments   = g_byte_array_new();
+    cache->key        = g_byte_array_new();
+    cache->param      = g_malloc0(param_size);
+    cache->param_size = param_size;
+    cache->is_valid   = FALSE;
+}
+
+static void
+jpeg_table_cache_clear(GstJpegTableCache *cache)
+{
+    if (cache->segments) {
+        g_byte_array_free(cache->segments, TRUE);
+        cache->segments = NULL;
+    }
+    if (cache->key) {
+        g_byte_array_free(cache->key, TRUE);
+        cache->key = NULL;
+    }
+    g_free(cache->param);
+    cache->param    = NULL;
+    cache->is_valid = FALSE;
+}
+
+/* The segments are compared byte for byte, rather than through a hash
+   that could let different tables collide */
+static gboolean
+jpeg_table_cache_lookup(GstJpegTableCache *cache)
+{
+    return cache->is_valid &&
+        cache->key->len == cache->segments->len &&
+        memcmp(cache->key->data, cache->segments->data,
+               cache->segments->len) == 0;
+}
+
+static void
+jpeg_table_cache_update(GstJpegTableCache *cache)
+{
+    g_byte_array_set_size(cache->key, 0);
+    g_byte_array_append(cache->key, cache->segments->data,
+                        cache->segments->len);
+    cache->is_valid = TRUE;
+}
+
+static gpointer
+default_huffman_tables_init(gpointer data)
+{
+    gst_jpeg_get_default_huffman_tables(data);
+    return data;
+}
+
+/* Computed once, for the images without DHT segments */
+static const GstJpegHuffmanTables *
+get_default_huffman_tables(void)
+{
+    static GOnce once = G_ONCE_INIT;
+    static GstJpegHuffmanTables huf_tables;
+
+    g_once(&once, default_huffman_tables_init, &huf_tables);
+    return once.retval;
+}
+
+static gpointer
+default_quant_tables_init(gpointer data)
+{
+    gst_jpeg_get_default_quantization_tables(data);
+    return data;
+}
+
+static const GstJpegQuantTables *
+get_default_quant_tables(void)
+{
+    static GOnce once = G_ONCE_INIT;
+    static GstJpegQuantTables quant_tables;
+
+    g_once(&once, default_quant_tables_init, &quant_tables);
+    return once.retval;
+}
 
 static void
 gst_vaapi_decoder_jpeg_close(GstVaapiDecoderJpeg *decoder)
@@ -78,33 +337,65 @@ gst_vaapi_decoder_jpeg_close(GstVaapiDecoderJpeg *decoder)
 
     gst_vaapi_picture_replace(&priv->current_picture, NULL);
 
+    jpeg_framer_clear(&priv->framer);
+
+    if (priv->adapter) {
+        gst_adapter_clear(priv->adapter);
+        g_object_unref(priv->adapter);
+        priv->adapter = NULL;
+    }
+
     /* Reset all */
     priv->profile               = GST_VAAPI_PROFILE_JPEG_BASELINE;
     priv->width                 = 0;
     priv->height                = 0;
     priv->is_opened             = FALSE;
     priv->profile_changed       = TRUE;
+    priv->size_changed          = FALSE;
 }
 
 static gboolean
 gst_vaapi_decoder_jpeg_open(GstVaapiDecoderJpeg *decoder, GstBuffer *buffer)
 {
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+
     gst_vaapi_decoder_jpeg_close(decoder);
 
+    priv->adapter = gst_adapter_new();
+    if (!priv->adapter)
+        return FALSE;
+
+    jpeg_framer_init(&priv->framer);
     return TRUE;
 }
 
 static void
 gst_vaapi_decoder_jpeg_destroy(GstVaapiDecoderJpeg *decoder)
 {
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+
     gst_vaapi_decoder_jpeg_close(decoder);
+
+    if (priv->num_table_hits + priv->num_table_misses > 0)
+        GST_DEBUG("%u Huffman and quantization tables reused, %u parsed",
+                  priv->num_table_hits, priv->num_table_misses);
+
+    jpeg_table_cache_clear(&priv->huf_cache);
+    jpeg_table_cache_clear(&priv->quant_cache);
 }
 
 static gboolean
 gst_vaapi_decoder_jpeg_create(GstVaapiDecoderJpeg *decoder)
 {
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+
     if (!GST_VAAPI_DECODER_CODEC(decoder))
         return FALSE;
+
+    jpeg_table_cache_init(&priv->huf_cache,
+                          sizeof(VAHuffmanTableBufferJPEGBaseline));
+    jpeg_table_cache_init(&priv->quant_cache,
+                          sizeof(VAIQMatrixBufferJPEGBaseline));
     return TRUE;
 }
 
@@ -136,6 +427,12 @@ ensure_context(GstVaapiDecoderJpeg *decoder)
         priv->profile = profiles[i];
     }
 
+    if (priv->size_changed) {
+        GST_DEBUG("size changed");
+        priv->size_changed = FALSE;
+        reset_context      = TRUE;
+    }
+
     if (reset_context) {
         GstVaapiContextInfo info;
 
@@ -204,60 +501,102 @@ fill_picture(
 }
 
 static gboolean
-fill_quantization_table(
-    GstVaapiDecoderJpeg *decoder, 
-    GstVaapiPicture     *picture
+build_iq_matrix(
+    GstVaapiDecoderJpeg          *decoder,
+    VAIQMatrixBufferJPEGBaseline *iq_matrix
 )
 {
     GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
-    VAIQMatrixBufferJPEGBaseline *iq_matrix;
-    guint i, j, num_tables;
-
-    if (!priv->has_quant_table)
-        gst_jpeg_get_default_quantization_tables(&priv->quant_tables);
-    
-    picture->iq_matrix = GST_VAAPI_IQ_MATRIX_NEW(JPEGBaseline, decoder);
-    g_assert(picture->iq_matrix);
-    iq_matrix = picture->iq_matrix->param;
+    GByteArray * const segments = priv->quant_cache.segments;
+    const GstJpegQuantTables *quant_tables;
+    guint i, j, ofs, size, num_tables;
+
+    if (segments->len == 0)
+        quant_tables = get_default_quant_tables();
+    else {
+        memset(&priv->quant_tables, 0, sizeof(priv->quant_tables));
+        for (ofs = 0; ofs < segments->len; ofs += size) {
+            size = GST_READ_UINT16_BE(segments->data + ofs);
+            if (!gst_jpeg_parse_quant_table(&priv->quant_tables,
+                                            segments->data + ofs, size, 0)) {
+                GST_DEBUG("failed to parse quantization table");
+                return FALSE;
+            }
+        }
+        quant_tables = &priv->quant_tables;
+    }
 
+    memset(iq_matrix, 0, sizeof(*iq_matrix));
     num_tables = MIN(G_N_ELEMENTS(iq_matrix->quantiser_table),
                      GST_JPEG_MAX_QUANT_ELEMENTS);
 
     for (i = 0; i < num_tables; i++) {
-        GstJpegQuantTable * const quant_table =
-            &priv->quant_tables.quant_tables[i];
+        const GstJpegQuantTable * const quant_table =
+            &quant_tables->quant_tables[i];
 
-        iq_matrix->load_quantiser_table[i] = quant_table->valid;
-        if (!iq_matrix->load_quantiser_table[i])
+        if (!quant_table->valid)
             continue;
 
         g_assert(quant_table->quant_precision == 0);
         for (j = 0; j < GST_JPEG_MAX_QUANT_ELEMENTS; j++)
             iq_matrix->quantiser_table[i][j] = quant_table->quant_table[j];
         iq_matrix->load_quantiser_table[i] = 1;
-        quant_table->valid = FALSE;
     }
     return TRUE;
 }
 
 static gboolean
-fill_huffman_table(
+fill_quantization_table(
     GstVaapiDecoderJpeg *decoder, 
     GstVaapiPicture     *picture
 )
 {
     GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
-    GstJpegHuffmanTables * const huf_tables = &priv->huf_tables;
-    VAHuffmanTableBufferJPEGBaseline *huffman_table;
-    guint i, num_tables;
+    GstJpegTableCache * const cache = &priv->quant_cache;
+
+    if (jpeg_table_cache_lookup(cache))
+        priv->num_table_hits++;
+    else {
+        priv->num_table_misses++;
+        cache->is_valid = FALSE;
+        if (!build_iq_matrix(decoder, cache->param))
+            return FALSE;
+        jpeg_table_cache_update(cache);
+    }
 
-    if (!priv->has_huf_table)
-        gst_jpeg_get_default_huffman_tables(&priv->huf_tables);
-    
-    picture->huf_table = GST_VAAPI_HUFFMAN_TABLE_NEW(JPEGBaseline, decoder);
-    g_assert(picture->huf_table);
-    huffman_table = picture->huf_table->param;
+    /* The VA buffer is created from the cached parameters in one go */
+    picture->iq_matrix = gst_vaapi_iq_matrix_new(
+        GST_VAAPI_DECODER_CAST(decoder), cache->param, cache->param_size);
+    return picture->iq_matrix != NULL;
+}
 
+static gboolean
+build_huffman_table(
+    GstVaapiDecoderJpeg              *decoder,
+    VAHuffmanTableBufferJPEGBaseline *huffman_table
+)
+{
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+    GByteArray * const segments = priv->huf_cache.segments;
+    const GstJpegHuffmanTables *huf_tables;
+    guint i, ofs, size, num_tables;
+
+    if (segments->len == 0)
+        huf_tables = get_default_huffman_tables();
+    else {
+        memset(&priv->huf_tables, 0, sizeof(priv->huf_tables));
+        for (ofs = 0; ofs < segments->len; ofs += size) {
+            size = GST_READ_UINT16_BE(segments->data + ofs);
+            if (!gst_jpeg_parse_huffman_table(&priv->huf_tables,
+                                              segments->data + ofs, size, 0)) {
+                GST_DEBUG("failed to parse Huffman table");
+                return FALSE;
+            }
+        }
+        huf_tables = &priv->huf_tables;
+    }
+
+    memset(huffman_table, 0, sizeof(*huffman_table));
     num_tables = MIN(G_N_ELEMENTS(huffman_table->huffman_table),
                      GST_JPEG_MAX_SCAN_COMPONENTS);
 
@@ -279,13 +618,34 @@ fill_huffman_table(
         memcpy(huffman_table->huffman_table[i].ac_values,
                huf_tables->ac_tables[i].huf_values,
                sizeof(huffman_table->huffman_table[i].ac_values));
-        memset(huffman_table->huffman_table[i].pad,
-               0,
-               sizeof(huffman_table->huffman_table[i].pad));
     }
     return TRUE;
 }
 
+static gboolean
+fill_huffman_table(
+    GstVaapiDecoderJpeg *decoder, 
+    GstVaapiPicture     *picture
+)
+{
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+    GstJpegTableCache * const cache = &priv->huf_cache;
+
+    if (jpeg_table_cache_lookup(cache))
+        priv->num_table_hits++;
+    else {
+        priv->num_table_misses++;
+        cache->is_valid = FALSE;
+        if (!build_huffman_table(decoder, cache->param))
+            return FALSE;
+        jpeg_table_cache_update(cache);
+    }
+
+    picture->huf_table = gst_vaapi_huffman_table_new(
+        GST_VAAPI_DECODER_CAST(decoder), cache->param, cache->param_size);
+    return picture->huf_table != NULL;
+}
+
 static guint
 get_max_horizontal_samples(GstJpegFrameHdr *frame_hdr)
 {
@@ -323,6 +683,8 @@ decode_picture(
     GstJpegFrameHdr * const frame_hdr = &priv->frame_hdr;
     GstVaapiPicture *picture;
     GstVaapiDecoderStatus status;
+    GstClockTime start;
+    gboolean success;
 
     switch (profile) {
     case GST_JPEG_MARKER_SOF_MIN:
@@ -338,8 +700,11 @@ decode_picture(
         GST_ERROR("failed to parse image");
         return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
     }
-    priv->height = frame_hdr->height;
-    priv->width  = frame_hdr->width;
+    if (priv->width != frame_hdr->width || priv->height != frame_hdr->height) {
+        priv->width        = frame_hdr->width;
+        priv->height       = frame_hdr->height;
+        priv->size_changed = TRUE;
+    }
 
     status = ensure_context(decoder);
     if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
@@ -358,7 +723,11 @@ decode_picture(
     gst_vaapi_picture_replace(&priv->current_picture, picture);
     gst_vaapi_picture_unref(picture);
 
-    if (!fill_picture(decoder, picture, frame_hdr))
+    start = gst_vaapi_decoder_stage_begin(GST_VAAPI_DECODER_CAST(decoder));
+    success = fill_picture(decoder, picture, frame_hdr);
+    gst_vaapi_decoder_stage_end(GST_VAAPI_DECODER_CAST(decoder),
+        GST_VAAPI_DECODER_STAGE_FILL, start);
+    if (!success)
         return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
 
     /* Update presentation time */
@@ -375,11 +744,8 @@ decode_huffman_table(
 {
     GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
 
-    if (!gst_jpeg_parse_huffman_table(&priv->huf_tables, buf, buf_size, 0)) {
-        GST_DEBUG("failed to parse Huffman table");
-        return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
-    }
-    priv->has_huf_table = TRUE;
+    /* Parsed when the first scan is decoded, if not cached */
+    g_byte_array_append(priv->huf_cache.segments, buf, buf_size);
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -392,11 +758,7 @@ decode_quant_table(
 {
     GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
 
-    if (!gst_jpeg_parse_quant_table(&priv->quant_tables, buf, buf_size, 0)) {
-        GST_DEBUG("failed to parse quantization table");
-        return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
-    }
-    priv->has_quant_table = TRUE;
+    g_byte_array_append(priv->quant_cache.segments, buf, buf_size);
     return GST_VAAPI_DECODER_STATUS_SUCCESS;
 }
 
@@ -430,6 +792,8 @@ decode_scan(
     GstVaapiSlice *gst_slice;
     guint total_h_samples, total_v_samples;
     GstJpegScanHdr  scan_hdr;
+    GstClockTime start;
+    gboolean success;
     guint i;
 
     if (!picture) {
@@ -437,15 +801,21 @@ decode_scan(
         return GST_VAAPI_DECODER_STATUS_ERROR_INVALID_SURFACE;
     }
 
+    start = gst_vaapi_decoder_stage_begin(GST_VAAPI_DECODER_CAST(decoder));
     if (!fill_quantization_table(decoder, picture)) {
         GST_ERROR("failed to fill in quantization table");
-        return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+        success = FALSE;
     }
-
-    if (!fill_huffman_table(decoder, picture)) {
+    else if (!fill_huffman_table(decoder, picture)) {
         GST_ERROR("failed to fill in huffman table");
-        return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+        success = FALSE;
     }
+    else
+        success = TRUE;
+    gst_vaapi_decoder_stage_end(GST_VAAPI_DECODER_CAST(decoder),
+        GST_VAAPI_DECODER_STAGE_FILL, start);
+    if (!success)
+        return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
 
     memset(&scan_hdr, 0, sizeof(scan_hdr));
     if (!gst_jpeg_parse_scan_hdr(&scan_hdr, scan_header, scan_header_size, 0)) {
@@ -490,128 +860,140 @@ decode_scan(
     return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
 }
 
+/* Decodes the image held in @buf, whose segments were recorded by the
+   framer */
 static GstVaapiDecoderStatus
-decode_buffer(GstVaapiDecoderJpeg *decoder, GstBuffer *buffer)
+decode_frame(GstVaapiDecoderJpeg *decoder, guchar *buf, GstClockTime pts)
 {
     GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+    GArray * const segments = priv->framer.segments;
     GstVaapiDecoderStatus status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
-    GstJpegMarkerSegment seg;
-    GstJpegScanSegment scan_seg;
-    GstClockTime pts;
-    guchar *buf;
-    guint buf_size, ofs;
-    gboolean append_ecs;
-
-    buf      = GST_BUFFER_DATA(buffer);
-    buf_size = GST_BUFFER_SIZE(buffer);
-    if (!buf && buf_size == 0)
-        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
-
-    memset(&scan_seg, 0, sizeof(scan_seg));
-
-    pts = GST_BUFFER_TIMESTAMP(buffer);
-    ofs = 0;
-    while (gst_jpeg_parse(&seg, buf, buf_size, ofs)) {
-        if (seg.size < 0) {
-            GST_DEBUG("buffer to short for parsing");
-            return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
-        }
-        ofs += seg.size;
+    GstJpegMarkerSegment *seg;
+    guint i, data_offset;
 
-        /* Decode scan, if complete */
-        if (seg.marker == GST_JPEG_MARKER_EOI && scan_seg.header_size > 0) {
-            scan_seg.data_size = seg.offset - scan_seg.data_offset;
-            scan_seg.is_valid  = TRUE;
-        }
-        if (scan_seg.is_valid) {
-            status = decode_scan(
-                decoder,
-                buf + scan_seg.header_offset,
-                scan_seg.header_size,
-                buf + scan_seg.data_offset,
-                scan_seg.data_size
-            );
-            if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
-                break;
-            memset(&scan_seg, 0, sizeof(scan_seg));
-        }
+    for (i = 0; i < segments->len; i++) {
+        seg = &g_array_index(segments, GstJpegMarkerSegment, i);
 
-        append_ecs = TRUE;
-        switch (seg.marker) {
+        switch (seg->marker) {
         case GST_JPEG_MARKER_SOI:
-            priv->has_quant_table = FALSE;
-            priv->has_huf_table   = FALSE;
+            g_byte_array_set_size(priv->huf_cache.segments, 0);
+            g_byte_array_set_size(priv->quant_cache.segments, 0);
             priv->mcu_restart     = 0;
             status = GST_VAAPI_DECODER_STATUS_SUCCESS;
             break;
         case GST_JPEG_MARKER_EOI:
-            if (decode_current_picture(decoder)) {
-                /* Get out of the loop, trailing data is not needed */
+            if (decode_current_picture(decoder))
                 status = GST_VAAPI_DECODER_STATUS_SUCCESS;
-                goto end;
-            }
-            status = GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+            else
+                status = GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
             break;
         case GST_JPEG_MARKER_DHT:
-            status = decode_huffman_table(decoder, buf + seg.offset, seg.size);
+            status = decode_huffman_table(decoder, buf + seg->offset, seg->size);
             break;
         case GST_JPEG_MARKER_DQT:
-            status = decode_quant_table(decoder, buf + seg.offset, seg.size);
+            status = decode_quant_table(decoder, buf + seg->offset, seg->size);
             break;
         case GST_JPEG_MARKER_DRI:
-            status = decode_restart_interval(decoder, buf + seg.offset, seg.size);
+            status = decode_restart_interval(decoder, buf + seg->offset, seg->size);
             break;
         case GST_JPEG_MARKER_DAC:
             GST_ERROR("unsupported arithmetic coding mode");
             status = GST_VAAPI_DECODER_STATUS_ERROR_UNSUPPORTED_PROFILE;
             break;
         case GST_JPEG_MARKER_SOS:
-            scan_seg.header_offset = seg.offset;
-            scan_seg.header_size   = seg.size;
-            scan_seg.data_offset   = seg.offset + seg.size;
-            scan_seg.data_size     = 0;
-            append_ecs             = FALSE;
+            /* The entropy coded segment, restart markers included, ends
+               with the next marker, and EOI is always the last one */
+            data_offset = seg->offset + seg->size;
+            GST_VAAPI_TRACE_BEGIN("jpeg.decode_scan", 0);
+            status = decode_scan(
+                decoder,
+                buf + seg->offset,
+                seg->size,
+                buf + data_offset,
+                seg[1].offset - 2 - data_offset
+            );
+            GST_VAAPI_TRACE_END("jpeg.decode_scan", 0);
             break;
         default:
-            /* Restart marker */
-            if (seg.marker >= GST_JPEG_MARKER_RST_MIN &&
-                seg.marker <= GST_JPEG_MARKER_RST_MAX) {
-                append_ecs = FALSE;
-                break;
-            }
-
             /* Frame header */
-            if (seg.marker >= GST_JPEG_MARKER_SOF_MIN &&
-                seg.marker <= GST_JPEG_MARKER_SOF_MAX) {
+            if (seg->marker >= GST_JPEG_MARKER_SOF_MIN &&
+                seg->marker <= GST_JPEG_MARKER_SOF_MAX) {
+                GST_VAAPI_TRACE_BEGIN("jpeg.decode_picture", 0);
                 status = decode_picture(
                     decoder,
-                    seg.marker,
-                    buf + seg.offset, seg.size,
+                    seg->marker,
+                    buf + seg->offset, seg->size,
                     pts
                 );
+                GST_VAAPI_TRACE_END("jpeg.decode_picture", 0);
                 break;
             }
 
-            /* Application segments */
-            if (seg.marker >= GST_JPEG_MARKER_APP_MIN &&
-                seg.marker <= GST_JPEG_MARKER_APP_MAX) {
+            /* Application segments and comments */
+            if ((seg->marker >= GST_JPEG_MARKER_APP_MIN &&
+                 seg->marker <= GST_JPEG_MARKER_APP_MAX) ||
+                seg->marker == GST_JPEG_MARKER_COM) {
                 status = GST_VAAPI_DECODER_STATUS_SUCCESS;
                 break;
             }
 
-            GST_WARNING("unsupported marker (0x%02x)", seg.marker);
+            GST_WARNING("unsupported marker (0x%02x)", seg->marker);
             status = GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
             break;
         }
-
-        /* Append entropy coded segments */
-        if (append_ecs)
-            scan_seg.data_size = seg.offset - scan_seg.data_offset;
-
         if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
             break;
     }
-end:
+    return status;
+}
+
+static GstVaapiDecoderStatus
+decode_buffer(GstVaapiDecoderJpeg *decoder, GstBuffer *buffer)
+{
+    GstVaapiDecoderJpegPrivate * const priv = decoder->priv;
+    GstJpegFramer * const framer = &priv->framer;
+    GstVaapiDecoderStatus status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+    GstBuffer *frame;
+    GstClockTime pts;
+    guchar *buf;
+    guint buf_size, ofs, frame_size;
+    gboolean got_frame;
+
+    buf      = GST_BUFFER_DATA(buffer);
+    buf_size = GST_BUFFER_SIZE(buffer);
+    if (!buf && buf_size == 0)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+    gst_adapter_push(priv->adapter, gst_buffer_ref(buffer));
+
+    for (ofs = 0; ofs < buf_size;) {
+        ofs += jpeg_framer_scan(framer, buf + ofs, buf_size - ofs, &got_frame);
+        if (!got_frame)
+            continue;
+
+        /* The image is a sub-buffer of the input, unless it spans
+           several input buffers */
+        gst_adapter_flush(priv->adapter, framer->frame_offset);
+        frame_size = framer->offset - framer->frame_offset;
+        pts   = gst_adapter_prev_timestamp(priv->adapter, NULL);
+        frame = gst_adapter_take_buffer(priv->adapter, frame_size);
+        framer->offset = 0;
+
+        status = decode_frame(decoder, GST_BUFFER_DATA(frame), pts);
+        gst_buffer_unref(frame);
+        jpeg_framer_reset(framer);
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+            gst_adapter_clear(priv->adapter);
+            framer->offset = 0;
+            return status;
+        }
+    }
+
+    /* Drop the data that precedes the next image */
+    if (!framer->has_soi) {
+        gst_adapter_flush(priv->adapter, framer->offset - framer->has_ff);
+        framer->offset = framer->has_ff;
+    }
     return status;
 }
 
@@ -678,15 +1060,20 @@ gst_vaapi_decoder_jpeg_init(GstVaapiDecoderJpeg *decoder)
     priv->width                 = 0;
     priv->height                = 0;
     priv->current_picture       = NULL;
-    priv->has_huf_table         = FALSE;
-    priv->has_quant_table       = FALSE;
+    priv->adapter               = NULL;
+    priv->num_table_hits        = 0;
+    priv->num_table_misses      = 0;
     priv->mcu_restart           = 0;
     priv->is_opened             = FALSE;
     priv->profile_changed       = TRUE;
+    priv->size_changed          = FALSE;
     priv->is_constructed        = FALSE;
+    memset(&priv->framer, 0, sizeof(priv->framer));
     memset(&priv->frame_hdr, 0, sizeof(priv->frame_hdr));
     memset(&priv->huf_tables, 0, sizeof(priv->huf_tables));
     memset(&priv->quant_tables, 0, sizeof(priv->quant_tables));
+    memset(&priv->huf_cache, 0, sizeof(priv->huf_cache));
+    memset(&priv->quant_cache, 0, sizeof(priv->quant_cache));
 }
 
 /**
@@ -719,3 +1106,33 @@ gst_vaapi_decoder_jpeg_new(GstVaapiDisplay *display, GstCaps *caps)
     }
     return GST_VAAPI_DECODER_CAST(decoder);
 }
+
+/**
+ * gst_vaapi_decoder_jpeg_get_table_stats:
+ * @decoder: a #GstVaapiDecoderJpeg
+ * @pnum_hits: return location for the number of Huffman and
+ *   quantization tables reused from the previous image, or %NULL
+ * @pnum_misses: return location for the number of Huffman and
+ *   quantization tables that were parsed, or %NULL
+ *
+ * Retrieves the statistics of the Huffman and quantization tables
+ * cache since @decoder was created. Both kinds of tables are looked
+ * up once per scan.
+ */
+void
+gst_vaapi_decoder_jpeg_get_table_stats(
+    GstVaapiDecoderJpeg *decoder,
+    guint               *pnum_hits,
+    guint               *pnum_misses
+)
+{
+    GstVaapiDecoderJpegPrivate *priv;
+
+    g_return_if_fail(GST_VAAPI_IS_DECODER_JPEG(decoder));
+
+    priv = decoder->priv;
+    if (pnum_hits)
+        *pnum_hits = priv->num_table_hits;
+    if (pnum_misses)
+        *pnum_misses = priv->num_table_misses;
+}
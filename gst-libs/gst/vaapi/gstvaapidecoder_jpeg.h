@@ -82,6 +82,13 @@ gst_vaapi_decoder_jpeg_get_type(void) G_GNUC_CONST;
 GstVaapiDecoder *
 gst_vaapi_decoder_jpeg_new(GstVaapiDisplay *display, GstCaps *caps);
 
+void
+gst_vaapi_decoder_jpeg_get_table_stats(
+    GstVaapiDecoderJpeg *decoder,
+    guint               *pnum_hits,
+    guint               *pnum_misses
+);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_JPEG_H */
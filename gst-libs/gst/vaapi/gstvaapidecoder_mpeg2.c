@@ -32,6 +32,7 @@
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_dpb.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapistartcode.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 
@@ -179,6 +180,7 @@ struct _GstVaapiDecoderMpeg2Private {
     GstVaapiPicture            *current_picture;
     GstVaapiDpb                *dpb;
     GstAdapter                 *adapter;
+    GstVaapiStartCodeScanner    scanner;
     PTSGenerator                tsg;
     guint                       is_constructed          : 1;
     guint                       is_opened               : 1;
@@ -290,6 +292,7 @@ gst_vaapi_decoder_mpeg2_close(GstVaapiDecoderMpeg2 *decoder)
         g_object_unref(priv->adapter);
         priv->adapter = NULL;
     }
+    gst_vaapi_start_code_scanner_clear(&priv->scanner);
 }
 
 static gboolean
@@ -302,6 +305,7 @@ gst_vaapi_decoder_mpeg2_open(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
     priv->adapter = gst_adapter_new();
     if (!priv->adapter)
 	return FALSE;
+    gst_vaapi_start_code_scanner_init(&priv->scanner, NULL);
 
     priv->dpb = gst_vaapi_dpb2_new();
     if (!priv->dpb)
@@ -871,6 +875,8 @@ decode_slice(
     GstVaapiSlice *slice;
     VASliceParameterBufferMPEG2 *slice_param;
     GstBitReader br;
+    GstClockTime start;
+    gboolean success;
     gint mb_x, mb_y, mb_inc;
     guint macroblock_offset;
     guint8 slice_vertical_position_extension;
@@ -880,8 +886,14 @@ decode_slice(
 
     GST_DEBUG("slice %d @ %p, %u bytes)", slice_no, buf, buf_size);
 
-    if (picture->slices->len == 0 && !fill_picture(decoder, picture))
-        return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    if (picture->slices->len == 0) {
+        start = gst_vaapi_decoder_stage_begin(GST_VAAPI_DECODER_CAST(decoder));
+        success = fill_picture(decoder, picture);
+        gst_vaapi_decoder_stage_end(GST_VAAPI_DECODER_CAST(decoder),
+            GST_VAAPI_DECODER_STAGE_FILL, start);
+        if (!success)
+            return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    }
 
     slice = GST_VAAPI_SLICE_NEW(MPEG2, decoder, buf, buf_size);
     if (!slice) {
@@ -936,15 +948,6 @@ failed:
     return GST_VAAPI_DECODER_STATUS_ERROR_BITSTREAM_PARSER;
 }
 
-static inline gint
-scan_for_start_code(GstAdapter *adapter, guint ofs, guint size, guint32 *scp)
-{
-    return (gint)gst_adapter_masked_scan_uint32_peek(adapter,
-                                                     0xffffff00, 0x00000100,
-                                                     ofs, size,
-                                                     scp);
-}
-
 static GstVaapiDecoderStatus
 decode_buffer(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
 {
@@ -961,17 +964,20 @@ decode_buffer(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
     if (!buf && buf_size == 0)
         return decode_sequence_end(decoder);
 
+    /* Each input byte is scanned once for start codes, as it arrives */
     gst_adapter_push(priv->adapter, gst_buffer_ref(buffer));
+    gst_vaapi_start_code_scanner_push(&priv->scanner, buf, buf_size);
 
     size   = gst_adapter_available(priv->adapter);
     status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
     do {
         if (size < 8)
             break;
-        ofs = scan_for_start_code(priv->adapter, 0, size, &start_code);
+        ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 0);
         if (ofs < 0)
             break;
         gst_adapter_flush(priv->adapter, ofs);
+        gst_vaapi_start_code_scanner_flush(&priv->scanner, ofs);
         size -= ofs;
 
         status = gst_vaapi_decoder_check_status(GST_VAAPI_DECODER(decoder));
@@ -980,13 +986,16 @@ decode_buffer(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
 
         if (size < 8)
             break;
-        ofs = scan_for_start_code(priv->adapter, 4, size - 4, NULL);
+        ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 4);
         if (ofs < 0)
             break;
         buffer = gst_adapter_take_buffer(priv->adapter, ofs);
+        gst_vaapi_start_code_scanner_flush(&priv->scanner, ofs);
         size -= ofs;
 
+        start_code = GST_READ_UINT32_BE(GST_BUFFER_DATA(buffer));
         if (ofs == 4) {
+            gst_buffer_unref(buffer);
             // Ignore empty user-data packets
             if ((start_code & 0xff) == GST_MPEG_VIDEO_PACKET_USER_DATA)
                 continue;
@@ -1003,7 +1012,9 @@ decode_buffer(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
         case GST_MPEG_VIDEO_PACKET_PICTURE:
             if (!priv->width || !priv->height)
                 break;
+            GST_VAAPI_TRACE_BEGIN("mpeg2.decode_picture", 0);
             status = decode_picture(decoder, buf, buf_size);
+            GST_VAAPI_TRACE_END("mpeg2.decode_picture", 0);
             break;
         case GST_MPEG_VIDEO_PACKET_SEQUENCE:
             status = decode_sequence(decoder, buf, buf_size);
@@ -1044,11 +1055,13 @@ decode_buffer(GstVaapiDecoderMpeg2 *decoder, GstBuffer *buffer)
                 type <= GST_MPEG_VIDEO_PACKET_SLICE_MAX) {
                 if (!priv->current_picture)
                     break;
+                GST_VAAPI_TRACE_BEGIN("mpeg2.decode_slice", 0);
                 status = decode_slice(
                     decoder,
                     type - GST_MPEG_VIDEO_PACKET_SLICE_MIN,
                     buf, buf_size
                 );
+                GST_VAAPI_TRACE_END("mpeg2.decode_slice", 0);
                 break;
             }
             else if (type >= 0xb9 && type <= 0xff) {
@@ -31,6 +31,7 @@
 #include "gstvaapidecoder_mpeg4.h"
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapistartcode.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 
@@ -69,6 +70,7 @@ struct _GstVaapiDecoderMpeg4Private {
     // backward reference pic
     GstVaapiPicture                *prev_picture;
     GstAdapter                     *adapter;
+    GstVaapiStartCodeScanner        scanner;
     GstBuffer                      *sub_buffer;
     GstClockTime                    seq_pts;
     GstClockTime                    gop_pts;
@@ -119,6 +121,7 @@ gst_vaapi_decoder_mpeg4_close(GstVaapiDecoderMpeg4 *decoder)
         g_object_unref(priv->adapter);
         priv->adapter = NULL;
     }
+    gst_vaapi_start_code_scanner_clear(&priv->scanner);
 }
 
 static gboolean
@@ -134,6 +137,7 @@ gst_vaapi_decoder_mpeg4_open(GstVaapiDecoderMpeg4 *decoder, GstBuffer *buffer)
     priv->adapter = gst_adapter_new();
     if (!priv->adapter)
         return FALSE;
+    gst_vaapi_start_code_scanner_init(&priv->scanner, NULL);
 
     priv->is_svh = 0;
     caps = gst_vaapi_decoder_get_caps(base_decoder);
@@ -760,12 +764,20 @@ decode_slice(
     GstVaapiPicture * const picture = priv->curr_picture;
     GstVaapiSlice *slice;
     VASliceParameterBufferMPEG4 *slice_param;
+    GstClockTime start;
+    gboolean success;
 
     GST_DEBUG("decoder silce: %p, %u bytes)", buf, buf_size);
 
     // has_packet_header is ture for the 2+ slice
-    if (!has_packet_header && !fill_picture(decoder, picture))
-        return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    if (!has_packet_header) {
+        start = gst_vaapi_decoder_stage_begin(GST_VAAPI_DECODER_CAST(decoder));
+        success = fill_picture(decoder, picture);
+        gst_vaapi_decoder_stage_end(GST_VAAPI_DECODER_CAST(decoder),
+            GST_VAAPI_DECODER_STAGE_FILL, start);
+        if (!success)
+            return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
+    }
 
     slice = GST_VAAPI_SLICE_NEW(MPEG4, decoder, buf, buf_size);
     if (!slice) {
@@ -832,7 +844,9 @@ decode_packet(GstVaapiDecoderMpeg4 *decoder, GstMpeg4Packet packet)
         status = decode_gop(decoder, packet.data + packet.offset, packet.size);
     }
     else if (tos->type == GST_MPEG4_VIDEO_OBJ_PLANE) {
+        GST_VAAPI_TRACE_BEGIN("mpeg4.decode_picture", 0);
         status = decode_picture(decoder, packet.data + packet.offset, packet.size);
+        GST_VAAPI_TRACE_END("mpeg4.decode_picture", 0);
         if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
             return status;
 
@@ -850,7 +864,9 @@ decode_packet(GstVaapiDecoderMpeg4 *decoder, GstMpeg4Packet packet)
         GstMpeg4Packet video_packet;
         
         if (priv->vol_hdr.resync_marker_disable) {
+            GST_VAAPI_TRACE_BEGIN("mpeg4.decode_slice", 0);
             status = decode_slice(decoder, _data, _data_size, FALSE);
+            GST_VAAPI_TRACE_END("mpeg4.decode_slice", 0);
             if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
                 return status;
         }
@@ -868,7 +884,9 @@ decode_packet(GstVaapiDecoderMpeg4 *decoder, GstMpeg4Packet packet)
                 }
 
                 if (first_slice) {
+                    GST_VAAPI_TRACE_BEGIN("mpeg4.decode_slice", 0);
                     status = decode_slice(decoder, _data, video_packet.size, FALSE);
+                    GST_VAAPI_TRACE_END("mpeg4.decode_slice", 0);
                     first_slice = FALSE;
                 }
                 else {
@@ -876,7 +894,9 @@ decode_packet(GstVaapiDecoderMpeg4 *decoder, GstMpeg4Packet packet)
                     _data_size -= video_packet.offset;
 
                     ret = gst_mpeg4_parse_video_packet_header (&priv->packet_hdr, &priv->vol_hdr, &priv->vop_hdr, &priv->sprite_trajectory, _data, _data_size);
+                    GST_VAAPI_TRACE_BEGIN("mpeg4.decode_slice", 0);
                     status = decode_slice(decoder,_data + priv->packet_hdr.size/8, video_packet.size - priv->packet_hdr.size/8, TRUE); 
+                    GST_VAAPI_TRACE_END("mpeg4.decode_slice", 0);
                 }
 
                 _data += video_packet.size;
@@ -906,6 +926,63 @@ decode_packet(GstVaapiDecoderMpeg4 *decoder, GstMpeg4Packet packet)
     return status;
 }
 
+static inline void
+flush_input(GstVaapiDecoderMpeg4 *decoder, guint size)
+{
+    GstVaapiDecoderMpeg4Private * const priv = decoder->priv;
+
+    gst_adapter_flush(priv->adapter, size);
+    gst_vaapi_start_code_scanner_flush(&priv->scanner, size);
+}
+
+/* Decodes the complete packets at the head of the adapter. Packets
+   are delimited by the start codes located by the scanner, and the
+   next start code is kept visible after each packet, as the slice
+   parser needs it to determine the end of the last video packet */
+static GstVaapiDecoderStatus
+decode_packets(GstVaapiDecoderMpeg4 *decoder)
+{
+    GstVaapiDecoderMpeg4Private * const priv = decoder->priv;
+    GstVaapiDecoderStatus status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+    GstMpeg4Packet packet;
+    const guint8 *buf;
+    gint ofs;
+
+    for (;;) {
+        ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 0);
+        if (ofs < 0)
+            break;
+        if (ofs > 0)
+            flush_input(decoder, ofs);
+
+        ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 4);
+        if (ofs < 0 || gst_adapter_available(priv->adapter) < ofs + 4)
+            break;
+
+        /* This is what gst_mpeg4_parse() would return */
+        buf = gst_adapter_peek(priv->adapter, ofs + 4);
+        memset(&packet, 0, sizeof(packet));
+        packet.data   = (guint8 *)buf;
+        packet.offset = 3;
+        packet.size   = ofs - 3;
+        packet.type   = buf[3];
+
+        status = decode_packet(decoder, packet);
+        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE) {
+            /* Keep the packet, and decode it again with the next buffer */
+            status = GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+            break;
+        }
+        flush_input(decoder, ofs);
+        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS &&
+            status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
+            GST_WARNING("decode mp4 packet failed\n");
+            break;
+        }
+    }
+    return status;
+}
+
 static GstVaapiDecoderStatus
 decode_buffer(GstVaapiDecoderMpeg4 *decoder, GstBuffer *buffer)
 {
@@ -924,6 +1001,14 @@ decode_buffer(GstVaapiDecoderMpeg4 *decoder, GstBuffer *buffer)
     gst_buffer_ref(buffer);
     gst_adapter_push(priv->adapter, buffer);
 
+    /* Each input byte is scanned once for start codes, as it arrives.
+       H.263 picture start codes are not byte aligned, and are still
+       located by the parser */
+    if (!priv->is_svh) {
+        gst_vaapi_start_code_scanner_push(&priv->scanner, buf, buf_size);
+        return decode_packets(decoder);
+    }
+
     if (priv->sub_buffer) {
         buffer = gst_buffer_merge(priv->sub_buffer, buffer);
         if (!buffer)
@@ -940,50 +1025,31 @@ decode_buffer(GstVaapiDecoderMpeg4 *decoder, GstBuffer *buffer)
     GstMpeg4ParseResult result = GST_MPEG4_PARSER_OK;
     guint consumed_size = 0;
 
-    if (priv->is_svh) {
-        while (result == GST_MPEG4_PARSER_OK && pos < buf_size) {
-            result = gst_h263_parse (&packet,buf, pos, buf_size);
-            if (result != GST_MPEG4_PARSER_OK) {
-                break;
-            }
-            status = decode_picture(decoder, packet.data+packet.offset, packet.size);
-            if (GST_VAAPI_DECODER_STATUS_SUCCESS == status) {
-                // MBs are not byte aligned, so we set the start address with byte aligned 
-                // and mb offset with (priv->svh_hdr.size)%8
-                status = decode_slice(decoder, packet.data+packet.offset+(priv->svh_hdr.size)/8, 
-                        packet.size - (priv->svh_hdr.size)/8, FALSE);
-                status = decode_current_picture(decoder);
-
-                consumed_size = packet.offset + packet.size; 
-                pos += consumed_size; 
-                if (gst_adapter_available(priv->adapter) >= pos)
-                    gst_adapter_flush(priv->adapter, pos);
-            }
-            else {
-                GST_WARNING("decode h263 packet failed\n");
-                break;
-            }
+    while (result == GST_MPEG4_PARSER_OK && pos < buf_size) {
+        result = gst_h263_parse (&packet,buf, pos, buf_size);
+        if (result != GST_MPEG4_PARSER_OK) {
+            break;
         }
-    }
-    else {
-        while (pos < buf_size) {
-            // don't skip user data, we need the size to pop tsb buffer
-            result = gst_mpeg4_parse(&packet, FALSE, NULL, buf, pos, buf_size);
-            if (result != GST_MPEG4_PARSER_OK) {
-                break;
-            }
-            status = decode_packet(decoder, packet);
-            if (GST_VAAPI_DECODER_STATUS_SUCCESS == status ||
-                GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA == status) {
-                consumed_size = packet.offset + packet.size - pos; 
-                pos = packet.offset + packet.size; 
-                if (gst_adapter_available(priv->adapter) >= pos)
-                    gst_adapter_flush(priv->adapter, pos);
-            }
-            else {
-                GST_WARNING("decode mp4 packet failed\n");
-                break;
-            }
+        GST_VAAPI_TRACE_BEGIN("mpeg4.decode_picture", 0);
+        status = decode_picture(decoder, packet.data+packet.offset, packet.size);
+        GST_VAAPI_TRACE_END("mpeg4.decode_picture", 0);
+        if (GST_VAAPI_DECODER_STATUS_SUCCESS == status) {
+            // MBs are not byte aligned, so we set the start address with byte aligned 
+            // and mb offset with (priv->svh_hdr.size)%8
+            GST_VAAPI_TRACE_BEGIN("mpeg4.decode_slice", 0);
+            status = decode_slice(decoder, packet.data+packet.offset+(priv->svh_hdr.size)/8, 
+                    packet.size - (priv->svh_hdr.size)/8, FALSE);
+            GST_VAAPI_TRACE_END("mpeg4.decode_slice", 0);
+            status = decode_current_picture(decoder);
+
+            consumed_size = packet.offset + packet.size; 
+            pos += consumed_size; 
+            if (gst_adapter_available(priv->adapter) >= pos)
+                gst_adapter_flush(priv->adapter, pos);
+        }
+        else {
+            GST_WARNING("decode h263 packet failed\n");
+            break;
         }
     }
 
@@ -82,6 +82,7 @@ gst_vaapi_picture_destroy(GstVaapiPicture *picture)
     }
 
     if (picture->proxy) {
+        gst_vaapi_surface_proxy_decoder_unref(picture->proxy);
         g_object_unref(picture->proxy);
         picture->proxy = NULL;
     }
@@ -92,7 +93,7 @@ gst_vaapi_picture_destroy(GstVaapiPicture *picture)
     picture->surface_id = VA_INVALID_ID;
     picture->surface = NULL;
 
-    vaapi_destroy_buffer(GET_VA_DISPLAY(picture), &picture->param_id);
+    gst_vaapi_decoder_destroy_buffer(GET_DECODER(picture), &picture->param_id);
     picture->param = NULL;
 }
 
@@ -108,6 +109,7 @@ gst_vaapi_picture_create(
         GstVaapiPicture * const parent_picture = GST_VAAPI_PICTURE(args->data);
 
         picture->proxy   = g_object_ref(parent_picture->proxy);
+        gst_vaapi_surface_proxy_decoder_ref(picture->proxy);
         picture->surface = gst_vaapi_surface_proxy_get_surface(picture->proxy);
         picture->type    = parent_picture->type;
         picture->pts     = parent_picture->pts;
@@ -147,15 +149,15 @@ gst_vaapi_picture_create(
             gst_vaapi_surface_proxy_new(GET_CONTEXT(picture), picture->surface);
         if (!picture->proxy)
             return FALSE;
+        gst_vaapi_surface_proxy_decoder_ref(picture->proxy);
 
         picture->structure = GST_VAAPI_PICTURE_STRUCTURE_FRAME;
         GST_VAAPI_PICTURE_FLAG_SET(picture, GST_VAAPI_PICTURE_FLAG_FF);
     }
     picture->surface_id = gst_vaapi_surface_get_id(picture->surface);
 
-    success = vaapi_create_buffer(
-        GET_VA_DISPLAY(picture),
-        GET_VA_CONTEXT(picture),
+    success = gst_vaapi_decoder_create_buffer(
+        GET_DECODER(picture),
         VAPictureParameterBufferType,
         args->param_size,
         args->param,
@@ -250,58 +252,53 @@ gst_vaapi_picture_add_slice(GstVaapiPicture *picture, GstVaapiSlice *slice)
 }
 
 static gboolean
-do_decode(VADisplay dpy, VAContextID ctx, VABufferID *buf_id, void **buf_ptr)
+do_decode(GstVaapiDecoder *decoder, VABufferID *buf_id, void **buf_ptr)
 {
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
     VAStatus status;
 
-    vaapi_unmap_buffer(dpy, *buf_id, buf_ptr);
+    if (*buf_ptr)
+        gst_vaapi_decoder_unmap_buffer(decoder, *buf_id, buf_ptr);
 
-    status = vaRenderPicture(dpy, ctx, buf_id, 1);
+    GST_VAAPI_TRACE_BEGIN("vaRenderPicture", *buf_id);
+    status = vaRenderPicture(priv->va_display, priv->va_context, buf_id, 1);
+    GST_VAAPI_TRACE_END("vaRenderPicture", *buf_id);
+    priv->num_va_calls++;
     if (!vaapi_check_status(status, "vaRenderPicture()"))
         return FALSE;
 
-    /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-    vaapi_destroy_buffer(dpy, buf_id);
+    /* Release the VA buffer so that it can be recycled by the next picture */
+    gst_vaapi_decoder_destroy_buffer(decoder, buf_id);
     return TRUE;
 }
 
-gboolean
-gst_vaapi_picture_decode(GstVaapiPicture *picture)
+/* Submits each VA buffer of the picture with its own vaRenderPicture()
+   call, and slice parameter and data buffers in pairs */
+static gboolean
+decode_buffers(GstVaapiPicture *picture, GstVaapiDecoder *decoder)
 {
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
     GstVaapiIqMatrix *iq_matrix;
     GstVaapiBitPlane *bitplane;
     GstVaapiHuffmanTable *huf_table;
-    VADisplay va_display;
-    VAContextID va_context;
     VAStatus status;
     guint i;
 
-    g_return_val_if_fail(GST_VAAPI_IS_PICTURE(picture), FALSE);
-
-    va_display = GET_VA_DISPLAY(picture);
-    va_context = GET_VA_CONTEXT(picture);
-
-    GST_DEBUG("decode picture 0x%08x", picture->surface_id);
-
-    status = vaBeginPicture(va_display, va_context, picture->surface_id);
-    if (!vaapi_check_status(status, "vaBeginPicture()"))
-        return FALSE;
-
-    if (!do_decode(va_display, va_context, &picture->param_id, &picture->param))
+    if (!do_decode(decoder, &picture->param_id, &picture->param))
         return FALSE;
 
     iq_matrix = picture->iq_matrix;
-    if (iq_matrix && !do_decode(va_display, va_context,
+    if (iq_matrix && !do_decode(decoder,
                                 &iq_matrix->param_id, &iq_matrix->param))
         return FALSE;
 
     bitplane = picture->bitplane;
-    if (bitplane && !do_decode(va_display, va_context,
+    if (bitplane && !do_decode(decoder,
                                &bitplane->data_id, (void **)&bitplane->data))
         return FALSE;
 
     huf_table = picture->huf_table;
-    if (huf_table && !do_decode(va_display, va_context,
+    if (huf_table && !do_decode(decoder,
                                 &huf_table->param_id,
                                 (void **)&huf_table->param))
         return FALSE;
@@ -310,34 +307,181 @@ gst_vaapi_picture_decode(GstVaapiPicture *picture)
         GstVaapiSlice * const slice = g_ptr_array_index(picture->slices, i);
         VABufferID va_buffers[2];
 
-        vaapi_unmap_buffer(va_display, slice->param_id, NULL);
+        if (slice->param)
+            gst_vaapi_decoder_unmap_buffer(decoder, slice->param_id,
+                                           &slice->param);
         va_buffers[0] = slice->param_id;
         va_buffers[1] = slice->data_id;
 
-        status = vaRenderPicture(va_display, va_context, va_buffers, 2);
+        GST_VAAPI_TRACE_BEGIN("vaRenderPicture", picture->surface_id);
+        status = vaRenderPicture(priv->va_display, priv->va_context,
+                                 va_buffers, 2);
+        GST_VAAPI_TRACE_END("vaRenderPicture", picture->surface_id);
+        priv->num_va_calls++;
         if (!vaapi_check_status(status, "vaRenderPicture()"))
             return FALSE;
 
-        vaapi_destroy_buffer(va_display, &slice->param_id);
-        vaapi_destroy_buffer(va_display, &slice->data_id);
+        gst_vaapi_decoder_destroy_buffer(decoder, &slice->param_id);
+        gst_vaapi_decoder_destroy_buffer(decoder, &slice->data_id);
+    }
+    return TRUE;
+}
+
+static inline void
+add_buffer(GstVaapiDecoder *decoder, VABufferID buf_id, void **buf_ptr)
+{
+    if (buf_ptr && *buf_ptr)
+        gst_vaapi_decoder_unmap_buffer(decoder, buf_id, buf_ptr);
+    g_array_append_val(decoder->priv->va_buffers, buf_id);
+}
+
+/* Submits all VA buffers of the picture with a single vaRenderPicture()
+   call. The buffers are left intact if the driver rejects the batch */
+static gboolean
+decode_buffers_batched(GstVaapiPicture *picture, GstVaapiDecoder *decoder)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    GstVaapiIqMatrix * const iq_matrix = picture->iq_matrix;
+    GstVaapiBitPlane * const bitplane = picture->bitplane;
+    GstVaapiHuffmanTable * const huf_table = picture->huf_table;
+    VAStatus status;
+    guint i;
+
+    g_array_set_size(priv->va_buffers, 0);
+    add_buffer(decoder, picture->param_id, &picture->param);
+    if (iq_matrix)
+        add_buffer(decoder, iq_matrix->param_id, &iq_matrix->param);
+    if (bitplane)
+        add_buffer(decoder, bitplane->data_id, (void **)&bitplane->data);
+    if (huf_table)
+        add_buffer(decoder, huf_table->param_id, (void **)&huf_table->param);
+    for (i = 0; i < picture->slices->len; i++) {
+        GstVaapiSlice * const slice = g_ptr_array_index(picture->slices, i);
+        add_buffer(decoder, slice->param_id, &slice->param);
+        add_buffer(decoder, slice->data_id, NULL);
+    }
+
+    GST_VAAPI_TRACE_BEGIN("vaRenderPicture", picture->surface_id);
+    status = vaRenderPicture(priv->va_display, priv->va_context,
+        (VABufferID *)priv->va_buffers->data, priv->va_buffers->len);
+    GST_VAAPI_TRACE_END("vaRenderPicture", picture->surface_id);
+    priv->num_va_calls++;
+    if (!vaapi_check_status(status, "vaRenderPicture() [batched]"))
+        return FALSE;
+
+    gst_vaapi_decoder_destroy_buffer(decoder, &picture->param_id);
+    if (iq_matrix)
+        gst_vaapi_decoder_destroy_buffer(decoder, &iq_matrix->param_id);
+    if (bitplane)
+        gst_vaapi_decoder_destroy_buffer(decoder, &bitplane->data_id);
+    if (huf_table)
+        gst_vaapi_decoder_destroy_buffer(decoder, &huf_table->param_id);
+    for (i = 0; i < picture->slices->len; i++) {
+        GstVaapiSlice * const slice = g_ptr_array_index(picture->slices, i);
+        gst_vaapi_decoder_destroy_buffer(decoder, &slice->param_id);
+        gst_vaapi_decoder_destroy_buffer(decoder, &slice->data_id);
+    }
+    return TRUE;
+}
+
+static gboolean
+begin_picture(GstVaapiPicture *picture, GstVaapiDecoder *decoder)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    VAStatus status;
+
+    GST_VAAPI_TRACE_BEGIN("vaBeginPicture", picture->surface_id);
+    status = vaBeginPicture(GET_VA_DISPLAY(picture), GET_VA_CONTEXT(picture),
+                            picture->surface_id);
+    GST_VAAPI_TRACE_END("vaBeginPicture", picture->surface_id);
+    priv->num_va_calls++;
+    return vaapi_check_status(status, "vaBeginPicture()");
+}
+
+static gboolean
+end_picture(GstVaapiPicture *picture, GstVaapiDecoder *decoder)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    VAStatus status;
+
+    GST_VAAPI_TRACE_BEGIN("vaEndPicture", picture->surface_id);
+    status = vaEndPicture(GET_VA_DISPLAY(picture), GET_VA_CONTEXT(picture));
+    GST_VAAPI_TRACE_END("vaEndPicture", picture->surface_id);
+    priv->num_va_calls++;
+    return vaapi_check_status(status, "vaEndPicture()");
+}
+
+static gboolean
+decode_picture(GstVaapiPicture *picture, GstVaapiDecoder *decoder)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+    guint num_va_calls;
+
+    GST_DEBUG("decode picture 0x%08x", picture->surface_id);
+
+    num_va_calls = priv->num_va_calls;
+    if (!begin_picture(picture, decoder))
+        return FALSE;
+
+    if (priv->no_batch_render) {
+        if (!decode_buffers(picture, decoder))
+            return FALSE;
+    }
+    else if (!decode_buffers_batched(picture, decoder)) {
+        /* The driver may have consumed part of the batch already, so the
+           picture is ended and started over before its buffers are
+           submitted again, one at a time */
+        end_picture(picture, decoder);
+        if (!begin_picture(picture, decoder))
+            return FALSE;
+        if (!decode_buffers(picture, decoder))
+            return FALSE;
+
+        /* The buffers were fine, the driver does not support batches */
+        GST_WARNING("batched vaRenderPicture() failed, "
+                    "falling back to one call per buffer");
+        priv->no_batch_render = TRUE;
     }
 
-    status = vaEndPicture(va_display, va_context);
-    if (!vaapi_check_status(status, "vaEndPicture()"))
+    if (!end_picture(picture, decoder))
         return FALSE;
+
+    priv->num_pictures++;
+    GST_DEBUG("picture 0x%08x submitted with %u VA calls",
+              picture->surface_id, priv->num_va_calls - num_va_calls);
     return TRUE;
 }
 
+gboolean
+gst_vaapi_picture_decode(GstVaapiPicture *picture)
+{
+    GstVaapiDecoder *decoder;
+    GstClockTime start;
+    gboolean success;
+
+    g_return_val_if_fail(GST_VAAPI_IS_PICTURE(picture), FALSE);
+
+    decoder = GET_DECODER(picture);
+    start   = gst_vaapi_decoder_stage_begin(decoder);
+    success = decode_picture(picture, decoder);
+    gst_vaapi_decoder_stage_end(decoder, GST_VAAPI_DECODER_STAGE_SUBMIT, start);
+    return success;
+}
+
 gboolean
 gst_vaapi_picture_output(GstVaapiPicture *picture)
 {
+    GstVaapiDecoder *decoder;
     GstVaapiSurfaceProxy *proxy;
+    GstClockTime start;
 
     g_return_val_if_fail(GST_VAAPI_IS_PICTURE(picture), FALSE);
 
     if (!picture->proxy)
         return FALSE;
 
+    decoder = GET_DECODER(picture);
+    start   = gst_vaapi_decoder_stage_begin(decoder);
     if (!GST_VAAPI_PICTURE_IS_SKIPPED(picture)) {
         proxy = g_object_ref(picture->proxy);
         gst_vaapi_surface_proxy_set_timestamp(proxy, picture->pts);
@@ -345,9 +489,10 @@ gst_vaapi_picture_output(GstVaapiPicture *picture)
             gst_vaapi_surface_proxy_set_interlaced(proxy, TRUE);
         if (GST_VAAPI_PICTURE_IS_TFF(picture))
             gst_vaapi_surface_proxy_set_tff(proxy, TRUE);
-        gst_vaapi_decoder_push_surface_proxy(GET_DECODER(picture), proxy);
+        gst_vaapi_decoder_push_surface_proxy(decoder, proxy);
     }
     GST_VAAPI_PICTURE_FLAG_SET(picture, GST_VAAPI_PICTURE_FLAG_OUTPUT);
+    gst_vaapi_decoder_stage_end(decoder, GST_VAAPI_DECODER_STAGE_OUTPUT, start);
     return TRUE;
 }
 
@@ -362,10 +507,10 @@ GST_VAAPI_CODEC_DEFINE_TYPE(GstVaapiSlice,
 static void
 gst_vaapi_slice_destroy(GstVaapiSlice *slice)
 {
-    VADisplay const va_display = GET_VA_DISPLAY(slice);
+    GstVaapiDecoder * const decoder = GET_DECODER(slice);
 
-    vaapi_destroy_buffer(va_display, &slice->data_id);
-    vaapi_destroy_buffer(va_display, &slice->param_id);
+    gst_vaapi_decoder_destroy_buffer(decoder, &slice->data_id);
+    gst_vaapi_decoder_destroy_buffer(decoder, &slice->param_id);
     slice->param = NULL;
 }
 
@@ -378,9 +523,8 @@ gst_vaapi_slice_create(
     VASliceParameterBufferBase *slice_param;
     gboolean success;
 
-    success = vaapi_create_buffer(
-        GET_VA_DISPLAY(slice),
-        GET_VA_CONTEXT(slice),
+    success = gst_vaapi_decoder_create_buffer(
+        GET_DECODER(slice),
         VASliceDataBufferType,
         args->data_size,
         args->data,
@@ -390,9 +534,8 @@ gst_vaapi_slice_create(
     if (!success)
         return FALSE;
 
-    success = vaapi_create_buffer(
-        GET_VA_DISPLAY(slice),
-        GET_VA_CONTEXT(slice),
+    success = gst_vaapi_decoder_create_buffer(
+        GET_DECODER(slice),
         VASliceParameterBufferType,
         args->param_size,
         args->param,
@@ -24,8 +24,11 @@
 #define GST_VAAPI_DECODER_PRIV_H
 
 #include <glib.h>
+#include <gst/gstutils.h>
 #include <gst/vaapi/gstvaapidecoder.h>
 #include <gst/vaapi/gstvaapicontext.h>
+#include <gst/vaapi/gstvaapitrace.h>
+#include "gstvaapibufferarena.h"
 
 G_BEGIN_DECLS
 
@@ -114,6 +117,10 @@ struct _GstVaapiDecoderPrivate {
     VADisplay           va_display;
     GstVaapiContext    *context;
     VAContextID         va_context;
+    GstVaapiBufferArena *buffer_arena;
+    GArray             *va_buffers;
+    guint               num_pictures;
+    guint               num_va_calls;
     GstCaps            *caps;
     GstVaapiCodec       codec;
     GstBuffer          *codec_data;
@@ -125,7 +132,11 @@ struct _GstVaapiDecoderPrivate {
     guint               par_d;
     GQueue             *buffers;
     GQueue             *surfaces;
+    GstVaapiDecoderStageStats *stage_stats;
+    guint64             stage_time;
+    guint               stage_depth;
     guint               is_interlaced   : 1;
+    guint               no_batch_render : 1;
 };
 
 G_GNUC_INTERNAL
@@ -191,6 +202,65 @@ G_GNUC_INTERNAL
 GstVaapiDecoderStatus
 gst_vaapi_decoder_check_status(GstVaapiDecoder *decoder);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_decoder_create_buffer(
+    GstVaapiDecoder *decoder,
+    int              type,
+    guint            size,
+    gconstpointer    data,
+    VABufferID      *buf_id_ptr,
+    gpointer        *mapped_data
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_unmap_buffer(
+    GstVaapiDecoder *decoder,
+    VABufferID       buf_id,
+    gpointer        *pbuf
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_destroy_buffer(GstVaapiDecoder *decoder, VABufferID *buf_id_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_stage_record(
+    GstVaapiDecoder     *decoder,
+    GstVaapiDecoderStage stage,
+    GstClockTime         duration
+);
+
+/* Starts timing a decoding stage. This returns 0 if stage timing is
+   disabled. Nested stages are accounted to the outermost one */
+static inline GstClockTime
+gst_vaapi_decoder_stage_begin(GstVaapiDecoder *decoder)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+
+    if (G_LIKELY(!priv->stage_stats))
+        return 0;
+    return priv->stage_depth++ == 0 ? gst_util_get_timestamp() : 0;
+}
+
+static inline void
+gst_vaapi_decoder_stage_end(
+    GstVaapiDecoder     *decoder,
+    GstVaapiDecoderStage stage,
+    GstClockTime         start
+)
+{
+    GstVaapiDecoderPrivate * const priv = decoder->priv;
+
+    if (G_LIKELY(!priv->stage_stats) || priv->stage_depth == 0)
+        return;
+    if (--priv->stage_depth == 0)
+        gst_vaapi_decoder_stage_record(decoder, stage,
+            gst_util_get_timestamp() - start);
+}
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_PRIV_H */
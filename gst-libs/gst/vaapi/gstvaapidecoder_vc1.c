@@ -31,6 +31,8 @@
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_dpb.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapibitplane.h"
+#include "gstvaapistartcode.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiobject_priv.h"
 
@@ -59,7 +61,7 @@ struct _GstVaapiDecoderVC1Private {
     GstVaapiPicture            *current_picture;
     GstVaapiDpb                *dpb;
     GstAdapter                 *adapter;
-    GstBuffer                  *sub_buffer;
+    GstVaapiStartCodeScanner    scanner;
     guint8                     *rbdu_buffer;
     guint                       rbdu_buffer_size;
     gint                        frm_cnt;
@@ -103,11 +105,6 @@ gst_vaapi_decoder_vc1_close(GstVaapiDecoderVC1 *decoder)
 
     gst_vaapi_picture_replace(&priv->current_picture, NULL);
 
-    if (priv->sub_buffer) {
-        gst_buffer_unref(priv->sub_buffer);
-        priv->sub_buffer = NULL;
-    }
-
     if (priv->bitplanes) {
         gst_vc1_bitplanes_free(priv->bitplanes);
         priv->bitplanes = NULL;
@@ -123,6 +120,7 @@ gst_vaapi_decoder_vc1_close(GstVaapiDecoderVC1 *decoder)
         g_object_unref(priv->adapter);
         priv->adapter = NULL;
     }
+    gst_vaapi_start_code_scanner_clear(&priv->scanner);
 }
 
 static gboolean
@@ -135,6 +133,7 @@ gst_vaapi_decoder_vc1_open(GstVaapiDecoderVC1 *decoder, GstBuffer *buffer)
     priv->adapter = gst_adapter_new();
     if (!priv->adapter)
         return FALSE;
+    gst_vaapi_start_code_scanner_init(&priv->scanner, NULL);
 
     priv->dpb = gst_vaapi_dpb2_new();
     if (!priv->dpb)
@@ -644,22 +643,6 @@ has_OVERFLAGS_bitplane(GstVaapiDecoderVC1 *decoder)
             pic->condover == GST_VC1_CONDOVER_SELECT);
 }
 
-static inline void
-pack_bitplanes(GstVaapiBitPlane *bitplane, guint n, const guint8 *bitplanes[3], guint x, guint y, guint stride)
-{
-    const guint dst_index = n / 2;
-    const guint src_index = y * stride + x;
-    guint8 v = 0;
-
-    if (bitplanes[0])
-        v |= bitplanes[0][src_index];
-    if (bitplanes[1])
-        v |= bitplanes[1][src_index] << 1;
-    if (bitplanes[2])
-        v |= bitplanes[2][src_index] << 2;
-    bitplane->data[dst_index] = (bitplane->data[dst_index] << 4) | v;
-}
-
 static gboolean
 fill_picture_structc(GstVaapiDecoderVC1 *decoder, GstVaapiPicture *picture)
 {
@@ -844,7 +827,6 @@ fill_picture(GstVaapiDecoderVC1 *decoder, GstVaapiPicture *picture)
 
     if (pic_param->bitplane_present.value) {
         const guint8 *bitplanes[3];
-        guint x, y, n;
 
         switch (picture->type) {
         case GST_VAAPI_PICTURE_TYPE_P:
@@ -877,12 +859,8 @@ fill_picture(GstVaapiDecoderVC1 *decoder, GstVaapiPicture *picture)
         if (!picture->bitplane)
             return FALSE;
 
-        n = 0;
-        for (y = 0; y < seq_hdr->mb_height; y++)
-            for (x = 0; x < seq_hdr->mb_width; x++, n++)
-                pack_bitplanes(picture->bitplane, n, bitplanes, x, y, seq_hdr->mb_stride);
-        if (n & 1) /* move last nibble to the high order */
-            picture->bitplane->data[n/2] <<= 4;
+        gst_vaapi_bitplane_pack(NULL, picture->bitplane->data, bitplanes,
+            seq_hdr->mb_width, seq_hdr->mb_height, seq_hdr->mb_stride);
     }
     return TRUE;
 }
@@ -899,7 +877,8 @@ decode_frame(GstVaapiDecoderVC1 *decoder, GstVC1BDU *rbdu, GstVC1BDU *ebdu)
     GstVaapiSlice *slice;
     GstVaapiDecoderStatus status;
     VASliceParameterBufferVC1 *slice_param;
-    GstClockTime pts;
+    GstClockTime pts, start;
+    gboolean success;
     gint32 poc;
 
     status = ensure_context(decoder);
@@ -986,7 +965,11 @@ decode_frame(GstVaapiDecoderVC1 *decoder, GstVC1BDU *rbdu, GstVC1BDU *ebdu)
     picture->pts = pts;
     priv->frm_cnt++;
 
-    if (!fill_picture(decoder, picture))
+    start = gst_vaapi_decoder_stage_begin(GST_VAAPI_DECODER_CAST(decoder));
+    success = fill_picture(decoder, picture);
+    gst_vaapi_decoder_stage_end(GST_VAAPI_DECODER_CAST(decoder),
+        GST_VAAPI_DECODER_STAGE_FILL, start);
+    if (!success)
         return GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN;
     slice = GST_VAAPI_SLICE_NEW(
         VC1,
@@ -1079,7 +1062,9 @@ decode_ebdu(GstVaapiDecoderVC1 *decoder, GstVC1BDU *ebdu)
         status = decode_entry_point(decoder, &rbdu, ebdu);
         break;
     case GST_VC1_FRAME:
+        GST_VAAPI_TRACE_BEGIN("vc1.decode_frame", 0);
         status = decode_frame(decoder, &rbdu, ebdu);
+        GST_VAAPI_TRACE_END("vc1.decode_frame", 0);
         break;
     case GST_VC1_SLICE:
         GST_DEBUG("decode slice");
@@ -1096,16 +1081,71 @@ decode_ebdu(GstVaapiDecoderVC1 *decoder, GstVC1BDU *ebdu)
     return status;
 }
 
+static inline void
+flush_input(GstVaapiDecoderVC1 *decoder, guint size)
+{
+    GstVaapiDecoderVC1Private * const priv = decoder->priv;
+
+    gst_adapter_flush(priv->adapter, size);
+    gst_vaapi_start_code_scanner_flush(&priv->scanner, size);
+}
+
+/* Decodes the next complete BDU at the head of the adapter. BDUs are
+   delimited by the start codes located by the scanner */
+static GstVaapiDecoderStatus
+decode_next_bdu(GstVaapiDecoderVC1 *decoder)
+{
+    GstVaapiDecoderVC1Private * const priv = decoder->priv;
+    GstVaapiDecoderStatus status;
+    GstVC1BDU ebdu;
+    const guint8 *buf;
+    guint bdu_size;
+    gint ofs;
+
+    ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 0);
+    if (ofs < 0)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+    if (ofs > 0)
+        flush_input(decoder, ofs);
+    if (gst_adapter_available(priv->adapter) < 4)
+        return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+
+    buf = gst_adapter_peek(priv->adapter, 4);
+    if (buf[3] == GST_VC1_END_OF_SEQ)
+        bdu_size = 4;
+    else {
+        ofs = gst_vaapi_start_code_scanner_find(&priv->scanner, 4);
+        if (ofs < 0)
+            return GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+        bdu_size = ofs;
+    }
+
+    buf = gst_adapter_peek(priv->adapter, bdu_size);
+    ebdu.type      = buf[3];
+    ebdu.size      = bdu_size - 4;
+    ebdu.sc_offset = 0;
+    ebdu.offset    = 4;
+    ebdu.data      = (guint8 *)buf;
+
+    /* As gst_vc1_identify_next_bdu(), leave out the zero byte that
+       precedes the next start code */
+    if (ebdu.size > 0 && buf[bdu_size - 1] == 0x00)
+        ebdu.size--;
+
+    status = decode_ebdu(decoder, &ebdu);
+    flush_input(decoder, bdu_size);
+    return status;
+}
+
 static GstVaapiDecoderStatus
 decode_buffer(GstVaapiDecoderVC1 *decoder, GstBuffer *buffer)
 {
     GstVaapiDecoderVC1Private * const priv = decoder->priv;
     GstVaapiDecoderStatus status;
-    GstVC1ParserResult result;
     GstVC1BDU ebdu;
     GstBuffer *codec_data;
     guchar *buf;
-    guint buf_size, ofs;
+    guint buf_size;
 
     buf      = GST_BUFFER_DATA(buffer);
     buf_size = GST_BUFFER_SIZE(buffer);
@@ -1130,39 +1170,10 @@ decode_buffer(GstVaapiDecoderVC1 *decoder, GstBuffer *buffer)
         return status;
     }
 
-    if (priv->sub_buffer) {
-        buffer = gst_buffer_merge(priv->sub_buffer, buffer);
-        if (!buffer)
-            return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
-        gst_buffer_unref(priv->sub_buffer);
-        priv->sub_buffer = NULL;
-    }
-
-    buf      = GST_BUFFER_DATA(buffer);
-    buf_size = GST_BUFFER_SIZE(buffer);
-    ofs      = 0;
+    /* Each input byte is scanned once for start codes, as it arrives */
+    gst_vaapi_start_code_scanner_push(&priv->scanner, buf, buf_size);
     do {
-        result = gst_vc1_identify_next_bdu(
-            buf + ofs,
-            buf_size - ofs,
-            &ebdu
-        );
-        status = get_status(result);
-
-        if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
-            priv->sub_buffer = gst_buffer_create_sub(buffer, ofs, buf_size - ofs);
-            break;
-        }
-        if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
-            break;
-
-        ofs += ebdu.offset + ebdu.size;
-        if (gst_adapter_available(priv->adapter) >= ebdu.offset)
-            gst_adapter_flush(priv->adapter, ebdu.offset);
-
-        status = decode_ebdu(decoder, &ebdu);
-        if (gst_adapter_available(priv->adapter) >= ebdu.size)
-            gst_adapter_flush(priv->adapter, ebdu.size);
+        status = decode_next_bdu(decoder);
     } while (status == GST_VAAPI_DECODER_STATUS_SUCCESS);
     return status;
 }
@@ -1322,7 +1333,6 @@ gst_vaapi_decoder_vc1_init(GstVaapiDecoderVC1 *decoder)
     priv->profile               = (GstVaapiProfile)0;
     priv->current_picture       = NULL;
     priv->adapter               = NULL;
-    priv->sub_buffer            = NULL;
     priv->rbdu_buffer           = NULL;
     priv->rbdu_buffer_size      = 0;
     priv->frm_cnt               = 0;
@@ -27,10 +27,13 @@
 
 #include "sysdeps.h"
 #include <string.h>
+#include <sys/stat.h>
 #include "gstvaapiutils.h"
 #include "gstvaapivalue.h"
 #include "gstvaapidisplay.h"
 #include "gstvaapidisplay_priv.h"
+#include "gstvaapidisplaycaps.h"
+#include "gstvaapitrace.h"
 #include "gstvaapiworkarounds.h"
 
 #define DEBUG 1
@@ -40,19 +43,6 @@ GST_DEBUG_CATEGORY(gst_debug_vaapi);
 
 G_DEFINE_TYPE(GstVaapiDisplay, gst_vaapi_display, G_TYPE_OBJECT)
 
-typedef struct _GstVaapiConfig GstVaapiConfig;
-struct _GstVaapiConfig {
-    GstVaapiProfile     profile;
-    GstVaapiEntrypoint  entrypoint;
-};
-
-typedef struct _GstVaapiProperty GstVaapiProperty;
-struct _GstVaapiProperty {
-    const gchar        *name;
-    VADisplayAttribute  attribute;
-    gint                old_value;
-};
-
 #define DEFAULT_RENDER_MODE     GST_VAAPI_RENDER_MODE_TEXTURE
 #define DEFAULT_ROTATION        GST_VAAPI_ROTATION_0
 
@@ -77,6 +67,10 @@ static GstVaapiDisplayCache *g_display_cache = NULL;
 
 static GParamSpec *g_properties[N_PROPERTIES] = { NULL, };
 
+/* Evaluates to the specified member of the display capabilities */
+#define DISPLAY_CAPS(display, member) \
+    ((display)->priv->caps ? (display)->priv->caps->member : NULL)
+
 static gboolean
 get_attribute(GstVaapiDisplay *display, VADisplayAttribType type, gint *value);
 
@@ -310,6 +304,9 @@ find_format(GArray *formats, GstVaapiImageFormat format)
 {
     guint i;
 
+    if (!formats)
+        return FALSE;
+
     for (i = 0; i < formats->len; i++)
         if (g_array_index(formats, GstVaapiImageFormat, i) == format)
             return TRUE;
@@ -337,6 +334,13 @@ get_format_caps(GArray *formats)
     return out_caps;
 }
 
+/* Copy the shared capabilities, for the caller to own them */
+static inline GstCaps *
+copy_caps(GstCaps *caps)
+{
+    return caps ? gst_caps_copy(caps) : NULL;
+}
+
 /* Find display attribute */
 static const GstVaapiProperty *
 find_property(GArray *properties, const gchar *name)
@@ -344,7 +348,7 @@ find_property(GArray *properties, const gchar *name)
     GstVaapiProperty *prop;
     guint i;
 
-    if (!name)
+    if (!name || !properties)
         return NULL;
 
     for (i = 0; i < properties->len; i++) {
@@ -374,7 +378,7 @@ find_property_by_type(GArray *properties, VADisplayAttribType type)
 static inline const GstVaapiProperty *
 find_property_by_pspec(GstVaapiDisplay *display, GParamSpec *pspec)
 {
-    return find_property(display->priv->properties, pspec->name);
+    return find_property(DISPLAY_CAPS(display, properties), pspec->name);
 }
 
 static void
@@ -431,29 +435,9 @@ gst_vaapi_display_destroy(GstVaapiDisplay *display)
 {
     GstVaapiDisplayPrivate * const priv = display->priv;
 
-    if (priv->decoders) {
-        g_array_free(priv->decoders, TRUE);
-        priv->decoders = NULL;
-    }
-
-    if (priv->encoders) {
-        g_array_free(priv->encoders, TRUE);
-        priv->encoders = NULL;
-    }
-
-    if (priv->image_formats) {
-        g_array_free(priv->image_formats, TRUE);
-        priv->image_formats = NULL;
-    }
-
-    if (priv->subpicture_formats) {
-        g_array_free(priv->subpicture_formats, TRUE);
-        priv->subpicture_formats = NULL;
-    }
-
-    if (priv->properties) {
-        g_array_free(priv->properties, TRUE);
-        priv->properties = NULL;
+    if (priv->caps) {
+        gst_vaapi_display_caps_unref(priv->caps);
+        priv->caps = NULL;
     }
 
     if (priv->display) {
@@ -476,64 +460,19 @@ gst_vaapi_display_destroy(GstVaapiDisplay *display)
     }
 }
 
+/* Queries the capabilities of the VA driver */
 static gboolean
-gst_vaapi_display_create(GstVaapiDisplay *display)
+query_caps(GstVaapiDisplay *display, GstVaapiDisplayCaps *caps)
 {
     GstVaapiDisplayPrivate * const priv = display->priv;
-    GstVaapiDisplayCache *cache;
     gboolean            has_errors      = TRUE;
     VADisplayAttribute *display_attrs   = NULL;
     VAProfile          *profiles        = NULL;
     VAEntrypoint       *entrypoints     = NULL;
     VAImageFormat      *formats         = NULL;
     unsigned int       *flags           = NULL;
-    gint                i, j, n, num_entrypoints, major_version, minor_version;
+    gint                i, j, n, num_entrypoints;
     VAStatus            status;
-    GstVaapiDisplayInfo info;
-    const GstVaapiDisplayInfo *cached_info = NULL;
-
-    memset(&info, 0, sizeof(info));
-    info.display = display;
-    info.display_type = priv->display_type;
-
-    if (priv->display)
-        info.va_display = priv->display;
-    else if (priv->create_display) {
-        GstVaapiDisplayClass *klass = GST_VAAPI_DISPLAY_GET_CLASS(display);
-        if (klass->open_display && !klass->open_display(display))
-            return FALSE;
-        if (!klass->get_display || !klass->get_display(display, &info))
-            return FALSE;
-        priv->display = info.va_display;
-        priv->display_type = info.display_type;
-        if (klass->get_size)
-            klass->get_size(display, &priv->width, &priv->height);
-        if (klass->get_size_mm)
-            klass->get_size_mm(display, &priv->width_mm, &priv->height_mm);
-        gst_vaapi_display_calculate_pixel_aspect_ratio(display);
-    }
-    if (!priv->display)
-        return FALSE;
-
-    cache = get_display_cache();
-    if (!cache)
-        return FALSE;
-    cached_info = gst_vaapi_display_cache_lookup_by_va_display(
-        cache,
-        info.va_display
-    );
-    if (cached_info) {
-        g_clear_object(&priv->parent);
-        priv->parent = g_object_ref(cached_info->display);
-        priv->display_type = cached_info->display_type;
-    }
-
-    if (!priv->parent) {
-        status = vaInitialize(priv->display, &major_version, &minor_version);
-        if (!vaapi_check_status(status, "vaInitialize()"))
-            goto end;
-        GST_DEBUG("VA-API version %d.%d", major_version, minor_version);
-    }
 
     /* VA profiles */
     profiles = g_new(VAProfile, vaMaxNumProfiles(priv->display));
@@ -556,12 +495,6 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
         GST_DEBUG("  %s", string_of_VAProfile(profiles[i]));
     }
 
-    priv->decoders = g_array_new(FALSE, FALSE, sizeof(GstVaapiConfig));
-    if (!priv->decoders)
-        goto end;
-    priv->encoders = g_array_new(FALSE, FALSE, sizeof(GstVaapiConfig));
-    if (!priv->encoders)
-        goto end;
 
     for (i = 0; i < n; i++) {
         GstVaapiConfig config;
@@ -584,15 +517,15 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
             case GST_VAAPI_ENTRYPOINT_VLD:
             case GST_VAAPI_ENTRYPOINT_IDCT:
             case GST_VAAPI_ENTRYPOINT_MOCO:
-                g_array_append_val(priv->decoders, config);
+                g_array_append_val(caps->decoders, config);
                 break;
             case GST_VAAPI_ENTRYPOINT_SLICE_ENCODE:
-                g_array_append_val(priv->encoders, config);
+                g_array_append_val(caps->encoders, config);
                 break;
             }
         }
     }
-    append_h263_config(priv->decoders);
+    append_h263_config(caps->decoders);
 
     /* VA display attributes */
     display_attrs =
@@ -605,10 +538,6 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
     if (!vaapi_check_status(status, "vaQueryDisplayAttributes()"))
         goto end;
 
-    priv->properties = g_array_new(FALSE, FALSE, sizeof(GstVaapiProperty));
-    if (!priv->properties)
-        goto end;
-
     GST_DEBUG("%d display attributes", n);
     for (i = 0; i < n; i++) {
         VADisplayAttribute * const attr = &display_attrs[i];
@@ -617,34 +546,7 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
 
         GST_DEBUG("  %s", string_of_VADisplayAttributeType(attr->type));
 
-        switch (attr->type) {
-#if !VA_CHECK_VERSION(0,34,0)
-        case VADisplayAttribDirectSurface:
-            prop.name = GST_VAAPI_DISPLAY_PROP_RENDER_MODE;
-            break;
-#endif
-        case VADisplayAttribRenderMode:
-            prop.name = GST_VAAPI_DISPLAY_PROP_RENDER_MODE;
-            break;
-        case VADisplayAttribRotation:
-            prop.name = GST_VAAPI_DISPLAY_PROP_ROTATION;
-            break;
-        case VADisplayAttribHue:
-            prop.name = GST_VAAPI_DISPLAY_PROP_HUE;
-            break;
-        case VADisplayAttribSaturation:
-            prop.name = GST_VAAPI_DISPLAY_PROP_SATURATION;
-            break;
-        case VADisplayAttribBrightness:
-            prop.name = GST_VAAPI_DISPLAY_PROP_BRIGHTNESS;
-            break;
-        case VADisplayAttribContrast:
-            prop.name = GST_VAAPI_DISPLAY_PROP_CONTRAST;
-            break;
-        default:
-            prop.name = NULL;
-            break;
-        }
+        prop.name = gst_vaapi_display_caps_get_property_name(attr->type);
         if (!prop.name)
             continue;
 
@@ -660,7 +562,7 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
 
         prop.attribute = *attr;
         prop.old_value = value;
-        g_array_append_val(priv->properties, prop);
+        g_array_append_val(caps->properties, prop);
     }
 
     /* VA image formats */
@@ -675,12 +577,8 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
     for (i = 0; i < n; i++)
         GST_DEBUG("  %" GST_FOURCC_FORMAT, GST_FOURCC_ARGS(formats[i].fourcc));
 
-    priv->image_formats =
-        g_array_new(FALSE, FALSE, sizeof(GstVaapiImageFormat));
-    if (!priv->image_formats)
-        goto end;
-    append_formats(priv->image_formats, formats, n);
-    g_array_sort(priv->image_formats, compare_yuv_formats);
+    append_formats(caps->image_formats, formats, n);
+    g_array_sort(caps->image_formats, compare_yuv_formats);
 
     /* VA subpicture formats */
     n = vaMaxNumSubpictureFormats(priv->display);
@@ -696,12 +594,161 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
     for (i = 0; i < n; i++)
         GST_DEBUG("  %" GST_FOURCC_FORMAT, GST_FOURCC_ARGS(formats[i].fourcc));
 
-    priv->subpicture_formats =
-        g_array_new(FALSE, FALSE, sizeof(GstVaapiImageFormat));
-    if (!priv->subpicture_formats)
+    append_formats(caps->subpicture_formats, formats, n);
+    g_array_sort(caps->subpicture_formats, compare_rgb_formats);
+
+    has_errors = FALSE;
+end:
+    g_free(display_attrs);
+    g_free(profiles);
+    g_free(entrypoints);
+    g_free(formats);
+    g_free(flags);
+    return !has_errors;
+}
+
+/* Identifies the device of a display without a name, from its DRM
+   device node, or returns %NULL if the device is not known */
+static gchar *
+get_device_key(GstVaapiDisplayInfo *info)
+{
+#if USE_DRM
+    struct stat st;
+
+    if (info->display_type == GST_VAAPI_DISPLAY_TYPE_DRM &&
+        fstat(GPOINTER_TO_INT(info->native_display), &st) == 0 &&
+        S_ISCHR(st.st_mode))
+        return g_strdup_printf("drm:%lu", (gulong)st.st_rdev);
+#endif
+    return NULL;
+}
+
+/* Gets the capabilities of the VA driver, from the ones already known to
+   this process, the on-disk cache, or the driver itself, in that order.
+   The on-disk cache is only used for displays with a name, e.g. a DRM
+   device path, and its entries are checked against the driver version.
+   Displays whose device is not known are queried every time, since two
+   GPUs may use the same driver */
+static gboolean
+ensure_caps(
+    GstVaapiDisplay     *display,
+    GstVaapiDisplayInfo *info,
+    gint                 major_version,
+    gint                 minor_version
+)
+{
+    GstVaapiDisplayPrivate * const priv = display->priv;
+    const gchar * const display_name = info->display_name;
+    GstVaapiDisplayCaps *caps = NULL;
+    const gchar *vendor;
+    gchar *key, *driver;
+    gboolean is_loaded = FALSE, is_shared = TRUE;
+
+    vendor = vaQueryVendorString(priv->display);
+    driver = g_strdup_printf("%s; VA-API %d.%d", vendor ? vendor : "unknown",
+                             major_version, minor_version);
+    key = display_name ? g_strdup(display_name) : get_device_key(info);
+    if (!key) {
+        key = g_strdup(driver);
+        is_shared = FALSE;
+    }
+
+    if (is_shared)
+        caps = gst_vaapi_display_caps_lookup(key, driver);
+    if (caps)
+        goto end;
+
+    if (display_name) {
+        caps = gst_vaapi_display_caps_load(key, driver);
+        is_loaded = caps != NULL;
+    }
+    if (!caps) {
+        caps = gst_vaapi_display_caps_new(key, driver);
+        if (!caps)
+            goto end;
+        if (!query_caps(display, caps)) {
+            gst_vaapi_display_caps_unref(caps);
+            caps = NULL;
+            goto end;
+        }
+    }
+
+    caps->decode_caps     = get_profile_caps(caps->decoders);
+    caps->encode_caps     = get_profile_caps(caps->encoders);
+    caps->image_caps      = get_format_caps(caps->image_formats);
+    caps->subpicture_caps = get_format_caps(caps->subpicture_formats);
+
+    if (display_name && !is_loaded)
+        gst_vaapi_display_caps_save(caps);
+    if (is_shared)
+        caps = gst_vaapi_display_caps_register(caps);
+
+end:
+    g_free(key);
+    g_free(driver);
+    priv->caps = caps;
+    return caps != NULL;
+}
+
+static gboolean
+gst_vaapi_display_create(GstVaapiDisplay *display)
+{
+    GstVaapiDisplayPrivate * const priv = display->priv;
+    GstVaapiDisplayCache *cache;
+    gboolean            has_errors      = TRUE;
+    gint                major_version   = 0;
+    gint                minor_version   = 0;
+    VAStatus            status;
+    GstVaapiDisplayInfo info;
+    const GstVaapiDisplayInfo *cached_info = NULL;
+
+    memset(&info, 0, sizeof(info));
+    info.display = display;
+    info.display_type = priv->display_type;
+
+    if (priv->display)
+        info.va_display = priv->display;
+    else if (priv->create_display) {
+        GstVaapiDisplayClass *klass = GST_VAAPI_DISPLAY_GET_CLASS(display);
+        if (klass->open_display && !klass->open_display(display))
+            return FALSE;
+        if (!klass->get_display || !klass->get_display(display, &info))
+            return FALSE;
+        priv->display = info.va_display;
+        priv->display_type = info.display_type;
+        if (klass->get_size)
+            klass->get_size(display, &priv->width, &priv->height);
+        if (klass->get_size_mm)
+            klass->get_size_mm(display, &priv->width_mm, &priv->height_mm);
+        gst_vaapi_display_calculate_pixel_aspect_ratio(display);
+    }
+    if (!priv->display)
+        return FALSE;
+
+    cache = get_display_cache();
+    if (!cache)
+        return FALSE;
+    cached_info = gst_vaapi_display_cache_lookup_by_va_display(
+        cache,
+        info.va_display
+    );
+    if (cached_info) {
+        g_clear_object(&priv->parent);
+        priv->parent = g_object_ref(cached_info->display);
+        priv->display_type = cached_info->display_type;
+    }
+
+    if (!priv->parent) {
+        status = vaInitialize(priv->display, &major_version, &minor_version);
+        if (!vaapi_check_status(status, "vaInitialize()"))
+            goto end;
+        GST_DEBUG("VA-API version %d.%d", major_version, minor_version);
+    }
+
+    if (priv->parent && priv->parent->priv->caps)
+        priv->caps = gst_vaapi_display_caps_ref(priv->parent->priv->caps);
+    else if (!ensure_caps(display, &info, major_version, minor_version))
         goto end;
-    append_formats(priv->subpicture_formats, formats, n);
-    g_array_sort(priv->subpicture_formats, compare_rgb_formats);
 
     if (!cached_info) {
         if (!gst_vaapi_display_cache_add(cache, &info))
@@ -710,11 +757,6 @@ gst_vaapi_display_create(GstVaapiDisplay *display)
 
     has_errors = FALSE;
 end:
-    g_free(display_attrs);
-    g_free(profiles);
-    g_free(entrypoints);
-    g_free(formats);
-    g_free(flags);
     return !has_errors;
 }
 
@@ -856,6 +898,7 @@ gst_vaapi_display_class_init(GstVaapiDisplayClass *klass)
     GstVaapiDisplayClass * const dpy_class = GST_VAAPI_DISPLAY_CLASS(klass);
 
     GST_DEBUG_CATEGORY_INIT(gst_debug_vaapi, "vaapi", 0, "VA-API helper");
+    gst_vaapi_trace_init();
 
     g_type_class_add_private(klass, sizeof(GstVaapiDisplayPrivate));
 
@@ -991,11 +1034,7 @@ gst_vaapi_display_init(GstVaapiDisplay *display)
     priv->height_mm             = 0;
     priv->par_n                 = 1;
     priv->par_d                 = 1;
-    priv->decoders              = NULL;
-    priv->encoders              = NULL;
-    priv->image_formats         = NULL;
-    priv->subpicture_formats    = NULL;
-    priv->properties            = NULL;
+    priv->caps                  = NULL;
     priv->create_display        = TRUE;
 
     g_static_rec_mutex_init(&priv->mutex);
@@ -1236,7 +1275,7 @@ gst_vaapi_display_get_decode_caps(GstVaapiDisplay *display)
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), NULL);
 
-    return get_profile_caps(display->priv->decoders);
+    return copy_caps(DISPLAY_CAPS(display, decode_caps));
 }
 
 /**
@@ -1259,7 +1298,7 @@ gst_vaapi_display_has_decoder(
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), FALSE);
 
-    return find_config(display->priv->decoders, profile, entrypoint);
+    return find_config(DISPLAY_CAPS(display, decoders), profile, entrypoint);
 }
 
 /**
@@ -1275,7 +1314,7 @@ gst_vaapi_display_get_encode_caps(GstVaapiDisplay *display)
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), NULL);
 
-    return get_profile_caps(display->priv->encoders);
+    return copy_caps(DISPLAY_CAPS(display, encode_caps));
 }
 
 /**
@@ -1298,7 +1337,7 @@ gst_vaapi_display_has_encoder(
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), FALSE);
 
-    return find_config(display->priv->encoders, profile, entrypoint);
+    return find_config(DISPLAY_CAPS(display, encoders), profile, entrypoint);
 }
 
 /**
@@ -1322,7 +1361,7 @@ gst_vaapi_display_get_image_caps(GstVaapiDisplay *display)
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), NULL);
 
-    return get_format_caps(display->priv->image_formats);
+    return copy_caps(DISPLAY_CAPS(display, image_caps));
 }
 
 /**
@@ -1343,14 +1382,14 @@ gst_vaapi_display_has_image_format(
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), FALSE);
     g_return_val_if_fail(format, FALSE);
 
-    if (find_format(display->priv->image_formats, format))
+    if (find_format(DISPLAY_CAPS(display, image_formats), format))
         return TRUE;
 
     /* XXX: try subpicture formats since some drivers could report a
      * set of VA image formats that is not a superset of the set of VA
      * subpicture formats
      */
-    return find_format(display->priv->subpicture_formats, format);
+    return find_format(DISPLAY_CAPS(display, subpicture_formats), format);
 }
 
 /**
@@ -1371,7 +1410,7 @@ gst_vaapi_display_get_subpicture_caps(GstVaapiDisplay *display)
 {
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), NULL);
 
-    return get_format_caps(display->priv->subpicture_formats);
+    return copy_caps(DISPLAY_CAPS(display, subpicture_caps));
 }
 
 /**
@@ -1392,7 +1431,7 @@ gst_vaapi_display_has_subpicture_format(
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), FALSE);
     g_return_val_if_fail(format, FALSE);
 
-    return find_format(display->priv->subpicture_formats, format);
+    return find_format(DISPLAY_CAPS(display, subpicture_formats), format);
 }
 
 /**
@@ -1413,7 +1452,7 @@ gst_vaapi_display_has_property(GstVaapiDisplay *display, const gchar *name)
     g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), FALSE);
     g_return_val_if_fail(name, FALSE);
 
-    return find_property(display->priv->properties, name) != NULL;
+    return find_property(DISPLAY_CAPS(display, properties), name) != NULL;
 }
 
 static gboolean
@@ -25,6 +25,7 @@
 
 #include <gst/vaapi/gstvaapidisplay.h>
 #include <gst/vaapi/gstvaapidisplaycache.h>
+#include <gst/vaapi/gstvaapidisplaycaps.h>
 
 G_BEGIN_DECLS
 
@@ -82,11 +83,7 @@ struct _GstVaapiDisplayPrivate {
     guint               height_mm;
     guint               par_n;
     guint               par_d;
-    GArray             *decoders;
-    GArray             *encoders;
-    GArray             *image_formats;
-    GArray             *subpicture_formats;
-    GArray             *properties;
+    GstVaapiDisplayCaps *caps;
     guint               create_display  : 1;
 };
 
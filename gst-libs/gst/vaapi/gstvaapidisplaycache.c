@@ -30,11 +30,36 @@
 typedef struct _CacheEntry CacheEntry;
 struct _CacheEntry {
     GstVaapiDisplayInfo info;
+    GList              *link;
 };
 
+/* Entries are indexed by each of these GstVaapiDisplayInfo fields */
+enum {
+    CACHE_INDEX_DISPLAY,
+    CACHE_INDEX_VA_DISPLAY,
+    CACHE_INDEX_NATIVE_DISPLAY,
+    CACHE_INDEX_NAME,
+
+    CACHE_INDEX_COUNT
+};
+
+static const gsize g_cache_index_offsets[CACHE_INDEX_COUNT] = {
+    G_STRUCT_OFFSET(GstVaapiDisplayInfo, display),
+    G_STRUCT_OFFSET(GstVaapiDisplayInfo, va_display),
+    G_STRUCT_OFFSET(GstVaapiDisplayInfo, native_display),
+    G_STRUCT_OFFSET(GstVaapiDisplayInfo, display_name),
+};
+
+#define CACHE_INDEX_KEY(info, index) \
+    G_STRUCT_MEMBER(gpointer, info, g_cache_index_offsets[index])
+
+/* Lookups are far more frequent than additions and removals, so they
+   only take the lock for reading. The list keeps entries from the most
+   recent one, and each index maps a key to the most recent entry */
 struct _GstVaapiDisplayCache {
-    GStaticMutex        mutex;
+    GStaticRWLock       lock;
     GList              *list;
+    GHashTable         *indexes[CACHE_INDEX_COUNT];
 };
 
 static void
@@ -64,6 +89,7 @@ cache_entry_new(const GstVaapiDisplayInfo *di)
     if (!entry)
         return NULL;
 
+    entry->link          = NULL;
     info                 = &entry->info;
     info->display        = di->display;
     info->va_display     = di->va_display;
@@ -83,51 +109,111 @@ error:
     return NULL;
 }
 
-#define CACHE_LOOKUP(cache, res, prop, comp_func, comp_data, user_data) do { \
-        GList *l;                                                       \
-                                                                        \
-        g_static_mutex_lock(&(cache)->mutex);                           \
-        for (l = (cache)->list; l != NULL; l = l->next) {               \
-            GstVaapiDisplayInfo * const info =                          \
-                &((CacheEntry *)l->data)->info;                         \
-            if (comp_func(info->prop, comp_data, user_data))            \
-                break;                                                  \
-        }                                                               \
-        g_static_mutex_unlock(&(cache)->mutex);                         \
-        res = l;                                                        \
-    } while (0)
-
-#define compare_equal(a, b, user_data) \
-    ((a) == (b))
-
-#define compare_string(a, b, user_data) \
-    ((a) == (b) || ((a) && (b) && strcmp(a, b) == 0))
-
-static GList *
-cache_lookup_display(GstVaapiDisplayCache *cache, GstVaapiDisplay *display)
+/* Makes @entry the one found for its keys. Called with the write lock */
+static void
+cache_index_add(GstVaapiDisplayCache *cache, CacheEntry *entry)
 {
-    GList *m;
+    gpointer key;
+    guint i;
 
-    CACHE_LOOKUP(cache, m, display, compare_equal, display, NULL);
-    return m;
+    for (i = 0; i < CACHE_INDEX_COUNT; i++) {
+        key = CACHE_INDEX_KEY(&entry->info, i);
+        if (key)
+            g_hash_table_replace(cache->indexes[i], key, entry);
+    }
 }
 
-static GList *
-cache_lookup_va_display(GstVaapiDisplayCache *cache, VADisplay va_display)
+/* Drops @entry from the indexes, and falls back to the next most recent
+   entry with the same keys, if any. Called with the write lock, once
+   @entry was removed from the list */
+static void
+cache_index_remove(GstVaapiDisplayCache *cache, CacheEntry *entry)
 {
-    GList *m;
+    GHashTable *index;
+    CacheEntry *other;
+    gpointer key, other_key;
+    GList *l;
+    guint i;
+
+    for (i = 0; i < CACHE_INDEX_COUNT; i++) {
+        index = cache->indexes[i];
+        key   = CACHE_INDEX_KEY(&entry->info, i);
+        if (!key || g_hash_table_lookup(index, key) != entry)
+            continue;
+
+        g_hash_table_remove(index, key);
+        for (l = cache->list; l != NULL; l = l->next) {
+            other     = l->data;
+            other_key = CACHE_INDEX_KEY(&other->info, i);
+            if (other_key && (other_key == key ||
+                              (i == CACHE_INDEX_NAME &&
+                               strcmp(other_key, key) == 0))) {
+                g_hash_table_replace(index, other_key, other);
+                break;
+            }
+        }
+    }
+}
 
-    CACHE_LOOKUP(cache, m, va_display, compare_equal, va_display, NULL);
-    return m;
+static CacheEntry *
+cache_lookup(GstVaapiDisplayCache *cache, guint index, gconstpointer key)
+{
+    CacheEntry *entry;
+
+    g_static_rw_lock_reader_lock(&cache->lock);
+    entry = g_hash_table_lookup(cache->indexes[index], key);
+    g_static_rw_lock_reader_unlock(&cache->lock);
+    return entry;
+}
+
+static CacheEntry *
+cache_lookup_display(GstVaapiDisplayCache *cache, GstVaapiDisplay *display)
+{
+    return cache_lookup(cache, CACHE_INDEX_DISPLAY, display);
+}
+
+static CacheEntry *
+cache_lookup_va_display(GstVaapiDisplayCache *cache, VADisplay va_display)
+{
+    return cache_lookup(cache, CACHE_INDEX_VA_DISPLAY, va_display);
 }
 
-static GList *
+static CacheEntry *
 cache_lookup_native_display(GstVaapiDisplayCache *cache, gpointer native_display)
 {
-    GList *m;
+    return cache_lookup(cache, CACHE_INDEX_NATIVE_DISPLAY, native_display);
+}
+
+/* Looks up an entry by name. An exact match is found through the index,
+   other matches through @compare_func need a scan of all entries */
+static CacheEntry *
+cache_lookup_name(
+    GstVaapiDisplayCache       *cache,
+    const gchar                *display_name,
+    GCompareDataFunc            compare_func,
+    gpointer                    user_data
+)
+{
+    CacheEntry *entry = NULL;
+    const gchar *name;
+    GList *l;
 
-    CACHE_LOOKUP(cache, m, native_display, compare_equal, native_display, NULL);
-    return m;
+    g_static_rw_lock_reader_lock(&cache->lock);
+    if (display_name)
+        entry = g_hash_table_lookup(cache->indexes[CACHE_INDEX_NAME],
+                                    display_name);
+    if (!entry && (compare_func || !display_name)) {
+        for (l = cache->list; l != NULL; l = l->next) {
+            name = ((CacheEntry *)l->data)->info.display_name;
+            if (compare_func ?
+                compare_func(name, display_name, user_data) : !name) {
+                entry = l->data;
+                break;
+            }
+        }
+    }
+    g_static_rw_lock_reader_unlock(&cache->lock);
+    return entry;
 }
 
 /**
@@ -146,7 +232,15 @@ gst_vaapi_display_cache_new(void)
     if (!cache)
         return NULL;
 
-    g_static_mutex_init(&cache->mutex);
+    g_static_rw_lock_init(&cache->lock);
+    cache->indexes[CACHE_INDEX_DISPLAY] =
+        g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->indexes[CACHE_INDEX_VA_DISPLAY] =
+        g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->indexes[CACHE_INDEX_NATIVE_DISPLAY] =
+        g_hash_table_new(g_direct_hash, g_direct_equal);
+    cache->indexes[CACHE_INDEX_NAME] =
+        g_hash_table_new(g_str_hash, g_str_equal);
     return cache;
 }
 
@@ -160,17 +254,25 @@ void
 gst_vaapi_display_cache_free(GstVaapiDisplayCache *cache)
 {
     GList *l;
+    guint i;
 
     if (!cache)
         return;
 
+    for (i = 0; i < CACHE_INDEX_COUNT; i++) {
+        if (cache->indexes[i]) {
+            g_hash_table_destroy(cache->indexes[i]);
+            cache->indexes[i] = NULL;
+        }
+    }
+
     if (cache->list) {
         for (l = cache->list; l != NULL; l = l->next)
             cache_entry_free(l->data);
         g_list_free(cache->list);
         cache->list = NULL;
     }
-    g_static_mutex_free(&cache->mutex);
+    g_static_rw_lock_free(&cache->lock);
     g_slice_free(GstVaapiDisplayCache, cache);
 }
 
@@ -189,9 +291,9 @@ gst_vaapi_display_cache_get_size(GstVaapiDisplayCache *cache)
 
     g_return_val_if_fail(cache != NULL, 0);
 
-    g_static_mutex_lock(&cache->mutex);
+    g_static_rw_lock_reader_lock(&cache->lock);
     size = g_list_length(cache->list);
-    g_static_mutex_unlock(&cache->mutex);
+    g_static_rw_lock_reader_unlock(&cache->lock);
     return size;
 }
 
@@ -220,9 +322,11 @@ gst_vaapi_display_cache_add(
     if (!entry)
         return FALSE;
 
-    g_static_mutex_lock(&cache->mutex);
+    g_static_rw_lock_writer_lock(&cache->lock);
     cache->list = g_list_prepend(cache->list, entry);
-    g_static_mutex_unlock(&cache->mutex);
+    entry->link = cache->list;
+    cache_index_add(cache, entry);
+    g_static_rw_lock_writer_unlock(&cache->lock);
     return TRUE;
 }
 
@@ -239,16 +343,16 @@ gst_vaapi_display_cache_remove(
     GstVaapiDisplay            *display
 )
 {
-    GList *m;
-
-    m = cache_lookup_display(cache, display);
-    if (!m)
-        return;
+    CacheEntry *entry;
 
-    cache_entry_free(m->data);
-    g_static_mutex_lock(&cache->mutex);
-    cache->list = g_list_delete_link(cache->list, m);
-    g_static_mutex_unlock(&cache->mutex);
+    g_static_rw_lock_writer_lock(&cache->lock);
+    entry = g_hash_table_lookup(cache->indexes[CACHE_INDEX_DISPLAY], display);
+    if (entry) {
+        cache->list = g_list_delete_link(cache->list, entry->link);
+        cache_index_remove(cache, entry);
+    }
+    g_static_rw_lock_writer_unlock(&cache->lock);
+    cache_entry_free(entry);
 }
 
 /**
@@ -268,16 +372,13 @@ gst_vaapi_display_cache_lookup(
 )
 {
     CacheEntry *entry;
-    GList *m;
 
     g_return_val_if_fail(cache != NULL, NULL);
     g_return_val_if_fail(display != NULL, NULL);
 
-    m = cache_lookup_display(cache, display);
-    if (!m)
+    entry = cache_lookup_display(cache, display);
+    if (!entry)
         return NULL;
-
-    entry = m->data;
     return &entry->info;
 }
 
@@ -298,16 +399,13 @@ gst_vaapi_display_cache_lookup_by_va_display(
 )
 {
     CacheEntry *entry;
-    GList *m;
 
     g_return_val_if_fail(cache != NULL, NULL);
     g_return_val_if_fail(va_display != NULL, NULL);
 
-    m = cache_lookup_va_display(cache, va_display);
-    if (!m)
+    entry = cache_lookup_va_display(cache, va_display);
+    if (!entry)
         return NULL;
-
-    entry = m->data;
     return &entry->info;
 }
 
@@ -328,16 +426,13 @@ gst_vaapi_display_cache_lookup_by_native_display(
 )
 {
     CacheEntry *entry;
-    GList *m;
 
     g_return_val_if_fail(cache != NULL, NULL);
     g_return_val_if_fail(native_display != NULL, NULL);
 
-    m = cache_lookup_native_display(cache, native_display);
-    if (!m)
+    entry = cache_lookup_native_display(cache, native_display);
+    if (!entry)
         return NULL;
-
-    entry = m->data;
     return &entry->info;
 }
 
@@ -350,7 +445,7 @@ gst_vaapi_display_cache_lookup_by_native_display(
  *
  * Looks up the display cache for the specified display name. A
  * specific comparison function can be provided to avoid a plain
- * strcmp().
+ * strcmp(). It is only called if no entry has exactly @display_name.
  *
  * Return value: a #GstVaapiDisplayInfo matching @display_name, or
  *   %NULL if none was found
@@ -364,17 +459,11 @@ gst_vaapi_display_cache_lookup_by_name(
 )
 {
     CacheEntry *entry;
-    GList *m;
 
     g_return_val_if_fail(cache != NULL, NULL);
 
-    if (compare_func)
-        CACHE_LOOKUP(cache, m, display_name, compare_func, display_name, user_data);
-    else
-        CACHE_LOOKUP(cache, m, display_name, compare_string, display_name, NULL);
-    if (!m)
+    entry = cache_lookup_name(cache, display_name, compare_func, user_data);
+    if (!entry)
         return NULL;
-
-    entry = m->data;
     return &entry->info;
 }
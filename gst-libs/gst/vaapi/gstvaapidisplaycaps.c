@@ -0,0 +1,502 @@
+/*
+ *  gstvaapidisplaycaps.c - VA display capabilities
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gstvaapidisplay.h"
+#include "gstvaapidisplaycaps.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Bump whenever the layout of the on-disk cache changes */
+#define CACHE_FILE_VERSION      1
+
+/* Number of integers stored per GstVaapiProperty */
+#define PROPERTY_NUM_FIELDS     5
+
+/* Capabilities of the drivers already opened in this process */
+static GStaticMutex g_display_caps_lock = G_STATIC_MUTEX_INIT;
+static GHashTable  *g_display_caps_table;
+
+/**
+ * gst_vaapi_display_caps_new:
+ * @key: the driver and device identification
+ * @driver: the VA driver vendor string and VA-API version
+ *
+ * Creates a new, empty, set of capabilities.
+ *
+ * Return value: the newly allocated #GstVaapiDisplayCaps
+ */
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_new(const gchar *key, const gchar *driver)
+{
+    GstVaapiDisplayCaps *caps;
+
+    g_return_val_if_fail(key != NULL, NULL);
+    g_return_val_if_fail(driver != NULL, NULL);
+
+    caps = g_slice_new0(GstVaapiDisplayCaps);
+    if (!caps)
+        return NULL;
+
+    caps->ref_count = 1;
+    caps->key       = g_strdup(key);
+    caps->driver    = g_strdup(driver);
+    caps->decoders  = g_array_new(FALSE, FALSE, sizeof(GstVaapiConfig));
+    caps->encoders  = g_array_new(FALSE, FALSE, sizeof(GstVaapiConfig));
+    caps->image_formats =
+        g_array_new(FALSE, FALSE, sizeof(GstVaapiImageFormat));
+    caps->subpicture_formats =
+        g_array_new(FALSE, FALSE, sizeof(GstVaapiImageFormat));
+    caps->properties = g_array_new(FALSE, FALSE, sizeof(GstVaapiProperty));
+    return caps;
+}
+
+static void
+gst_vaapi_display_caps_free(GstVaapiDisplayCaps *caps)
+{
+    g_free(caps->key);
+    g_free(caps->driver);
+    g_array_free(caps->decoders, TRUE);
+    g_array_free(caps->encoders, TRUE);
+    g_array_free(caps->image_formats, TRUE);
+    g_array_free(caps->subpicture_formats, TRUE);
+    g_array_free(caps->properties, TRUE);
+    gst_caps_replace(&caps->decode_caps, NULL);
+    gst_caps_replace(&caps->encode_caps, NULL);
+    gst_caps_replace(&caps->image_caps, NULL);
+    gst_caps_replace(&caps->subpicture_caps, NULL);
+    g_slice_free(GstVaapiDisplayCaps, caps);
+}
+
+/**
+ * gst_vaapi_display_caps_ref:
+ * @caps: a #GstVaapiDisplayCaps
+ *
+ * Atomically increases the reference count of @caps by one.
+ *
+ * Return value: the same @caps argument
+ */
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_ref(GstVaapiDisplayCaps *caps)
+{
+    g_return_val_if_fail(caps != NULL, NULL);
+
+    g_atomic_int_inc(&caps->ref_count);
+    return caps;
+}
+
+/**
+ * gst_vaapi_display_caps_unref:
+ * @caps: a #GstVaapiDisplayCaps
+ *
+ * Atomically decreases the reference count of @caps by one. If the
+ * reference count reaches zero, @caps is freed.
+ */
+void
+gst_vaapi_display_caps_unref(GstVaapiDisplayCaps *caps)
+{
+    g_return_if_fail(caps != NULL);
+
+    if (g_atomic_int_dec_and_test(&caps->ref_count))
+        gst_vaapi_display_caps_free(caps);
+}
+
+/**
+ * gst_vaapi_display_caps_lookup:
+ * @key: the driver and device identification
+ * @driver: the VA driver vendor string and VA-API version
+ *
+ * Looks up the capabilities already queried in this process for @key,
+ * provided they were queried with the same @driver.
+ *
+ * Return value: a new reference to the #GstVaapiDisplayCaps, or %NULL
+ *   if none was found
+ */
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_lookup(const gchar *key, const gchar *driver)
+{
+    GstVaapiDisplayCaps *caps = NULL;
+
+    g_return_val_if_fail(key != NULL, NULL);
+    g_return_val_if_fail(driver != NULL, NULL);
+
+    g_static_mutex_lock(&g_display_caps_lock);
+    if (g_display_caps_table)
+        caps = g_hash_table_lookup(g_display_caps_table, key);
+    if (caps && strcmp(caps->driver, driver) == 0)
+        gst_vaapi_display_caps_ref(caps);
+    else
+        caps = NULL;
+    g_static_mutex_unlock(&g_display_caps_lock);
+    return caps;
+}
+
+/**
+ * gst_vaapi_display_caps_register:
+ * @caps: a #GstVaapiDisplayCaps
+ *
+ * Shares @caps with the displays created later in this process. If
+ * another thread registered capabilities for the same driver in the
+ * meantime, @caps is released and those are returned instead.
+ *
+ * Return value: the registered #GstVaapiDisplayCaps
+ */
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_register(GstVaapiDisplayCaps *caps)
+{
+    GstVaapiDisplayCaps *registered_caps;
+
+    g_return_val_if_fail(caps != NULL, NULL);
+
+    g_static_mutex_lock(&g_display_caps_lock);
+    if (!g_display_caps_table)
+        g_display_caps_table = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify)gst_vaapi_display_caps_unref);
+
+    registered_caps = g_hash_table_lookup(g_display_caps_table, caps->key);
+    if (registered_caps && strcmp(registered_caps->driver, caps->driver) == 0) {
+        gst_vaapi_display_caps_unref(caps);
+        caps = registered_caps;
+    }
+    else
+        g_hash_table_replace(g_display_caps_table, caps->key,
+            gst_vaapi_display_caps_ref(caps));
+    gst_vaapi_display_caps_ref(caps);
+    g_static_mutex_unlock(&g_display_caps_lock);
+    return caps;
+}
+
+/**
+ * gst_vaapi_display_caps_get_property_name:
+ * @type: a #VADisplayAttribType
+ *
+ * Maps a VA display attribute to the #GstVaapiDisplay property that
+ * exposes it.
+ *
+ * Return value: the property name, or %NULL if @type is not exposed
+ */
+const gchar *
+gst_vaapi_display_caps_get_property_name(VADisplayAttribType type)
+{
+    switch (type) {
+#if !VA_CHECK_VERSION(0,34,0)
+    case VADisplayAttribDirectSurface:
+        return GST_VAAPI_DISPLAY_PROP_RENDER_MODE;
+#endif
+    case VADisplayAttribRenderMode:
+        return GST_VAAPI_DISPLAY_PROP_RENDER_MODE;
+    case VADisplayAttribRotation:
+        return GST_VAAPI_DISPLAY_PROP_ROTATION;
+    case VADisplayAttribHue:
+        return GST_VAAPI_DISPLAY_PROP_HUE;
+    case VADisplayAttribSaturation:
+        return GST_VAAPI_DISPLAY_PROP_SATURATION;
+    case VADisplayAttribBrightness:
+        return GST_VAAPI_DISPLAY_PROP_BRIGHTNESS;
+    case VADisplayAttribContrast:
+        return GST_VAAPI_DISPLAY_PROP_CONTRAST;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- On-disk cache                                                     --- */
+/* ------------------------------------------------------------------------- */
+
+/* The cache file can be moved with GST_VAAPI_DISPLAY_CACHE, or disabled
+   by setting it to an empty string */
+static gchar *
+get_cache_filename(void)
+{
+    const gchar *filename;
+
+    filename = g_getenv("GST_VAAPI_DISPLAY_CACHE");
+    if (filename)
+        return filename[0] ? g_strdup(filename) : NULL;
+
+    return g_build_filename(g_get_user_cache_dir(), "gstreamer-vaapi",
+                            "display-caps.cache", NULL);
+}
+
+static gboolean
+load_configs(GKeyFile *key_file, const gchar *group, const gchar *name,
+    GArray *configs)
+{
+    GstVaapiConfig config;
+    gint *values;
+    gsize i, n;
+
+    values = g_key_file_get_integer_list(key_file, group, name, &n, NULL);
+    if (!values)
+        return n == 0 && g_key_file_has_key(key_file, group, name, NULL);
+
+    for (i = 0; i + 1 < n; i += 2) {
+        config.profile    = values[i];
+        config.entrypoint = values[i + 1];
+        g_array_append_val(configs, config);
+    }
+    g_free(values);
+    return i == n;
+}
+
+static void
+save_configs(GKeyFile *key_file, const gchar *group, const gchar *name,
+    GArray *configs)
+{
+    GstVaapiConfig *config;
+    gint *values;
+    guint i;
+
+    values = g_new(gint, 2 * configs->len + 1);
+    for (i = 0; i < configs->len; i++) {
+        config = &g_array_index(configs, GstVaapiConfig, i);
+        values[2 * i + 0] = config->profile;
+        values[2 * i + 1] = config->entrypoint;
+    }
+    g_key_file_set_integer_list(key_file, group, name, values,
+                                2 * configs->len);
+    g_free(values);
+}
+
+static gboolean
+load_formats(GKeyFile *key_file, const gchar *group, const gchar *name,
+    GArray *formats)
+{
+    GstVaapiImageFormat format;
+    gint *values;
+    gsize i, n;
+
+    values = g_key_file_get_integer_list(key_file, group, name, &n, NULL);
+    if (!values)
+        return n == 0 && g_key_file_has_key(key_file, group, name, NULL);
+
+    for (i = 0; i < n; i++) {
+        format = (guint32)values[i];
+        g_array_append_val(formats, format);
+    }
+    g_free(values);
+    return TRUE;
+}
+
+static void
+save_formats(GKeyFile *key_file, const gchar *group, const gchar *name,
+    GArray *formats)
+{
+    gint *values;
+    guint i;
+
+    values = g_new(gint, formats->len + 1);
+    for (i = 0; i < formats->len; i++)
+        values[i] = (gint)g_array_index(formats, GstVaapiImageFormat, i);
+    g_key_file_set_integer_list(key_file, group, name, values, formats->len);
+    g_free(values);
+}
+
+static gboolean
+load_properties(GKeyFile *key_file, const gchar *group, GArray *properties)
+{
+    GstVaapiProperty prop;
+    gint *values;
+    gsize i, n;
+
+    values = g_key_file_get_integer_list(key_file, group, "properties", &n,
+                                         NULL);
+    if (!values)
+        return n == 0 &&
+            g_key_file_has_key(key_file, group, "properties", NULL);
+
+    for (i = 0; i + PROPERTY_NUM_FIELDS <= n; i += PROPERTY_NUM_FIELDS) {
+        prop.attribute.type      = values[i + 0];
+        prop.attribute.min_value = values[i + 1];
+        prop.attribute.max_value = values[i + 2];
+        prop.attribute.value     = values[i + 3];
+        prop.attribute.flags     = values[i + 4];
+        prop.old_value           = prop.attribute.value;
+        prop.name = gst_vaapi_display_caps_get_property_name(
+            prop.attribute.type);
+        if (!prop.name)
+            break;
+        g_array_append_val(properties, prop);
+    }
+    g_free(values);
+    return i == n;
+}
+
+static void
+save_properties(GKeyFile *key_file, const gchar *group, GArray *properties)
+{
+    GstVaapiProperty *prop;
+    gint *values, *v;
+    guint i;
+
+    values = g_new(gint, PROPERTY_NUM_FIELDS * properties->len + 1);
+    for (i = 0; i < properties->len; i++) {
+        prop = &g_array_index(properties, GstVaapiProperty, i);
+        v    = &values[PROPERTY_NUM_FIELDS * i];
+        v[0] = prop->attribute.type;
+        v[1] = prop->attribute.min_value;
+        v[2] = prop->attribute.max_value;
+        v[3] = prop->old_value;
+        v[4] = prop->attribute.flags;
+    }
+    g_key_file_set_integer_list(key_file, group, "properties", values,
+                                PROPERTY_NUM_FIELDS * properties->len);
+    g_free(values);
+}
+
+/* Checks the cache entry was written by this version, for @driver */
+static gboolean
+check_cache_group(GKeyFile *key_file, const gchar *group, const gchar *driver)
+{
+    gchar *value;
+    gboolean is_valid;
+
+    if (g_key_file_get_integer(key_file, group, "version", NULL) !=
+        CACHE_FILE_VERSION)
+        return FALSE;
+
+    value = g_key_file_get_string(key_file, group, "library", NULL);
+    is_valid = value && strcmp(value, PACKAGE_VERSION) == 0;
+    g_free(value);
+    if (!is_valid)
+        return FALSE;
+
+    value = g_key_file_get_string(key_file, group, "driver", NULL);
+    is_valid = value && strcmp(value, driver) == 0;
+    g_free(value);
+    return is_valid;
+}
+
+/**
+ * gst_vaapi_display_caps_load:
+ * @key: the driver and device identification
+ * @driver: the VA driver vendor string and VA-API version
+ *
+ * Loads the capabilities of @key from the on-disk cache. Entries saved
+ * by another library version, or for another @driver, are ignored.
+ *
+ * Return value: the newly allocated #GstVaapiDisplayCaps, without
+ *   #GstCaps, or %NULL if no valid entry was found
+ */
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_load(const gchar *key, const gchar *driver)
+{
+    GstVaapiDisplayCaps *caps = NULL;
+    GKeyFile *key_file;
+    gchar *filename;
+
+    g_return_val_if_fail(key != NULL, NULL);
+    g_return_val_if_fail(driver != NULL, NULL);
+
+    filename = get_cache_filename();
+    if (!filename)
+        return NULL;
+
+    key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, filename, G_KEY_FILE_NONE, NULL))
+        goto end;
+    if (!check_cache_group(key_file, key, driver))
+        goto end;
+
+    caps = gst_vaapi_display_caps_new(key, driver);
+    if (!caps)
+        goto end;
+    if (!load_configs(key_file, key, "decoders", caps->decoders) ||
+        !load_configs(key_file, key, "encoders", caps->encoders) ||
+        !load_formats(key_file, key, "image-formats", caps->image_formats) ||
+        !load_formats(key_file, key, "subpicture-formats",
+                      caps->subpicture_formats) ||
+        !load_properties(key_file, key, caps->properties)) {
+        GST_WARNING("invalid cache entry for %s in %s", key, filename);
+        gst_vaapi_display_caps_unref(caps);
+        caps = NULL;
+        goto end;
+    }
+    GST_DEBUG("loaded capabilities of %s from %s", key, filename);
+
+end:
+    g_key_file_free(key_file);
+    g_free(filename);
+    return caps;
+}
+
+/**
+ * gst_vaapi_display_caps_save:
+ * @caps: a #GstVaapiDisplayCaps
+ *
+ * Saves @caps to the on-disk cache, keeping the entries of the other
+ * drivers and devices.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_display_caps_save(GstVaapiDisplayCaps *caps)
+{
+    GKeyFile *key_file;
+    gchar *filename, *dirname, *data = NULL;
+    gsize data_size;
+    gboolean success = FALSE;
+
+    g_return_val_if_fail(caps != NULL, FALSE);
+
+    filename = get_cache_filename();
+    if (!filename)
+        return FALSE;
+
+    key_file = g_key_file_new();
+    g_key_file_load_from_file(key_file, filename, G_KEY_FILE_NONE, NULL);
+
+    g_key_file_remove_group(key_file, caps->key, NULL);
+    g_key_file_set_integer(key_file, caps->key, "version", CACHE_FILE_VERSION);
+    g_key_file_set_string(key_file, caps->key, "library", PACKAGE_VERSION);
+    g_key_file_set_string(key_file, caps->key, "driver", caps->driver);
+    save_configs(key_file, caps->key, "decoders", caps->decoders);
+    save_configs(key_file, caps->key, "encoders", caps->encoders);
+    save_formats(key_file, caps->key, "image-formats", caps->image_formats);
+    save_formats(key_file, caps->key, "subpicture-formats",
+                 caps->subpicture_formats);
+    save_properties(key_file, caps->key, caps->properties);
+
+    data = g_key_file_to_data(key_file, &data_size, NULL);
+    if (!data)
+        goto end;
+
+    dirname = g_path_get_dirname(filename);
+    g_mkdir_with_parents(dirname, 0755);
+    g_free(dirname);
+
+    /* The file is replaced atomically, so concurrent readers only ever
+       see complete contents */
+    success = g_file_set_contents(filename, data, data_size, NULL);
+    if (!success)
+        GST_DEBUG("could not write display capabilities to %s", filename);
+
+end:
+    g_free(data);
+    g_key_file_free(key_file);
+    g_free(filename);
+    return success;
+}
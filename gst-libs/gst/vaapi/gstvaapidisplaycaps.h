@@ -0,0 +1,117 @@
+/*
+ *  gstvaapidisplaycaps.h - VA display capabilities
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DISPLAY_CAPS_H
+#define GST_VAAPI_DISPLAY_CAPS_H
+
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapiprofile.h>
+#include <gst/vaapi/gstvaapiimageformat.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiConfig                  GstVaapiConfig;
+typedef struct _GstVaapiProperty                GstVaapiProperty;
+typedef struct _GstVaapiDisplayCaps             GstVaapiDisplayCaps;
+
+struct _GstVaapiConfig {
+    GstVaapiProfile     profile;
+    GstVaapiEntrypoint  entrypoint;
+};
+
+struct _GstVaapiProperty {
+    const gchar        *name;
+    VADisplayAttribute  attribute;
+    gint                old_value;
+};
+
+/**
+ * GstVaapiDisplayCaps:
+ * @key: the driver and device these capabilities were queried for
+ * @driver: the VA driver vendor string and VA-API version
+ * @decoders: the supported decode #GstVaapiConfig
+ * @encoders: the supported encode #GstVaapiConfig
+ * @image_formats: the supported image formats, YUV first
+ * @subpicture_formats: the supported subpicture formats, RGB first
+ * @properties: the supported display attributes, as #GstVaapiProperty
+ * @decode_caps: @decoders as #GstCaps
+ * @encode_caps: @encoders as #GstCaps
+ * @image_caps: @image_formats as #GstCaps
+ * @subpicture_caps: @subpicture_formats as #GstCaps
+ *
+ * A snapshot of the capabilities of a VA driver, shared by all the
+ * displays that use the same driver and device. It is immutable once
+ * registered with gst_vaapi_display_caps_register().
+ */
+struct _GstVaapiDisplayCaps {
+    /*< private >*/
+    volatile gint       ref_count;
+
+    /*< public >*/
+    gchar              *key;
+    gchar              *driver;
+    GArray             *decoders;
+    GArray             *encoders;
+    GArray             *image_formats;
+    GArray             *subpicture_formats;
+    GArray             *properties;
+    GstCaps            *decode_caps;
+    GstCaps            *encode_caps;
+    GstCaps            *image_caps;
+    GstCaps            *subpicture_caps;
+};
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_new(const gchar *key, const gchar *driver);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_ref(GstVaapiDisplayCaps *caps);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_caps_unref(GstVaapiDisplayCaps *caps);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_lookup(const gchar *key, const gchar *driver);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_register(GstVaapiDisplayCaps *caps);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCaps *
+gst_vaapi_display_caps_load(const gchar *key, const gchar *driver);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_caps_save(GstVaapiDisplayCaps *caps);
+
+G_GNUC_INTERNAL
+const gchar *
+gst_vaapi_display_caps_get_property_name(VADisplayAttribType type);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DISPLAY_CAPS_H */
@@ -26,10 +26,12 @@
  */
 
 #include "sysdeps.h"
+#include <stdlib.h>
 #include <string.h>
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
 #include "gstvaapiimage.h"
+#include "gstvaapiimagecopy.h"
 #include "gstvaapi_priv.h"
 
 #define DEBUG 1
@@ -53,6 +55,7 @@ struct _GstVaapiImagePrivate {
     guint               create_image    : 1;
     guint               is_constructed  : 1;
     guint               is_linear       : 1;
+    guint               is_uncached     : 1;
 };
 
 enum {
@@ -407,6 +410,7 @@ gst_vaapi_image_init(GstVaapiImage *image)
     priv->create_image            = TRUE;
     priv->is_constructed          = FALSE;
     priv->is_linear               = FALSE;
+    priv->is_uncached             = FALSE;
 
     memset(&priv->internal_image, 0, sizeof(priv->internal_image));
     priv->internal_image.image_id = VA_INVALID_ID;
@@ -707,6 +711,41 @@ gst_vaapi_image_is_linear(GstVaapiImage *image)
     return image->priv->is_linear;
 }
 
+/**
+ * gst_vaapi_image_is_uncached:
+ * @image: a #GstVaapiImage
+ *
+ * Checks whether the @image data is known to be mapped from uncached
+ * or write-combining memory, e.g. for images derived from a surface.
+ *
+ * Return value: %TRUE if reading from the mapped @image is slow
+ */
+gboolean
+gst_vaapi_image_is_uncached(GstVaapiImage *image)
+{
+    g_return_val_if_fail(GST_VAAPI_IS_IMAGE(image), FALSE);
+
+    return image->priv->is_uncached;
+}
+
+/**
+ * gst_vaapi_image_set_uncached:
+ * @image: a #GstVaapiImage
+ * @uncached: %TRUE if the @image data is mapped from uncached memory
+ *
+ * Declares whether the @image data is mapped from uncached or
+ * write-combining memory. In that case, gst_vaapi_image_get_buffer()
+ * and gst_vaapi_image_get_raw() read the pixels with streaming loads,
+ * if the CPU supports them.
+ */
+void
+gst_vaapi_image_set_uncached(GstVaapiImage *image, gboolean uncached)
+{
+    g_return_if_fail(GST_VAAPI_IS_IMAGE(image));
+
+    image->priv->is_uncached = uncached;
+}
+
 /**
  * gst_vaapi_image_is_mapped:
  * @image: a #GstVaapiImage
@@ -758,23 +797,24 @@ _gst_vaapi_image_map(GstVaapiImage *image, GstVaapiImageRaw *raw_image)
     guint i;
 
     if (_gst_vaapi_image_is_mapped(image))
-        return TRUE;
-
-    display = GST_VAAPI_OBJECT_DISPLAY(image);
-    if (!display)
-        return FALSE;
+        image_data = priv->image_data;
+    else {
+        display = GST_VAAPI_OBJECT_DISPLAY(image);
+        if (!display)
+            return FALSE;
 
-    GST_VAAPI_DISPLAY_LOCK(display);
-    status = vaMapBuffer(
-        GST_VAAPI_DISPLAY_VADISPLAY(display),
-        image->priv->image.buf,
-        &image_data
-    );
-    GST_VAAPI_DISPLAY_UNLOCK(display);
-    if (!vaapi_check_status(status, "vaMapBuffer()"))
-        return FALSE;
+        GST_VAAPI_DISPLAY_LOCK(display);
+        status = vaMapBuffer(
+            GST_VAAPI_DISPLAY_VADISPLAY(display),
+            image->priv->image.buf,
+            &image_data
+        );
+        GST_VAAPI_DISPLAY_UNLOCK(display);
+        if (!vaapi_check_status(status, "vaMapBuffer()"))
+            return FALSE;
 
-    image->priv->image_data = image_data;
+        image->priv->image_data = image_data;
+    }
 
     if (raw_image) {
         const VAImage * const va_image = &priv->image;
@@ -968,6 +1008,13 @@ init_image_from_buffer(GstVaapiImageRaw *raw_image, GstBuffer *buffer)
         raw_image->stride[2]  = raw_image->stride[1];
         size2                += height2 * raw_image->stride[2];
         break;
+    case GST_VAAPI_IMAGE_YUY2:
+    case GST_VAAPI_IMAGE_UYVY:
+        raw_image->num_planes = 1;
+        raw_image->pixels[0]  = data;
+        raw_image->stride[0]  = GST_ROUND_UP_4(width * 2);
+        size2                += height * raw_image->stride[0];
+        break;
     case GST_VAAPI_IMAGE_ARGB:
     case GST_VAAPI_IMAGE_RGBA:
     case GST_VAAPI_IMAGE_ABGR:
@@ -991,6 +1038,32 @@ init_image_from_buffer(GstVaapiImageRaw *raw_image, GstBuffer *buffer)
     return TRUE;
 }
 
+/* State shared by the copy and conversion functions */
+typedef struct {
+    const GstVaapiImageCopyFuncs *funcs;
+    void      (*copy_row)(guint8 *dst, const guint8 *src, guint n);
+    guchar     *src_rows[2];    /* cached copies of uncached source rows */
+    gpointer    src_rows_data;
+} CopyContext;
+
+static void
+copy_row(guint8 *dst, const guint8 *src, guint n)
+{
+    memcpy(dst, src, n);
+}
+
+/* Returns the specified source row, or a cached copy of it if the
+   source image is uncached, for the conversion kernels to read */
+static inline const guchar *
+read_row(CopyContext *ctx, guint index, const guchar *src, guint len)
+{
+    if (!ctx->src_rows_data)
+        return src;
+
+    ctx->funcs->copy_uncached(ctx->src_rows[index], src, len);
+    return ctx->src_rows[index];
+}
+
 /* Copy N lines of an image */
 static inline void
 memcpy_pic(
@@ -999,137 +1072,370 @@ memcpy_pic(
     const guchar *src,
     guint         src_stride,
     guint         len,
-    guint         height
+    guint         height,
+    CopyContext  *ctx
 )
 {
     guint i;
 
     for (i = 0; i < height; i++)  {
-        memcpy(dst, src, len);
+        ctx->copy_row(dst, src, len);
         dst += dst_stride;
         src += src_stride;
     }
 }
 
+/* Returns a pointer to the byte at (x, y) of the specified plane */
+static inline guchar *
+get_pixels(GstVaapiImageRaw *image, guint plane, guint x, guint y)
+{
+    return image->pixels[plane] + y * image->stride[plane] + x;
+}
+
+/* Returns the U and V plane indices of YV12 and I420 images */
+static inline void
+get_uv_planes(GstVaapiImageRaw *image, guint *u_plane, guint *v_plane)
+{
+    const gboolean is_yv12 = image->format == GST_VAAPI_IMAGE_YV12;
+
+    *u_plane = is_yv12 ? 2 : 1;
+    *v_plane = is_yv12 ? 1 : 2;
+}
+
+/* Returns the order of the R, G, B, A bytes of RGB images */
+static const gchar *
+get_rgba_order(GstVaapiImageFormat format)
+{
+    switch (format) {
+    case GST_VAAPI_IMAGE_ARGB: return "ARGB";
+    case GST_VAAPI_IMAGE_RGBA: return "RGBA";
+    case GST_VAAPI_IMAGE_ABGR: return "ABGR";
+    case GST_VAAPI_IMAGE_BGRA: return "BGRA";
+    default:                   break;
+    }
+    return NULL;
+}
+
+/* Copy the Y plane of planar YUV images */
+static void
+copy_plane_Y(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    memcpy_pic(
+        get_pixels(dst_image, 0, rect->x, rect->y), dst_image->stride[0],
+        get_pixels(src_image, 0, rect->x, rect->y), src_image->stride[0],
+        rect->width, rect->height, ctx
+    );
+}
+
 /* Copy NV12 images */
 static void
 copy_image_NV12(
     GstVaapiImageRaw        *dst_image,
     GstVaapiImageRaw        *src_image,
-    const GstVaapiRectangle *rect
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
 )
 {
     guchar *dst, *src;
     guint dst_stride, src_stride;
 
     /* Y plane */
-    dst_stride = dst_image->stride[0];
-    dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-    src_stride = src_image->stride[0];
-    src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-    memcpy_pic(dst, dst_stride, src, src_stride, rect->width, rect->height);
+    copy_plane_Y(dst_image, src_image, rect, ctx);
 
     /* UV plane */
     dst_stride = dst_image->stride[1];
     dst = dst_image->pixels[1] + (rect->y / 2) * dst_stride + (rect->x & -2);
     src_stride = src_image->stride[1];
     src = src_image->pixels[1] + (rect->y / 2) * src_stride + (rect->x & -2);
-    memcpy_pic(dst, dst_stride, src, src_stride, rect->width, rect->height / 2);
+    memcpy_pic(dst, dst_stride, src, src_stride, rect->width, rect->height / 2,
+               ctx);
 }
 
-/* Copy YV12 images */
+/* Copy YV12 and I420 images, possibly swapping the U/V planes */
 static void
 copy_image_YV12(
     GstVaapiImageRaw        *dst_image,
     GstVaapiImageRaw        *src_image,
-    const GstVaapiRectangle *rect
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
 )
 {
-    guchar *dst, *src;
-    guint dst_stride, src_stride;
+    guint dst_planes[2], src_planes[2];
     guint i, x, y, w, h;
 
     /* Y plane */
-    dst_stride = dst_image->stride[0];
-    dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-    src_stride = src_image->stride[0];
-    src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-    memcpy_pic(dst, dst_stride, src, src_stride, rect->width, rect->height);
+    copy_plane_Y(dst_image, src_image, rect, ctx);
 
     /* U/V planes */
+    get_uv_planes(dst_image, &dst_planes[0], &dst_planes[1]);
+    get_uv_planes(src_image, &src_planes[0], &src_planes[1]);
     x = rect->x / 2;
     y = rect->y / 2;
     w = rect->width / 2;
     h = rect->height / 2;
-    for (i = 1; i < dst_image->num_planes; i++) {
-        dst_stride = dst_image->stride[i];
-        dst = dst_image->pixels[i] + y * dst_stride + x;
-        src_stride = src_image->stride[i];
-        src = src_image->pixels[i] + y * src_stride + x;
-        memcpy_pic(dst, dst_stride, src, src_stride, w, h);
-    }
+    for (i = 0; i < 2; i++)
+        memcpy_pic(
+            get_pixels(dst_image, dst_planes[i], x, y),
+            dst_image->stride[dst_planes[i]],
+            get_pixels(src_image, src_planes[i], x, y),
+            src_image->stride[src_planes[i]],
+            w, h, ctx
+        );
 }
 
-/* Copy RGBA images */
+/* Copy packed images, e.g. RGBA or YUY2 */
 static void
-copy_image_RGBA(
+copy_image_packed(
     GstVaapiImageRaw        *dst_image,
     GstVaapiImageRaw        *src_image,
-    const GstVaapiRectangle *rect
+    const GstVaapiRectangle *rect,
+    guint                    bpp,
+    CopyContext             *ctx
 )
 {
-    guchar *dst, *src;
-    guint dst_stride, src_stride;
+    memcpy_pic(
+        get_pixels(dst_image, 0, bpp * rect->x, rect->y), dst_image->stride[0],
+        get_pixels(src_image, 0, bpp * rect->x, rect->y), src_image->stride[0],
+        bpp * rect->width, rect->height, ctx
+    );
+}
+
+/* Convert NV12 images to YV12 or I420 */
+static void
+convert_image_NV12_to_YV12(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    guint u_plane, v_plane, x, y, w, h, i;
 
-    dst_stride = dst_image->stride[0];
-    dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-    src_stride = src_image->stride[0];
-    src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-    memcpy_pic(dst, dst_stride, src, src_stride, 4 * rect->width, rect->height);
+    copy_plane_Y(dst_image, src_image, rect, ctx);
+
+    get_uv_planes(dst_image, &u_plane, &v_plane);
+    x = rect->x / 2;
+    y = rect->y / 2;
+    w = rect->width / 2;
+    h = rect->height / 2;
+    for (i = 0; i < h; i++)
+        ctx->funcs->deinterleave_uv(
+            get_pixels(dst_image, u_plane, x, y + i),
+            get_pixels(dst_image, v_plane, x, y + i),
+            read_row(ctx, 0, get_pixels(src_image, 1, 2 * x, y + i), 2 * w),
+            w
+        );
 }
 
-static gboolean
-copy_image(
+/* Convert YV12 or I420 images to NV12 */
+static void
+convert_image_YV12_to_NV12(
     GstVaapiImageRaw        *dst_image,
     GstVaapiImageRaw        *src_image,
-    const GstVaapiRectangle *rect
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
 )
 {
-    GstVaapiRectangle default_rect;
+    guint u_plane, v_plane, x, y, w, h, i;
 
-    if (dst_image->format != src_image->format ||
-        dst_image->width  != src_image->width  ||
-        dst_image->height != src_image->height)
-        return FALSE;
+    copy_plane_Y(dst_image, src_image, rect, ctx);
 
-    if (rect) {
-        if (rect->x >= src_image->width ||
-            rect->x + src_image->width > src_image->width ||
-            rect->y >= src_image->height ||
-            rect->y + src_image->height > src_image->height)
+    get_uv_planes(src_image, &u_plane, &v_plane);
+    x = rect->x / 2;
+    y = rect->y / 2;
+    w = rect->width / 2;
+    h = rect->height / 2;
+    for (i = 0; i < h; i++)
+        ctx->funcs->interleave_uv(
+            get_pixels(dst_image, 1, 2 * x, y + i),
+            read_row(ctx, 0, get_pixels(src_image, u_plane, x, y + i), w),
+            read_row(ctx, 1, get_pixels(src_image, v_plane, x, y + i), w),
+            w
+        );
+}
+
+/* Convert YUY2 or UYVY images to NV12, YV12 or I420 */
+static gboolean
+convert_image_YUY2_to_420(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    const GstVaapiImageCopyFuncs * const funcs = ctx->funcs;
+    const gboolean is_uyvy = src_image->format == GST_VAAPI_IMAGE_UYVY;
+    const gboolean is_nv12 = dst_image->format == GST_VAAPI_IMAGE_NV12;
+    guint u_plane = 0, v_plane = 0, x, y, w, h, i;
+    guchar *u_row, *v_row, *uv_row;
+    const guchar *src0, *src1;
+    guchar *y0, *y1;
+
+    x = rect->x & -2;
+    w = rect->width / 2;
+    h = rect->height;
+
+    if (is_nv12) {
+        u_row = g_malloc(2 * w);
+        if (!u_row)
             return FALSE;
+        v_row = u_row + w;
     }
     else {
-        default_rect.x      = 0;
-        default_rect.y      = 0;
-        default_rect.width  = src_image->width;
-        default_rect.height = src_image->height;
-        rect                = &default_rect;
+        get_uv_planes(dst_image, &u_plane, &v_plane);
+        u_row = v_row = NULL;
+    }
+
+    /* An odd last row is converted with itself for chroma */
+    for (i = 0; i < h; i += 2) {
+        y    = rect->y + i;
+        y0   = get_pixels(dst_image, 0, x, y);
+        y1   = i + 1 < h ? get_pixels(dst_image, 0, x, y + 1) : y0;
+        src0 = read_row(ctx, 0, get_pixels(src_image, 0, 2 * x, y), 4 * w);
+        src1 = i + 1 < h ?
+            read_row(ctx, 1, get_pixels(src_image, 0, 2 * x, y + 1), 4 * w) :
+            src0;
+
+        if (is_nv12) {
+            funcs->packed422_to_planar420(y0, y1, u_row, v_row,
+                src0, src1, w, is_uyvy);
+            uv_row = get_pixels(dst_image, 1, x, y / 2);
+            funcs->interleave_uv(uv_row, u_row, v_row, w);
+        }
+        else
+            funcs->packed422_to_planar420(y0, y1,
+                get_pixels(dst_image, u_plane, x / 2, y / 2),
+                get_pixels(dst_image, v_plane, x / 2, y / 2),
+                src0, src1, w, is_uyvy);
+    }
+    g_free(u_row);
+    return TRUE;
+}
+
+/* Convert between RGB images with different byte orders */
+static void
+convert_image_RGBA(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    const gchar * const dst_order = get_rgba_order(dst_image->format);
+    const gchar * const src_order = get_rgba_order(src_image->format);
+    guint8 map[4];
+    guint i;
+
+    for (i = 0; i < 4; i++)
+        map[i] = strchr(src_order, dst_order[i]) - src_order;
+
+    for (i = 0; i < rect->height; i++)
+        ctx->funcs->swizzle_rgba(
+            get_pixels(dst_image, 0, 4 * rect->x, rect->y + i),
+            read_row(ctx, 0,
+                get_pixels(src_image, 0, 4 * rect->x, rect->y + i),
+                4 * rect->width),
+            rect->width, map
+        );
+}
+
+static gboolean
+convert_image(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    switch (src_image->format) {
+    case GST_VAAPI_IMAGE_NV12:
+        switch (dst_image->format) {
+        case GST_VAAPI_IMAGE_YV12:
+        case GST_VAAPI_IMAGE_I420:
+            convert_image_NV12_to_YV12(dst_image, src_image, rect, ctx);
+            return TRUE;
+        default:
+            break;
+        }
+        break;
+    case GST_VAAPI_IMAGE_YV12:
+    case GST_VAAPI_IMAGE_I420:
+        switch (dst_image->format) {
+        case GST_VAAPI_IMAGE_NV12:
+            convert_image_YV12_to_NV12(dst_image, src_image, rect, ctx);
+            return TRUE;
+        case GST_VAAPI_IMAGE_YV12:
+        case GST_VAAPI_IMAGE_I420:
+            copy_image_YV12(dst_image, src_image, rect, ctx);
+            return TRUE;
+        default:
+            break;
+        }
+        break;
+    case GST_VAAPI_IMAGE_YUY2:
+    case GST_VAAPI_IMAGE_UYVY:
+        switch (dst_image->format) {
+        case GST_VAAPI_IMAGE_NV12:
+        case GST_VAAPI_IMAGE_YV12:
+        case GST_VAAPI_IMAGE_I420:
+            return convert_image_YUY2_to_420(dst_image, src_image, rect, ctx);
+        default:
+            break;
+        }
+        break;
+    case GST_VAAPI_IMAGE_ARGB:
+    case GST_VAAPI_IMAGE_RGBA:
+    case GST_VAAPI_IMAGE_ABGR:
+    case GST_VAAPI_IMAGE_BGRA:
+        if (get_rgba_order(dst_image->format)) {
+            convert_image_RGBA(dst_image, src_image, rect, ctx);
+            return TRUE;
+        }
+        break;
+    default:
+        break;
     }
 
+    GST_ERROR("unsupported conversion from %" GST_FOURCC_FORMAT
+              " to %" GST_FOURCC_FORMAT,
+              GST_FOURCC_ARGS(src_image->format),
+              GST_FOURCC_ARGS(dst_image->format));
+    return FALSE;
+}
+
+static gboolean
+do_copy_image(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    CopyContext             *ctx
+)
+{
+    if (dst_image->format != src_image->format)
+        return convert_image(dst_image, src_image, rect, ctx);
+
     switch (dst_image->format) {
     case GST_VAAPI_IMAGE_NV12:
-        copy_image_NV12(dst_image, src_image, rect);
+        copy_image_NV12(dst_image, src_image, rect, ctx);
         break;
     case GST_VAAPI_IMAGE_YV12:
     case GST_VAAPI_IMAGE_I420:
-        copy_image_YV12(dst_image, src_image, rect);
+        copy_image_YV12(dst_image, src_image, rect, ctx);
+        break;
+    case GST_VAAPI_IMAGE_YUY2:
+    case GST_VAAPI_IMAGE_UYVY:
+        copy_image_packed(dst_image, src_image, rect, 2, ctx);
         break;
     case GST_VAAPI_IMAGE_ARGB:
     case GST_VAAPI_IMAGE_RGBA:
     case GST_VAAPI_IMAGE_ABGR:
     case GST_VAAPI_IMAGE_BGRA:
-        copy_image_RGBA(dst_image, src_image, rect);
+        copy_image_packed(dst_image, src_image, rect, 4, ctx);
         break;
     default:
         GST_ERROR("unsupported image format for copy");
@@ -1138,6 +1444,304 @@ copy_image(
     return TRUE;
 }
 
+/* Copies @rect from @src_image to @dst_image, on the calling thread */
+static gboolean
+copy_rect(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    gboolean                 src_is_uncached
+)
+{
+    CopyContext ctx;
+    gsize row_size;
+    guint i;
+    gboolean success;
+
+    ctx.funcs         = gst_vaapi_image_copy_get_funcs();
+    ctx.copy_row      = copy_row;
+    ctx.src_rows[0]   = NULL;
+    ctx.src_rows[1]   = NULL;
+    ctx.src_rows_data = NULL;
+
+    if (src_is_uncached) {
+        ctx.copy_row = ctx.funcs->copy_uncached;
+
+        /* Conversion kernels read from two cache-aligned source rows */
+        if (dst_image->format != src_image->format) {
+            row_size = 0;
+            for (i = 0; i < src_image->num_planes; i++)
+                row_size = MAX(row_size, src_image->stride[i]);
+            row_size = GST_ROUND_UP_64(row_size);
+
+            ctx.src_rows_data = g_malloc(2 * row_size + 63);
+            if (!ctx.src_rows_data)
+                return FALSE;
+            ctx.src_rows[0] = (guchar *)
+                GST_ROUND_UP_64((gsize)ctx.src_rows_data);
+            ctx.src_rows[1] = ctx.src_rows[0] + row_size;
+        }
+    }
+
+    success = do_copy_image(dst_image, src_image, rect, &ctx);
+    g_free(ctx.src_rows_data);
+    return success;
+}
+
+/*
+ * Row-parallel copies
+ *
+ * A single core cannot saturate the memory bandwidth, nor hide the
+ * latency of uncached reads, so large copies can be split into bands
+ * of rows, copied concurrently by a shared thread pool and the calling
+ * thread. This is opt-in, the pool is only created once parallel
+ * copies are enabled.
+ */
+
+/* Maximum number of threads per copy */
+#define MAX_COPY_THREADS        16
+
+/* Default number of threads per copy: parallel copies are disabled */
+#define DEFAULT_COPY_THREADS    1
+
+/* Default minimum size of a row-parallel copy, in pixels. For smaller
+   images, waking up the workers costs about as much as it saves */
+#define DEFAULT_COPY_THRESHOLD  (2560 * 1440)
+
+/* Minimum number of rows per band */
+#define MIN_COPY_BAND_HEIGHT    64
+
+static volatile gint g_copy_threads;    /* 0: not determined yet */
+static volatile gint g_copy_threshold = DEFAULT_COPY_THRESHOLD;
+
+typedef struct _CopyJob CopyJob;
+struct _CopyJob {
+    GMutex             *mutex;
+    GCond              *cond;
+    guint               num_pending;
+    gboolean            success;
+};
+
+typedef struct _CopyBand CopyBand;
+struct _CopyBand {
+    CopyJob            *job;
+    GstVaapiImageRaw   *dst_image;
+    GstVaapiImageRaw   *src_image;
+    GstVaapiRectangle   rect;
+    gboolean            src_is_uncached;
+};
+
+static guint
+get_default_copy_threads(void)
+{
+    const gchar * const env = g_getenv("GST_VAAPI_COPY_THREADS");
+
+    if (env && *env)
+        return CLAMP(strtol(env, NULL, 10), 1, MAX_COPY_THREADS);
+    return DEFAULT_COPY_THREADS;
+}
+
+static guint
+get_copy_threads(void)
+{
+    gint num_threads = g_atomic_int_get(&g_copy_threads);
+
+    if (num_threads <= 0) {
+        g_atomic_int_compare_and_exchange(&g_copy_threads, num_threads,
+            get_default_copy_threads());
+        num_threads = g_atomic_int_get(&g_copy_threads);
+    }
+    return MAX(num_threads, 1);
+}
+
+static void
+copy_band(gpointer data, gpointer user_data)
+{
+    CopyBand * const band = data;
+    CopyJob * const job = band->job;
+    gboolean success;
+
+    success = copy_rect(band->dst_image, band->src_image, &band->rect,
+        band->src_is_uncached);
+
+    g_mutex_lock(job->mutex);
+    if (!success)
+        job->success = FALSE;
+    if (--job->num_pending == 0)
+        g_cond_signal(job->cond);
+    g_mutex_unlock(job->mutex);
+}
+
+static gpointer
+create_copy_pool(gpointer data)
+{
+    /* Threads are shared with other pools and only created on demand */
+    return g_thread_pool_new(copy_band, NULL, MAX_COPY_THREADS - 1, FALSE,
+        NULL);
+}
+
+static GThreadPool *
+get_copy_pool(void)
+{
+    static GOnce once = G_ONCE_INIT;
+
+    return g_once(&once, create_copy_pool, NULL);
+}
+
+/* Splits @rect into @num_bands bands of rows, copied in parallel. The
+   bands have an even number of rows, so that chroma rows of 4:2:0
+   images are not split */
+static gboolean
+copy_image_parallel(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    gboolean                 src_is_uncached,
+    guint                    num_bands
+)
+{
+    GThreadPool * const pool = get_copy_pool();
+    CopyBand bands[MAX_COPY_THREADS];
+    CopyJob job;
+    guint i, y, band_height;
+    gboolean success;
+
+    if (!pool)
+        return copy_rect(dst_image, src_image, rect, src_is_uncached);
+
+    job.mutex       = g_mutex_new();
+    job.cond        = g_cond_new();
+    job.num_pending = num_bands - 1;
+    job.success     = TRUE;
+
+    band_height = (rect->height / num_bands) & -2;
+    y = rect->y;
+    for (i = 0; i < num_bands; i++) {
+        CopyBand * const band = &bands[i];
+
+        band->job             = &job;
+        band->dst_image       = dst_image;
+        band->src_image       = src_image;
+        band->src_is_uncached = src_is_uncached;
+        band->rect.x          = rect->x;
+        band->rect.y          = y;
+        band->rect.width      = rect->width;
+        band->rect.height     = i + 1 < num_bands ?
+            band_height : rect->y + rect->height - y;
+        y += band->rect.height;
+    }
+
+    /* The calling thread copies the first band */
+    for (i = 1; i < num_bands; i++)
+        g_thread_pool_push(pool, &bands[i], NULL);
+    success = copy_rect(dst_image, src_image, &bands[0].rect,
+        src_is_uncached);
+
+    g_mutex_lock(job.mutex);
+    while (job.num_pending > 0)
+        g_cond_wait(job.cond, job.mutex);
+    g_mutex_unlock(job.mutex);
+
+    g_mutex_free(job.mutex);
+    g_cond_free(job.cond);
+    return success && job.success;
+}
+
+/* Copies @rect from @src_image to @dst_image. Uncached sources, e.g.
+   mapped derived images, are read with the copy_uncached() kernel */
+static gboolean
+copy_image(
+    GstVaapiImageRaw        *dst_image,
+    GstVaapiImageRaw        *src_image,
+    const GstVaapiRectangle *rect,
+    gboolean                 src_is_uncached
+)
+{
+    GstVaapiRectangle default_rect;
+    guint num_bands;
+
+    if (dst_image->width  != src_image->width  ||
+        dst_image->height != src_image->height)
+        return FALSE;
+
+    if (rect) {
+        if (rect->x >= src_image->width ||
+            rect->x + rect->width > src_image->width ||
+            rect->y >= src_image->height ||
+            rect->y + rect->height > src_image->height)
+            return FALSE;
+    }
+    else {
+        default_rect.x      = 0;
+        default_rect.y      = 0;
+        default_rect.width  = src_image->width;
+        default_rect.height = src_image->height;
+        rect                = &default_rect;
+    }
+
+    num_bands = 1;
+    if ((guint64)rect->width * rect->height >=
+        (guint)g_atomic_int_get(&g_copy_threshold)) {
+        num_bands = MIN(get_copy_threads(),
+                        rect->height / MIN_COPY_BAND_HEIGHT);
+    }
+    if (num_bands > 1)
+        return copy_image_parallel(dst_image, src_image, rect,
+            src_is_uncached, num_bands);
+    return copy_rect(dst_image, src_image, rect, src_is_uncached);
+}
+
+/**
+ * gst_vaapi_image_set_copy_threads:
+ * @num_threads: the number of threads, or 0 for the default
+ *
+ * Sets the number of threads that copy large images, in the
+ * gst_vaapi_image_get_buffer() family of functions. Images are split
+ * into bands of rows, copied in parallel. A value of 1 disables
+ * parallel copies.
+ *
+ * The default is the value of the GST_VAAPI_COPY_THREADS environment
+ * variable if set, otherwise 1: parallel copies are disabled unless
+ * asked for. The setting applies to all images.
+ */
+void
+gst_vaapi_image_set_copy_threads(guint num_threads)
+{
+    g_atomic_int_set(&g_copy_threads, MIN(num_threads, MAX_COPY_THREADS));
+}
+
+/**
+ * gst_vaapi_image_get_copy_threads:
+ *
+ * Returns the number of threads that copy large images, as set by
+ * gst_vaapi_image_set_copy_threads().
+ *
+ * Return value: the number of copy threads
+ */
+guint
+gst_vaapi_image_get_copy_threads(void)
+{
+    return get_copy_threads();
+}
+
+/**
+ * gst_vaapi_image_set_copy_threshold:
+ * @num_pixels: the minimum size of a parallel copy, in pixels, or 0
+ *   for the default
+ *
+ * Sets the size from which copies are split across threads, see
+ * gst_vaapi_image_set_copy_threads(). Smaller copies are done on the
+ * calling thread, since waking up the workers would cost about as much
+ * as it saves. The default is 2560x1440 pixels, so that 1080p frames
+ * are copied on a single thread, and 4K frames in parallel.
+ */
+void
+gst_vaapi_image_set_copy_threshold(guint num_pixels)
+{
+    g_atomic_int_set(&g_copy_threshold,
+        num_pixels ? MIN(num_pixels, G_MAXINT) : DEFAULT_COPY_THRESHOLD);
+}
+
 /**
  * gst_vaapi_image_get_buffer:
  * @image: a #GstVaapiImage
@@ -1146,7 +1750,13 @@ copy_image(
  *   whole image
  *
  * Transfers pixels data contained in the @image into the #GstBuffer.
- * Both image structures shall have the same format.
+ * Both image structures shall have the same size. The @buffer format
+ * can differ from the @image format, if the conversion is supported:
+ * between NV12, YV12 and I420, from YUY2 or UYVY to 4:2:0 formats, or
+ * between RGB formats.
+ *
+ * If the @image is already mapped, it is left mapped, so that the copy
+ * does not need to wait for the display lock.
  *
  * Return value: %TRUE on success
  */
@@ -1159,7 +1769,7 @@ gst_vaapi_image_get_buffer(
 {
     GstVaapiImagePrivate *priv;
     GstVaapiImageRaw dst_image, src_image;
-    gboolean success;
+    gboolean success, was_mapped;
 
     g_return_val_if_fail(GST_VAAPI_IS_IMAGE(image), FALSE);
     g_return_val_if_fail(image->priv->is_constructed, FALSE);
@@ -1169,17 +1779,16 @@ gst_vaapi_image_get_buffer(
 
     if (!init_image_from_buffer(&dst_image, buffer))
         return FALSE;
-    if (dst_image.format != priv->format)
-        return FALSE;
     if (dst_image.width != priv->width || dst_image.height != priv->height)
         return FALSE;
 
+    was_mapped = _gst_vaapi_image_is_mapped(image);
     if (!_gst_vaapi_image_map(image, &src_image))
         return FALSE;
 
-    success = copy_image(&dst_image, &src_image, rect);
+    success = copy_image(&dst_image, &src_image, rect, priv->is_uncached);
 
-    if (!_gst_vaapi_image_unmap(image))
+    if (!was_mapped && !_gst_vaapi_image_unmap(image))
         return FALSE;
 
     return success;
@@ -1193,7 +1802,11 @@ gst_vaapi_image_get_buffer(
  *   whole image
  *
  * Transfers pixels data contained in the @image into the #GstVaapiImageRaw.
- * Both image structures shall have the same format.
+ * Both image structures shall have the same size. The formats can
+ * differ if the conversion is supported, as in
+ * gst_vaapi_image_get_buffer().
+ *
+ * If the @image is already mapped, it is left mapped.
  *
  * Return value: %TRUE on success
  */
@@ -1205,17 +1818,19 @@ gst_vaapi_image_get_raw(
 )
 {
     GstVaapiImageRaw src_image;
-    gboolean success;
+    gboolean success, was_mapped;
 
     g_return_val_if_fail(GST_VAAPI_IS_IMAGE(image), FALSE);
     g_return_val_if_fail(image->priv->is_constructed, FALSE);
 
+    was_mapped = _gst_vaapi_image_is_mapped(image);
     if (!_gst_vaapi_image_map(image, &src_image))
         return FALSE;
 
-    success = copy_image(dst_image, &src_image, rect);
+    success = copy_image(dst_image, &src_image, rect,
+        image->priv->is_uncached);
 
-    if (!_gst_vaapi_image_unmap(image))
+    if (!was_mapped && !_gst_vaapi_image_unmap(image))
         return FALSE;
 
     return success;
@@ -1229,7 +1844,12 @@ gst_vaapi_image_get_raw(
  *   whole image
  *
  * Transfers pixels data contained in the #GstBuffer into the
- * @image. Both image structures shall have the same format.
+ * @image. Both image structures shall have the same size. The @buffer
+ * format can differ from the @image format, if the conversion is
+ * supported: between NV12, YV12 and I420, from YUY2 or UYVY to 4:2:0
+ * formats, or between RGB formats.
+ *
+ * If the @image is already mapped, it is left mapped.
  *
  * Return value: %TRUE on success
  */
@@ -1242,7 +1862,7 @@ gst_vaapi_image_update_from_buffer(
 {
     GstVaapiImagePrivate *priv;
     GstVaapiImageRaw dst_image, src_image;
-    gboolean success;
+    gboolean success, was_mapped;
 
     g_return_val_if_fail(GST_VAAPI_IS_IMAGE(image), FALSE);
     g_return_val_if_fail(image->priv->is_constructed, FALSE);
@@ -1252,17 +1872,16 @@ gst_vaapi_image_update_from_buffer(
 
     if (!init_image_from_buffer(&src_image, buffer))
         return FALSE;
-    if (src_image.format != priv->format)
-        return FALSE;
     if (src_image.width != priv->width || src_image.height != priv->height)
         return FALSE;
 
+    was_mapped = _gst_vaapi_image_is_mapped(image);
     if (!_gst_vaapi_image_map(image, &dst_image))
         return FALSE;
 
-    success = copy_image(&dst_image, &src_image, rect);
+    success = copy_image(&dst_image, &src_image, rect, FALSE);
 
-    if (!_gst_vaapi_image_unmap(image))
+    if (!was_mapped && !_gst_vaapi_image_unmap(image))
         return FALSE;
 
     return success;
@@ -1277,7 +1896,11 @@ gst_vaapi_image_update_from_buffer(
  *   whole image
  *
  * Transfers pixels data contained in the #GstVaapiImageRaw into the
- * @image. Both image structures shall have the same format.
+ * @image. Both image structures shall have the same size. The formats
+ * can differ if the conversion is supported, as in
+ * gst_vaapi_image_update_from_buffer().
+ *
+ * If the @image is already mapped, it is left mapped.
  *
  * Return value: %TRUE on success
  */
@@ -1289,17 +1912,18 @@ gst_vaapi_image_update_from_raw(
 )
 {
     GstVaapiImageRaw dst_image;
-    gboolean success;
+    gboolean success, was_mapped;
 
     g_return_val_if_fail(GST_VAAPI_IS_IMAGE(image), FALSE);
     g_return_val_if_fail(image->priv->is_constructed, FALSE);
 
+    was_mapped = _gst_vaapi_image_is_mapped(image);
     if (!_gst_vaapi_image_map(image, &dst_image))
         return FALSE;
 
-    success = copy_image(&dst_image, src_image, rect);
+    success = copy_image(&dst_image, src_image, rect, FALSE);
 
-    if (!_gst_vaapi_image_unmap(image))
+    if (!was_mapped && !_gst_vaapi_image_unmap(image))
         return FALSE;
 
     return success;
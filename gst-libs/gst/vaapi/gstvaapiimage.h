@@ -155,6 +155,12 @@ gst_vaapi_image_get_size(GstVaapiImage *image, guint *pwidth, guint *pheight);
 gboolean
 gst_vaapi_image_is_linear(GstVaapiImage *image);
 
+gboolean
+gst_vaapi_image_is_uncached(GstVaapiImage *image);
+
+void
+gst_vaapi_image_set_uncached(GstVaapiImage *image, gboolean uncached);
+
 gboolean
 gst_vaapi_image_is_mapped(GstVaapiImage *image);
 
@@ -204,6 +210,15 @@ gst_vaapi_image_update_from_raw(
     GstVaapiRectangle *rect
 );
 
+void
+gst_vaapi_image_set_copy_threads(guint num_threads);
+
+guint
+gst_vaapi_image_get_copy_threads(void);
+
+void
+gst_vaapi_image_set_copy_threshold(guint num_pixels);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_IMAGE_H */
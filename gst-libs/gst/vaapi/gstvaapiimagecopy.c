@@ -0,0 +1,605 @@
+/*
+ *  gstvaapiimagecopy.c - Image copy and format conversion kernels
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapicpu.h"
+#include "gstvaapiimagecopy.h"
+
+#if GST_VAAPI_CPU_HAS_X86
+# include <immintrin.h>
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+# include <arm_neon.h>
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- Generic C implementation                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+interleave_uv_c(guint8 *uv, const guint8 *u, const guint8 *v, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        uv[2*i + 0] = u[i];
+        uv[2*i + 1] = v[i];
+    }
+}
+
+static void
+deinterleave_uv_c(guint8 *u, guint8 *v, const guint8 *uv, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        u[i] = uv[2*i + 0];
+        v[i] = uv[2*i + 1];
+    }
+}
+
+static void
+packed422_to_planar420_c(
+    guint8       *y0,
+    guint8       *y1,
+    guint8       *u,
+    guint8       *v,
+    const guint8 *src0,
+    const guint8 *src1,
+    guint         n,
+    gboolean      is_uyvy
+)
+{
+    const guint yo = is_uyvy ? 1 : 0;
+    const guint co = is_uyvy ? 0 : 1;
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        const guint8 * const s0 = src0 + 4*i;
+        const guint8 * const s1 = src1 + 4*i;
+
+        y0[2*i + 0] = s0[yo];
+        y0[2*i + 1] = s0[yo + 2];
+        y1[2*i + 0] = s1[yo];
+        y1[2*i + 1] = s1[yo + 2];
+        u[i] = (s0[co]     + s1[co]     + 1) >> 1;
+        v[i] = (s0[co + 2] + s1[co + 2] + 1) >> 1;
+    }
+}
+
+static void
+swizzle_rgba_c(guint8 *dst, const guint8 *src, guint n, const guint8 map[4])
+{
+    const guint m0 = map[0], m1 = map[1], m2 = map[2], m3 = map[3];
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        dst[0] = src[m0];
+        dst[1] = src[m1];
+        dst[2] = src[m2];
+        dst[3] = src[m3];
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void
+copy_uncached_c(guint8 *dst, const guint8 *src, guint n)
+{
+    memcpy(dst, src, n);
+}
+
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_c = {
+    "c",
+    interleave_uv_c,
+    deinterleave_uv_c,
+    packed422_to_planar420_c,
+    swizzle_rgba_c,
+    copy_uncached_c,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- x86 implementations                                               --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_X86
+
+#define SSE2    GST_VAAPI_CPU_TARGET("sse2")
+#define SSSE3   GST_VAAPI_CPU_TARGET("ssse3")
+#define SSE41   GST_VAAPI_CPU_TARGET("sse4.1")
+#define AVX2    GST_VAAPI_CPU_TARGET("avx2")
+
+static SSE2 void
+interleave_uv_sse2(guint8 *uv, const guint8 *u, const guint8 *v, guint n)
+{
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m128i mu = _mm_loadu_si128((const __m128i *)(u + i));
+        const __m128i mv = _mm_loadu_si128((const __m128i *)(v + i));
+        _mm_storeu_si128((__m128i *)(uv + 2*i),
+                         _mm_unpacklo_epi8(mu, mv));
+        _mm_storeu_si128((__m128i *)(uv + 2*i + 16),
+                         _mm_unpackhi_epi8(mu, mv));
+    }
+    interleave_uv_c(uv + 2*i, u + i, v + i, n - i);
+}
+
+static SSE2 void
+deinterleave_uv_sse2(guint8 *u, guint8 *v, const guint8 *uv, guint n)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(uv + 2*i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2*i + 16));
+        _mm_storeu_si128((__m128i *)(u + i), _mm_packus_epi16(
+            _mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *)(v + i), _mm_packus_epi16(
+            _mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    deinterleave_uv_c(u + i, v + i, uv + 2*i, n - i);
+}
+
+/* Splits 16 YUY2 or UYVY pixels into 16 luma and 16 chroma bytes */
+static SSE2 inline void
+split_packed422_sse2(__m128i *y, __m128i *c, const guint8 *src,
+    gboolean is_uyvy)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i a = _mm_loadu_si128((const __m128i *)src);
+    const __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+    const __m128i lo = _mm_packus_epi16(_mm_and_si128(a, mask),
+                                        _mm_and_si128(b, mask));
+    const __m128i hi = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                        _mm_srli_epi16(b, 8));
+
+    *y = is_uyvy ? hi : lo;
+    *c = is_uyvy ? lo : hi;
+}
+
+static SSE2 void
+packed422_to_planar420_sse2(
+    guint8       *y0,
+    guint8       *y1,
+    guint8       *u,
+    guint8       *v,
+    const guint8 *src0,
+    const guint8 *src1,
+    guint         n,
+    gboolean      is_uyvy
+)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ya, yb, ca, cb, c;
+    guint i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        split_packed422_sse2(&ya, &ca, src0 + 4*i, is_uyvy);
+        split_packed422_sse2(&yb, &cb, src1 + 4*i, is_uyvy);
+        _mm_storeu_si128((__m128i *)(y0 + 2*i), ya);
+        _mm_storeu_si128((__m128i *)(y1 + 2*i), yb);
+
+        c = _mm_avg_epu8(ca, cb);
+        _mm_storel_epi64((__m128i *)(u + i),
+            _mm_packus_epi16(_mm_and_si128(c, mask), zero));
+        _mm_storel_epi64((__m128i *)(v + i),
+            _mm_packus_epi16(_mm_srli_epi16(c, 8), zero));
+    }
+    packed422_to_planar420_c(y0 + 2*i, y1 + 2*i, u + i, v + i,
+        src0 + 4*i, src1 + 4*i, n - i, is_uyvy);
+}
+
+static SSSE3 void
+deinterleave_uv_ssse3(guint8 *u, guint8 *v, const guint8 *uv, guint n)
+{
+    const __m128i shuffle = _mm_setr_epi8(
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *)(uv + 2*i)), shuffle);
+        const __m128i b = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *)(uv + 2*i + 16)), shuffle);
+        _mm_storeu_si128((__m128i *)(u + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128((__m128i *)(v + i), _mm_unpackhi_epi64(a, b));
+    }
+    deinterleave_uv_c(u + i, v + i, uv + 2*i, n - i);
+}
+
+static SSSE3 void
+swizzle_rgba_ssse3(guint8 *dst, const guint8 *src, guint n,
+    const guint8 map[4])
+{
+    guint8 shuffle_bytes[16];
+    __m128i shuffle;
+    guint i, k;
+
+    for (i = 0; i < 16; i += 4)
+        for (k = 0; k < 4; k++)
+            shuffle_bytes[i + k] = i + map[k];
+    shuffle = _mm_loadu_si128((const __m128i *)shuffle_bytes);
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(src + 4*i));
+        _mm_storeu_si128((__m128i *)(dst + 4*i),
+                         _mm_shuffle_epi8(a, shuffle));
+    }
+    swizzle_rgba_c(dst + 4*i, src + 4*i, n - i, map);
+}
+
+static AVX2 void
+interleave_uv_avx2(guint8 *uv, const guint8 *u, const guint8 *v, guint n)
+{
+    guint i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        const __m256i mu = _mm256_loadu_si256((const __m256i *)(u + i));
+        const __m256i mv = _mm256_loadu_si256((const __m256i *)(v + i));
+        const __m256i lo = _mm256_unpacklo_epi8(mu, mv);
+        const __m256i hi = _mm256_unpackhi_epi8(mu, mv);
+        _mm256_storeu_si256((__m256i *)(uv + 2*i),
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(uv + 2*i + 32),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_uv_sse2(uv + 2*i, u + i, v + i, n - i);
+}
+
+static AVX2 void
+deinterleave_uv_avx2(guint8 *u, guint8 *v, const guint8 *uv, guint n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    guint i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(uv + 2*i));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(uv + 2*i + 32));
+        const __m256i mu = _mm256_packus_epi16(
+            _mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+        const __m256i mv = _mm256_packus_epi16(
+            _mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+
+        /* packus works within 128-bit lanes, restore the qword order */
+        _mm256_storeu_si256((__m256i *)(u + i),
+                            _mm256_permute4x64_epi64(mu, 0xd8));
+        _mm256_storeu_si256((__m256i *)(v + i),
+                            _mm256_permute4x64_epi64(mv, 0xd8));
+    }
+    deinterleave_uv_ssse3(u + i, v + i, uv + 2*i, n - i);
+}
+
+/* Splits 32 YUY2 or UYVY pixels into 32 luma and 32 chroma bytes */
+static AVX2 inline void
+split_packed422_avx2(__m256i *y, __m256i *c, const guint8 *src,
+    gboolean is_uyvy)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    const __m256i a = _mm256_loadu_si256((const __m256i *)src);
+    const __m256i b = _mm256_loadu_si256((const __m256i *)(src + 32));
+    const __m256i lo = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+        _mm256_and_si256(a, mask), _mm256_and_si256(b, mask)), 0xd8);
+    const __m256i hi = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+        _mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8)), 0xd8);
+
+    *y = is_uyvy ? hi : lo;
+    *c = is_uyvy ? lo : hi;
+}
+
+static AVX2 void
+packed422_to_planar420_avx2(
+    guint8       *y0,
+    guint8       *y1,
+    guint8       *u,
+    guint8       *v,
+    const guint8 *src0,
+    const guint8 *src1,
+    guint         n,
+    gboolean      is_uyvy
+)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i ya, yb, ca, cb, c, cu, cv;
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        split_packed422_avx2(&ya, &ca, src0 + 4*i, is_uyvy);
+        split_packed422_avx2(&yb, &cb, src1 + 4*i, is_uyvy);
+        _mm256_storeu_si256((__m256i *)(y0 + 2*i), ya);
+        _mm256_storeu_si256((__m256i *)(y1 + 2*i), yb);
+
+        c  = _mm256_avg_epu8(ca, cb);
+        cu = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+            _mm256_and_si256(c, mask), zero), 0xd8);
+        cv = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+            _mm256_srli_epi16(c, 8), zero), 0xd8);
+        _mm_storeu_si128((__m128i *)(u + i), _mm256_castsi256_si128(cu));
+        _mm_storeu_si128((__m128i *)(v + i), _mm256_castsi256_si128(cv));
+    }
+    packed422_to_planar420_sse2(y0 + 2*i, y1 + 2*i, u + i, v + i,
+        src0 + 4*i, src1 + 4*i, n - i, is_uyvy);
+}
+
+static AVX2 void
+swizzle_rgba_avx2(guint8 *dst, const guint8 *src, guint n,
+    const guint8 map[4])
+{
+    guint8 shuffle_bytes[32];
+    __m256i shuffle;
+    guint i, k;
+
+    /* vpshufb works within 128-bit lanes, which hold whole pixels */
+    for (i = 0; i < 32; i += 4)
+        for (k = 0; k < 4; k++)
+            shuffle_bytes[i + k] = (i % 16) + map[k];
+    shuffle = _mm256_loadu_si256((const __m256i *)shuffle_bytes);
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(src + 4*i));
+        _mm256_storeu_si256((__m256i *)(dst + 4*i),
+                            _mm256_shuffle_epi8(a, shuffle));
+    }
+    swizzle_rgba_ssse3(dst + 4*i, src + 4*i, n - i, map);
+}
+
+/* Uncached memory is read with streaming loads, which fetch whole
+   cache lines at once, into a bounce buffer that stays in L1 cache */
+#define UNCACHED_CHUNK_SIZE 4096
+
+static SSE41 void
+copy_uncached_sse41(guint8 *dst, const guint8 *src, guint n)
+{
+    __m128i bounce[UNCACHED_CHUNK_SIZE / 16] __attribute__((aligned(64)));
+    __m128i *s;
+    __m128i x0, x1, x2, x3;
+    guint i, m, head;
+
+    /* Streaming loads need 16-byte aligned addresses */
+    head = MIN((-(gsize)src) & 15, n);
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    n   -= head;
+
+    /* Make sure earlier writes to the mapping are visible */
+    _mm_mfence();
+
+    while (n >= 16) {
+        m = MIN(n, UNCACHED_CHUNK_SIZE) / 16;
+        s = (__m128i *)src;
+        for (i = 0; i + 4 <= m; i += 4) {
+            x0 = _mm_stream_load_si128(s + i + 0);
+            x1 = _mm_stream_load_si128(s + i + 1);
+            x2 = _mm_stream_load_si128(s + i + 2);
+            x3 = _mm_stream_load_si128(s + i + 3);
+            _mm_store_si128(&bounce[i + 0], x0);
+            _mm_store_si128(&bounce[i + 1], x1);
+            _mm_store_si128(&bounce[i + 2], x2);
+            _mm_store_si128(&bounce[i + 3], x3);
+        }
+        for (; i < m; i++)
+            _mm_store_si128(&bounce[i], _mm_stream_load_si128(s + i));
+
+        for (i = 0; i < m; i++)
+            _mm_storeu_si128((__m128i *)dst + i, _mm_load_si128(&bounce[i]));
+        dst += 16 * m;
+        src += 16 * m;
+        n   -= 16 * m;
+    }
+    memcpy(dst, src, n);
+}
+
+#undef AVX2
+#undef SSE41
+#undef SSSE3
+#undef SSE2
+
+/* SSE2 has no generic byte shuffle, RGBA swizzles use the C code */
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_sse2 = {
+    "sse2",
+    interleave_uv_sse2,
+    deinterleave_uv_sse2,
+    packed422_to_planar420_sse2,
+    swizzle_rgba_c,
+    copy_uncached_c,
+};
+
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_ssse3 = {
+    "ssse3",
+    interleave_uv_sse2,
+    deinterleave_uv_ssse3,
+    packed422_to_planar420_sse2,
+    swizzle_rgba_ssse3,
+    copy_uncached_c,
+};
+
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_sse41 = {
+    "sse4.1",
+    interleave_uv_sse2,
+    deinterleave_uv_ssse3,
+    packed422_to_planar420_sse2,
+    swizzle_rgba_ssse3,
+    copy_uncached_sse41,
+};
+
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_avx2 = {
+    "avx2",
+    interleave_uv_avx2,
+    deinterleave_uv_avx2,
+    packed422_to_planar420_avx2,
+    swizzle_rgba_avx2,
+    copy_uncached_sse41,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_X86 */
+
+/* ------------------------------------------------------------------------- */
+/* --- ARM implementation                                                --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_NEON
+
+static void
+interleave_uv_neon(guint8 *uv, const guint8 *u, const guint8 *v, guint n)
+{
+    uint8x16x2_t w;
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        w.val[0] = vld1q_u8(u + i);
+        w.val[1] = vld1q_u8(v + i);
+        vst2q_u8(uv + 2*i, w);
+    }
+    interleave_uv_c(uv + 2*i, u + i, v + i, n - i);
+}
+
+static void
+deinterleave_uv_neon(guint8 *u, guint8 *v, const guint8 *uv, guint n)
+{
+    uint8x16x2_t w;
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        w = vld2q_u8(uv + 2*i);
+        vst1q_u8(u + i, w.val[0]);
+        vst1q_u8(v + i, w.val[1]);
+    }
+    deinterleave_uv_c(u + i, v + i, uv + 2*i, n - i);
+}
+
+static void
+packed422_to_planar420_neon(
+    guint8       *y0,
+    guint8       *y1,
+    guint8       *u,
+    guint8       *v,
+    const guint8 *src0,
+    const guint8 *src1,
+    guint         n,
+    gboolean      is_uyvy
+)
+{
+    const guint yo = is_uyvy ? 1 : 0;
+    const guint co = is_uyvy ? 0 : 1;
+    uint8x16x4_t a, b;
+    uint8x16x2_t w;
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        a = vld4q_u8(src0 + 4*i);
+        b = vld4q_u8(src1 + 4*i);
+
+        w.val[0] = a.val[yo];
+        w.val[1] = a.val[yo + 2];
+        vst2q_u8(y0 + 2*i, w);
+        w.val[0] = b.val[yo];
+        w.val[1] = b.val[yo + 2];
+        vst2q_u8(y1 + 2*i, w);
+
+        vst1q_u8(u + i, vrhaddq_u8(a.val[co],     b.val[co]));
+        vst1q_u8(v + i, vrhaddq_u8(a.val[co + 2], b.val[co + 2]));
+    }
+    packed422_to_planar420_c(y0 + 2*i, y1 + 2*i, u + i, v + i,
+        src0 + 4*i, src1 + 4*i, n - i, is_uyvy);
+}
+
+static void
+swizzle_rgba_neon(guint8 *dst, const guint8 *src, guint n,
+    const guint8 map[4])
+{
+    uint8x16x4_t a, b;
+    guint i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        a = vld4q_u8(src + 4*i);
+        b.val[0] = a.val[map[0]];
+        b.val[1] = a.val[map[1]];
+        b.val[2] = a.val[map[2]];
+        b.val[3] = a.val[map[3]];
+        vst4q_u8(dst + 4*i, b);
+    }
+    swizzle_rgba_c(dst + 4*i, src + 4*i, n - i, map);
+}
+
+static const GstVaapiImageCopyFuncs g_image_copy_funcs_neon = {
+    "neon",
+    interleave_uv_neon,
+    deinterleave_uv_neon,
+    packed422_to_planar420_neon,
+    swizzle_rgba_neon,
+    copy_uncached_c,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_NEON */
+
+/* ------------------------------------------------------------------------- */
+/* --- Dispatch                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_image_copy_get_funcs_for_flags:
+ * @cpu_flags: a set of #GstVaapiCpuFlags
+ *
+ * Selects the fastest kernels that only use the SIMD extensions
+ * listed in @cpu_flags. This is mostly useful to compare the
+ * optimized kernels against the generic C code, i.e. with zero
+ * @cpu_flags.
+ *
+ * Return value: the #GstVaapiImageCopyFuncs for @cpu_flags
+ */
+const GstVaapiImageCopyFuncs *
+gst_vaapi_image_copy_get_funcs_for_flags(guint cpu_flags)
+{
+#if GST_VAAPI_CPU_HAS_X86
+    /* All AVX2 capable processors also implement SSE4.1 */
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_AVX2)
+        return &g_image_copy_funcs_avx2;
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSE4_1)
+        return &g_image_copy_funcs_sse41;
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSSE3)
+        return &g_image_copy_funcs_ssse3;
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSE2)
+        return &g_image_copy_funcs_sse2;
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_NEON)
+        return &g_image_copy_funcs_neon;
+#endif
+    return &g_image_copy_funcs_c;
+}
+
+/**
+ * gst_vaapi_image_copy_get_funcs:
+ *
+ * Selects the fastest kernels for this CPU.
+ *
+ * Return value: the #GstVaapiImageCopyFuncs to use
+ */
+const GstVaapiImageCopyFuncs *
+gst_vaapi_image_copy_get_funcs(void)
+{
+    return gst_vaapi_image_copy_get_funcs_for_flags(gst_vaapi_cpu_get_flags());
+}
@@ -0,0 +1,75 @@
+/*
+ *  gstvaapiimagecopy.h - Image copy and format conversion kernels
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_IMAGE_COPY_H
+#define GST_VAAPI_IMAGE_COPY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiImageCopyFuncs          GstVaapiImageCopyFuncs;
+
+/**
+ * GstVaapiImageCopyFuncs:
+ * @name: name of the implementation, e.g. "sse2"
+ * @interleave_uv: merges @n U and @n V samples into an UV row
+ * @deinterleave_uv: splits an UV row into @n U and @n V samples
+ * @packed422_to_planar420: converts @n pixel pairs from two YUY2 (or
+ *   UYVY, if @is_uyvy is set) rows into two Y rows and a single row
+ *   of U and V samples, the chroma being the rounded average of both
+ *   source rows
+ * @swizzle_rgba: reorders the bytes of @n 32-bit pixels, so that
+ *   dst[k] = src[@map[k]] for each byte k of a pixel
+ * @copy_uncached: copies @n bytes from uncached or write-combining
+ *   memory, e.g. a mapped VA image, to regular memory
+ *
+ * Row conversion kernels. All pointers may be unaligned, and source
+ * and destination rows shall not overlap. All implementations produce
+ * bit-exact results.
+ */
+struct _GstVaapiImageCopyFuncs {
+    const gchar *name;
+
+    void (*interleave_uv)(guint8 *uv, const guint8 *u, const guint8 *v,
+                          guint n);
+    void (*deinterleave_uv)(guint8 *u, guint8 *v, const guint8 *uv,
+                            guint n);
+    void (*packed422_to_planar420)(guint8 *y0, guint8 *y1,
+                                   guint8 *u, guint8 *v,
+                                   const guint8 *src0, const guint8 *src1,
+                                   guint n, gboolean is_uyvy);
+    void (*swizzle_rgba)(guint8 *dst, const guint8 *src, guint n,
+                         const guint8 map[4]);
+    void (*copy_uncached)(guint8 *dst, const guint8 *src, guint n);
+};
+
+G_GNUC_INTERNAL
+const GstVaapiImageCopyFuncs *
+gst_vaapi_image_copy_get_funcs(void);
+
+G_GNUC_INTERNAL
+const GstVaapiImageCopyFuncs *
+gst_vaapi_image_copy_get_funcs_for_flags(guint cpu_flags);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_IMAGE_COPY_H */
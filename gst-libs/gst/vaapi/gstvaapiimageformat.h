@@ -36,6 +36,10 @@ G_BEGIN_DECLS
  *   planar YUV 4:2:0, 12-bit, 3 planes for Y V U
  * @GST_VAAPI_IMAGE_I420:
  *   planar YUV 4:2:0, 12-bit, 3 planes for Y U V
+ * @GST_VAAPI_IMAGE_YUY2:
+ *   packed YUV 4:2:2, 16-bit, Y0 U Y1 V
+ * @GST_VAAPI_IMAGE_UYVY:
+ *   packed YUV 4:2:2, 16-bit, U Y0 V Y1
  * @GST_VAAPI_IMAGE_AYUV:
  *   packed YUV 4:4:4, 32-bit, A Y U V, native endian byte-order
  * @GST_VAAPI_IMAGE_ARGB:
@@ -53,6 +57,8 @@ typedef enum {
     GST_VAAPI_IMAGE_NV12 = GST_MAKE_FOURCC('N','V','1','2'),
     GST_VAAPI_IMAGE_YV12 = GST_MAKE_FOURCC('Y','V','1','2'),
     GST_VAAPI_IMAGE_I420 = GST_MAKE_FOURCC('I','4','2','0'),
+    GST_VAAPI_IMAGE_YUY2 = GST_MAKE_FOURCC('Y','U','Y','2'),
+    GST_VAAPI_IMAGE_UYVY = GST_MAKE_FOURCC('U','Y','V','Y'),
     GST_VAAPI_IMAGE_AYUV = GST_MAKE_FOURCC('A','Y','U','V'),
     GST_VAAPI_IMAGE_ARGB = GST_MAKE_FOURCC('A','R','G','B'),
     GST_VAAPI_IMAGE_RGBA = GST_MAKE_FOURCC('R','G','B','A'),
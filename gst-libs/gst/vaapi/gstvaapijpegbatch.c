@@ -0,0 +1,459 @@
+/*
+ *  gstvaapijpegbatch.c - Batch JPEG decoding
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapijpegbatch
+ * @short_description: Batch JPEG decoding
+ *
+ * Decodes a list of independent JPEG images, e.g. photos or
+ * thumbnails, of possibly different sizes. The images are grouped by
+ * size and chroma format so that each group is decoded into a single
+ * VA context, and a small set of contexts is reused from one call to
+ * the next. Several pictures are submitted to the hardware before the
+ * oldest one is waited for, so that the CPU side parsing of an image
+ * overlaps with the decoding of the previous ones.
+ *
+ * A #GstVaapiJpegBatch is not thread-safe: use one per thread.
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include <gst/codecparsers/gstjpegparser.h>
+#include "gstvaapijpegbatch.h"
+#include "gstvaapidecoder_jpeg.h"
+#include "gstvaapiprofile.h"
+#include "gstvaapisurface.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Number of contexts used when none is specified */
+#define DEFAULT_NUM_CONTEXTS    2
+
+/* Pictures submitted before the oldest one is synced. This is less
+   than the number of scratch surfaces a decoder context has, so that
+   decoding never waits for a surface to be released */
+#define MAX_PICTURES_IN_FLIGHT  4
+
+typedef struct _JpegBatchKey JpegBatchKey;
+struct _JpegBatchKey {
+    guint               width;
+    guint               height;
+    GstVaapiChromaType  chroma_type;    /* 0 for grayscale images */
+};
+
+typedef struct _JpegBatchImage JpegBatchImage;
+struct _JpegBatchImage {
+    guint               index;
+    JpegBatchKey        key;
+};
+
+typedef struct _JpegBatchInstance JpegBatchInstance;
+struct _JpegBatchInstance {
+    GstVaapiDecoder    *decoder;
+    JpegBatchKey        key;
+    guint64             last_used;
+};
+
+typedef struct _JpegBatchPicture JpegBatchPicture;
+struct _JpegBatchPicture {
+    guint               index;
+    GstVaapiSurfaceProxy *proxy;
+};
+
+struct _GstVaapiJpegBatch {
+    GstVaapiDisplay    *display;
+    JpegBatchInstance  *instances;
+    guint               num_instances;
+    guint64             use_count;
+    GQueue             *pictures;       /* JpegBatchPicture, oldest first */
+    GstVaapiJpegBatchFunc func;
+    gpointer            user_data;
+    guint               num_decoded;
+    guint               num_context_resets;
+    guint               num_groups;
+};
+
+static inline gboolean
+key_equal(const JpegBatchKey *a, const JpegBatchKey *b)
+{
+    return (a->width       == b->width  &&
+            a->height      == b->height &&
+            a->chroma_type == b->chroma_type);
+}
+
+/* Images with the same key end up next to each other, in their
+   original order */
+static gint
+compare_images(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const JpegBatchImage * const ia = a;
+    const JpegBatchImage * const ib = b;
+
+    if (ia->key.width != ib->key.width)
+        return ia->key.width < ib->key.width ? -1 : 1;
+    if (ia->key.height != ib->key.height)
+        return ia->key.height < ib->key.height ? -1 : 1;
+    if (ia->key.chroma_type != ib->key.chroma_type)
+        return ia->key.chroma_type < ib->key.chroma_type ? -1 : 1;
+    if (ia->index != ib->index)
+        return ia->index < ib->index ? -1 : 1;
+    return 0;
+}
+
+static GstVaapiChromaType
+get_chroma_type(const GstJpegFrameHdr *frame_hdr)
+{
+    const GstJpegFrameComponent * const c = frame_hdr->components;
+
+    if (frame_hdr->num_components != 3)
+        return 0;
+    if (c[0].vertical_factor == c[1].vertical_factor) {
+        if (c[0].horizontal_factor == c[1].horizontal_factor)
+            return GST_VAAPI_CHROMA_TYPE_YUV444;
+        if (c[0].horizontal_factor == 2 * c[1].horizontal_factor)
+            return GST_VAAPI_CHROMA_TYPE_YUV422;
+    }
+    return GST_VAAPI_CHROMA_TYPE_YUV420;
+}
+
+/* Reads the frame header of the image, without decoding anything */
+static gboolean
+get_image_key(GstBuffer *buffer, JpegBatchKey *key)
+{
+    const guint8 * const buf = GST_BUFFER_DATA(buffer);
+    const guint buf_size = GST_BUFFER_SIZE(buffer);
+    GstJpegMarkerSegment seg;
+    GstJpegFrameHdr frame_hdr;
+    guint ofs = 0;
+
+    while (gst_jpeg_parse(&seg, buf, buf_size, ofs)) {
+        if (seg.size < 0)
+            break;
+
+        switch (seg.marker) {
+        case GST_JPEG_MARKER_SOI:
+            ofs = seg.offset;
+            continue;
+        case GST_JPEG_MARKER_SOS:
+        case GST_JPEG_MARKER_EOI:
+            return FALSE;
+        case GST_JPEG_MARKER_DHT:
+        case GST_JPEG_MARKER_DAC:
+            break;
+        default:
+            if (seg.marker < GST_JPEG_MARKER_SOF_MIN ||
+                seg.marker > GST_JPEG_MARKER_SOF_MAX)
+                break;
+            memset(&frame_hdr, 0, sizeof(frame_hdr));
+            if (!gst_jpeg_parse_frame_hdr(&frame_hdr, buf, buf_size, seg.offset))
+                return FALSE;
+            key->width       = frame_hdr.width;
+            key->height      = frame_hdr.height;
+            key->chroma_type = get_chroma_type(&frame_hdr);
+            return TRUE;
+        }
+        ofs = seg.offset + seg.size;
+    }
+    return FALSE;
+}
+
+/* Waits for the oldest pictures until at most @max_pictures are left
+   in flight, and hands them over to the user */
+static void
+flush_pictures(GstVaapiJpegBatch *batch, guint max_pictures)
+{
+    JpegBatchPicture *picture;
+    GstVaapiSurface *surface;
+
+    while (g_queue_get_length(batch->pictures) > max_pictures) {
+        picture = g_queue_pop_head(batch->pictures);
+        surface = gst_vaapi_surface_proxy_get_surface(picture->proxy);
+        if (gst_vaapi_surface_sync(surface)) {
+            batch->num_decoded++;
+            if (batch->func)
+                batch->func(picture->index, picture->proxy, batch->user_data);
+        }
+        else
+            GST_WARNING("failed to decode image %u", picture->index);
+        g_object_unref(picture->proxy);
+        g_slice_free(JpegBatchPicture, picture);
+    }
+}
+
+static GstVaapiDecoder *
+create_decoder(GstVaapiJpegBatch *batch, const JpegBatchKey *key)
+{
+    GstVaapiDecoder *decoder;
+    GstCaps *caps;
+
+    caps = gst_vaapi_profile_get_caps(GST_VAAPI_PROFILE_JPEG_BASELINE);
+    if (!caps)
+        return NULL;
+
+    gst_caps_set_simple(
+        caps,
+        "width",  G_TYPE_INT, key->width,
+        "height", G_TYPE_INT, key->height,
+        NULL
+    );
+    decoder = gst_vaapi_decoder_jpeg_new(batch->display, caps);
+    gst_caps_unref(caps);
+    return decoder;
+}
+
+/* Returns the instance whose context matches @key, or reassigns the
+   least recently used one. Its decoder resets the context to the new
+   size with the first image it decodes */
+static JpegBatchInstance *
+get_instance(GstVaapiJpegBatch *batch, const JpegBatchKey *key)
+{
+    JpegBatchInstance *instance = NULL;
+    guint i;
+
+    for (i = 0; i < batch->num_instances; i++) {
+        if (batch->instances[i].decoder &&
+            key_equal(&batch->instances[i].key, key)) {
+            instance = &batch->instances[i];
+            goto done;
+        }
+    }
+
+    for (i = 0; i < batch->num_instances; i++) {
+        JpegBatchInstance * const inst = &batch->instances[i];
+        if (!inst->decoder) {
+            instance = inst;
+            break;
+        }
+        if (!instance || inst->last_used < instance->last_used)
+            instance = inst;
+    }
+
+    if (instance->decoder) {
+        /* The surfaces of the pictures in flight go away with the
+           context, all of them are synced first */
+        flush_pictures(batch, 0);
+        batch->num_context_resets++;
+    }
+    else {
+        instance->decoder = create_decoder(batch, key);
+        if (!instance->decoder)
+            return NULL;
+    }
+    instance->key = *key;
+
+done:
+    instance->last_used = ++batch->use_count;
+    return instance;
+}
+
+static void
+decode_image(
+    GstVaapiJpegBatch *batch,
+    JpegBatchInstance *instance,
+    guint              index,
+    GstBuffer         *buffer
+)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    JpegBatchPicture *picture;
+
+    if (!gst_vaapi_decoder_put_buffer(instance->decoder, buffer))
+        return;
+
+    proxy = gst_vaapi_decoder_get_surface(instance->decoder, &status);
+    if (!proxy && status == GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE) {
+        flush_pictures(batch, 0);
+        proxy = gst_vaapi_decoder_get_surface(instance->decoder, &status);
+    }
+    if (!proxy) {
+        GST_WARNING("failed to decode image %u (status %d)", index, status);
+        return;
+    }
+
+    picture        = g_slice_new(JpegBatchPicture);
+    picture->index = index;
+    picture->proxy = proxy;
+    g_queue_push_tail(batch->pictures, picture);
+    flush_pictures(batch, MAX_PICTURES_IN_FLIGHT);
+}
+
+/**
+ * gst_vaapi_jpeg_batch_new:
+ * @display: a #GstVaapiDisplay
+ * @num_contexts: the maximum number of VA contexts to keep, or 0 for
+ *   the default
+ *
+ * Creates a batch decoder for JPEG images. Up to @num_contexts image
+ * sizes are decoded without creating new VA surfaces, which is useful
+ * when the same few sizes occur over and over, e.g. camera photos and
+ * their thumbnails.
+ *
+ * Return value: the newly allocated #GstVaapiJpegBatch object
+ */
+GstVaapiJpegBatch *
+gst_vaapi_jpeg_batch_new(GstVaapiDisplay *display, guint num_contexts)
+{
+    GstVaapiJpegBatch *batch;
+
+    g_return_val_if_fail(GST_VAAPI_IS_DISPLAY(display), NULL);
+
+    if (!num_contexts)
+        num_contexts = DEFAULT_NUM_CONTEXTS;
+
+    batch = g_slice_new0(GstVaapiJpegBatch);
+    batch->display       = g_object_ref(display);
+    batch->instances     = g_new0(JpegBatchInstance, num_contexts);
+    batch->num_instances = num_contexts;
+    batch->pictures      = g_queue_new();
+    return batch;
+}
+
+/**
+ * gst_vaapi_jpeg_batch_free:
+ * @batch: a #GstVaapiJpegBatch
+ *
+ * Releases @batch and the VA contexts it holds.
+ */
+void
+gst_vaapi_jpeg_batch_free(GstVaapiJpegBatch *batch)
+{
+    guint i;
+
+    if (!batch)
+        return;
+
+    batch->func = NULL;
+    flush_pictures(batch, 0);
+    g_queue_free(batch->pictures);
+
+    for (i = 0; i < batch->num_instances; i++) {
+        if (batch->instances[i].decoder)
+            g_object_unref(batch->instances[i].decoder);
+    }
+    g_free(batch->instances);
+    g_object_unref(batch->display);
+    g_slice_free(GstVaapiJpegBatch, batch);
+}
+
+/**
+ * gst_vaapi_jpeg_batch_decode:
+ * @batch: a #GstVaapiJpegBatch
+ * @buffers: the JPEG images, one complete image per buffer
+ * @num_buffers: the number of buffers in @buffers
+ * @func: the function called for each decoded image, or %NULL
+ * @user_data: the data passed to @func
+ *
+ * Decodes @num_buffers JPEG images. The images of the same size and
+ * chroma format are decoded one after the other, so @func is not
+ * called in the order of @buffers: use the index it is passed to tell
+ * the images apart. All the images are decoded when this function
+ * returns.
+ *
+ * Return value: the number of images successfully decoded
+ */
+guint
+gst_vaapi_jpeg_batch_decode(
+    GstVaapiJpegBatch    *batch,
+    GstBuffer           **buffers,
+    guint                 num_buffers,
+    GstVaapiJpegBatchFunc func,
+    gpointer              user_data
+)
+{
+    JpegBatchInstance *instance;
+    JpegBatchImage *images;
+    guint i, j, k, num_images = 0;
+
+    g_return_val_if_fail(batch != NULL, 0);
+    g_return_val_if_fail(buffers != NULL || num_buffers == 0, 0);
+
+    images = g_new(JpegBatchImage, num_buffers);
+    for (i = 0; i < num_buffers; i++) {
+        if (!get_image_key(buffers[i], &images[num_images].key)) {
+            GST_WARNING("image %u: no frame header found", i);
+            continue;
+        }
+        images[num_images++].index = i;
+    }
+    g_qsort_with_data(images, num_images, sizeof(*images),
+                      compare_images, NULL);
+
+    batch->func        = func;
+    batch->user_data   = user_data;
+    batch->num_decoded = 0;
+
+    for (i = 0; i < num_images; i = j) {
+        for (j = i + 1; j < num_images; j++) {
+            if (!key_equal(&images[i].key, &images[j].key))
+                break;
+        }
+        batch->num_groups++;
+
+        GST_DEBUG("decode %u images of size %ux%u, chroma type 0x%x",
+                  j - i, images[i].key.width, images[i].key.height,
+                  images[i].key.chroma_type);
+
+        instance = get_instance(batch, &images[i].key);
+        if (!instance) {
+            GST_WARNING("failed to create decoder for size %ux%u",
+                        images[i].key.width, images[i].key.height);
+            continue;
+        }
+        for (k = i; k < j; k++)
+            decode_image(batch, instance, images[k].index,
+                         buffers[images[k].index]);
+    }
+    flush_pictures(batch, 0);
+    g_free(images);
+
+    batch->func      = NULL;
+    batch->user_data = NULL;
+    return batch->num_decoded;
+}
+
+/**
+ * gst_vaapi_jpeg_batch_get_stats:
+ * @batch: a #GstVaapiJpegBatch
+ * @pnum_context_resets: return location for the number of times a
+ *   context was reset to another image size, or %NULL
+ * @pnum_groups: return location for the number of groups of images
+ *   of the same size decoded so far, or %NULL
+ *
+ * Retrieves how well the contexts of @batch are reused. Many resets
+ * compared to the number of groups mean that more contexts would pay
+ * off.
+ */
+void
+gst_vaapi_jpeg_batch_get_stats(
+    GstVaapiJpegBatch *batch,
+    guint             *pnum_context_resets,
+    guint             *pnum_groups
+)
+{
+    g_return_if_fail(batch != NULL);
+
+    if (pnum_context_resets)
+        *pnum_context_resets = batch->num_context_resets;
+    if (pnum_groups)
+        *pnum_groups = batch->num_groups;
+}
@@ -0,0 +1,80 @@
+/*
+ *  gstvaapijpegbatch.h - Batch JPEG decoding
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_JPEG_BATCH_H
+#define GST_VAAPI_JPEG_BATCH_H
+
+#include <gst/gstbuffer.h>
+#include <gst/vaapi/gstvaapidisplay.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiJpegBatch               GstVaapiJpegBatch;
+
+/**
+ * GstVaapiJpegBatch:
+ *
+ * An opaque structure that holds the JPEG decoders of a batch.
+ */
+
+/**
+ * GstVaapiJpegBatchFunc:
+ * @index: the index of the image in the array passed to
+ *   gst_vaapi_jpeg_batch_decode()
+ * @proxy: the decoded surface
+ * @user_data: the data passed to gst_vaapi_jpeg_batch_decode()
+ *
+ * Called for each decoded image, once its surface is ready. The
+ * surface returns to the decoder pool when @proxy is released, so
+ * holding on to it for longer than the call stalls decoding.
+ */
+typedef void (*GstVaapiJpegBatchFunc)(
+    guint                 index,
+    GstVaapiSurfaceProxy *proxy,
+    gpointer              user_data
+);
+
+GstVaapiJpegBatch *
+gst_vaapi_jpeg_batch_new(GstVaapiDisplay *display, guint num_contexts);
+
+void
+gst_vaapi_jpeg_batch_free(GstVaapiJpegBatch *batch);
+
+guint
+gst_vaapi_jpeg_batch_decode(
+    GstVaapiJpegBatch    *batch,
+    GstBuffer           **buffers,
+    guint                 num_buffers,
+    GstVaapiJpegBatchFunc func,
+    gpointer              user_data
+);
+
+void
+gst_vaapi_jpeg_batch_get_stats(
+    GstVaapiJpegBatch *batch,
+    guint             *pnum_context_resets,
+    guint             *pnum_groups
+);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_JPEG_BATCH_H */
@@ -0,0 +1,217 @@
+/*
+ *  gstvaapijpegmarker.c - JPEG marker search
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include "gstvaapicpu.h"
+#include "gstvaapijpegmarker.h"
+
+#if GST_VAAPI_CPU_HAS_X86
+# include <immintrin.h>
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+# include <arm_neon.h>
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- Generic C implementation                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/* 0xff bytes are rare in entropy coded data, memchr() skips over the
+   rest of it faster than a byte loop */
+static guint
+find_c(const guint8 *buf, guint n)
+{
+    const guint8 * const end = buf + n;
+    const guint8 *p = buf;
+
+    while (p + 1 < end) {
+        p = memchr(p, 0xff, end - 1 - p);
+        if (!p)
+            break;
+        if (GST_VAAPI_JPEG_IS_MARKER(p[1]))
+            return p - buf;
+        p++;
+    }
+    return n;
+}
+
+static const GstVaapiJpegMarkerFuncs g_jpeg_marker_funcs_c = {
+    "c",
+    find_c,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- x86 implementations                                               --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_X86
+
+#define SSE2    GST_VAAPI_CPU_TARGET("sse2")
+#define AVX2    GST_VAAPI_CPU_TARGET("avx2")
+
+/* The marker code is checked only for blocks that hold a 0xff byte.
+   Unsigned b >= 0xc0 is max(b, 0xc0) == b, and restart markers are the
+   codes with (b & 0xf8) == 0xd0 */
+static SSE2 guint
+find_sse2(const guint8 *buf, guint n)
+{
+    const __m128i ff   = _mm_set1_epi8(0xff);
+    const __m128i c0   = _mm_set1_epi8(0xc0);
+    const __m128i f8   = _mm_set1_epi8(0xf8);
+    const __m128i d0   = _mm_set1_epi8(0xd0);
+    __m128i a, b, is_ff, not_marker;
+    guint i, mask;
+
+    for (i = 0; i + 17 <= n; i += 16) {
+        a = _mm_loadu_si128((const __m128i *)(buf + i));
+        is_ff = _mm_cmpeq_epi8(a, ff);
+        if (!_mm_movemask_epi8(is_ff))
+            continue;
+
+        b = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+        not_marker = _mm_or_si128(_mm_cmpeq_epi8(b, ff),
+            _mm_cmpeq_epi8(_mm_and_si128(b, f8), d0));
+        mask = _mm_movemask_epi8(_mm_andnot_si128(not_marker, _mm_and_si128(
+            is_ff, _mm_cmpeq_epi8(_mm_max_epu8(b, c0), b))));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_c(buf + i, n - i);
+}
+
+static AVX2 guint
+find_avx2(const guint8 *buf, guint n)
+{
+    const __m256i ff   = _mm256_set1_epi8(0xff);
+    const __m256i c0   = _mm256_set1_epi8(0xc0);
+    const __m256i f8   = _mm256_set1_epi8(0xf8);
+    const __m256i d0   = _mm256_set1_epi8(0xd0);
+    __m256i a, b, is_ff, not_marker;
+    guint i, mask;
+
+    for (i = 0; i + 33 <= n; i += 32) {
+        a = _mm256_loadu_si256((const __m256i *)(buf + i));
+        is_ff = _mm256_cmpeq_epi8(a, ff);
+        if (!_mm256_movemask_epi8(is_ff))
+            continue;
+
+        b = _mm256_loadu_si256((const __m256i *)(buf + i + 1));
+        not_marker = _mm256_or_si256(_mm256_cmpeq_epi8(b, ff),
+            _mm256_cmpeq_epi8(_mm256_and_si256(b, f8), d0));
+        mask = (guint)_mm256_movemask_epi8(_mm256_andnot_si256(not_marker,
+            _mm256_and_si256(is_ff,
+                _mm256_cmpeq_epi8(_mm256_max_epu8(b, c0), b))));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_sse2(buf + i, n - i);
+}
+
+#undef AVX2
+#undef SSE2
+
+static const GstVaapiJpegMarkerFuncs g_jpeg_marker_funcs_sse2 = {
+    "sse2",
+    find_sse2,
+};
+
+static const GstVaapiJpegMarkerFuncs g_jpeg_marker_funcs_avx2 = {
+    "avx2",
+    find_avx2,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_X86 */
+
+/* ------------------------------------------------------------------------- */
+/* --- ARM implementation                                                --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_NEON
+
+/* NEON has no movemask, the C code checks the blocks that hold a 0xff
+   byte */
+static guint
+find_neon(const guint8 *buf, guint n)
+{
+    const uint8x16_t ff = vdupq_n_u8(0xff);
+    uint64x2_t m;
+    guint i, ofs;
+
+    for (i = 0; i + 17 <= n; i += 16) {
+        m = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(buf + i), ff));
+        if (!(vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)))
+            continue;
+        ofs = find_c(buf + i, 17);
+        if (ofs < 16)
+            return i + ofs;
+    }
+    return i + find_c(buf + i, n - i);
+}
+
+static const GstVaapiJpegMarkerFuncs g_jpeg_marker_funcs_neon = {
+    "neon",
+    find_neon,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_NEON */
+
+/* ------------------------------------------------------------------------- */
+/* --- Dispatch                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_jpeg_marker_get_funcs_for_flags:
+ * @cpu_flags: a set of #GstVaapiCpuFlags
+ *
+ * Selects the fastest kernels that only use the SIMD extensions
+ * listed in @cpu_flags.
+ *
+ * Return value: the #GstVaapiJpegMarkerFuncs for @cpu_flags
+ */
+const GstVaapiJpegMarkerFuncs *
+gst_vaapi_jpeg_marker_get_funcs_for_flags(guint cpu_flags)
+{
+#if GST_VAAPI_CPU_HAS_X86
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_AVX2)
+        return &g_jpeg_marker_funcs_avx2;
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSE2)
+        return &g_jpeg_marker_funcs_sse2;
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_NEON)
+        return &g_jpeg_marker_funcs_neon;
+#endif
+    return &g_jpeg_marker_funcs_c;
+}
+
+/**
+ * gst_vaapi_jpeg_marker_get_funcs:
+ *
+ * Selects the fastest kernels for this CPU.
+ *
+ * Return value: the #GstVaapiJpegMarkerFuncs to use
+ */
+const GstVaapiJpegMarkerFuncs *
+gst_vaapi_jpeg_marker_get_funcs(void)
+{
+    return gst_vaapi_jpeg_marker_get_funcs_for_flags(gst_vaapi_cpu_get_flags());
+}
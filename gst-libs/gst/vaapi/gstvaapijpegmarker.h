@@ -0,0 +1,68 @@
+/*
+ *  gstvaapijpegmarker.h - JPEG marker search
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_JPEG_MARKER_H
+#define GST_VAAPI_JPEG_MARKER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiJpegMarkerFuncs         GstVaapiJpegMarkerFuncs;
+
+/**
+ * GST_VAAPI_JPEG_IS_MARKER:
+ * @code: the byte following a 0xff byte
+ *
+ * Evaluates to %TRUE if 0xff @code is a marker that ends an entropy
+ * coded segment, i.e. neither a stuffed 0xff00 byte, a fill byte nor
+ * a restart marker.
+ */
+#define GST_VAAPI_JPEG_IS_MARKER(code) \
+    ((code) >= 0xc0 && (code) != 0xff && ((code) & 0xf8) != 0xd0)
+
+/**
+ * GstVaapiJpegMarkerFuncs:
+ * @name: name of the implementation, e.g. "sse2"
+ * @find: returns the offset of the first 0xff byte within the @n
+ *   bytes at @buf that is followed by a byte satisfying
+ *   GST_VAAPI_JPEG_IS_MARKER(), or @n if there is none
+ *
+ * JPEG marker search kernels. All implementations return the same
+ * results.
+ */
+struct _GstVaapiJpegMarkerFuncs {
+    const gchar *name;
+
+    guint (*find)(const guint8 *buf, guint n);
+};
+
+G_GNUC_INTERNAL
+const GstVaapiJpegMarkerFuncs *
+gst_vaapi_jpeg_marker_get_funcs(void);
+
+G_GNUC_INTERNAL
+const GstVaapiJpegMarkerFuncs *
+gst_vaapi_jpeg_marker_get_funcs_for_flags(guint cpu_flags);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_JPEG_MARKER_H */
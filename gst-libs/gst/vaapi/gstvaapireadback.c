@@ -0,0 +1,478 @@
+/*
+ *  gstvaapireadback.c - Pipelined surface readback
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapireadback
+ * @short_description: Pipelined surface readback
+ *
+ * Reads surfaces back to system memory in two stages. A fetch thread
+ * transfers each pushed surface to an image, with vaGetImage(), while
+ * the caller copies the previously fetched images out with
+ * gst_vaapi_readback_pop(). Up to depth surfaces are fetched ahead of
+ * the one being copied, so that the wait for the GPU and the transfer
+ * overlap with the CPU copy of older frames.
+ *
+ * Surfaces are popped in the order they were pushed. Each one carries
+ * user data, typically a copy of the timestamps of the frame, which is
+ * handed back by gst_vaapi_readback_pop(). The object that keeps the
+ * surface from being decoded to, typically the buffer holding it, is
+ * passed separately and released as soon as the surface was fetched,
+ * so that only the surfaces not fetched yet are held.
+ *
+ * The push and pop functions are meant to be called from a single
+ * thread, e.g. a streaming thread.
+ */
+
+#include "sysdeps.h"
+#include <gst/gstutils.h>
+#include "gstvaapireadback.h"
+#include "gstvaapiimage.h"
+#include "gstvaapitrace.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct _ReadbackJob ReadbackJob;
+struct _ReadbackJob {
+    GstVaapiSurface    *surface;
+    GstVaapiID          surface_id;
+    gpointer            surface_data;
+    GstVaapiImage      *image;
+    gpointer            user_data;
+    GstClockTime        push_time;
+    gboolean            success;
+};
+
+struct _GstVaapiReadback {
+    GstVaapiVideoPool  *images;
+    guint               depth;
+    GDestroyNotify      destroy_func;
+    GThread            *thread;
+    GMutex             *mutex;
+    GCond              *cond;
+    GQueue              input;          /* surfaces to fetch */
+    GQueue              output;         /* fetched surfaces */
+    gboolean            busy;           /* a surface is being fetched */
+    gboolean            stop;
+    GstVaapiReadbackStageStats stats[GST_VAAPI_READBACK_STAGE_COUNT];
+};
+
+/* Drops the surface of @job, once its pixels are in the image */
+static void
+readback_job_release_surface(GstVaapiReadback *readback, ReadbackJob *job)
+{
+    if (job->surface) {
+        g_object_unref(job->surface);
+        job->surface = NULL;
+    }
+    if (job->surface_data && readback->destroy_func)
+        readback->destroy_func(job->surface_data);
+    job->surface_data = NULL;
+}
+
+static void
+readback_job_free(GstVaapiReadback *readback, ReadbackJob *job)
+{
+    if (job->image) {
+        if (gst_vaapi_image_is_mapped(job->image))
+            gst_vaapi_image_unmap(job->image);
+        gst_vaapi_video_pool_put_object(readback->images, job->image);
+    }
+    readback_job_release_surface(readback, job);
+    if (job->user_data && readback->destroy_func)
+        readback->destroy_func(job->user_data);
+    g_slice_free(ReadbackJob, job);
+}
+
+/* Called with the readback mutex */
+static void
+stage_record_unlocked(
+    GstVaapiReadback     *readback,
+    GstVaapiReadbackStage stage,
+    GstClockTime          duration
+)
+{
+    GstVaapiReadbackStageStats * const stats = &readback->stats[stage];
+
+    stats->count++;
+    stats->total_time += duration;
+    if (stats->min_time > duration)
+        stats->min_time = duration;
+    if (stats->max_time < duration)
+        stats->max_time = duration;
+}
+
+static gpointer
+readback_thread(gpointer data)
+{
+    GstVaapiReadback * const readback = data;
+    ReadbackJob *job;
+    GstClockTime start_time, end_time;
+
+    g_mutex_lock(readback->mutex);
+    for (;;) {
+        while (g_queue_is_empty(&readback->input) && !readback->stop)
+            g_cond_wait(readback->cond, readback->mutex);
+        if (readback->stop)
+            break;
+
+        job = g_queue_pop_head(&readback->input);
+        readback->busy = TRUE;
+        start_time = gst_util_get_timestamp();
+        stage_record_unlocked(readback, GST_VAAPI_READBACK_STAGE_QUEUE,
+            start_time - job->push_time);
+        g_mutex_unlock(readback->mutex);
+
+        /* vaGetImage() waits for the surface to be ready. The image is
+           also mapped here, so that the copy in gst_vaapi_readback_pop()
+           does not wait for the display lock held by the next fetch */
+        GST_VAAPI_TRACE_BEGIN("readback.fetch", job->surface_id);
+        job->image = gst_vaapi_video_pool_get_object(readback->images);
+        job->success = job->image &&
+            gst_vaapi_surface_get_image(job->surface, job->image) &&
+            gst_vaapi_image_map(job->image);
+        GST_VAAPI_TRACE_END("readback.fetch", job->surface_id);
+        if (!job->success)
+            GST_WARNING("failed to fetch surface %" GST_VAAPI_ID_FORMAT,
+                GST_VAAPI_ID_ARGS(job->surface_id));
+        readback_job_release_surface(readback, job);
+        end_time = gst_util_get_timestamp();
+
+        g_mutex_lock(readback->mutex);
+        stage_record_unlocked(readback, GST_VAAPI_READBACK_STAGE_FETCH,
+            end_time - start_time);
+        g_queue_push_tail(&readback->output, job);
+        readback->busy = FALSE;
+        g_cond_broadcast(readback->cond);
+    }
+    g_mutex_unlock(readback->mutex);
+    return NULL;
+}
+
+/**
+ * gst_vaapi_readback_new:
+ * @images: the #GstVaapiImagePool the surfaces are fetched into
+ * @depth: the maximum number of surfaces fetched ahead of the one
+ *   being copied out
+ * @destroy_func: the function called on the surface data once the
+ *   surfaces are fetched, and on the user data of the surfaces that are
+ *   discarded, or %NULL
+ *
+ * Creates a readback pipeline and starts its fetch thread. The @images
+ * pool determines the format and size of the fetched images. It
+ * should not be limited to less than @depth + 1 images, or fetching
+ * stalls until the caller pops a surface.
+ *
+ * Up to @depth + 1 surfaces are held until they are fetched. When
+ * they come from a decoder, @depth should leave enough of its spare
+ * surfaces to decode into, e.g. no more than 3 for a #GstVaapiContext
+ * that allocates 4 surfaces beyond the reference frames.
+ *
+ * The @destroy_func may be called from the fetch thread.
+ *
+ * Return value: the newly allocated #GstVaapiReadback, or %NULL
+ */
+GstVaapiReadback *
+gst_vaapi_readback_new(
+    GstVaapiVideoPool *images,
+    guint              depth,
+    GDestroyNotify     destroy_func
+)
+{
+    GstVaapiReadback *readback;
+    guint i;
+
+    g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(images), NULL);
+    g_return_val_if_fail(depth > 0, NULL);
+
+    readback = g_slice_new0(GstVaapiReadback);
+    readback->images        = g_object_ref(images);
+    readback->depth         = depth;
+    readback->destroy_func  = destroy_func;
+    readback->mutex         = g_mutex_new();
+    readback->cond          = g_cond_new();
+    g_queue_init(&readback->input);
+    g_queue_init(&readback->output);
+    for (i = 0; i < G_N_ELEMENTS(readback->stats); i++)
+        readback->stats[i].min_time = G_MAXUINT64;
+
+#if GLIB_CHECK_VERSION(2,31,0)
+    readback->thread = g_thread_new("vaapireadback", readback_thread, readback);
+#else
+    readback->thread = g_thread_create(readback_thread, readback, TRUE, NULL);
+#endif
+    if (!readback->thread) {
+        GST_DEBUG("failed to create readback thread");
+        gst_vaapi_readback_free(readback);
+        return NULL;
+    }
+    return readback;
+}
+
+/**
+ * gst_vaapi_readback_free:
+ * @readback: a #GstVaapiReadback
+ *
+ * Stops the fetch thread, discards the pending surfaces and frees
+ * @readback.
+ */
+void
+gst_vaapi_readback_free(GstVaapiReadback *readback)
+{
+    if (!readback)
+        return;
+
+    if (readback->thread) {
+        gst_vaapi_readback_flush(readback);
+
+        g_mutex_lock(readback->mutex);
+        readback->stop = TRUE;
+        g_cond_broadcast(readback->cond);
+        g_mutex_unlock(readback->mutex);
+
+        g_thread_join(readback->thread);
+        readback->thread = NULL;
+    }
+
+    g_cond_free(readback->cond);
+    g_mutex_free(readback->mutex);
+    g_object_unref(readback->images);
+    g_slice_free(GstVaapiReadback, readback);
+}
+
+/**
+ * gst_vaapi_readback_get_depth:
+ * @readback: a #GstVaapiReadback
+ *
+ * Returns the number of surfaces fetched ahead of the one being copied
+ * out, as passed to gst_vaapi_readback_new().
+ *
+ * Return value: the readback depth
+ */
+guint
+gst_vaapi_readback_get_depth(GstVaapiReadback *readback)
+{
+    g_return_val_if_fail(readback != NULL, 0);
+
+    return readback->depth;
+}
+
+/**
+ * gst_vaapi_readback_get_pending:
+ * @readback: a #GstVaapiReadback
+ *
+ * Returns the number of surfaces pushed and not popped yet, whether
+ * they were fetched or not. The caller should pop a surface once more
+ * than depth surfaces are pending.
+ *
+ * Return value: the number of pending surfaces
+ */
+guint
+gst_vaapi_readback_get_pending(GstVaapiReadback *readback)
+{
+    guint num_pending;
+
+    g_return_val_if_fail(readback != NULL, 0);
+
+    g_mutex_lock(readback->mutex);
+    num_pending = g_queue_get_length(&readback->input) +
+        g_queue_get_length(&readback->output) + (readback->busy ? 1 : 0);
+    g_mutex_unlock(readback->mutex);
+    return num_pending;
+}
+
+/**
+ * gst_vaapi_readback_push:
+ * @readback: a #GstVaapiReadback
+ * @surface: the #GstVaapiSurface to read back
+ * @surface_data: the data that keeps @surface from being rendered to,
+ *   or %NULL
+ * @user_data: the data returned along with the pixels of @surface
+ *
+ * Queues @surface to be fetched. This function does not block. The
+ * surface should not be rendered to until it is fetched, at which
+ * point @surface_data is released with the destroy function passed to
+ * gst_vaapi_readback_new(). The @user_data is held until the surface
+ * is popped, so it should not reference @surface.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_readback_push(
+    GstVaapiReadback *readback,
+    GstVaapiSurface  *surface,
+    gpointer          surface_data,
+    gpointer          user_data
+)
+{
+    ReadbackJob *job;
+
+    g_return_val_if_fail(readback != NULL, FALSE);
+    g_return_val_if_fail(GST_VAAPI_IS_SURFACE(surface), FALSE);
+
+    job = g_slice_new0(ReadbackJob);
+    job->surface      = g_object_ref(surface);
+    job->surface_id   = gst_vaapi_surface_get_id(surface);
+    job->surface_data = surface_data;
+    job->user_data    = user_data;
+    job->push_time    = gst_util_get_timestamp();
+
+    g_mutex_lock(readback->mutex);
+    g_queue_push_tail(&readback->input, job);
+    g_cond_broadcast(readback->cond);
+    g_mutex_unlock(readback->mutex);
+    return TRUE;
+}
+
+/**
+ * gst_vaapi_readback_pop:
+ * @readback: a #GstVaapiReadback
+ * @buffer: the #GstBuffer to copy the pixels to, or %NULL
+ * @puser_data: return location for the user data of the surface, or %NULL
+ *
+ * Waits for the oldest pending surface to be fetched and copies its
+ * pixels to @buffer, which must match the format and size of the
+ * images. If @buffer is %NULL, the surface is discarded.
+ *
+ * The user data of the popped surface is returned in @puser_data even
+ * if the readback failed. If @puser_data is %NULL, the user data is
+ * released with the destroy function passed to gst_vaapi_readback_new().
+ *
+ * Return value: %TRUE if the pixels were copied to @buffer, %FALSE if
+ *   no surface is pending or the readback failed
+ */
+gboolean
+gst_vaapi_readback_pop(
+    GstVaapiReadback *readback,
+    GstBuffer        *buffer,
+    gpointer         *puser_data
+)
+{
+    ReadbackJob *job;
+    GstClockTime start_time, end_time;
+    gboolean success;
+
+    g_return_val_if_fail(readback != NULL, FALSE);
+
+    if (puser_data)
+        *puser_data = NULL;
+
+    start_time = gst_util_get_timestamp();
+    g_mutex_lock(readback->mutex);
+    while (g_queue_is_empty(&readback->output) &&
+           (readback->busy || !g_queue_is_empty(&readback->input)))
+        g_cond_wait(readback->cond, readback->mutex);
+    job = g_queue_pop_head(&readback->output);
+    if (job)
+        stage_record_unlocked(readback, GST_VAAPI_READBACK_STAGE_WAIT,
+            gst_util_get_timestamp() - start_time);
+    g_mutex_unlock(readback->mutex);
+    if (!job)
+        return FALSE;
+
+    success = job->success && buffer != NULL;
+    if (success) {
+        start_time = gst_util_get_timestamp();
+        GST_VAAPI_TRACE_BEGIN("readback.copy", job->surface_id);
+        success = gst_vaapi_image_get_buffer(job->image, buffer, NULL);
+        GST_VAAPI_TRACE_END("readback.copy", job->surface_id);
+        end_time = gst_util_get_timestamp();
+        if (!success)
+            GST_WARNING("failed to copy image to buffer");
+
+        g_mutex_lock(readback->mutex);
+        stage_record_unlocked(readback, GST_VAAPI_READBACK_STAGE_COPY,
+            end_time - start_time);
+        stage_record_unlocked(readback, GST_VAAPI_READBACK_STAGE_LATENCY,
+            end_time - job->push_time);
+        g_mutex_unlock(readback->mutex);
+    }
+
+    if (puser_data) {
+        *puser_data = job->user_data;
+        job->user_data = NULL;
+    }
+    readback_job_free(readback, job);
+    return success;
+}
+
+/**
+ * gst_vaapi_readback_flush:
+ * @readback: a #GstVaapiReadback
+ *
+ * Discards all pending surfaces, e.g. on seeking. The user data of the
+ * surfaces is released with the destroy function passed to
+ * gst_vaapi_readback_new(). This function waits for the surface being
+ * fetched, if any.
+ */
+void
+gst_vaapi_readback_flush(GstVaapiReadback *readback)
+{
+    GQueue jobs = G_QUEUE_INIT;
+    ReadbackJob *job;
+
+    g_return_if_fail(readback != NULL);
+
+    g_mutex_lock(readback->mutex);
+    while ((job = g_queue_pop_head(&readback->input)) != NULL)
+        g_queue_push_tail(&jobs, job);
+    while (readback->busy)
+        g_cond_wait(readback->cond, readback->mutex);
+    while ((job = g_queue_pop_head(&readback->output)) != NULL)
+        g_queue_push_tail(&jobs, job);
+    g_mutex_unlock(readback->mutex);
+
+    /* The destroy function may release surfaces, do not hold the lock */
+    while ((job = g_queue_pop_head(&jobs)) != NULL)
+        readback_job_free(readback, job);
+}
+
+/**
+ * gst_vaapi_readback_get_stage_stats:
+ * @readback: a #GstVaapiReadback
+ * @stage: a #GstVaapiReadbackStage
+ * @stats: return location for the statistics
+ *
+ * Retrieves the latency statistics of the readback @stage since
+ * @readback was created. If the stage was never run, @stats min_time
+ * is zero.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_readback_get_stage_stats(
+    GstVaapiReadback           *readback,
+    GstVaapiReadbackStage       stage,
+    GstVaapiReadbackStageStats *stats
+)
+{
+    g_return_val_if_fail(readback != NULL, FALSE);
+    g_return_val_if_fail(stage < GST_VAAPI_READBACK_STAGE_COUNT, FALSE);
+    g_return_val_if_fail(stats != NULL, FALSE);
+
+    g_mutex_lock(readback->mutex);
+    *stats = readback->stats[stage];
+    g_mutex_unlock(readback->mutex);
+
+    if (stats->count == 0)
+        stats->min_time = 0;
+    return TRUE;
+}
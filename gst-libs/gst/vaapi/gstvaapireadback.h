@@ -0,0 +1,123 @@
+/*
+ *  gstvaapireadback.h - Pipelined surface readback
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_READBACK_H
+#define GST_VAAPI_READBACK_H
+
+#include <gst/gstbuffer.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapivideopool.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiReadback                GstVaapiReadback;
+typedef struct _GstVaapiReadbackStageStats      GstVaapiReadbackStageStats;
+
+/**
+ * GstVaapiReadback:
+ *
+ * An opaque structure that holds the surfaces being read back.
+ */
+
+/**
+ * GstVaapiReadbackStage:
+ * @GST_VAAPI_READBACK_STAGE_QUEUE: Wait of a pushed surface until the
+ *   fetch thread picks it up.
+ * @GST_VAAPI_READBACK_STAGE_FETCH: Transfer of a surface to an image,
+ *   including the wait for the surface to be ready.
+ * @GST_VAAPI_READBACK_STAGE_WAIT: Wait in gst_vaapi_readback_pop() for
+ *   the oldest surface to be fetched.
+ * @GST_VAAPI_READBACK_STAGE_COPY: Copy of an image to the output buffer.
+ * @GST_VAAPI_READBACK_STAGE_LATENCY: Whole readback of a surface, from
+ *   gst_vaapi_readback_push() to the end of the copy.
+ * @GST_VAAPI_READBACK_STAGE_COUNT: Number of stages.
+ *
+ * Readback stages reported by gst_vaapi_readback_get_stage_stats().
+ */
+typedef enum {
+    GST_VAAPI_READBACK_STAGE_QUEUE = 0,
+    GST_VAAPI_READBACK_STAGE_FETCH,
+    GST_VAAPI_READBACK_STAGE_WAIT,
+    GST_VAAPI_READBACK_STAGE_COPY,
+    GST_VAAPI_READBACK_STAGE_LATENCY,
+    GST_VAAPI_READBACK_STAGE_COUNT
+} GstVaapiReadbackStage;
+
+/**
+ * GstVaapiReadbackStageStats:
+ * @count: number of times the stage was run
+ * @total_time: total time spent in the stage, in nanoseconds
+ * @min_time: shortest run, in nanoseconds
+ * @max_time: longest run, in nanoseconds
+ *
+ * Latency statistics of a readback stage.
+ */
+struct _GstVaapiReadbackStageStats {
+    guint64     count;
+    guint64     total_time;
+    guint64     min_time;
+    guint64     max_time;
+};
+
+GstVaapiReadback *
+gst_vaapi_readback_new(
+    GstVaapiVideoPool *images,
+    guint              depth,
+    GDestroyNotify     destroy_func
+);
+
+void
+gst_vaapi_readback_free(GstVaapiReadback *readback);
+
+guint
+gst_vaapi_readback_get_depth(GstVaapiReadback *readback);
+
+guint
+gst_vaapi_readback_get_pending(GstVaapiReadback *readback);
+
+gboolean
+gst_vaapi_readback_push(
+    GstVaapiReadback *readback,
+    GstVaapiSurface  *surface,
+    gpointer          surface_data,
+    gpointer          user_data
+);
+
+gboolean
+gst_vaapi_readback_pop(
+    GstVaapiReadback *readback,
+    GstBuffer        *buffer,
+    gpointer         *puser_data
+);
+
+void
+gst_vaapi_readback_flush(GstVaapiReadback *readback);
+
+gboolean
+gst_vaapi_readback_get_stage_stats(
+    GstVaapiReadback           *readback,
+    GstVaapiReadbackStage       stage,
+    GstVaapiReadbackStageStats *stats
+);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_READBACK_H */
@@ -0,0 +1,372 @@
+/*
+ *  gstvaapistartcode.c - Start code scanner
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include "gstvaapicpu.h"
+#include "gstvaapistartcode.h"
+
+#if GST_VAAPI_CPU_HAS_X86
+# include <immintrin.h>
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+# include <arm_neon.h>
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- Generic C implementation                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/* Looks at the third byte of each candidate first: unless it is 0 or
+   1, no start code can begin at any of the three positions it covers */
+static guint
+find_c(const guint8 *buf, guint n)
+{
+    guint i = 0;
+
+    while (i + 2 < n) {
+        if (buf[i + 2] > 1)
+            i += 3;
+        else if (buf[i + 2] == 0)
+            i++;
+        else if (buf[i] == 0 && buf[i + 1] == 0)
+            return i;
+        else
+            i += 3;
+    }
+    return n;
+}
+
+static const GstVaapiStartCodeFuncs g_start_code_funcs_c = {
+    "c",
+    find_c,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- x86 implementations                                               --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_X86
+
+#define SSE2    GST_VAAPI_CPU_TARGET("sse2")
+#define AVX2    GST_VAAPI_CPU_TARGET("avx2")
+
+/* Each bit of the mask tells whether a start code begins at that byte.
+   The three loads overlap, so the last 2 bytes of the input are only
+   covered by the C code */
+static SSE2 guint
+find_sse2(const guint8 *buf, guint n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    __m128i a, b, c;
+    guint i, mask;
+
+    for (i = 0; i + 18 <= n; i += 16) {
+        a = _mm_loadu_si128((const __m128i *)(buf + i));
+        b = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+        c = _mm_loadu_si128((const __m128i *)(buf + i + 2));
+        mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)),
+            _mm_cmpeq_epi8(c, one)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_c(buf + i, n - i);
+}
+
+static AVX2 guint
+find_avx2(const guint8 *buf, guint n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+    __m256i a, b, c;
+    guint i, mask;
+
+    for (i = 0; i + 34 <= n; i += 32) {
+        a = _mm256_loadu_si256((const __m256i *)(buf + i));
+        b = _mm256_loadu_si256((const __m256i *)(buf + i + 1));
+        c = _mm256_loadu_si256((const __m256i *)(buf + i + 2));
+        mask = (guint)_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, zero),
+                             _mm256_cmpeq_epi8(b, zero)),
+            _mm256_cmpeq_epi8(c, one)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + find_sse2(buf + i, n - i);
+}
+
+#undef AVX2
+#undef SSE2
+
+static const GstVaapiStartCodeFuncs g_start_code_funcs_sse2 = {
+    "sse2",
+    find_sse2,
+};
+
+static const GstVaapiStartCodeFuncs g_start_code_funcs_avx2 = {
+    "avx2",
+    find_avx2,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_X86 */
+
+/* ------------------------------------------------------------------------- */
+/* --- ARM implementation                                                --- */
+/* ------------------------------------------------------------------------- */
+
+#if GST_VAAPI_CPU_HAS_NEON
+
+/* NEON has no movemask, the C code locates the start code within the
+   16 bytes once any is detected */
+static guint
+find_neon(const guint8 *buf, guint n)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one  = vdupq_n_u8(1);
+    uint64x2_t m;
+    guint i;
+
+    for (i = 0; i + 18 <= n; i += 16) {
+        m = vreinterpretq_u64_u8(vandq_u8(
+            vandq_u8(vceqq_u8(vld1q_u8(buf + i), zero),
+                     vceqq_u8(vld1q_u8(buf + i + 1), zero)),
+            vceqq_u8(vld1q_u8(buf + i + 2), one)));
+        if (vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1))
+            return i + find_c(buf + i, 18);
+    }
+    return i + find_c(buf + i, n - i);
+}
+
+static const GstVaapiStartCodeFuncs g_start_code_funcs_neon = {
+    "neon",
+    find_neon,
+};
+
+#endif /* GST_VAAPI_CPU_HAS_NEON */
+
+/* ------------------------------------------------------------------------- */
+/* --- Dispatch                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_start_code_get_funcs_for_flags:
+ * @cpu_flags: a set of #GstVaapiCpuFlags
+ *
+ * Selects the fastest kernels that only use the SIMD extensions
+ * listed in @cpu_flags.
+ *
+ * Return value: the #GstVaapiStartCodeFuncs for @cpu_flags
+ */
+const GstVaapiStartCodeFuncs *
+gst_vaapi_start_code_get_funcs_for_flags(guint cpu_flags)
+{
+#if GST_VAAPI_CPU_HAS_X86
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_AVX2)
+        return &g_start_code_funcs_avx2;
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_SSE2)
+        return &g_start_code_funcs_sse2;
+#endif
+#if GST_VAAPI_CPU_HAS_NEON
+    if (cpu_flags & GST_VAAPI_CPU_FLAG_NEON)
+        return &g_start_code_funcs_neon;
+#endif
+    return &g_start_code_funcs_c;
+}
+
+/**
+ * gst_vaapi_start_code_get_funcs:
+ *
+ * Selects the fastest kernels for this CPU.
+ *
+ * Return value: the #GstVaapiStartCodeFuncs to use
+ */
+const GstVaapiStartCodeFuncs *
+gst_vaapi_start_code_get_funcs(void)
+{
+    return gst_vaapi_start_code_get_funcs_for_flags(gst_vaapi_cpu_get_flags());
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Scanner                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * gst_vaapi_start_code_scanner_init:
+ * @scanner: a #GstVaapiStartCodeScanner
+ * @funcs: the kernels to use, or %NULL for the fastest ones
+ *
+ * Initializes @scanner for a new bitstream.
+ */
+void
+gst_vaapi_start_code_scanner_init(
+    GstVaapiStartCodeScanner     *scanner,
+    const GstVaapiStartCodeFuncs *funcs
+)
+{
+    scanner->funcs     = funcs ? funcs : gst_vaapi_start_code_get_funcs();
+    scanner->positions = g_array_new(FALSE, FALSE, sizeof(guint));
+    scanner->size      = 0;
+    scanner->num_zeros = 0;
+}
+
+/**
+ * gst_vaapi_start_code_scanner_clear:
+ * @scanner: a #GstVaapiStartCodeScanner
+ *
+ * Releases the resources held by @scanner.
+ */
+void
+gst_vaapi_start_code_scanner_clear(GstVaapiStartCodeScanner *scanner)
+{
+    if (scanner->positions) {
+        g_array_free(scanner->positions, TRUE);
+        scanner->positions = NULL;
+    }
+    scanner->size      = 0;
+    scanner->num_zeros = 0;
+}
+
+/**
+ * gst_vaapi_start_code_scanner_reset:
+ * @scanner: a #GstVaapiStartCodeScanner
+ *
+ * Forgets about all the data scanned so far, e.g. when the adapter
+ * holding the bitstream is cleared.
+ */
+void
+gst_vaapi_start_code_scanner_reset(GstVaapiStartCodeScanner *scanner)
+{
+    g_array_set_size(scanner->positions, 0);
+    scanner->size      = 0;
+    scanner->num_zeros = 0;
+}
+
+static inline void
+add_position(GstVaapiStartCodeScanner *scanner, guint position)
+{
+    g_array_append_val(scanner->positions, position);
+}
+
+/**
+ * gst_vaapi_start_code_scanner_push:
+ * @scanner: a #GstVaapiStartCodeScanner
+ * @buf: the bitstream data
+ * @buf_size: the size of @buf, in bytes
+ *
+ * Scans the next @buf_size bytes of the bitstream, and records the
+ * start codes found, including those that begin in the previously
+ * pushed data.
+ */
+void
+gst_vaapi_start_code_scanner_push(
+    GstVaapiStartCodeScanner *scanner,
+    const guint8             *buf,
+    guint                     buf_size
+)
+{
+    guint i, n, ofs, num_zeros;
+
+    /* Start codes that straddle the previous data */
+    num_zeros = scanner->num_zeros;
+    for (i = 0; i < buf_size && i < 2; i++) {
+        if (buf[i] == 0) {
+            num_zeros = MIN(num_zeros + 1, 2);
+            continue;
+        }
+        if (buf[i] == 1 && num_zeros == 2)
+            add_position(scanner, scanner->size + i - 2);
+        num_zeros = 0;
+    }
+
+    for (ofs = 0; ofs + 3 <= buf_size; ofs += n + 3) {
+        n = scanner->funcs->find(buf + ofs, buf_size - ofs);
+        if (ofs + n >= buf_size)
+            break;
+        add_position(scanner, scanner->size + ofs + n);
+    }
+
+    if (buf_size > 2)
+        num_zeros = buf[buf_size - 1] ? 0 : (buf[buf_size - 2] ? 1 : 2);
+    scanner->num_zeros = num_zeros;
+    scanner->size += buf_size;
+}
+
+/**
+ * gst_vaapi_start_code_scanner_find:
+ * @scanner: a #GstVaapiStartCodeScanner
+ * @offset: the offset to start from
+ *
+ * Looks up the first start code prefix found at @offset or later,
+ * relative to the first byte that was not flushed yet.
+ *
+ * Return value: the offset of the start code prefix, or -1 if none
+ *   was found
+ */
+gint
+gst_vaapi_start_code_scanner_find(
+    GstVaapiStartCodeScanner *scanner,
+    guint                     offset
+)
+{
+    const guint * const positions = (guint *)scanner->positions->data;
+    guint i;
+
+    for (i = 0; i < scanner->positions->len; i++) {
+        if (positions[i] >= offset)
+            return positions[i];
+    }
+    return -1;
+}
+
+/**
+ * gst_vaapi_start_code_scanner_flush:
+ * @scanner: a #GstVaapiStartCodeScanner
+ * @size: the number of bytes to flush
+ *
+ * Discards the first @size bytes of the data scanned so far. This
+ * shall be called whenever that data is flushed from the adapter.
+ */
+void
+gst_vaapi_start_code_scanner_flush(
+    GstVaapiStartCodeScanner *scanner,
+    guint                     size
+)
+{
+    guint * const positions = (guint *)scanner->positions->data;
+    guint i, n;
+
+    if (size >= scanner->size) {
+        gst_vaapi_start_code_scanner_reset(scanner);
+        return;
+    }
+
+    for (n = 0; n < scanner->positions->len; n++) {
+        if (positions[n] >= size)
+            break;
+    }
+    if (n > 0)
+        g_array_remove_range(scanner->positions, 0, n);
+
+    for (i = 0; i < scanner->positions->len; i++)
+        positions[i] -= size;
+    scanner->size -= size;
+}
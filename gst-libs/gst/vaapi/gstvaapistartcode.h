@@ -0,0 +1,115 @@
+/*
+ *  gstvaapistartcode.h - Start code scanner
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_START_CODE_H
+#define GST_VAAPI_START_CODE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiStartCodeFuncs          GstVaapiStartCodeFuncs;
+typedef struct _GstVaapiStartCodeScanner        GstVaapiStartCodeScanner;
+
+/**
+ * GstVaapiStartCodeFuncs:
+ * @name: name of the implementation, e.g. "sse2"
+ * @find: returns the offset of the first 00 00 01 start code prefix
+ *   that lies entirely within the @n bytes at @buf, or @n if there
+ *   is none
+ *
+ * Start code search kernels. All implementations return the same
+ * results.
+ */
+struct _GstVaapiStartCodeFuncs {
+    const gchar *name;
+
+    guint (*find)(const guint8 *buf, guint n);
+};
+
+/**
+ * GstVaapiStartCodeScanner:
+ * @funcs: the kernels used to scan the bitstream
+ * @positions: offsets of the start codes found so far, relative to
+ *   the first byte that was not flushed yet
+ * @size: number of bytes scanned and not flushed yet
+ * @num_zeros: number of trailing zero bytes scanned, up to 2
+ *
+ * Locates the 00 00 01 start code prefixes of a bitstream that is
+ * fed in arbitrary pieces, e.g. as the decoder input buffers are
+ * pushed into a #GstAdapter. Every byte is scanned once, including
+ * for start codes that straddle two pieces.
+ */
+struct _GstVaapiStartCodeScanner {
+    const GstVaapiStartCodeFuncs *funcs;
+    GArray                       *positions;
+    guint                         size;
+    guint                         num_zeros;
+};
+
+G_GNUC_INTERNAL
+const GstVaapiStartCodeFuncs *
+gst_vaapi_start_code_get_funcs(void);
+
+G_GNUC_INTERNAL
+const GstVaapiStartCodeFuncs *
+gst_vaapi_start_code_get_funcs_for_flags(guint cpu_flags);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_start_code_scanner_init(
+    GstVaapiStartCodeScanner     *scanner,
+    const GstVaapiStartCodeFuncs *funcs
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_start_code_scanner_clear(GstVaapiStartCodeScanner *scanner);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_start_code_scanner_reset(GstVaapiStartCodeScanner *scanner);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_start_code_scanner_push(
+    GstVaapiStartCodeScanner *scanner,
+    const guint8             *buf,
+    guint                     buf_size
+);
+
+G_GNUC_INTERNAL
+gint
+gst_vaapi_start_code_scanner_find(
+    GstVaapiStartCodeScanner *scanner,
+    guint                     offset
+);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_start_code_scanner_flush(
+    GstVaapiStartCodeScanner *scanner,
+    guint                     size
+);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_START_CODE_H */
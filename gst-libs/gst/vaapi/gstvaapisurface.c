@@ -496,6 +496,7 @@ GstVaapiImage *
 gst_vaapi_surface_derive_image(GstVaapiSurface *surface)
 {
     GstVaapiDisplay *display;
+    GstVaapiImage *image;
     VAImage va_image;
     VAStatus status;
 
@@ -517,7 +518,11 @@ gst_vaapi_surface_derive_image(GstVaapiSurface *surface)
     if (va_image.image_id == VA_INVALID_ID || va_image.buf == VA_INVALID_ID)
         return NULL;
 
-    return gst_vaapi_image_new_with_image(display, &va_image);
+    /* Derived images map the surface memory, which is usually uncached */
+    image = gst_vaapi_image_new_with_image(display, &va_image);
+    if (image)
+        gst_vaapi_image_set_uncached(image, TRUE);
+    return image;
 }
 
 /**
@@ -43,6 +43,7 @@ struct _GstVaapiSurfaceProxyPrivate {
     GstVaapiContext    *context;
     GstVaapiSurface    *surface;
     GstClockTime        timestamp;
+    volatile gint       decoder_refs;
     guint               is_interlaced   : 1;
     guint               tff             : 1;
 };
@@ -197,6 +198,7 @@ gst_vaapi_surface_proxy_init(GstVaapiSurfaceProxy *proxy)
     priv->context       = NULL;
     priv->surface       = NULL;
     priv->timestamp     = GST_CLOCK_TIME_NONE;
+    priv->decoder_refs  = 0;
     priv->is_interlaced = FALSE;
     priv->tff           = FALSE;
 }
@@ -429,3 +431,51 @@ gst_vaapi_surface_proxy_set_tff(GstVaapiSurfaceProxy *proxy, gboolean tff)
 
     proxy->priv->tff = tff;
 }
+
+/**
+ * gst_vaapi_surface_proxy_decoder_ref:
+ * @proxy: a #GstVaapiSurfaceProxy
+ *
+ * Records that a decoder picture uses the @proxy surface, either as
+ * a decode target or as a reference picture.
+ */
+void
+gst_vaapi_surface_proxy_decoder_ref(GstVaapiSurfaceProxy *proxy)
+{
+    g_return_if_fail(GST_VAAPI_IS_SURFACE_PROXY(proxy));
+
+    g_atomic_int_inc(&proxy->priv->decoder_refs);
+}
+
+/**
+ * gst_vaapi_surface_proxy_decoder_unref:
+ * @proxy: a #GstVaapiSurfaceProxy
+ *
+ * Records that a decoder picture no longer uses the @proxy surface.
+ */
+void
+gst_vaapi_surface_proxy_decoder_unref(GstVaapiSurfaceProxy *proxy)
+{
+    g_return_if_fail(GST_VAAPI_IS_SURFACE_PROXY(proxy));
+    g_return_if_fail(g_atomic_int_get(&proxy->priv->decoder_refs) > 0);
+
+    g_atomic_int_add(&proxy->priv->decoder_refs, -1);
+}
+
+/**
+ * gst_vaapi_surface_proxy_is_decoder_done:
+ * @proxy: a #GstVaapiSurfaceProxy
+ *
+ * Determines whether the decoder released all pictures bound to the
+ * @proxy surface. Once this function returned %TRUE, the decoder will
+ * neither write to nor reference the surface any more.
+ *
+ * Return value: %TRUE if the decoder is done with the surface
+ */
+gboolean
+gst_vaapi_surface_proxy_is_decoder_done(GstVaapiSurfaceProxy *proxy)
+{
+    g_return_val_if_fail(GST_VAAPI_IS_SURFACE_PROXY(proxy), FALSE);
+
+    return g_atomic_int_get(&proxy->priv->decoder_refs) == 0;
+}
@@ -164,6 +164,17 @@ gst_vaapi_surface_proxy_get_tff(GstVaapiSurfaceProxy *proxy);
 void
 gst_vaapi_surface_proxy_set_tff(GstVaapiSurfaceProxy *proxy, gboolean tff);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_surface_proxy_decoder_ref(GstVaapiSurfaceProxy *proxy);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_surface_proxy_decoder_unref(GstVaapiSurfaceProxy *proxy);
+
+gboolean
+gst_vaapi_surface_proxy_is_decoder_done(GstVaapiSurfaceProxy *proxy);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_SURFACE_PROXY_H */
@@ -0,0 +1,245 @@
+/*
+ *  gstvaapitrace.c - Low-overhead event tracing
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapitrace
+ * @short_description: Low-overhead event tracing
+ *
+ * Trace events are recorded into a fixed-size ring buffer without
+ * taking any lock: writers reserve a slot with a single atomic
+ * increment, and the oldest events are overwritten once the buffer is
+ * full. The events can then be written out in the Chrome trace event
+ * format, which chrome://tracing and Perfetto load.
+ *
+ * Setting the GST_VAAPI_TRACE environment variable to a file name
+ * starts tracing when the first #GstVaapiDisplay is created, and writes
+ * the events to that file when the library is unloaded, usually when
+ * the process exits. This needs a compiler that supports destructor
+ * functions, otherwise use gst_vaapi_trace_write().
+ */
+
+#include "sysdeps.h"
+#include <unistd.h>
+#include <gst/gstutils.h>
+#include "gstvaapitrace.h"
+#include "gstvaapi_priv.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+/* Default number of events kept, when tracing is started through the
+   environment. This is a power of two */
+#define DEFAULT_NUM_EVENTS      (1U << 18)
+
+typedef struct _TraceEvent TraceEvent;
+struct _TraceEvent {
+    GstClockTime        timestamp;
+    const gchar        *name;
+    guint32             id;
+    guint32             thread_id;
+    gchar               phase;
+};
+
+volatile gint gst_vaapi_trace_enabled = 0;
+
+static TraceEvent      *g_trace_events;
+static guint            g_trace_num_events;
+static volatile gint    g_trace_pos;
+static GstClockTime     g_trace_start_time;
+static gchar           *g_trace_filename;
+
+/**
+ * gst_vaapi_trace_start:
+ * @num_events: the number of events to keep, rounded up to a power of two
+ *
+ * Starts recording trace events, and discards the events recorded
+ * so far. The events buffer is allocated on the first call, later
+ * calls keep its size. It is never freed, so that threads that are
+ * still recording events while tracing is stopped are safe.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_trace_start(guint num_events)
+{
+    if (!g_trace_events) {
+        num_events = MAX(num_events, 2);
+        if (num_events > (1U << 30))
+            return FALSE;
+        g_trace_num_events = 1U << g_bit_storage(num_events - 1);
+        g_trace_events = g_try_new0(TraceEvent, g_trace_num_events);
+        if (!g_trace_events)
+            return FALSE;
+    }
+
+    g_atomic_int_set(&gst_vaapi_trace_enabled, 0);
+    g_atomic_int_set(&g_trace_pos, 0);
+    g_trace_start_time = gst_util_get_timestamp();
+    g_atomic_int_set(&gst_vaapi_trace_enabled, 1);
+    return TRUE;
+}
+
+/**
+ * gst_vaapi_trace_stop:
+ *
+ * Stops recording trace events. The recorded events are kept until
+ * tracing is started again.
+ */
+void
+gst_vaapi_trace_stop(void)
+{
+    g_atomic_int_set(&gst_vaapi_trace_enabled, 0);
+}
+
+/**
+ * gst_vaapi_trace_event:
+ * @name: a static string naming the event
+ * @phase: the Chrome trace event phase: 'B' (begin), 'E' (end) or
+ *   'i' (instant)
+ * @id: an identifier shown with the event
+ *
+ * Records a trace event. Use the GST_VAAPI_TRACE_BEGIN(),
+ * GST_VAAPI_TRACE_END() and GST_VAAPI_TRACE_INSTANT() macros instead,
+ * which do not call this function if tracing is disabled. The @name
+ * string is referenced, not copied.
+ */
+void
+gst_vaapi_trace_event(const gchar *name, gchar phase, guint32 id)
+{
+    TraceEvent *event;
+    guint pos;
+
+    if (!g_trace_events)
+        return;
+
+#if GLIB_CHECK_VERSION(2,30,0)
+    pos = (guint)g_atomic_int_add(&g_trace_pos, 1);
+#else
+    pos = (guint)g_atomic_int_exchange_and_add(&g_trace_pos, 1);
+#endif
+
+    event = &g_trace_events[pos & (g_trace_num_events - 1)];
+    event->timestamp = gst_util_get_timestamp();
+    event->name      = name;
+    event->id        = id;
+    event->thread_id = GPOINTER_TO_UINT(g_thread_self());
+    event->phase     = phase;
+}
+
+/**
+ * gst_vaapi_trace_write:
+ * @filename: the output file name
+ *
+ * Writes the recorded events to @filename in the Chrome trace event
+ * JSON format. Timestamps are in microseconds since tracing started.
+ * This should be called once tracing is stopped, since events recorded
+ * meanwhile could be partially written.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_trace_write(const gchar *filename)
+{
+    GString *str;
+    GError *error = NULL;
+    guint i, first, last;
+    gboolean success;
+    const gint pid = getpid();
+
+    g_return_val_if_fail(filename != NULL, FALSE);
+
+    str = g_string_new("{\"traceEvents\":[\n");
+    if (g_trace_events) {
+        last  = (guint)g_atomic_int_get(&g_trace_pos);
+        first = last > g_trace_num_events ? last - g_trace_num_events : 0;
+        for (i = first; i < last; i++) {
+            const TraceEvent * const event =
+                &g_trace_events[i & (g_trace_num_events - 1)];
+
+            if (!event->name || event->timestamp < g_trace_start_time)
+                continue;
+            g_string_append_printf(str,
+                "{\"name\":\"%s\",\"cat\":\"vaapi\",\"ph\":\"%c\","
+                "\"ts\":%.3f,\"pid\":%d,\"tid\":%u,%s"
+                "\"args\":{\"id\":\"0x%08x\"}},\n",
+                event->name, event->phase,
+                (event->timestamp - g_trace_start_time) / 1000.0,
+                pid, event->thread_id,
+                event->phase == 'i' ? "\"s\":\"t\"," : "",
+                event->id);
+        }
+    }
+
+    /* Drop the trailing comma */
+    if (str->str[str->len - 2] == ',')
+        g_string_truncate(str, str->len - 2);
+    g_string_append(str, "\n]}\n");
+
+    success = g_file_set_contents(filename, str->str, str->len, &error);
+    if (!success) {
+        GST_ERROR("failed to write trace to %s: %s", filename, error->message);
+        g_error_free(error);
+    }
+    g_string_free(str, TRUE);
+    return success;
+}
+
+/* Writes the trace started through the environment. This runs when
+   the library is unloaded, rather than from an atexit() handler that
+   could outlive the library code */
+#if defined(__GNUC__)
+static void __attribute__((destructor))
+write_trace_at_unload(void)
+{
+    if (!g_trace_filename)
+        return;
+
+    gst_vaapi_trace_stop();
+    gst_vaapi_trace_write(g_trace_filename);
+    g_free(g_trace_filename);
+    g_trace_filename = NULL;
+}
+#endif
+
+static gpointer
+trace_init_once(gpointer data)
+{
+    const gchar * const filename = g_getenv("GST_VAAPI_TRACE");
+
+    if (!filename || !*filename)
+        return NULL;
+
+    if (!gst_vaapi_trace_start(DEFAULT_NUM_EVENTS))
+        return NULL;
+
+    g_trace_filename = g_strdup(filename);
+    GST_INFO("tracing to %s", g_trace_filename);
+    return NULL;
+}
+
+/* Starts tracing if the GST_VAAPI_TRACE environment variable is set */
+void
+gst_vaapi_trace_init(void)
+{
+    static GOnce once = G_ONCE_INIT;
+
+    g_once(&once, trace_init_once, NULL);
+}
@@ -0,0 +1,95 @@
+/*
+ *  gstvaapitrace.h - Low-overhead event tracing
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TRACE_H
+#define GST_VAAPI_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Do not use directly, this is only exported for the trace macros */
+extern volatile gint gst_vaapi_trace_enabled;
+
+/**
+ * GST_VAAPI_TRACE_IS_ENABLED:
+ *
+ * Evaluates to %TRUE if tracing is enabled.
+ */
+#define GST_VAAPI_TRACE_IS_ENABLED() \
+    G_UNLIKELY(gst_vaapi_trace_enabled)
+
+/**
+ * GST_VAAPI_TRACE_BEGIN:
+ * @name: a static string naming the traced section
+ * @id: an identifier shown with the event, e.g. a surface ID, or 0
+ *
+ * Records the start of the @name section in the current thread. This
+ * costs a single test if tracing is disabled.
+ */
+#define GST_VAAPI_TRACE_BEGIN(name, id) G_STMT_START {                  \
+        if (GST_VAAPI_TRACE_IS_ENABLED())                               \
+            gst_vaapi_trace_event(name, 'B', (guint32)(id));            \
+    } G_STMT_END
+
+/**
+ * GST_VAAPI_TRACE_END:
+ * @name: a static string naming the traced section
+ * @id: an identifier shown with the event, e.g. a surface ID, or 0
+ *
+ * Records the end of the @name section in the current thread.
+ */
+#define GST_VAAPI_TRACE_END(name, id) G_STMT_START {                    \
+        if (GST_VAAPI_TRACE_IS_ENABLED())                               \
+            gst_vaapi_trace_event(name, 'E', (guint32)(id));            \
+    } G_STMT_END
+
+/**
+ * GST_VAAPI_TRACE_INSTANT:
+ * @name: a static string naming the event
+ * @id: an identifier shown with the event, e.g. a surface ID, or 0
+ *
+ * Records a single point in time event.
+ */
+#define GST_VAAPI_TRACE_INSTANT(name, id) G_STMT_START {                \
+        if (GST_VAAPI_TRACE_IS_ENABLED())                               \
+            gst_vaapi_trace_event(name, 'i', (guint32)(id));            \
+    } G_STMT_END
+
+gboolean
+gst_vaapi_trace_start(guint num_events);
+
+void
+gst_vaapi_trace_stop(void);
+
+gboolean
+gst_vaapi_trace_write(const gchar *filename);
+
+void
+gst_vaapi_trace_event(const gchar *name, gchar phase, guint32 id);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_trace_init(void);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TRACE_H */
@@ -26,6 +26,8 @@
 
 #include "sysdeps.h"
 #include "gstvaapivideopool.h"
+#include "gstvaapiobject.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -39,8 +41,10 @@ G_DEFINE_TYPE(GstVaapiVideoPool, gst_vaapi_video_pool, G_TYPE_OBJECT)
 
 struct _GstVaapiVideoPoolPrivate {
     GstVaapiDisplay    *display;
+    GMutex             *mutex;
+    GCond              *object_ready;
     GQueue              free_objects;
-    GList              *used_objects;
+    GHashTable         *used_objects;
     GstCaps            *caps;
     guint               used_count;
     guint               capacity;
@@ -70,14 +74,11 @@ gst_vaapi_video_pool_clear(GstVaapiVideoPool *pool)
 {
     GstVaapiVideoPoolPrivate * const priv = pool->priv;
     gpointer object;
-    GList *list, *next;
 
-    for (list = priv->used_objects; list; list = next) {
-        next = list->next;
-        g_object_unref(list->data);
-        g_list_free_1(list);
+    if (priv->used_objects) {
+        g_hash_table_destroy(priv->used_objects);
+        priv->used_objects = NULL;
     }
-    priv->used_objects = NULL;
 
     while ((object = g_queue_pop_head(&priv->free_objects)))
         g_object_unref(object);
@@ -96,6 +97,16 @@ gst_vaapi_video_pool_destroy(GstVaapiVideoPool *pool)
     }
 
     g_clear_object(&priv->display);
+
+    if (priv->object_ready) {
+        g_cond_free(priv->object_ready);
+        priv->object_ready = NULL;
+    }
+
+    if (priv->mutex) {
+        g_mutex_free(priv->mutex);
+        priv->mutex = NULL;
+    }
 }
 
 static void
@@ -118,7 +129,7 @@ gst_vaapi_video_pool_set_property(
 
     switch (prop_id) {
     case PROP_DISPLAY:
-        pool->priv->display = g_object_ref(g_value_get_object(value));
+        pool->priv->display = g_value_dup_object(value);
         break;
     case PROP_CAPS:
         gst_vaapi_video_pool_set_caps(pool, g_value_get_pointer(value));
@@ -220,11 +231,16 @@ gst_vaapi_video_pool_init(GstVaapiVideoPool *pool)
 
     pool->priv          = priv;
     priv->display       = NULL;
-    priv->used_objects  = NULL;
+    priv->mutex         = g_mutex_new();
+    priv->object_ready  = g_cond_new();
     priv->caps          = NULL;
     priv->used_count    = 0;
     priv->capacity      = 0;
 
+    /* Checked out objects, each holding a reference owned by the pool */
+    priv->used_objects  = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, (GDestroyNotify)g_object_unref);
+
     g_queue_init(&priv->free_objects);
 }
 
@@ -280,6 +296,37 @@ gst_vaapi_video_pool_set_caps(GstVaapiVideoPool *pool, GstCaps *caps)
         klass->set_caps(pool, caps);
 }
 
+/* Returns the VA object ID to show in trace events */
+static guint32
+get_trace_id(gpointer object)
+{
+    return GST_VAAPI_IS_OBJECT(object) ? gst_vaapi_object_get_id(object) : 0;
+}
+
+/* Retrieves a free object, or allocates a new one. Called with the
+   pool lock held */
+static gpointer
+get_object_unlocked(GstVaapiVideoPool *pool)
+{
+    GstVaapiVideoPoolPrivate * const priv = pool->priv;
+    gpointer object;
+
+    if (priv->capacity && priv->used_count >= priv->capacity)
+        return NULL;
+
+    object = g_queue_pop_head(&priv->free_objects);
+    if (!object) {
+        object = gst_vaapi_video_pool_alloc_object(pool);
+        if (!object)
+            return NULL;
+    }
+
+    ++priv->used_count;
+    g_hash_table_insert(priv->used_objects, object, object);
+    GST_VAAPI_TRACE_INSTANT("pool.get", get_trace_id(object));
+    return g_object_ref(object);
+}
+
 /**
  * gst_vaapi_video_pool_get_object:
  * @pool: a #GstVaapiVideoPool
@@ -289,10 +336,30 @@ gst_vaapi_video_pool_set_caps(GstVaapiVideoPool *pool, GstCaps *caps)
  * and thus shall be released through gst_vaapi_video_pool_put_object()
  * when it's no longer needed.
  *
+ * This function does not block and is equivalent to
+ * gst_vaapi_video_pool_try_get_object().
+ *
  * Return value: a possibly newly allocated object, or %NULL on error
  */
 gpointer
 gst_vaapi_video_pool_get_object(GstVaapiVideoPool *pool)
+{
+    return gst_vaapi_video_pool_try_get_object(pool);
+}
+
+/**
+ * gst_vaapi_video_pool_try_get_object:
+ * @pool: a #GstVaapiVideoPool
+ *
+ * Retrieves a new object from the @pool, or allocates a new one if
+ * none was found. This function returns %NULL immediately if the
+ * @pool capacity is reached.
+ *
+ * Return value: a possibly newly allocated object, or %NULL if none
+ *   is available
+ */
+gpointer
+gst_vaapi_video_pool_try_get_object(GstVaapiVideoPool *pool)
 {
     GstVaapiVideoPoolPrivate *priv;
     gpointer object;
@@ -300,19 +367,54 @@ gst_vaapi_video_pool_get_object(GstVaapiVideoPool *pool)
     g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), NULL);
 
     priv = pool->priv;
-    if (priv->capacity && priv->used_count >= priv->capacity)
-        return NULL;
+    g_mutex_lock(priv->mutex);
+    object = get_object_unlocked(pool);
+    g_mutex_unlock(priv->mutex);
+    return object;
+}
 
-    object = g_queue_pop_head(&priv->free_objects);
-    if (!object) {
-        object = gst_vaapi_video_pool_alloc_object(pool);
-        if (!object)
-            return NULL;
-    }
+/**
+ * gst_vaapi_video_pool_get_object_timeout:
+ * @pool: a #GstVaapiVideoPool
+ * @timeout: the maximum time to wait, in microseconds
+ *
+ * Retrieves a new object from the @pool, or allocates a new one if
+ * none was found. If the @pool capacity is reached, this function
+ * blocks until another thread returns an object through
+ * gst_vaapi_video_pool_put_object(), or until @timeout microseconds
+ * have elapsed. A @timeout of zero does not block.
+ *
+ * Return value: a possibly newly allocated object, or %NULL if none
+ *   became available within @timeout
+ */
+gpointer
+gst_vaapi_video_pool_get_object_timeout(GstVaapiVideoPool *pool,
+    guint64 timeout)
+{
+    GstVaapiVideoPoolPrivate *priv;
+    GTimeVal end_time;
+    gpointer object;
 
-    ++priv->used_count;
-    priv->used_objects = g_list_prepend(priv->used_objects, object);
-    return g_object_ref(object);
+    g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), NULL);
+
+    priv = pool->priv;
+    g_get_current_time(&end_time);
+    g_time_val_add(&end_time, (glong)MIN(timeout, G_MAXLONG));
+
+    g_mutex_lock(priv->mutex);
+    for (;;) {
+        object = get_object_unlocked(pool);
+        if (object || !priv->capacity || priv->used_count < priv->capacity)
+            break;
+        GST_VAAPI_TRACE_BEGIN("pool.wait", 0);
+        if (!g_cond_timed_wait(priv->object_ready, priv->mutex, &end_time)) {
+            GST_VAAPI_TRACE_END("pool.wait", 0);
+            break;
+        }
+        GST_VAAPI_TRACE_END("pool.wait", 0);
+    }
+    g_mutex_unlock(priv->mutex);
+    return object;
 }
 
 /**
@@ -323,26 +425,66 @@ gst_vaapi_video_pool_get_object(GstVaapiVideoPool *pool)
  * Pushes the @object back into the pool. The @object shall be
  * obtained from the @pool through gst_vaapi_video_pool_get_object().
  * Calling this function with an arbitrary object yields undefined
- * behaviour.
+ * behaviour. This function is thread-safe and wakes up the threads
+ * waiting in gst_vaapi_video_pool_get_object_timeout() or
+ * gst_vaapi_video_pool_wait_object().
  */
 void
 gst_vaapi_video_pool_put_object(GstVaapiVideoPool *pool, gpointer object)
 {
     GstVaapiVideoPoolPrivate *priv;
-    GList *elem;
 
     g_return_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool));
     g_return_if_fail(G_IS_OBJECT(object));
 
     priv = pool->priv;
-    elem = g_list_find(priv->used_objects, object);
-    if (!elem)
+    g_mutex_lock(priv->mutex);
+    if (!g_hash_table_steal(priv->used_objects, object)) {
+        g_mutex_unlock(priv->mutex);
         return;
+    }
 
+    GST_VAAPI_TRACE_INSTANT("pool.put", get_trace_id(object));
     g_object_unref(object);
     --priv->used_count;
-    priv->used_objects = g_list_delete_link(priv->used_objects, elem);
     g_queue_push_tail(&priv->free_objects, object);
+    g_cond_broadcast(priv->object_ready);
+    g_mutex_unlock(priv->mutex);
+}
+
+/**
+ * gst_vaapi_video_pool_wait_object:
+ * @pool: a #GstVaapiVideoPool
+ * @timeout: the maximum time to wait, in microseconds
+ *
+ * Waits until at least one free object is available in the @pool, or
+ * until @timeout microseconds have elapsed. The calling thread is
+ * woken up as soon as another thread returns an object through
+ * gst_vaapi_video_pool_put_object(). A @timeout of zero does not
+ * block.
+ *
+ * Return value: %TRUE if a free object is available
+ */
+gboolean
+gst_vaapi_video_pool_wait_object(GstVaapiVideoPool *pool, guint64 timeout)
+{
+    GstVaapiVideoPoolPrivate *priv;
+    GTimeVal end_time;
+    gboolean success;
+
+    g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), FALSE);
+
+    priv = pool->priv;
+    g_get_current_time(&end_time);
+    g_time_val_add(&end_time, (glong)MIN(timeout, G_MAXLONG));
+
+    g_mutex_lock(priv->mutex);
+    while (!(success = !g_queue_is_empty(&priv->free_objects))) {
+        if (!g_cond_timed_wait(priv->object_ready, priv->mutex, &end_time))
+            break;
+    }
+    g_mutex_unlock(priv->mutex);
+    return success;
 }
 
 /**
@@ -359,10 +501,16 @@ gst_vaapi_video_pool_put_object(GstVaapiVideoPool *pool, gpointer object)
 gboolean
 gst_vaapi_video_pool_add_object(GstVaapiVideoPool *pool, gpointer object)
 {
+    GstVaapiVideoPoolPrivate *priv;
+
     g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), FALSE);
     g_return_val_if_fail(G_IS_OBJECT(object), FALSE);
 
-    g_queue_push_tail(&pool->priv->free_objects, g_object_ref(object));
+    priv = pool->priv;
+    g_mutex_lock(priv->mutex);
+    g_queue_push_tail(&priv->free_objects, g_object_ref(object));
+    g_cond_broadcast(priv->object_ready);
+    g_mutex_unlock(priv->mutex);
     return TRUE;
 }
 
@@ -403,9 +551,16 @@ gst_vaapi_video_pool_add_objects(GstVaapiVideoPool *pool, GPtrArray *objects)
 guint
 gst_vaapi_video_pool_get_size(GstVaapiVideoPool *pool)
 {
+    GstVaapiVideoPoolPrivate *priv;
+    guint size;
+
     g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), 0);
 
-    return g_queue_get_length(&pool->priv->free_objects);
+    priv = pool->priv;
+    g_mutex_lock(priv->mutex);
+    size = g_queue_get_length(&priv->free_objects);
+    g_mutex_unlock(priv->mutex);
+    return size;
 }
 
 /**
@@ -423,24 +578,33 @@ gst_vaapi_video_pool_get_size(GstVaapiVideoPool *pool)
 gboolean
 gst_vaapi_video_pool_reserve(GstVaapiVideoPool *pool, guint n)
 {
+    GstVaapiVideoPoolPrivate *priv;
     guint i, num_allocated;
+    gboolean success = TRUE;
 
     g_return_val_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool), 0);
 
-    num_allocated = gst_vaapi_video_pool_get_size(pool) + pool->priv->used_count;
+    priv = pool->priv;
+    g_mutex_lock(priv->mutex);
+    num_allocated = g_queue_get_length(&priv->free_objects) + priv->used_count;
     if (n < num_allocated)
-        return TRUE;
+        goto end;
 
-    if ((n -= num_allocated) > pool->priv->capacity)
-        n = pool->priv->capacity;
+    if ((n -= num_allocated) > priv->capacity)
+        n = priv->capacity;
 
     for (i = num_allocated; i < n; i++) {
         gpointer const object = gst_vaapi_video_pool_alloc_object(pool);
-        if (!object)
-            return FALSE;
-        g_queue_push_tail(&pool->priv->free_objects, object);
+        if (!object) {
+            success = FALSE;
+            break;
+        }
+        g_queue_push_tail(&priv->free_objects, object);
     }
-    return TRUE;
+
+end:
+    g_mutex_unlock(priv->mutex);
+    return success;
 }
 
 /**
@@ -470,7 +634,13 @@ gst_vaapi_video_pool_get_capacity(GstVaapiVideoPool *pool)
 void
 gst_vaapi_video_pool_set_capacity(GstVaapiVideoPool *pool, guint capacity)
 {
+    GstVaapiVideoPoolPrivate *priv;
+
     g_return_if_fail(GST_VAAPI_IS_VIDEO_POOL(pool));
 
-    pool->priv->capacity = capacity;
+    priv = pool->priv;
+    g_mutex_lock(priv->mutex);
+    priv->capacity = capacity;
+    g_cond_broadcast(priv->object_ready);
+    g_mutex_unlock(priv->mutex);
 }
@@ -97,9 +97,19 @@ gst_vaapi_video_pool_get_caps(GstVaapiVideoPool *pool);
 gpointer
 gst_vaapi_video_pool_get_object(GstVaapiVideoPool *pool);
 
+gpointer
+gst_vaapi_video_pool_try_get_object(GstVaapiVideoPool *pool);
+
+gpointer
+gst_vaapi_video_pool_get_object_timeout(GstVaapiVideoPool *pool,
+    guint64 timeout);
+
 void
 gst_vaapi_video_pool_put_object(GstVaapiVideoPool *pool, gpointer object);
 
+gboolean
+gst_vaapi_video_pool_wait_object(GstVaapiVideoPool *pool, guint64 timeout);
+
 gboolean
 gst_vaapi_video_pool_add_object(GstVaapiVideoPool *pool, gpointer object);
 
@@ -89,6 +89,26 @@ static GstStaticPadTemplate gst_vaapidecode_src_factory =
         GST_PAD_ALWAYS,
         GST_STATIC_CAPS(gst_vaapidecode_src_caps_str));
 
+enum {
+    PROP_0,
+
+    PROP_SURFACE_TIMEOUT,
+    PROP_SURFACE_WAIT_COUNT,
+    PROP_SURFACE_WAIT_TIME,
+    PROP_SURFACE_WAIT_MAX,
+    PROP_ASYNC_DEPTH,
+    PROP_QUEUE_LEVEL,
+    PROP_QUEUE_LEVEL_MAX,
+    PROP_QUEUE_LATENCY_AVG,
+    PROP_QUEUE_LATENCY_MAX,
+};
+
+/* Maximum time to wait for a free VA surface, in milliseconds */
+#define DEFAULT_SURFACE_TIMEOUT         1000
+
+/* Number of buffers queued to the decode thread (0: no decode thread) */
+#define DEFAULT_ASYNC_DEPTH             0
+
 static void
 gst_vaapidecode_implements_iface_init(GstImplementsInterfaceClass *iface);
 
@@ -171,15 +191,78 @@ gst_vaapidecode_update_src_caps(GstVaapiDecode *decode, GstCaps *caps)
     return success;
 }
 
-static void
-gst_vaapidecode_release(GstVaapiDecode *decode, GObject *dead_object)
+/* Wait for a VA surface to be displayed and released to the pool */
+static gboolean
+gst_vaapidecode_wait_surface(GstVaapiDecode *decode)
 {
-    if (!decode->decoder_mutex || !decode->decoder_ready)
-        return;
+    GstClockTime start_time, wait_time;
+    gboolean success;
+
+    if (decode->surface_timeout == 0)
+        return FALSE;
+
+    start_time = gst_util_get_timestamp();
+    success = gst_vaapi_decoder_wait_surface(decode->decoder,
+        (guint64)decode->surface_timeout * 1000);
+    wait_time = gst_util_get_timestamp() - start_time;
+
+    GST_OBJECT_LOCK(decode);
+    decode->surface_wait_count++;
+    decode->surface_wait_time += wait_time;
+    if (decode->surface_wait_max < wait_time)
+        decode->surface_wait_max = wait_time;
+    GST_OBJECT_UNLOCK(decode);
+
+    GST_LOG("waited %" GST_TIME_FORMAT " for a free VA surface",
+            GST_TIME_ARGS(wait_time));
+    return success;
+}
+
+static GstFlowReturn
+gst_vaapidecode_push_surface(GstVaapiDecode *decode, GstVaapiSurfaceProxy *proxy)
+{
+    GstBuffer *buffer;
+    GstFlowReturn ret;
+
+    buffer = gst_vaapi_video_buffer_new(decode->display);
+    if (!buffer)
+        goto error_create_buffer;
+
+    GST_BUFFER_TIMESTAMP(buffer) = GST_VAAPI_SURFACE_PROXY_TIMESTAMP(proxy);
+    gst_buffer_set_caps(buffer, GST_PAD_CAPS(decode->srcpad));
+
+    if (GST_VAAPI_SURFACE_PROXY_TFF(proxy))
+        GST_BUFFER_FLAG_SET(buffer, GST_VIDEO_BUFFER_TFF);
+
+    gst_vaapi_video_buffer_set_surface_proxy(
+        GST_VAAPI_VIDEO_BUFFER(buffer),
+        proxy
+    );
+
+    g_object_unref(proxy);
+
+    ret = gst_pad_push(decode->srcpad, buffer);
+    if (ret != GST_FLOW_OK)
+        goto error_commit_buffer;
+    return GST_FLOW_OK;
+
+    /* ERRORS */
+error_create_buffer:
+    {
+        const GstVaapiID surface_id =
+            gst_vaapi_surface_get_id(GST_VAAPI_SURFACE_PROXY_SURFACE(proxy));
 
-    g_mutex_lock(decode->decoder_mutex);
-    g_cond_signal(decode->decoder_ready);
-    g_mutex_unlock(decode->decoder_mutex);
+        GST_DEBUG("video sink failed to create video buffer for proxy'ed "
+                  "surface %" GST_VAAPI_ID_FORMAT,
+                  GST_VAAPI_ID_ARGS(surface_id));
+        g_object_unref(proxy);
+        return GST_FLOW_UNEXPECTED;
+    }
+error_commit_buffer:
+    {
+        GST_DEBUG("video sink rejected the video buffer (error %d)", ret);
+        return GST_FLOW_UNEXPECTED;
+    }
 }
 
 static GstFlowReturn
@@ -187,30 +270,15 @@ gst_vaapidecode_step(GstVaapiDecode *decode)
 {
     GstVaapiSurfaceProxy *proxy;
     GstVaapiDecoderStatus status;
-    GstBuffer *buffer;
     GstFlowReturn ret;
-    guint tries;
 
     for (;;) {
-        tries = 0;
-    again:
         proxy = gst_vaapi_decoder_get_surface(decode->decoder, &status);
         if (!proxy) {
             if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_SURFACE) {
-                /* Wait for a VA surface to be displayed and free'd */
-                if (++tries > 100)
+                if (!gst_vaapidecode_wait_surface(decode))
                     goto error_decode_timeout;
-                GTimeVal timeout;
-                g_get_current_time(&timeout);
-                g_time_val_add(&timeout, 10000); /* 10 ms each step */
-                g_mutex_lock(decode->decoder_mutex);
-                g_cond_timed_wait(
-                    decode->decoder_ready,
-                    decode->decoder_mutex,
-                    &timeout
-                );
-                g_mutex_unlock(decode->decoder_mutex);
-                goto again;
+                continue;
             }
             if (status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
                 goto error_decode;
@@ -218,32 +286,9 @@ gst_vaapidecode_step(GstVaapiDecode *decode)
             break;
         }
 
-        g_object_weak_ref(
-            G_OBJECT(proxy),
-            (GWeakNotify)gst_vaapidecode_release,
-            decode
-        );
-
-        buffer = gst_vaapi_video_buffer_new(decode->display);
-        if (!buffer)
-            goto error_create_buffer;
-
-        GST_BUFFER_TIMESTAMP(buffer) = GST_VAAPI_SURFACE_PROXY_TIMESTAMP(proxy);
-        gst_buffer_set_caps(buffer, GST_PAD_CAPS(decode->srcpad));
-
-        if (GST_VAAPI_SURFACE_PROXY_TFF(proxy))
-            GST_BUFFER_FLAG_SET(buffer, GST_VIDEO_BUFFER_TFF);
-
-        gst_vaapi_video_buffer_set_surface_proxy(
-            GST_VAAPI_VIDEO_BUFFER(buffer),
-            proxy
-        );
-
-        ret = gst_pad_push(decode->srcpad, buffer);
+        ret = gst_vaapidecode_push_surface(decode, proxy);
         if (ret != GST_FLOW_OK)
-            goto error_commit_buffer;
-
-        g_object_unref(proxy);
+            return ret;
     }
     return GST_FLOW_OK;
 
@@ -251,7 +296,7 @@ gst_vaapidecode_step(GstVaapiDecode *decode)
 error_decode_timeout:
     {
         GST_DEBUG("decode timeout. Decoder required a VA surface but none "
-                  "got available within one second");
+                  "got available within %u ms", decode->surface_timeout);
         return GST_FLOW_UNEXPECTED;
     }
 error_decode:
@@ -269,25 +314,234 @@ error_decode:
         }
         return ret;
     }
-error_create_buffer:
-    {
-        const GstVaapiID surface_id =
-            gst_vaapi_surface_get_id(GST_VAAPI_SURFACE_PROXY_SURFACE(proxy));
+}
 
-        GST_DEBUG("video sink failed to create video buffer for proxy'ed "
-                  "surface %" GST_VAAPI_ID_FORMAT " (error %d)",
-                  GST_VAAPI_ID_ARGS(surface_id), ret);
-        g_object_unref(proxy);
-        return GST_FLOW_UNEXPECTED;
-    }
-error_commit_buffer:
+static GstFlowReturn
+gst_vaapidecode_decode_buffer(GstVaapiDecode *decode, GstBuffer *buf)
+{
+    if (!gst_vaapi_decoder_put_buffer(decode->decoder, buf))
+        goto error_push_buffer;
+    return gst_vaapidecode_step(decode);
+
+    /* ERRORS */
+error_push_buffer:
     {
-        GST_DEBUG("video sink rejected the video buffer (error %d)", ret);
-        g_object_unref(proxy);
+        GST_DEBUG("failed to push input buffer to decoder");
         return GST_FLOW_UNEXPECTED;
     }
 }
 
+/* Asynchronous decoding: the streaming thread queues the incoming
+   buffers, while the decode thread parses them, submits them to the
+   hardware and pushes the decoded surfaces downstream as soon as they
+   are output */
+
+typedef struct _DecodeQueueItem DecodeQueueItem;
+struct _DecodeQueueItem {
+    GstBuffer          *buffer;
+    GstClockTime        queue_time;
+};
+
+static void
+decode_queue_item_free(DecodeQueueItem *item)
+{
+    gst_buffer_unref(item->buffer);
+    g_slice_free(DecodeQueueItem, item);
+}
+
+static inline guint
+gst_vaapidecode_get_queue_level_unlocked(GstVaapiDecode *decode)
+{
+    return g_queue_get_length(&decode->decode_input) + (decode->decode_busy ? 1 : 0);
+}
+
+static void
+gst_vaapidecode_clear_queue_unlocked(GstVaapiDecode *decode)
+{
+    DecodeQueueItem *item;
+
+    while ((item = g_queue_pop_head(&decode->decode_input)) != NULL)
+        decode_queue_item_free(item);
+}
+
+static gpointer
+gst_vaapidecode_decode_thread(gpointer data)
+{
+    GstVaapiDecode * const decode = data;
+    DecodeQueueItem *item;
+    GstClockTime latency;
+    GstFlowReturn ret;
+
+    g_mutex_lock(decode->decode_lock);
+    for (;;) {
+        while (g_queue_is_empty(&decode->decode_input) && !decode->decode_stop)
+            g_cond_wait(decode->decode_cond, decode->decode_lock);
+        if (decode->decode_stop)
+            break;
+
+        item = g_queue_pop_head(&decode->decode_input);
+        ret = decode->decode_ret;
+        decode->decode_busy = TRUE;
+        g_mutex_unlock(decode->decode_lock);
+
+        /* Buffers queued after an error are dropped */
+        if (ret == GST_FLOW_OK)
+            ret = gst_vaapidecode_decode_buffer(decode, item->buffer);
+        latency = gst_util_get_timestamp() - item->queue_time;
+        decode_queue_item_free(item);
+
+        g_mutex_lock(decode->decode_lock);
+        if (decode->decode_ret == GST_FLOW_OK)
+            decode->decode_ret = ret;
+        decode->queue_latency_count++;
+        decode->queue_latency_total += latency;
+        if (decode->queue_latency_max < latency)
+            decode->queue_latency_max = latency;
+        decode->decode_busy = FALSE;
+        g_cond_broadcast(decode->decode_cond);
+    }
+    g_mutex_unlock(decode->decode_lock);
+    return NULL;
+}
+
+/* Waits until fewer than max_level buffers are pending in the decode
+   thread. Called with decode_lock */
+static GstFlowReturn
+gst_vaapidecode_wait_queue_unlocked(GstVaapiDecode *decode, guint max_level)
+{
+    for (;;) {
+        if (decode->decode_stop)
+            return GST_FLOW_WRONG_STATE;
+        if (decode->decode_ret != GST_FLOW_OK)
+            return decode->decode_ret;
+        if (gst_vaapidecode_get_queue_level_unlocked(decode) < max_level)
+            return GST_FLOW_OK;
+        g_cond_wait(decode->decode_cond, decode->decode_lock);
+    }
+}
+
+static GstFlowReturn
+gst_vaapidecode_queue_buffer(GstVaapiDecode *decode, GstBuffer *buf)
+{
+    DecodeQueueItem *item;
+    GstFlowReturn ret;
+    guint level;
+
+    g_mutex_lock(decode->decode_lock);
+    ret = gst_vaapidecode_wait_queue_unlocked(decode, decode->queue_depth);
+    if (ret != GST_FLOW_OK) {
+        g_mutex_unlock(decode->decode_lock);
+        gst_buffer_unref(buf);
+        return ret;
+    }
+
+    item = g_slice_new(DecodeQueueItem);
+    item->buffer     = buf;
+    item->queue_time = gst_util_get_timestamp();
+    g_queue_push_tail(&decode->decode_input, item);
+    g_cond_broadcast(decode->decode_cond);
+
+    level = gst_vaapidecode_get_queue_level_unlocked(decode);
+    if (decode->queue_level_max < level)
+        decode->queue_level_max = level;
+    g_mutex_unlock(decode->decode_lock);
+    return GST_FLOW_OK;
+}
+
+/* Waits for all queued buffers to be decoded and pushed downstream */
+static GstFlowReturn
+gst_vaapidecode_drain_queue(GstVaapiDecode *decode)
+{
+    GstFlowReturn ret;
+
+    g_mutex_lock(decode->decode_lock);
+    ret = gst_vaapidecode_wait_queue_unlocked(decode, 1);
+    g_mutex_unlock(decode->decode_lock);
+    return ret;
+}
+
+static gboolean
+gst_vaapidecode_start_thread(GstVaapiDecode *decode)
+{
+    decode->decode_ret  = GST_FLOW_OK;
+    decode->decode_stop = FALSE;
+    decode->is_async    = TRUE;
+
+#if GLIB_CHECK_VERSION(2,31,0)
+    decode->decode_thread = g_thread_new("vaapidecode",
+        gst_vaapidecode_decode_thread, decode);
+#else
+    decode->decode_thread = g_thread_create(
+        gst_vaapidecode_decode_thread, decode, TRUE, NULL);
+#endif
+    if (!decode->decode_thread) {
+        GST_DEBUG("failed to create decode thread");
+        decode->is_async = FALSE;
+        return FALSE;
+    }
+    GST_DEBUG("decoding in a separate thread, queue depth %u",
+              decode->queue_depth);
+    return TRUE;
+}
+
+/* Wakes up the decode thread and the streaming thread, so that both
+   give up as soon as possible. The decode thread may still be busy
+   with a buffer, until downstream drops the surfaces it holds or the
+   surface timeout expires */
+static void
+gst_vaapidecode_cancel_thread(GstVaapiDecode *decode)
+{
+    g_mutex_lock(decode->decode_lock);
+    decode->decode_stop = TRUE;
+    g_cond_broadcast(decode->decode_cond);
+    g_mutex_unlock(decode->decode_lock);
+}
+
+/* Waits for the decode thread to exit and drops the buffers it did not
+   decode */
+static void
+gst_vaapidecode_join_thread(GstVaapiDecode *decode)
+{
+    gst_vaapidecode_cancel_thread(decode);
+    g_thread_join(decode->decode_thread);
+    decode->decode_thread = NULL;
+
+    g_mutex_lock(decode->decode_lock);
+    gst_vaapidecode_clear_queue_unlocked(decode);
+    decode->decode_stop = FALSE;
+    decode->decode_ret  = GST_FLOW_OK;
+    g_mutex_unlock(decode->decode_lock);
+}
+
+/* Drops all queued buffers after a flush, and restarts the decode
+   thread */
+static gboolean
+gst_vaapidecode_flush_queue(GstVaapiDecode *decode)
+{
+    if (decode->decode_thread)
+        gst_vaapidecode_join_thread(decode);
+    return gst_vaapidecode_start_thread(decode);
+}
+
+static void
+gst_vaapidecode_stop_thread(GstVaapiDecode *decode)
+{
+    if (!decode->decode_thread)
+        return;
+
+    gst_vaapidecode_join_thread(decode);
+
+    g_mutex_lock(decode->decode_lock);
+    GST_DEBUG("decode queue: max level %u, latency avg %" GST_TIME_FORMAT
+              ", max %" GST_TIME_FORMAT, decode->queue_level_max,
+              GST_TIME_ARGS(decode->queue_latency_count > 0 ?
+                  decode->queue_latency_total / decode->queue_latency_count :
+                  0),
+              GST_TIME_ARGS(decode->queue_latency_max));
+    decode->is_async = FALSE;
+    g_mutex_unlock(decode->decode_lock);
+}
+
 static inline gboolean
 gst_vaapidecode_ensure_display(GstVaapiDecode *decode)
 {
@@ -306,14 +560,6 @@ gst_vaapidecode_create(GstVaapiDecode *decode, GstCaps *caps)
         return FALSE;
     dpy = decode->display;
 
-    decode->decoder_mutex = g_mutex_new();
-    if (!decode->decoder_mutex)
-        return FALSE;
-
-    decode->decoder_ready = g_cond_new();
-    if (!decode->decoder_ready)
-        return FALSE;
-
     structure = gst_caps_get_structure(caps, 0);
     if (!structure)
         return FALSE;
@@ -349,13 +595,25 @@ gst_vaapidecode_create(GstVaapiDecode *decode, GstCaps *caps)
     );
 
     decode->decoder_caps = gst_caps_ref(caps);
+
+    decode->queue_depth = decode->async_depth;
+    if (decode->queue_depth > 0 && !gst_vaapidecode_start_thread(decode))
+        return FALSE;
     return TRUE;
 }
 
 static void
 gst_vaapidecode_destroy(GstVaapiDecode *decode)
 {
+    gst_vaapidecode_stop_thread(decode);
+
     if (decode->decoder) {
+        GST_DEBUG("waited %u times for a free VA surface, "
+                  "total %" GST_TIME_FORMAT ", max %" GST_TIME_FORMAT,
+                  decode->surface_wait_count,
+                  GST_TIME_ARGS(decode->surface_wait_time),
+                  GST_TIME_ARGS(decode->surface_wait_max));
+
         gst_vaapi_decoder_put_buffer(decode->decoder, NULL);
         g_object_unref(decode->decoder);
         decode->decoder = NULL;
@@ -365,17 +623,6 @@ gst_vaapidecode_destroy(GstVaapiDecode *decode)
         gst_caps_unref(decode->decoder_caps);
         decode->decoder_caps = NULL;
     }
-
-    if (decode->decoder_ready) {
-        gst_vaapidecode_release(decode, NULL);
-        g_cond_free(decode->decoder_ready);
-        decode->decoder_ready = NULL;
-    }
-
-    if (decode->decoder_mutex) {
-        g_mutex_free(decode->decoder_mutex);
-        decode->decoder_mutex = NULL;
-    }
 }
 
 static gboolean
@@ -452,9 +699,119 @@ gst_vaapidecode_finalize(GObject *object)
         decode->delayed_new_seg = NULL;
     }
 
+    if (decode->decode_cond) {
+        g_cond_free(decode->decode_cond);
+        decode->decode_cond = NULL;
+    }
+
+    if (decode->decode_lock) {
+        g_mutex_free(decode->decode_lock);
+        decode->decode_lock = NULL;
+    }
+
     G_OBJECT_CLASS(gst_vaapidecode_parent_class)->finalize(object);
 }
 
+static void
+gst_vaapidecode_reset_stats(GstVaapiDecode *decode)
+{
+    GST_OBJECT_LOCK(decode);
+    decode->surface_wait_count  = 0;
+    decode->surface_wait_time   = 0;
+    decode->surface_wait_max    = 0;
+    GST_OBJECT_UNLOCK(decode);
+
+    g_mutex_lock(decode->decode_lock);
+    decode->queue_level_max     = 0;
+    decode->queue_latency_count = 0;
+    decode->queue_latency_total = 0;
+    decode->queue_latency_max   = 0;
+    g_mutex_unlock(decode->decode_lock);
+}
+
+static void
+gst_vaapidecode_set_property(
+    GObject      *object,
+    guint         prop_id,
+    const GValue *value,
+    GParamSpec   *pspec
+)
+{
+    GstVaapiDecode * const decode = GST_VAAPIDECODE(object);
+
+    switch (prop_id) {
+    case PROP_SURFACE_TIMEOUT:
+        decode->surface_timeout = g_value_get_uint(value);
+        break;
+    case PROP_ASYNC_DEPTH:
+        decode->async_depth = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_vaapidecode_get_property(
+    GObject    *object,
+    guint       prop_id,
+    GValue     *value,
+    GParamSpec *pspec
+)
+{
+    GstVaapiDecode * const decode = GST_VAAPIDECODE(object);
+
+    switch (prop_id) {
+    case PROP_SURFACE_TIMEOUT:
+        g_value_set_uint(value, decode->surface_timeout);
+        break;
+    case PROP_SURFACE_WAIT_COUNT:
+        GST_OBJECT_LOCK(decode);
+        g_value_set_uint(value, decode->surface_wait_count);
+        GST_OBJECT_UNLOCK(decode);
+        break;
+    case PROP_SURFACE_WAIT_TIME:
+        GST_OBJECT_LOCK(decode);
+        g_value_set_uint64(value, decode->surface_wait_time);
+        GST_OBJECT_UNLOCK(decode);
+        break;
+    case PROP_SURFACE_WAIT_MAX:
+        GST_OBJECT_LOCK(decode);
+        g_value_set_uint64(value, decode->surface_wait_max);
+        GST_OBJECT_UNLOCK(decode);
+        break;
+    case PROP_ASYNC_DEPTH:
+        g_value_set_uint(value, decode->async_depth);
+        break;
+    case PROP_QUEUE_LEVEL:
+        g_mutex_lock(decode->decode_lock);
+        g_value_set_uint(value,
+            gst_vaapidecode_get_queue_level_unlocked(decode));
+        g_mutex_unlock(decode->decode_lock);
+        break;
+    case PROP_QUEUE_LEVEL_MAX:
+        g_mutex_lock(decode->decode_lock);
+        g_value_set_uint(value, decode->queue_level_max);
+        g_mutex_unlock(decode->decode_lock);
+        break;
+    case PROP_QUEUE_LATENCY_AVG:
+        g_mutex_lock(decode->decode_lock);
+        g_value_set_uint64(value, decode->queue_latency_count > 0 ?
+            decode->queue_latency_total / decode->queue_latency_count : 0);
+        g_mutex_unlock(decode->decode_lock);
+        break;
+    case PROP_QUEUE_LATENCY_MAX:
+        g_mutex_lock(decode->decode_lock);
+        g_value_set_uint64(value, decode->queue_latency_max);
+        g_mutex_unlock(decode->decode_lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
 static GstStateChangeReturn
 gst_vaapidecode_change_state(GstElement *element, GstStateChange transition)
 {
@@ -466,6 +823,7 @@ gst_vaapidecode_change_state(GstElement *element, GstStateChange transition)
         decode->is_ready = TRUE;
         break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+        gst_vaapidecode_reset_stats(decode);
         break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
         break;
@@ -504,6 +862,8 @@ gst_vaapidecode_class_init(GstVaapiDecodeClass *klass)
                             GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
 
     object_class->finalize      = gst_vaapidecode_finalize;
+    object_class->set_property  = gst_vaapidecode_set_property;
+    object_class->get_property  = gst_vaapidecode_get_property;
 
     element_class->change_state = gst_vaapidecode_change_state;
 
@@ -524,6 +884,151 @@ gst_vaapidecode_class_init(GstVaapiDecodeClass *klass)
     pad_template = gst_static_pad_template_get(&gst_vaapidecode_src_factory);
     gst_element_class_add_pad_template(element_class, pad_template);
     gst_object_unref(pad_template);
+
+    /**
+     * GstVaapiDecode:surface-timeout:
+     *
+     * The maximum time, in milliseconds, to wait for a VA surface to
+     * be released downstream when all of them are in use. Decoding
+     * resumes as soon as a surface is released. A value of zero
+     * disables waiting, i.e. decoding fails immediately.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_SURFACE_TIMEOUT,
+         g_param_spec_uint("surface-timeout",
+                           "Surface timeout",
+                           "Maximum time to wait for a free VA surface (ms)",
+                           0, G_MAXUINT, DEFAULT_SURFACE_TIMEOUT,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:surface-wait-count:
+     *
+     * The number of times the decoder had to wait for a free VA
+     * surface since the element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_SURFACE_WAIT_COUNT,
+         g_param_spec_uint("surface-wait-count",
+                           "Surface wait count",
+                           "Number of waits for a free VA surface",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:surface-wait-time:
+     *
+     * The accumulated time, in nanoseconds, spent waiting for free VA
+     * surfaces since the element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_SURFACE_WAIT_TIME,
+         g_param_spec_uint64("surface-wait-time",
+                             "Surface wait time",
+                             "Total time spent waiting for free VA surfaces",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:surface-wait-max:
+     *
+     * The longest time, in nanoseconds, spent waiting for a free VA
+     * surface since the element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_SURFACE_WAIT_MAX,
+         g_param_spec_uint64("surface-wait-max",
+                             "Surface wait max",
+                             "Longest time spent waiting for a free VA surface",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:async-depth:
+     *
+     * The maximum number of input buffers queued to a dedicated
+     * decode thread. When non-zero, bitstream parsing, VA submission
+     * and the pushing of decoded surfaces downstream run in that
+     * thread, while the streaming thread only queues buffers. A value
+     * of zero decodes in the streaming thread. Changes take effect
+     * when the decoder is created, i.e. on the next caps change.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_ASYNC_DEPTH,
+         g_param_spec_uint("async-depth",
+                           "Async depth",
+                           "Number of buffers queued to the decode thread "
+                           "(0: decode in the streaming thread)",
+                           0, G_MAXUINT, DEFAULT_ASYNC_DEPTH,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:queue-level:
+     *
+     * The number of input buffers currently queued to, or being
+     * decoded by, the decode thread.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_QUEUE_LEVEL,
+         g_param_spec_uint("queue-level",
+                           "Queue level",
+                           "Number of buffers pending in the decode thread",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:queue-level-max:
+     *
+     * The highest #GstVaapiDecode:queue-level reached since the
+     * element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_QUEUE_LEVEL_MAX,
+         g_param_spec_uint("queue-level-max",
+                           "Queue level max",
+                           "Highest number of buffers pending in the decode "
+                           "thread",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:queue-latency-avg:
+     *
+     * The average time, in nanoseconds, between an input buffer being
+     * queued and the decode thread being done with it, since the
+     * element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_QUEUE_LATENCY_AVG,
+         g_param_spec_uint64("queue-latency-avg",
+                             "Queue latency avg",
+                             "Average time from queueing to decoding a buffer",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiDecode:queue-latency-max:
+     *
+     * The longest time, in nanoseconds, between an input buffer being
+     * queued and the decode thread being done with it, since the
+     * element went to PAUSED state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_QUEUE_LATENCY_MAX,
+         g_param_spec_uint64("queue-latency-max",
+                             "Queue latency max",
+                             "Longest time from queueing to decoding a buffer",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static gboolean
@@ -628,20 +1133,14 @@ static GstFlowReturn
 gst_vaapidecode_chain(GstPad *pad, GstBuffer *buf)
 {
     GstVaapiDecode * const decode = GST_VAAPIDECODE(GST_OBJECT_PARENT(pad));
+    GstFlowReturn ret;
 
-    if (!gst_vaapi_decoder_put_buffer(decode->decoder, buf))
-        goto error_push_buffer;
+    if (decode->is_async)
+        return gst_vaapidecode_queue_buffer(decode, buf);
 
+    ret = gst_vaapidecode_decode_buffer(decode, buf);
     gst_buffer_unref(buf);
-    return gst_vaapidecode_step(decode);
-
-    /* ERRORS */
-error_push_buffer:
-    {
-        GST_DEBUG("failed to push input buffer to decoder");
-        gst_buffer_unref(buf);
-        return GST_FLOW_UNEXPECTED;
-    }
+    return ret;
 }
 
 static gboolean
@@ -651,6 +1150,22 @@ gst_vaapidecode_sink_event(GstPad *pad, GstEvent *event)
 
     GST_DEBUG("handle sink event '%s'", GST_EVENT_TYPE_NAME(event));
 
+    /* Serialized events must follow the surfaces decoded so far */
+    if (decode->is_async) {
+        switch (GST_EVENT_TYPE(event)) {
+        case GST_EVENT_FLUSH_START:
+            gst_vaapidecode_cancel_thread(decode);
+            break;
+        case GST_EVENT_FLUSH_STOP:
+            gst_vaapidecode_flush_queue(decode);
+            break;
+        default:
+            if (GST_EVENT_IS_SERIALIZED(event))
+                gst_vaapidecode_drain_queue(decode);
+            break;
+        }
+    }
+
     /* Propagate event downstream */
     switch (GST_EVENT_TYPE(event)) {
     case GST_EVENT_NEWSEGMENT:
@@ -704,12 +1219,28 @@ gst_vaapidecode_init(GstVaapiDecode *decode)
 
     decode->display             = NULL;
     decode->decoder             = NULL;
-    decode->decoder_mutex       = NULL;
-    decode->decoder_ready       = NULL;
     decode->decoder_caps        = NULL;
     decode->allowed_caps        = NULL;
     decode->delayed_new_seg     = NULL;
+    decode->surface_timeout     = DEFAULT_SURFACE_TIMEOUT;
+    decode->surface_wait_count  = 0;
+    decode->surface_wait_time   = 0;
+    decode->surface_wait_max    = 0;
+    decode->decode_thread       = NULL;
+    decode->decode_lock         = g_mutex_new();
+    decode->decode_cond         = g_cond_new();
+    decode->decode_ret          = GST_FLOW_OK;
+    decode->async_depth         = DEFAULT_ASYNC_DEPTH;
+    decode->queue_depth         = 0;
+    decode->queue_level_max     = 0;
+    decode->queue_latency_count = 0;
+    decode->queue_latency_total = 0;
+    decode->queue_latency_max   = 0;
     decode->is_ready            = FALSE;
+    decode->is_async            = FALSE;
+    decode->decode_busy         = FALSE;
+    decode->decode_stop         = FALSE;
+    g_queue_init(&decode->decode_input);
 
     /* Pad through which data comes in to the element */
     decode->sinkpad = gst_pad_new_from_template(
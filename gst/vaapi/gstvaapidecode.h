@@ -67,12 +67,28 @@ struct _GstVaapiDecode {
     GstCaps            *srcpad_caps;
     GstVaapiDisplay    *display;
     GstVaapiDecoder    *decoder;
-    GMutex             *decoder_mutex;
-    GCond              *decoder_ready;
     GstCaps            *decoder_caps;
     GstCaps            *allowed_caps;
     GstEvent           *delayed_new_seg;
+    guint               surface_timeout;
+    guint               surface_wait_count;
+    GstClockTime        surface_wait_time;
+    GstClockTime        surface_wait_max;
+    GThread            *decode_thread;
+    GMutex             *decode_lock;
+    GCond              *decode_cond;
+    GQueue              decode_input;
+    GstFlowReturn       decode_ret;
+    gboolean            decode_busy;
+    gboolean            decode_stop;
+    guint               async_depth;
+    guint               queue_depth;
+    guint               queue_level_max;
+    guint               queue_latency_count;
+    GstClockTime        queue_latency_total;
+    GstClockTime        queue_latency_max;
     unsigned int        is_ready        : 1;
+    unsigned int        is_async        : 1;
 };
 
 struct _GstVaapiDecodeClass {
@@ -25,6 +25,19 @@
  * @short_description: A VA to video flow filter
  *
  * vaapidownload converts from VA surfaces to raw YUV pixels.
+ *
+ * With drivers that support vaDeriveImage(), the pixels are read
+ * straight from the surface memory. If #GstVaapiDownload:zero-copy is
+ * set, the mapped surface is even pushed downstream as is, provided
+ * its layout is the one GStreamer expects for the negotiated caps and
+ * the decoder no longer uses it as a reference picture.
+ *
+ * If #GstVaapiDownload:readback-depth is set, surfaces are rather
+ * fetched with vaGetImage() in a separate thread, that many frames
+ * ahead of the one being copied to the output buffer. Frames are
+ * delayed by as much, but the wait for the GPU and the transfer
+ * overlap with the copy of the previous frames. Each surface is
+ * released as soon as it is fetched.
  */
 
 #include "config.h"
@@ -32,6 +45,7 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <gst/video/videocontext.h>
+#include <gst/vaapi/gstvaapireadback.h>
 #include <gst/vaapi/gstvaapivideobuffer.h>
 
 #include "gstvaapidownload.h"
@@ -81,6 +95,15 @@ struct _TransformSizeCache {
     guint               size;
 };
 
+/* A derived image mapped into an output buffer. The input buffer is
+   held so that the surface is not decoded to before the output buffer
+   is released, and the image is destroyed along with the surface proxy */
+typedef struct _MappedImage MappedImage;
+struct _MappedImage {
+    GstVaapiImage      *image;
+    GstBuffer          *buffer;
+};
+
 struct _GstVaapiDownload {
     /*< private >*/
     GstBaseTransform    parent_instance;
@@ -92,7 +115,14 @@ struct _GstVaapiDownload {
     GstVaapiImageFormat image_format;
     guint               image_width;
     guint               image_height;
-    unsigned int        images_reset    : 1;
+    GstVaapiReadback   *readback;
+    GstCaps            *readback_caps;
+    guint               readback_size;
+    guint               readback_depth;
+    unsigned int        images_reset        : 1;
+    unsigned int        zero_copy           : 1;
+    unsigned int        has_derive_image    : 1;
+    unsigned int        copy_derived_image  : 1;
 };
 
 struct _GstVaapiDownloadClass {
@@ -100,6 +130,27 @@ struct _GstVaapiDownloadClass {
     GstBaseTransformClass parent_class;
 };
 
+#define DEFAULT_ZERO_COPY       FALSE
+#define DEFAULT_READBACK_DEPTH  0
+
+/* Decoders allocate 4 surfaces beyond their reference frames, and up
+   to depth + 1 surfaces are held until they are fetched */
+#define MAX_READBACK_DEPTH      3
+
+enum {
+    PROP_0,
+
+    PROP_ZERO_COPY,
+    PROP_READBACK_DEPTH,
+};
+
+static const gchar *g_readback_stage_names[GST_VAAPI_READBACK_STAGE_COUNT] = {
+    "queue", "fetch", "wait", "copy", "latency"
+};
+
+/* Key of the image derived from a surface, kept as surface proxy data */
+static GQuark g_derived_image_quark;
+
 static void
 gst_vaapidownload_implements_iface_init(GstImplementsInterfaceClass *iface);
 
@@ -132,6 +183,18 @@ gst_vaapidownload_transform(
     GstBuffer        *outbuf
 );
 
+static GstFlowReturn
+gst_vaapidownload_prepare_output_buffer(
+    GstBaseTransform *trans,
+    GstBuffer        *inbuf,
+    gint              size,
+    GstCaps          *caps,
+    GstBuffer       **poutbuf
+);
+
+static gboolean
+gst_vaapidownload_event(GstBaseTransform *trans, GstEvent *event);
+
 static GstCaps *
 gst_vaapidownload_transform_caps(
     GstBaseTransform *trans,
@@ -195,11 +258,38 @@ gst_video_context_interface_init(GstVideoContextInterface *iface)
     iface->set_context = gst_vaapidownload_set_video_context;
 }
 
+static void
+gst_vaapidownload_destroy_readback(GstVaapiDownload *download)
+{
+    GstVaapiReadbackStageStats stats;
+    guint i;
+
+    if (!download->readback)
+        return;
+
+    for (i = 0; i < GST_VAAPI_READBACK_STAGE_COUNT; i++) {
+        gst_vaapi_readback_get_stage_stats(download->readback, i, &stats);
+        GST_INFO("readback %-8s %" G_GUINT64_FORMAT " frames, avg %"
+                 GST_TIME_FORMAT ", max %" GST_TIME_FORMAT,
+                 g_readback_stage_names[i], stats.count,
+                 GST_TIME_ARGS(stats.count > 0 ?
+                     stats.total_time / stats.count : 0),
+                 GST_TIME_ARGS(stats.max_time));
+    }
+
+    gst_vaapi_readback_free(download->readback);
+    download->readback = NULL;
+    gst_caps_replace(&download->readback_caps, NULL);
+    download->readback_size = 0;
+}
+
 static void
 gst_vaapidownload_destroy(GstVaapiDownload *download)
 {
     guint i;
 
+    gst_vaapidownload_destroy_readback(download);
+
     for (i = 0; i < G_N_ELEMENTS(download->transform_size_cache); i++) {
         TransformSizeCache * const tsc = &download->transform_size_cache[i];
         if (tsc->caps) {
@@ -226,6 +316,56 @@ gst_vaapidownload_finalize(GObject *object)
     G_OBJECT_CLASS(gst_vaapidownload_parent_class)->finalize(object);
 }
 
+static void
+gst_vaapidownload_set_property(
+    GObject      *object,
+    guint         prop_id,
+    const GValue *value,
+    GParamSpec   *pspec
+)
+{
+    GstVaapiDownload * const download = GST_VAAPIDOWNLOAD(object);
+
+    switch (prop_id) {
+    case PROP_ZERO_COPY:
+        GST_OBJECT_LOCK(download);
+        download->zero_copy = g_value_get_boolean(value);
+        GST_OBJECT_UNLOCK(download);
+        break;
+    case PROP_READBACK_DEPTH:
+        GST_OBJECT_LOCK(download);
+        download->readback_depth = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(download);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_vaapidownload_get_property(
+    GObject    *object,
+    guint       prop_id,
+    GValue     *value,
+    GParamSpec *pspec
+)
+{
+    GstVaapiDownload * const download = GST_VAAPIDOWNLOAD(object);
+
+    switch (prop_id) {
+    case PROP_ZERO_COPY:
+        g_value_set_boolean(value, download->zero_copy);
+        break;
+    case PROP_READBACK_DEPTH:
+        g_value_set_uint(value, download->readback_depth);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
 static void
 gst_vaapidownload_class_init(GstVaapiDownloadClass *klass)
 {
@@ -237,7 +377,12 @@ gst_vaapidownload_class_init(GstVaapiDownloadClass *klass)
     GST_DEBUG_CATEGORY_INIT(gst_debug_vaapidownload,
                             GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
 
+    g_derived_image_quark =
+        g_quark_from_static_string("GstVaapiDownloadDerivedImage");
+
     object_class->finalize        = gst_vaapidownload_finalize;
+    object_class->set_property    = gst_vaapidownload_set_property;
+    object_class->get_property    = gst_vaapidownload_get_property;
     trans_class->start            = gst_vaapidownload_start;
     trans_class->stop             = gst_vaapidownload_stop;
     trans_class->before_transform = gst_vaapidownload_before_transform;
@@ -245,6 +390,9 @@ gst_vaapidownload_class_init(GstVaapiDownloadClass *klass)
     trans_class->transform_caps   = gst_vaapidownload_transform_caps;
     trans_class->transform_size   = gst_vaapidownload_transform_size;
     trans_class->set_caps         = gst_vaapidownload_set_caps;
+    trans_class->event            = gst_vaapidownload_event;
+    trans_class->prepare_output_buffer =
+        gst_vaapidownload_prepare_output_buffer;
 
     gst_element_class_set_details_simple(
         element_class,
@@ -263,6 +411,58 @@ gst_vaapidownload_class_init(GstVaapiDownloadClass *klass)
     pad_template = gst_static_pad_template_get(&gst_vaapidownload_src_factory);
     gst_element_class_add_pad_template(element_class, pad_template);
     gst_object_unref(pad_template);
+
+    /**
+     * GstVaapiDownload:zero-copy:
+     *
+     * Pushes the mapped surface pixels downstream instead of a copy,
+     * when the driver supports vaDeriveImage() and the surface layout
+     * matches the negotiated caps. Each output buffer then holds a
+     * decoder surface until it is released, so downstream elements
+     * that queue many buffers can stall the decoder.
+     *
+     * Writing to those buffers would alter the decoded surface. Only
+     * surfaces the decoder no longer uses as reference pictures are
+     * exported, others are copied, and exported buffers are flagged
+     * %GST_BUFFER_FLAG_READONLY. Downstream elements that modify
+     * buffers in place without honouring that flag, e.g. on the sole
+     * grounds of gst_buffer_is_writable(), still alter the surface
+     * until it is recycled.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_ZERO_COPY,
+         g_param_spec_boolean("zero-copy",
+                              "Zero copy",
+                              "Push the mapped surfaces instead of copies",
+                              DEFAULT_ZERO_COPY,
+                              G_PARAM_READWRITE));
+
+    /**
+     * GstVaapiDownload:readback-depth:
+     *
+     * The number of frames fetched from the GPU ahead of the frame
+     * being copied to the output buffer, in a separate thread. This
+     * delays each frame by as many input frames, but hides the wait
+     * for the GPU behind the copies. If zero, each frame is read back
+     * before the next one is accepted. This is not used in zero-copy
+     * mode. Changes take effect on the next start or format change.
+     *
+     * Up to readback-depth + 1 decoder surfaces are held until the
+     * fetch thread transfers them, out of the 4 spare surfaces decoders
+     * allocate beyond their reference frames. Hence the limit of 3.
+     *
+     * The delay is reported in latency queries, as readback-depth frame
+     * durations, so that live pipelines account for it.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_READBACK_DEPTH,
+         g_param_spec_uint("readback-depth",
+                           "Readback depth",
+                           "Number of frames fetched ahead of the one copied",
+                           0, MAX_READBACK_DEPTH, DEFAULT_READBACK_DEPTH,
+                           G_PARAM_READWRITE));
 }
 
 static void
@@ -277,6 +477,13 @@ gst_vaapidownload_init(GstVaapiDownload *download)
     download->image_format      = (GstVaapiImageFormat)0;
     download->image_width       = 0;
     download->image_height      = 0;
+    download->readback          = NULL;
+    download->readback_caps     = NULL;
+    download->readback_size     = 0;
+    download->readback_depth    = DEFAULT_READBACK_DEPTH;
+    download->zero_copy         = DEFAULT_ZERO_COPY;
+    download->has_derive_image  = TRUE;
+    download->copy_derived_image = TRUE;
 
     /* Override buffer allocator on sink pad */
     sinkpad = gst_element_get_static_pad(GST_ELEMENT(download), "sink");
@@ -303,6 +510,9 @@ gst_vaapidownload_start(GstBaseTransform *trans)
 
     if (!gst_vaapidownload_ensure_display(download))
         return FALSE;
+
+    download->has_derive_image   = TRUE;
+    download->copy_derived_image = TRUE;
     return TRUE;
 }
 
@@ -311,26 +521,260 @@ gst_vaapidownload_stop(GstBaseTransform *trans)
 {
     GstVaapiDownload * const download = GST_VAAPIDOWNLOAD(trans);
 
+    gst_vaapidownload_destroy_readback(download);
     g_clear_object(&download->display);
 
     return TRUE;
 }
 
-static GstVaapiImageFormat
-get_surface_format(GstVaapiSurface *surface)
+static void
+derived_image_release(gpointer data, GObject *proxy)
 {
+    g_object_unref(data);
+}
+
+/* Returns a new reference to the image derived from the surface of
+   @vbuffer, or %NULL if the driver cannot derive images. A failure
+   disables derivation until the next caps change. The image is kept
+   along with the surface proxy, so that it is derived once per
+   decoded frame. It is destroyed when the proxy is disposed, before
+   the surface goes back to the decoder */
+static GstVaapiImage *
+get_derived_image(GstVaapiDownload *download, GstVaapiVideoBuffer *vbuffer)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiSurface *surface;
     GstVaapiImage *image;
-    GstVaapiImageFormat format = GST_VAAPI_IMAGE_NV12;
 
-    /* XXX: NV12 is assumed by default */
+    if (!download->has_derive_image)
+        return NULL;
+
+    proxy = gst_vaapi_video_buffer_get_surface_proxy(vbuffer);
+    if (proxy) {
+        image = g_object_get_qdata(G_OBJECT(proxy), g_derived_image_quark);
+        if (image)
+            return g_object_ref(image);
+    }
+
+    surface = gst_vaapi_video_buffer_get_surface(vbuffer);
+    if (!surface)
+        return NULL;
+
     image = gst_vaapi_surface_derive_image(surface);
-    if (image) {
-        format = gst_vaapi_image_get_format(image);
-        g_object_unref(image);
+    if (!image) {
+        GST_INFO("vaDeriveImage() failed, copying surfaces until the next "
+                 "caps change");
+        download->has_derive_image = FALSE;
+        return NULL;
+    }
+
+    if (proxy) {
+        g_object_set_qdata(G_OBJECT(proxy), g_derived_image_quark, image);
+        g_object_weak_ref(G_OBJECT(proxy), derived_image_release,
+                          g_object_ref(image));
     }
+    return image;
+}
+
+static GstVaapiImageFormat
+get_surface_format(GstVaapiDownload *download, GstVaapiVideoBuffer *vbuffer)
+{
+    GstVaapiImageFormat format;
+    GstVaapiImage *image;
+
+    /* XXX: NV12 is assumed by default */
+    image = get_derived_image(download, vbuffer);
+    if (!image)
+        return GST_VAAPI_IMAGE_NV12;
+    format = gst_vaapi_image_get_format(image);
+    g_object_unref(image);
     return format;
 }
 
+/* Checks whether the decoder is done with the surface of @vbuffer,
+   i.e. the DPB released all pictures bound to it. Surfaces without a
+   proxy are not known to be free and are never exported */
+static gboolean
+is_surface_released(GstVaapiVideoBuffer *vbuffer)
+{
+    GstVaapiSurfaceProxy *proxy;
+
+    proxy = gst_vaapi_video_buffer_get_surface_proxy(vbuffer);
+    return proxy && gst_vaapi_surface_proxy_is_decoder_done(proxy);
+}
+
+/* Checks whether the @image pixels have the layout GStreamer expects
+   for @caps, so that they can be pushed downstream as is */
+static gboolean
+image_has_caps_layout(GstVaapiImage *image, GstCaps *caps, guint size)
+{
+    GstVideoFormat format;
+    VAImage va_image;
+    gint width, height, component;
+    guint i;
+
+    if (gst_vaapi_image_get_format(image) !=
+        gst_vaapi_image_format_from_caps(caps))
+        return FALSE;
+    if (!gst_video_format_parse_caps(caps, &format, &width, &height))
+        return FALSE;
+    if (!gst_vaapi_image_get_image(image, &va_image))
+        return FALSE;
+
+    if (va_image.width != width || va_image.height != height)
+        return FALSE;
+    if (size != gst_video_format_get_size(format, width, height))
+        return FALSE;
+    if (va_image.data_size < va_image.offsets[0] + size)
+        return FALSE;
+
+    for (i = 0; i < va_image.num_planes; i++) {
+        /* The chroma planes of YV12 are in V, U order */
+        component = (format == GST_VIDEO_FORMAT_YV12 && i > 0) ? 3 - i : i;
+        if (va_image.pitches[i] !=
+            gst_video_format_get_row_stride(format, component, width))
+            return FALSE;
+        if (i > 0 && va_image.offsets[i] - va_image.offsets[0] !=
+            gst_video_format_get_component_offset(format, component,
+                                                  width, height))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+mapped_image_free(gpointer data)
+{
+    MappedImage * const mapping = data;
+
+    gst_vaapi_image_unmap(mapping->image);
+    g_object_unref(mapping->image);
+    gst_buffer_unref(mapping->buffer);
+    g_slice_free(MappedImage, mapping);
+}
+
+/* Wraps the mapped surface of @inbuf into a new buffer, or returns
+   %NULL if its pixels have to be copied */
+static GstBuffer *
+gst_vaapidownload_export_image(
+    GstVaapiDownload *download,
+    GstBuffer        *inbuf,
+    guint             size,
+    GstCaps          *caps
+)
+{
+    GstVaapiVideoBuffer *vbuffer;
+    GstVaapiSurface *surface;
+    GstVaapiImage *image;
+    MappedImage *mapping;
+    GstBuffer *buffer;
+
+    if (!GST_VAAPI_IS_VIDEO_BUFFER(inbuf))
+        return NULL;
+
+    vbuffer = GST_VAAPI_VIDEO_BUFFER(inbuf);
+    surface = gst_vaapi_video_buffer_get_surface(vbuffer);
+    if (!surface)
+        return NULL;
+
+    /* Reference pictures would be corrupted by writes to the buffer */
+    if (!is_surface_released(vbuffer)) {
+        GST_LOG("surface 0x%08x is still used by the decoder, copying",
+                gst_vaapi_surface_get_id(surface));
+        return NULL;
+    }
+
+    /* The image is still mapped if the surface is pushed twice */
+    image = get_derived_image(download, vbuffer);
+    if (!image)
+        return NULL;
+    if (gst_vaapi_image_is_mapped(image))
+        goto error;
+
+    if (!image_has_caps_layout(image, caps, size)) {
+        GST_LOG("surface 0x%08x layout does not match caps, copying",
+                gst_vaapi_surface_get_id(surface));
+        goto error;
+    }
+
+    if (!gst_vaapi_surface_sync(surface) || !gst_vaapi_image_map(image))
+        goto error;
+
+    mapping         = g_slice_new(MappedImage);
+    mapping->image  = image;
+    mapping->buffer = gst_buffer_ref(inbuf);
+
+    buffer = gst_buffer_new();
+    GST_BUFFER_DATA(buffer)       = gst_vaapi_image_get_plane(image, 0);
+    GST_BUFFER_SIZE(buffer)       = size;
+    GST_BUFFER_MALLOCDATA(buffer) = (guint8 *)mapping;
+    GST_BUFFER_FREE_FUNC(buffer)  = mapped_image_free;
+    GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_READONLY);
+    gst_buffer_set_caps(buffer, caps);
+    return buffer;
+
+error:
+    g_object_unref(image);
+    return NULL;
+}
+
+static gboolean
+gst_vaapidownload_ensure_readback(GstVaapiDownload *download, GstBuffer *outbuf)
+{
+    if (download->readback)
+        return TRUE;
+
+    download->readback = gst_vaapi_readback_new(download->images,
+        download->readback_depth, (GDestroyNotify)gst_mini_object_unref);
+    if (!download->readback)
+        return FALSE;
+
+    gst_caps_replace(&download->readback_caps, GST_BUFFER_CAPS(outbuf));
+    download->readback_size = GST_BUFFER_SIZE(outbuf);
+    GST_DEBUG("reading back surfaces %u frames ahead",
+              download->readback_depth);
+    return TRUE;
+}
+
+/* Pushes the frames still held in the readback pipeline downstream,
+   in order, before a serialized event or a format change */
+static GstFlowReturn
+gst_vaapidownload_drain(GstVaapiDownload *download)
+{
+    GstBaseTransform * const trans = GST_BASE_TRANSFORM(download);
+    GstBuffer *inbuf, *outbuf;
+    GstFlowReturn ret = GST_FLOW_OK;
+    gboolean success;
+
+    if (!download->readback)
+        return GST_FLOW_OK;
+
+    while (ret == GST_FLOW_OK &&
+           gst_vaapi_readback_get_pending(download->readback) > 0) {
+        outbuf = gst_buffer_new_and_alloc(download->readback_size);
+        gst_buffer_set_caps(outbuf, download->readback_caps);
+
+        success = gst_vaapi_readback_pop(download->readback, outbuf,
+            (gpointer *)&inbuf);
+        if (inbuf) {
+            gst_buffer_copy_metadata(outbuf, inbuf,
+                GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
+            gst_buffer_unref(inbuf);
+        }
+        if (!success) {
+            GST_WARNING("failed to read back surface");
+            gst_buffer_unref(outbuf);
+            ret = GST_FLOW_UNEXPECTED;
+            break;
+        }
+        ret = gst_pad_push(trans->srcpad, outbuf);
+    }
+
+    /* Frames left after an error are discarded */
+    gst_vaapi_readback_flush(download->readback);
+    return ret;
+}
+
 static gboolean
 gst_vaapidownload_update_src_caps(GstVaapiDownload *download, GstBuffer *buffer)
 {
@@ -347,7 +791,7 @@ gst_vaapidownload_update_src_caps(GstVaapiDownload *download, GstBuffer *buffer)
         return FALSE;
     }
 
-    format = get_surface_format(surface);
+    format = get_surface_format(download, vbuffer);
     if (format == download->image_format)
         return TRUE;
 
@@ -369,6 +813,9 @@ gst_vaapidownload_update_src_caps(GstVaapiDownload *download, GstBuffer *buffer)
         return FALSE;
     }
 
+    /* Frames held for readback have the previous format */
+    gst_vaapidownload_drain(download);
+
     /* Try to renegotiate downstream caps */
     srcpad = gst_element_get_static_pad(GST_ELEMENT(download), "src");
     gst_pad_set_caps(srcpad, out_caps);
@@ -388,6 +835,51 @@ gst_vaapidownload_before_transform(GstBaseTransform *trans, GstBuffer *buffer)
     gst_vaapidownload_update_src_caps(download, buffer);
 }
 
+/* Queues the surface of @inbuf for readback, and copies the oldest
+   pending frame to @outbuf once the pipeline is full */
+static GstFlowReturn
+gst_vaapidownload_transform_readback(
+    GstVaapiDownload *download,
+    GstVaapiSurface  *surface,
+    GstBuffer        *inbuf,
+    GstBuffer        *outbuf
+)
+{
+    GstVaapiReadback * const readback = download->readback;
+    GstBuffer *buffer;
+    gboolean success;
+
+    /* The input buffer, and thus the surface, is released once fetched.
+       Only its timestamps and flags are kept until the frame is output */
+    buffer = gst_buffer_new();
+    gst_buffer_copy_metadata(buffer, inbuf,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
+
+    if (!gst_vaapi_readback_push(readback, surface, gst_buffer_ref(inbuf),
+                                 buffer)) {
+        gst_buffer_unref(inbuf);
+        gst_buffer_unref(buffer);
+        return GST_FLOW_UNEXPECTED;
+    }
+
+    if (gst_vaapi_readback_get_pending(readback) <=
+        gst_vaapi_readback_get_depth(readback))
+        return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+    /* The output buffer gets the timestamps of the frame read back */
+    success = gst_vaapi_readback_pop(readback, outbuf, (gpointer *)&buffer);
+    if (buffer) {
+        gst_buffer_copy_metadata(outbuf, buffer,
+            GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
+        gst_buffer_unref(buffer);
+    }
+    if (!success) {
+        GST_WARNING("failed to read back surface");
+        return GST_FLOW_UNEXPECTED;
+    }
+    return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_vaapidownload_transform(
     GstBaseTransform *trans,
@@ -401,11 +893,42 @@ gst_vaapidownload_transform(
     GstVaapiImage *image = NULL;
     gboolean success;
 
+    /* The output buffer maps the surface, there is nothing to copy */
+    if (GST_BUFFER_FREE_FUNC(outbuf) == mapped_image_free)
+        return GST_FLOW_OK;
+
     vbuffer = GST_VAAPI_VIDEO_BUFFER(inbuf);
     surface = gst_vaapi_video_buffer_get_surface(vbuffer);
     if (!surface)
         return GST_FLOW_UNEXPECTED;
 
+    if (!download->readback && download->readback_depth > 0 &&
+        !download->zero_copy)
+        gst_vaapidownload_ensure_readback(download, outbuf);
+    if (download->readback)
+        return gst_vaapidownload_transform_readback(download, surface,
+            inbuf, outbuf);
+
+    /* Copy straight from the surface memory, rather than to an image
+       with vaGetImage() and then again to the output buffer */
+    image = download->copy_derived_image ?
+        get_derived_image(download, vbuffer) : NULL;
+    if (image) {
+        success = FALSE;
+        if (!gst_vaapi_image_is_mapped(image) &&
+            gst_vaapi_surface_sync(surface)) {
+            success = gst_vaapi_image_get_buffer(image, outbuf, NULL);
+            if (!success) {
+                GST_INFO("failed to copy from derived image, "
+                         "using vaGetImage()");
+                download->copy_derived_image = FALSE;
+            }
+        }
+        g_object_unref(image);
+        if (success)
+            return GST_FLOW_OK;
+    }
+
     image = gst_vaapi_video_pool_get_object(download->images);
     if (!image)
         return GST_FLOW_UNEXPECTED;
@@ -435,6 +958,50 @@ error_get_buffer:
     }
 }
 
+static GstFlowReturn
+gst_vaapidownload_prepare_output_buffer(
+    GstBaseTransform *trans,
+    GstBuffer        *inbuf,
+    gint              size,
+    GstCaps          *caps,
+    GstBuffer       **poutbuf
+)
+{
+    GstVaapiDownload * const download = GST_VAAPIDOWNLOAD(trans);
+    GstBuffer *buffer = NULL;
+
+    /* Mapped surfaces would overtake the frames held for readback */
+    if (download->zero_copy && !download->readback)
+        buffer = gst_vaapidownload_export_image(download, inbuf, size, caps);
+    if (buffer) {
+        *poutbuf = buffer;
+        return GST_FLOW_OK;
+    }
+    return gst_pad_alloc_buffer_and_set_caps(trans->srcpad,
+        GST_BUFFER_OFFSET(inbuf), size, caps, poutbuf);
+}
+
+static gboolean
+gst_vaapidownload_event(GstBaseTransform *trans, GstEvent *event)
+{
+    GstVaapiDownload * const download = GST_VAAPIDOWNLOAD(trans);
+
+    if (download->readback) {
+        switch (GST_EVENT_TYPE(event)) {
+        case GST_EVENT_FLUSH_STOP:
+            gst_vaapi_readback_flush(download->readback);
+            break;
+        default:
+            /* The frames held for readback precede the event, e.g. EOS */
+            if (GST_EVENT_IS_SERIALIZED(event))
+                gst_vaapidownload_drain(download);
+            break;
+        }
+    }
+    return GST_BASE_TRANSFORM_CLASS(gst_vaapidownload_parent_class)->event(
+        trans, event);
+}
+
 static GstCaps *
 gst_vaapidownload_transform_caps(
     GstBaseTransform *trans,
@@ -521,6 +1088,8 @@ gst_vaapidownload_ensure_image_pool(GstVaapiDownload *download, GstCaps *caps)
         download->image_format = format;
         download->image_width  = width;
         download->image_height = height;
+        gst_vaapidownload_drain(download);
+        gst_vaapidownload_destroy_readback(download);
         g_clear_object(&download->images);
         download->images = gst_vaapi_image_pool_new(download->display, caps);
         if (!download->images)
@@ -553,6 +1122,9 @@ gst_vaapidownload_set_caps(
 
     if (!gst_vaapidownload_negotiate_buffers(download, incaps, outcaps))
         return FALSE;
+
+    /* Surfaces of the new stream may be derivable again */
+    download->has_derive_image = TRUE;
     return TRUE;
 }
 
@@ -601,6 +1173,61 @@ gst_vaapidownload_transform_size(
     return TRUE;
 }
 
+/* Returns the duration of @n frames at the framerate of @caps, or
+   GST_CLOCK_TIME_NONE if the framerate is not known */
+static GstClockTime
+get_frames_duration(GstCaps *caps, guint n)
+{
+    gint fps_n, fps_d;
+
+    if (!caps || !gst_video_parse_caps_framerate(caps, &fps_n, &fps_d))
+        return GST_CLOCK_TIME_NONE;
+    if (fps_n <= 0 || fps_d <= 0)
+        return GST_CLOCK_TIME_NONE;
+    return gst_util_uint64_scale_int(n * GST_SECOND, fps_d, fps_n);
+}
+
+/* Frames read back are output readback-depth input frames late, which
+   the upstream latency has to account for */
+static gboolean
+gst_vaapidownload_query_latency(GstVaapiDownload *download, GstQuery *query)
+{
+    GstClockTime min_latency, max_latency, latency;
+    gboolean live;
+    GstPad *sinkpad;
+    guint depth;
+
+    sinkpad = gst_element_get_static_pad(GST_ELEMENT(download), "sink");
+    if (!gst_pad_peer_query(sinkpad, query)) {
+        gst_object_unref(sinkpad);
+        return FALSE;
+    }
+
+    GST_OBJECT_LOCK(download);
+    depth = download->zero_copy ? 0 : download->readback_depth;
+    GST_OBJECT_UNLOCK(download);
+
+    latency = depth > 0 ?
+        get_frames_duration(GST_PAD_CAPS(sinkpad), depth) : 0;
+    gst_object_unref(sinkpad);
+    if (!GST_CLOCK_TIME_IS_VALID(latency)) {
+        GST_WARNING("unknown framerate, cannot report readback latency");
+        return TRUE;
+    }
+    if (latency == 0)
+        return TRUE;
+
+    gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+    min_latency += latency;
+    if (GST_CLOCK_TIME_IS_VALID(max_latency))
+        max_latency += latency;
+    gst_query_set_latency(query, live, min_latency, max_latency);
+
+    GST_DEBUG("readback of %u frames adds %" GST_TIME_FORMAT " latency",
+              depth, GST_TIME_ARGS(latency));
+    return TRUE;
+}
+
 static gboolean
 gst_vaapidownload_query(GstPad *pad, GstQuery *query)
 {
@@ -609,7 +1236,10 @@ gst_vaapidownload_query(GstPad *pad, GstQuery *query)
 
     GST_DEBUG("sharing display %p", download->display);
 
-    if (gst_vaapi_reply_to_query(query, download->display))
+    if (GST_QUERY_TYPE(query) == GST_QUERY_LATENCY &&
+        GST_PAD_DIRECTION(pad) == GST_PAD_SRC)
+        res = gst_vaapidownload_query_latency(download, query);
+    else if (gst_vaapi_reply_to_query(query, download->display))
         res = TRUE;
     else
         res = gst_pad_query_default(pad, query);
@@ -27,6 +27,11 @@
  * vaapisink renders video frames to a drawable (X #Window) on a local
  * display using the Video Acceleration (VA) API. The element will
  * create its own internal window and render into it.
+ *
+ * With a DRM display, vaapisink renders headless: frames are not
+ * shown, but each surface is waited for as if it were scanned out,
+ * optionally at the pace of a simulated display, and then released.
+ * This is useful to load-test decoding without a window system.
  */
 
 #include "config.h"
@@ -35,6 +40,7 @@
 #include <gst/video/videocontext.h>
 #include <gst/vaapi/gstvaapivalue.h>
 #include <gst/vaapi/gstvaapivideobuffer.h>
+#include <gst/vaapi/gstvaapitrace.h>
 #if USE_DRM
 # include <gst/vaapi/gstvaapidisplay_drm.h>
 #endif
@@ -107,10 +113,19 @@ enum {
     PROP_SYNCHRONOUS,
     PROP_USE_REFLECTION,
     PROP_ROTATION,
+    PROP_FRAMES_IN_FLIGHT,
+    PROP_REFRESH_RATE,
+    PROP_FRAMES_PRESENTED,
+    PROP_FRAMES_LATE,
+    PROP_LATENCY_AVG,
+    PROP_LATENCY_MAX,
 };
 
 #define DEFAULT_DISPLAY_TYPE            GST_VAAPI_DISPLAY_TYPE_ANY
 #define DEFAULT_ROTATION                GST_VAAPI_ROTATION_0
+#define DEFAULT_FRAMES_IN_FLIGHT        1
+#define MAX_FRAMES_IN_FLIGHT            2
+#define DEFAULT_REFRESH_RATE            0
 
 /* GstImplementsInterface interface */
 
@@ -222,9 +237,37 @@ gst_vaapisink_xoverlay_iface_init(GstXOverlayClass *iface)
     iface->expose               = gst_vaapisink_xoverlay_expose;
 }
 
+#if USE_DRM
+/* A frame queued for headless presentation */
+typedef struct _HeadlessFrame HeadlessFrame;
+struct _HeadlessFrame {
+    GstBuffer          *buffer;
+    GstClockTime        queued_time;
+};
+
+static void
+headless_frame_free(HeadlessFrame *frame)
+{
+    gst_buffer_unref(frame->buffer);
+    g_slice_free(HeadlessFrame, frame);
+}
+#endif
+
+static void
+gst_vaapisink_reset_headless(GstVaapiSink *sink)
+{
+#if USE_DRM
+    g_queue_foreach(&sink->headless_frames, (GFunc)headless_frame_free, NULL);
+    g_queue_clear(&sink->headless_frames);
+#endif
+    sink->vblank_base  = GST_CLOCK_TIME_NONE;
+    sink->vblank_index = 0;
+}
+
 static void
 gst_vaapisink_destroy(GstVaapiSink *sink)
 {
+    gst_vaapisink_reset_headless(sink);
     gst_buffer_replace(&sink->video_buffer, NULL);
     g_clear_object(&sink->texture);
     g_clear_object(&sink->display);
@@ -561,6 +604,13 @@ gst_vaapisink_start(GstBaseSink *base_sink)
 {
     GstVaapiSink * const sink = GST_VAAPISINK(base_sink);
 
+    GST_OBJECT_LOCK(sink);
+    sink->frames_presented = 0;
+    sink->frames_late      = 0;
+    sink->latency_total    = 0;
+    sink->latency_max      = 0;
+    GST_OBJECT_UNLOCK(sink);
+
     return gst_vaapisink_ensure_display(sink);
 }
 
@@ -569,6 +619,24 @@ gst_vaapisink_stop(GstBaseSink *base_sink)
 {
     GstVaapiSink * const sink = GST_VAAPISINK(base_sink);
 
+#if USE_DRM
+    if (sink->display_type == GST_VAAPI_DISPLAY_TYPE_DRM) {
+        guint64 num_frames;
+
+        GST_OBJECT_LOCK(sink);
+        num_frames = sink->frames_presented + sink->frames_late;
+        GST_INFO("headless rendering: %" G_GUINT64_FORMAT " frames presented, "
+                 "%" G_GUINT64_FORMAT " late, latency avg %" GST_TIME_FORMAT
+                 ", max %" GST_TIME_FORMAT, sink->frames_presented,
+                 sink->frames_late,
+                 GST_TIME_ARGS(num_frames > 0 ?
+                     sink->latency_total / num_frames : 0),
+                 GST_TIME_ARGS(sink->latency_max));
+        GST_OBJECT_UNLOCK(sink);
+    }
+#endif
+
+    gst_vaapisink_reset_headless(sink);
     gst_buffer_replace(&sink->video_buffer, NULL);
     g_clear_object(&sink->window);
     g_clear_object(&sink->display);
@@ -804,6 +872,118 @@ gst_vaapisink_put_surface(
     return TRUE;
 }
 
+#if USE_DRM
+/* Waits for the next vblank of the simulated display, and returns its
+   time. Like page flips, at most one frame is presented per vblank */
+static GstClockTime
+gst_vaapisink_wait_vblank(GstVaapiSink *sink)
+{
+    const GstClockTime period = GST_SECOND / sink->refresh_rate;
+    const GstClockTime now = gst_util_get_timestamp();
+    GstClockTime vblank_time;
+    guint64 index;
+
+    if (!GST_CLOCK_TIME_IS_VALID(sink->vblank_base)) {
+        sink->vblank_base  = now;
+        sink->vblank_index = 0;
+        return now;
+    }
+
+    index = (now - sink->vblank_base + period - 1) / period;
+    if (index <= sink->vblank_index)
+        index = sink->vblank_index + 1;
+    sink->vblank_index = index;
+
+    vblank_time = sink->vblank_base + index * period;
+    if (vblank_time > now)
+        g_usleep((vblank_time - now) / GST_USECOND);
+    return vblank_time;
+}
+
+static gboolean
+gst_vaapisink_present_frame_headless(GstVaapiSink *sink, HeadlessFrame *frame)
+{
+    GstVaapiVideoBuffer * const vbuffer =
+        GST_VAAPI_VIDEO_BUFFER(frame->buffer);
+    GstVaapiSurface * const surface =
+        gst_vaapi_video_buffer_get_surface(vbuffer);
+    GstClockTime period, presented_time, latency;
+    gboolean success;
+
+    GST_VAAPI_TRACE_BEGIN("sink.render", gst_vaapi_surface_get_id(surface));
+
+    /* The surface can only be scanned out once it is decoded */
+    success = gst_vaapi_surface_sync(surface);
+    if (!success)
+        GST_DEBUG("could not sync VA surface");
+
+    if (sink->refresh_rate > 0) {
+        presented_time = gst_vaapisink_wait_vblank(sink);
+        period = GST_SECOND / sink->refresh_rate;
+    }
+    else {
+        presented_time = gst_util_get_timestamp();
+        period = GST_BUFFER_DURATION(frame->buffer);
+    }
+    latency = presented_time > frame->queued_time ?
+        presented_time - frame->queued_time : 0;
+
+    GST_VAAPI_TRACE_END("sink.render", gst_vaapi_surface_get_id(surface));
+
+    /* A frame that took longer than its slot in the flip queue, and
+       the one being displayed, is late. It is still presented, but a
+       real display would have dropped it to catch up */
+    GST_OBJECT_LOCK(sink);
+    if (GST_CLOCK_TIME_IS_VALID(period) &&
+        latency > (sink->frames_in_flight + 1) * period)
+        sink->frames_late++;
+    else
+        sink->frames_presented++;
+    sink->latency_total += latency;
+    if (sink->latency_max < latency)
+        sink->latency_max = latency;
+    GST_OBJECT_UNLOCK(sink);
+
+    /* The presented surface stays in use until the next one replaces
+       it, as if it were scanned out */
+    gst_buffer_replace(&sink->video_buffer, frame->buffer);
+    headless_frame_free(frame);
+    return success;
+}
+
+/* Presents the queued frames beyond @max_frames, oldest first */
+static gboolean
+gst_vaapisink_flush_headless(GstVaapiSink *sink, guint max_frames)
+{
+    gboolean success = TRUE;
+
+    while (g_queue_get_length(&sink->headless_frames) > max_frames) {
+        if (!gst_vaapisink_present_frame_headless(sink,
+                g_queue_pop_head(&sink->headless_frames)))
+            success = FALSE;
+    }
+    return success;
+}
+
+static GstFlowReturn
+gst_vaapisink_show_frame_headless(GstVaapiSink *sink, GstBuffer *buffer)
+{
+    HeadlessFrame *frame;
+
+    if (!gst_vaapi_video_buffer_get_surface(GST_VAAPI_VIDEO_BUFFER(buffer)))
+        return GST_FLOW_UNEXPECTED;
+
+    frame = g_slice_new(HeadlessFrame);
+    frame->buffer      = gst_buffer_ref(buffer);
+    frame->queued_time = gst_util_get_timestamp();
+    g_queue_push_tail(&sink->headless_frames, frame);
+
+    if (!gst_vaapisink_flush_headless(sink, sink->frames_in_flight))
+        return GST_FLOW_UNEXPECTED;
+    return GST_FLOW_OK;
+}
+#endif
+
 static GstFlowReturn
 gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
 {
@@ -820,6 +1000,11 @@ gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
       sink->display = g_object_ref (gst_vaapi_video_buffer_get_display (vbuffer));
     }
 
+#if USE_DRM
+    if (sink->display_type == GST_VAAPI_DISPLAY_TYPE_DRM)
+        return gst_vaapisink_show_frame_headless(sink, buffer);
+#endif
+
     if (!sink->window)
         return GST_FLOW_UNEXPECTED;
 
@@ -834,6 +1019,8 @@ gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
 
     flags = gst_vaapi_video_buffer_get_render_flags(vbuffer);
 
+    GST_VAAPI_TRACE_BEGIN("sink.render", gst_vaapi_surface_get_id(surface));
+
     if (!gst_vaapi_surface_set_subpictures_from_composition(surface,
              composition, TRUE))
         GST_WARNING("could not update subtitles");
@@ -844,11 +1031,6 @@ gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
         success = gst_vaapisink_show_frame_glx(sink, surface, flags);
         break;
 #endif
-#if USE_DRM
-    case GST_VAAPI_DISPLAY_TYPE_DRM:
-        success = TRUE;
-        break;
-#endif
 #if USE_X11
     case GST_VAAPI_DISPLAY_TYPE_X11:
         success = gst_vaapisink_put_surface(sink, surface, flags);
@@ -864,6 +1046,7 @@ gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
         success = FALSE;
         break;
     }
+    GST_VAAPI_TRACE_END("sink.render", gst_vaapi_surface_get_id(surface));
     if (!success)
         return GST_FLOW_UNEXPECTED;
 
@@ -873,6 +1056,44 @@ gst_vaapisink_show_frame(GstBaseSink *base_sink, GstBuffer *buffer)
     return GST_FLOW_OK;
 }
 
+static GstFlowReturn
+gst_vaapisink_preroll(GstBaseSink *base_sink, GstBuffer *buffer)
+{
+#if USE_DRM
+    GstVaapiSink * const sink = GST_VAAPISINK(base_sink);
+
+    /* There is nothing to show before playback starts, the preroll
+       buffer is rendered again then */
+    if (sink->display_type == GST_VAAPI_DISPLAY_TYPE_DRM)
+        return GST_FLOW_OK;
+#endif
+    return gst_vaapisink_show_frame(base_sink, buffer);
+}
+
+static gboolean
+gst_vaapisink_event(GstBaseSink *base_sink, GstEvent *event)
+{
+    GstBaseSinkClass * const parent_class =
+        GST_BASE_SINK_CLASS(gst_vaapisink_parent_class);
+#if USE_DRM
+    GstVaapiSink * const sink = GST_VAAPISINK(base_sink);
+
+    if (sink->display_type == GST_VAAPI_DISPLAY_TYPE_DRM) {
+        switch (GST_EVENT_TYPE(event)) {
+        case GST_EVENT_EOS:
+            gst_vaapisink_flush_headless(sink, 0);
+            break;
+        case GST_EVENT_FLUSH_STOP:
+            gst_vaapisink_reset_headless(sink);
+            break;
+        default:
+            break;
+        }
+    }
+#endif
+    return parent_class->event ? parent_class->event(base_sink, event) : TRUE;
+}
+
 static gboolean
 gst_vaapisink_query(GstBaseSink *base_sink, GstQuery *query)
 {
@@ -915,6 +1136,12 @@ gst_vaapisink_set_property(
     case PROP_ROTATION:
         sink->rotation_req = g_value_get_enum(value);
         break;
+    case PROP_FRAMES_IN_FLIGHT:
+        sink->frames_in_flight = g_value_get_uint(value);
+        break;
+    case PROP_REFRESH_RATE:
+        sink->refresh_rate = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -947,6 +1174,35 @@ gst_vaapisink_get_property(
     case PROP_ROTATION:
         g_value_set_enum(value, sink->rotation);
         break;
+    case PROP_FRAMES_IN_FLIGHT:
+        g_value_set_uint(value, sink->frames_in_flight);
+        break;
+    case PROP_REFRESH_RATE:
+        g_value_set_uint(value, sink->refresh_rate);
+        break;
+    case PROP_FRAMES_PRESENTED:
+        GST_OBJECT_LOCK(sink);
+        g_value_set_uint64(value, sink->frames_presented);
+        GST_OBJECT_UNLOCK(sink);
+        break;
+    case PROP_FRAMES_LATE:
+        GST_OBJECT_LOCK(sink);
+        g_value_set_uint64(value, sink->frames_late);
+        GST_OBJECT_UNLOCK(sink);
+        break;
+    case PROP_LATENCY_AVG:
+        GST_OBJECT_LOCK(sink);
+        g_value_set_uint64(value,
+            sink->frames_presented + sink->frames_late > 0 ?
+            sink->latency_total /
+            (sink->frames_presented + sink->frames_late) : 0);
+        GST_OBJECT_UNLOCK(sink);
+        break;
+    case PROP_LATENCY_MAX:
+        GST_OBJECT_LOCK(sink);
+        g_value_set_uint64(value, sink->latency_max);
+        GST_OBJECT_UNLOCK(sink);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -971,8 +1227,9 @@ gst_vaapisink_class_init(GstVaapiSinkClass *klass)
     basesink_class->start        = gst_vaapisink_start;
     basesink_class->stop         = gst_vaapisink_stop;
     basesink_class->set_caps     = gst_vaapisink_set_caps;
-    basesink_class->preroll      = gst_vaapisink_show_frame;
+    basesink_class->preroll      = gst_vaapisink_preroll;
     basesink_class->render       = gst_vaapisink_show_frame;
+    basesink_class->event        = gst_vaapisink_event;
     basesink_class->query        = gst_vaapisink_query;
 
     gst_element_class_set_details_simple(
@@ -1046,6 +1303,114 @@ gst_vaapisink_class_init(GstVaapiSinkClass *klass)
                            GST_VAAPI_TYPE_ROTATION,
                            DEFAULT_ROTATION,
                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+#if USE_DRM
+    /**
+     * GstVaapiSink:frames-in-flight:
+     *
+     * The number of frames queued for presentation in headless mode,
+     * on a DRM display, besides the one being presented. Decoding of
+     * the queued frames overlaps with the presentation.
+     *
+     * Each queued frame, and the one being presented, holds a decoder
+     * surface. Decoders only allocate 4 surfaces beyond their reference
+     * frames, some of which are needed to decode ahead, hence the limit
+     * of 2.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_FRAMES_IN_FLIGHT,
+         g_param_spec_uint("frames-in-flight",
+                           "Frames in flight",
+                           "Number of frames queued for headless "
+                           "presentation",
+                           0, MAX_FRAMES_IN_FLIGHT, DEFAULT_FRAMES_IN_FLIGHT,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiSink:refresh-rate:
+     *
+     * The refresh rate, in Hz, of the display simulated in headless
+     * mode. Frames are then presented on vblanks, at most one per
+     * vblank. A value of zero presents frames as soon as they are
+     * decoded.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_REFRESH_RATE,
+         g_param_spec_uint("refresh-rate",
+                           "Refresh rate",
+                           "Refresh rate of the simulated headless display "
+                           "(0: no vblank pacing)",
+                           0, 1000, DEFAULT_REFRESH_RATE,
+                           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiSink:frames-presented:
+     *
+     * The number of frames presented on time in headless mode, since
+     * the element went to READY state.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_FRAMES_PRESENTED,
+         g_param_spec_uint64("frames-presented",
+                             "Frames presented",
+                             "Number of frames presented on time",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiSink:frames-late:
+     *
+     * The number of frames that missed their vblank in headless mode,
+     * since the element went to READY state. A frame is late when it
+     * is presented more than #GstVaapiSink:frames-in-flight + 1
+     * refresh periods after it was received, or frame durations if
+     * #GstVaapiSink:refresh-rate is zero. Late frames are still
+     * presented, nothing is dropped.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_FRAMES_LATE,
+         g_param_spec_uint64("frames-late",
+                             "Frames late",
+                             "Number of frames presented too late",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiSink:presentation-latency-avg:
+     *
+     * The average time, in nanoseconds, between a frame being received
+     * and presented in headless mode.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_LATENCY_AVG,
+         g_param_spec_uint64("presentation-latency-avg",
+                             "Presentation latency avg",
+                             "Average time from receiving to presenting "
+                             "a frame",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    /**
+     * GstVaapiSink:presentation-latency-max:
+     *
+     * The longest time, in nanoseconds, between a frame being received
+     * and presented in headless mode.
+     */
+    g_object_class_install_property
+        (object_class,
+         PROP_LATENCY_MAX,
+         g_param_spec_uint64("presentation-latency-max",
+                             "Presentation latency max",
+                             "Longest time from receiving to presenting "
+                             "a frame",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+#endif
 }
 
 static void
@@ -1071,4 +1436,13 @@ gst_vaapisink_init(GstVaapiSink *sink)
     sink->use_reflection = FALSE;
     sink->use_overlay    = FALSE;
     sink->use_rotation   = FALSE;
+    sink->frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+    sink->refresh_rate   = DEFAULT_REFRESH_RATE;
+    sink->vblank_base    = GST_CLOCK_TIME_NONE;
+    sink->vblank_index   = 0;
+    sink->frames_presented = 0;
+    sink->frames_late    = 0;
+    sink->latency_total  = 0;
+    sink->latency_max    = 0;
+    g_queue_init(&sink->headless_frames);
 }
@@ -82,6 +82,15 @@ struct _GstVaapiSink {
     GstVaapiRectangle   display_rect;
     GstVaapiRotation    rotation;
     GstVaapiRotation    rotation_req;
+    GQueue              headless_frames;
+    guint               frames_in_flight;
+    guint               refresh_rate;
+    GstClockTime        vblank_base;
+    guint64             vblank_index;
+    guint64             frames_presented;
+    guint64             frames_late;
+    guint64             latency_total;
+    guint64             latency_max;
     guint               foreign_window  : 1;
     guint               fullscreen      : 1;
     guint               synchronous     : 1;
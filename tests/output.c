@@ -39,6 +39,7 @@
 # include <gst/vaapi/gstvaapiwindow_wayland.h>
 #endif
 #include "output.h"
+#include "stub.h"
 
 static const VideoOutputInfo *g_video_output;
 static const VideoOutputInfo g_video_outputs[] = {
@@ -66,6 +67,11 @@ static const VideoOutputInfo g_video_outputs[] = {
       gst_vaapi_display_drm_new,
       gst_vaapi_window_drm_new
     },
+    /* Stand-in VA driver, never selected automatically */
+    { "stub",
+      stub_display_new,
+      gst_vaapi_window_drm_new
+    },
 #endif
     { NULL, }
 };
@@ -158,6 +164,8 @@ video_output_create_display(const gchar *display_name)
             o = video_output_lookup(g_output_name);
         else {
             for (o = g_video_outputs; o->name != NULL; o++) {
+                if (strcmp(o->name, "stub") == 0)
+                    continue;
                 display = o->create_display(display_name);
                 if (display) {
                     if (gst_vaapi_display_get_display(display))
@@ -0,0 +1,138 @@
+/*
+ *  stub.c - Stand-in VA driver helpers
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <gmodule.h>
+#if USE_DRM
+# include <gst/vaapi/gstvaapidisplay_drm.h>
+#endif
+#include "stub.h"
+
+static void
+close_device(gpointer data, GObject *display)
+{
+    close(GPOINTER_TO_INT(data));
+}
+
+/**
+ * stub_display_new:
+ * @display_name: the DRM device path, or %NULL
+ *
+ * Creates a DRM display that is backed by the stub VA driver. The
+ * driver does not touch the DRM device, so /dev/null is used if no
+ * real DRM device is available.
+ *
+ * Note: this selects the stub driver for all VA displays that are
+ * initialized afterwards in this process.
+ *
+ * Return value: the newly allocated #GstVaapiDisplay, or %NULL
+ */
+GstVaapiDisplay *
+stub_display_new(const gchar *display_name)
+{
+#if USE_DRM
+    GstVaapiDisplay *display;
+    gint fd;
+
+    g_setenv("LIBVA_DRIVER_NAME", STUB_DRIVER_NAME, TRUE);
+    g_setenv("LIBVA_DRIVERS_PATH", STUB_DRIVER_PATH, TRUE);
+
+    display = gst_vaapi_display_drm_new(display_name);
+    if (display && gst_vaapi_display_get_display(display))
+        return display;
+    if (display)
+        g_object_unref(display);
+
+    fd = open("/dev/null", O_RDWR|O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    display = gst_vaapi_display_drm_new_with_device(fd);
+    if (!display) {
+        close(fd);
+        return NULL;
+    }
+    g_object_weak_ref(G_OBJECT(display), close_device, GINT_TO_POINTER(fd));
+    return display;
+#else
+    return NULL;
+#endif
+}
+
+static StubDriverStats *
+lookup_stats(void)
+{
+    static StubDriverStats *stats;
+    GModule *module;
+    gpointer symbol;
+
+    if (stats)
+        return stats;
+
+    /* The VA driver is loaded with RTLD_GLOBAL, so its symbols are
+       visible from the main program */
+    module = g_module_open(NULL, 0);
+    if (!module)
+        return NULL;
+
+    if (g_module_symbol(module, STUB_DRIVER_STATS_SYMBOL, &symbol))
+        stats = symbol;
+    g_module_close(module);
+    return stats;
+}
+
+/**
+ * stub_driver_get_stats:
+ *
+ * Returns the call counters of the stub VA driver, or %NULL if the
+ * driver was not loaded, e.g. a real VA driver is in use.
+ *
+ * Return value: the #StubDriverStats, or %NULL
+ */
+const StubDriverStats *
+stub_driver_get_stats(void)
+{
+    return lookup_stats();
+}
+
+/**
+ * stub_driver_reset_stats:
+ *
+ * Resets all call counters and the parameter checksum of the stub VA
+ * driver, but the number of live VA buffers.
+ */
+void
+stub_driver_reset_stats(void)
+{
+    StubDriverStats * const stats = lookup_stats();
+    guint num_live_buffers;
+
+    if (!stats)
+        return;
+
+    num_live_buffers = stats->num_live_buffers;
+    memset(stats, 0, sizeof(*stats));
+    stats->num_live_buffers = num_live_buffers;
+    stats->param_checksum   = STUB_PARAM_CHECKSUM_INIT;
+}
@@ -0,0 +1,37 @@
+/*
+ *  stub.h - Stand-in VA driver helpers
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef STUB_H
+#define STUB_H
+
+#include <gst/vaapi/gstvaapidisplay.h>
+#include "stub_drv_video.h"
+
+GstVaapiDisplay *
+stub_display_new(const gchar *display_name);
+
+const StubDriverStats *
+stub_driver_get_stats(void);
+
+void
+stub_driver_reset_stats(void);
+
+#endif /* STUB_H */
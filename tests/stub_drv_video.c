@@ -0,0 +1,1320 @@
+/*
+ *  stub_drv_video.c - Call-counting stand-in VA driver
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/* This is a VA driver that does not decode anything. It validates the
+   objects it is passed, keeps buffers in system memory, and counts
+   calls to the driver entry points so that tests can measure how many
+   driver round-trips the decoders perform. It also hashes the submitted
+   parameter buffers, so that tests can check the decoders against
+   golden values without a GPU. Surfaces hold NV12 pixels in system
+   memory, so that images can be uploaded and read back. Load it with:
+
+     LIBVA_DRIVER_NAME=stub LIBVA_DRIVERS_PATH=<builddir>/.libs */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <va/va.h>
+#include <va/va_backend.h>
+#include "stub_drv_video.h"
+
+#ifndef VA_DRIVER_INIT_FUNC
+#define VA_DRIVER_INIT_FUNC_1(major, minor) __vaDriverInit_##major##_##minor
+#define VA_DRIVER_INIT_FUNC_0(major, minor) VA_DRIVER_INIT_FUNC_1(major, minor)
+#define VA_DRIVER_INIT_FUNC \
+    VA_DRIVER_INIT_FUNC_0(VA_MAJOR_VERSION, VA_MINOR_VERSION)
+#endif
+
+#define STUB_MAX_PROFILES               16
+#define STUB_MAX_ENTRYPOINTS            1
+#define STUB_MAX_ATTRIBUTES             1
+#define STUB_MAX_IMAGE_FORMATS          4
+#define STUB_MAX_SUBPIC_FORMATS         1
+#define STUB_MAX_DISPLAY_ATTRIBUTES     1
+
+StubDriverStats stub_drv_video_stats = {
+    .param_checksum = STUB_PARAM_CHECKSUM_INIT,
+};
+
+#define STUB_CALL(name) \
+    (stub_drv_video_stats.num_calls++, stub_drv_video_stats.name++)
+
+typedef enum {
+    STUB_OBJECT_CONFIG = 1,
+    STUB_OBJECT_SURFACE,
+    STUB_OBJECT_CONTEXT,
+    STUB_OBJECT_BUFFER,
+    STUB_OBJECT_IMAGE,
+    STUB_OBJECT_SUBPICTURE
+} StubObjectType;
+
+typedef struct _StubObject StubObject;
+struct _StubObject {
+    StubObjectType      type;
+    union {
+        struct {
+            VAProfile           profile;
+            VAEntrypoint        entrypoint;
+        }                   config;
+        struct {
+            guint               width;
+            guint               height;
+            guint8             *data;           /* NV12 pixels, or NULL */
+            guint               picture_num;    /* last picture decoded */
+        }                   surface;
+        struct {
+            VAConfigID          config_id;
+            VASurfaceID         render_target;
+        }                   context;
+        struct {
+            VABufferType        type;
+            guint               size;
+            guint               num_elements;
+            guint8             *data;
+        }                   buffer;
+        VAImage             image;
+        struct {
+            VAImageID           image_id;
+        }                   subpicture;
+    }                   u;
+};
+
+typedef struct _StubDriverData StubDriverData;
+struct _StubDriverData {
+    GHashTable         *objects;
+    guint               next_id;
+    gulong              get_image_delay;        /* in microseconds */
+};
+
+static const VAProfile g_profiles[] = {
+    VAProfileMPEG2Simple,
+    VAProfileMPEG2Main,
+    VAProfileMPEG4Simple,
+    VAProfileMPEG4AdvancedSimple,
+    VAProfileMPEG4Main,
+    VAProfileH264ConstrainedBaseline,
+    VAProfileH264Baseline,
+    VAProfileH264Main,
+    VAProfileH264High,
+    VAProfileVC1Simple,
+    VAProfileVC1Main,
+    VAProfileVC1Advanced,
+    VAProfileJPEGBaseline,
+};
+
+static const VAImageFormat g_image_formats[] = {
+    { VA_FOURCC('N','V','1','2'), VA_LSB_FIRST, 12, },
+    { VA_FOURCC('Y','V','1','2'), VA_LSB_FIRST, 12, },
+    { VA_FOURCC('I','4','2','0'), VA_LSB_FIRST, 12, },
+};
+
+static const VAImageFormat g_subpicture_formats[] = {
+    { VA_FOURCC('B','G','R','A'), VA_LSB_FIRST, 32,
+      32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 },
+};
+
+#define STUB_DRIVER_DATA(ctx) ((StubDriverData *)(ctx)->pDriverData)
+
+static void
+stub_object_free(StubObject *object)
+{
+    switch (object->type) {
+    case STUB_OBJECT_SURFACE:
+        g_free(object->u.surface.data);
+        break;
+    case STUB_OBJECT_BUFFER:
+        g_free(object->u.buffer.data);
+        stub_drv_video_stats.num_live_buffers--;
+        break;
+    default:
+        break;
+    }
+    g_slice_free(StubObject, object);
+}
+
+static StubObject *
+stub_object_new(VADriverContextP ctx, StubObjectType type, guint *id_ptr)
+{
+    StubDriverData * const data = STUB_DRIVER_DATA(ctx);
+    StubObject *object;
+
+    object = g_slice_new0(StubObject);
+    object->type = type;
+
+    *id_ptr = ++data->next_id;
+    g_hash_table_insert(data->objects, GUINT_TO_POINTER(*id_ptr), object);
+    return object;
+}
+
+static StubObject *
+stub_object_lookup(VADriverContextP ctx, StubObjectType type, guint id)
+{
+    StubDriverData * const data = STUB_DRIVER_DATA(ctx);
+    StubObject *object;
+
+    object = g_hash_table_lookup(data->objects, GUINT_TO_POINTER(id));
+    if (!object || object->type != type)
+        return NULL;
+    return object;
+}
+
+static gboolean
+stub_object_destroy(VADriverContextP ctx, StubObjectType type, guint id)
+{
+    StubDriverData * const data = STUB_DRIVER_DATA(ctx);
+
+    if (!stub_object_lookup(ctx, type, id))
+        return FALSE;
+    return g_hash_table_remove(data->objects, GUINT_TO_POINTER(id));
+}
+
+static StubObject *
+stub_buffer_new(
+    VADriverContextP    ctx,
+    VABufferType        type,
+    guint               size,
+    guint               num_elements,
+    gconstpointer       buf,
+    VABufferID         *buf_id
+)
+{
+    StubObject *object;
+
+    object = stub_object_new(ctx, STUB_OBJECT_BUFFER, buf_id);
+    object->u.buffer.type         = type;
+    object->u.buffer.size         = size;
+    object->u.buffer.num_elements = num_elements;
+    object->u.buffer.data         = g_malloc0(size * num_elements);
+    if (buf)
+        memcpy(object->u.buffer.data, buf, size * num_elements);
+    stub_drv_video_stats.num_live_buffers++;
+    return object;
+}
+
+/* Returns the NV12 pixels of a surface. They are only allocated on
+   first access, since decoding does not produce any */
+static guint8 *
+stub_surface_get_data(StubObject *object)
+{
+    const guint width  = object->u.surface.width;
+    const guint height = object->u.surface.height;
+
+    if (!object->u.surface.data)
+        object->u.surface.data = g_malloc0(width * height +
+            2 * ((width + 1) / 2) * ((height + 1) / 2));
+    return object->u.surface.data;
+}
+
+/* Copies a rectangle between a surface and a 4:2:0 image, in either
+   direction. Other image formats would need a color conversion, their
+   pixels are left as is */
+static void
+stub_surface_copy(
+    StubObject         *surface,
+    int                 surface_x,
+    int                 surface_y,
+    const VAImage      *image,
+    guint8             *image_data,
+    int                 image_x,
+    int                 image_y,
+    unsigned int        width,
+    unsigned int        height,
+    gboolean            to_image
+)
+{
+    const guint surface_width  = surface->u.surface.width;
+    const guint surface_height = surface->u.surface.height;
+    const guint pitch  = surface_width;
+    const guint pitch2 = 2 * ((surface_width + 1) / 2);
+    guint8 * const data = stub_surface_get_data(surface);
+    guint8 * const data2 = data + pitch * surface_height;
+    guint8 *src, *dst, *plane[2];
+    guint x, y, width2, height2, u_plane;
+
+    if (surface_x < 0 || (guint)surface_x >= surface_width ||
+        surface_y < 0 || (guint)surface_y >= surface_height ||
+        image_x < 0 || image_x >= image->width ||
+        image_y < 0 || image_y >= image->height)
+        return;
+    width  = MIN(width,  MIN(surface_width - surface_x, image->width - image_x));
+    height = MIN(height, MIN(surface_height - surface_y,
+                             image->height - image_y));
+
+    width2  = (width  + 1) / 2;
+    height2 = (height + 1) / 2;
+
+    switch (image->format.fourcc) {
+    case VA_FOURCC('N','V','1','2'):
+    case VA_FOURCC('Y','V','1','2'):
+    case VA_FOURCC('I','4','2','0'):
+        break;
+    default:
+        return;
+    }
+
+    for (y = 0; y < height; y++) {
+        src = data + (surface_y + y) * pitch + surface_x;
+        dst = image_data + image->offsets[0] +
+            (image_y + y) * image->pitches[0] + image_x;
+        if (to_image)
+            memcpy(dst, src, width);
+        else
+            memcpy(src, dst, width);
+    }
+
+    if (image->format.fourcc == VA_FOURCC('N','V','1','2')) {
+        for (y = 0; y < height2; y++) {
+            src = data2 + (surface_y / 2 + y) * pitch2 + surface_x / 2 * 2;
+            dst = image_data + image->offsets[1] +
+                (image_y / 2 + y) * image->pitches[1] + image_x / 2 * 2;
+            if (to_image)
+                memcpy(dst, src, 2 * width2);
+            else
+                memcpy(src, dst, 2 * width2);
+        }
+        return;
+    }
+
+    /* The chroma planes of YV12 are in V, U order */
+    u_plane = image->format.fourcc == VA_FOURCC('Y','V','1','2') ? 2 : 1;
+    for (y = 0; y < height2; y++) {
+        src = data2 + (surface_y / 2 + y) * pitch2 + surface_x / 2 * 2;
+        plane[0] = image_data + image->offsets[u_plane] +
+            (image_y / 2 + y) * image->pitches[u_plane] + image_x / 2;
+        plane[1] = image_data + image->offsets[3 - u_plane] +
+            (image_y / 2 + y) * image->pitches[3 - u_plane] + image_x / 2;
+        for (x = 0; x < width2; x++) {
+            if (to_image) {
+                plane[0][x] = src[2 * x];
+                plane[1][x] = src[2 * x + 1];
+            }
+            else {
+                src[2 * x]     = plane[0][x];
+                src[2 * x + 1] = plane[1][x];
+            }
+        }
+    }
+}
+
+static guint32
+stub_checksum_update(guint32 hash, gconstpointer data, guint size)
+{
+    const guint8 *p = data;
+    guint i;
+
+    for (i = 0; i < size; i++)
+        hash = (hash ^ p[i]) * 16777619u;
+    return hash;
+}
+
+/* Replaces a surface ID with the number of the last picture decoded
+   into that surface, or zero if there is none */
+static void
+stub_normalize_surface(VADriverContextP ctx, VASurfaceID *id_ptr)
+{
+    StubObject *object;
+
+    if (*id_ptr == VA_INVALID_SURFACE)
+        return;
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_SURFACE, *id_ptr);
+    *id_ptr = object ? object->u.surface.picture_num : 0;
+}
+
+static void
+stub_normalize_picture_h264(VADriverContextP ctx, VAPictureH264 *pic,
+    guint num_pics)
+{
+    guint i;
+
+    for (i = 0; i < num_pics; i++)
+        stub_normalize_surface(ctx, &pic[i].picture_id);
+}
+
+/* Rewrites the surface IDs a parameter buffer refers to, so that the
+   checksum does not depend on the order in which surfaces were
+   allocated or recycled */
+static void
+stub_normalize_buffer(VADriverContextP ctx, VAProfile profile,
+    VABufferType type, guint8 *data, guint size, guint num_elements)
+{
+    guint i;
+
+    switch (profile) {
+    case VAProfileH264ConstrainedBaseline:
+    case VAProfileH264Baseline:
+    case VAProfileH264Main:
+    case VAProfileH264High:
+        if (type == VAPictureParameterBufferType &&
+            size >= sizeof(VAPictureParameterBufferH264)) {
+            VAPictureParameterBufferH264 * const pic_param = (gpointer)data;
+
+            stub_normalize_picture_h264(ctx, &pic_param->CurrPic, 1);
+            stub_normalize_picture_h264(ctx, pic_param->ReferenceFrames,
+                G_N_ELEMENTS(pic_param->ReferenceFrames));
+        }
+        else if (type == VASliceParameterBufferType &&
+                 size >= sizeof(VASliceParameterBufferH264)) {
+            for (i = 0; i < num_elements; i++) {
+                VASliceParameterBufferH264 * const slice_param =
+                    (gpointer)(data + i * size);
+
+                stub_normalize_picture_h264(ctx, slice_param->RefPicList0,
+                    G_N_ELEMENTS(slice_param->RefPicList0));
+                stub_normalize_picture_h264(ctx, slice_param->RefPicList1,
+                    G_N_ELEMENTS(slice_param->RefPicList1));
+            }
+        }
+        break;
+    case VAProfileMPEG2Simple:
+    case VAProfileMPEG2Main:
+        if (type == VAPictureParameterBufferType &&
+            size >= sizeof(VAPictureParameterBufferMPEG2)) {
+            VAPictureParameterBufferMPEG2 * const pic_param = (gpointer)data;
+
+            stub_normalize_surface(ctx, &pic_param->forward_reference_picture);
+            stub_normalize_surface(ctx, &pic_param->backward_reference_picture);
+        }
+        break;
+    case VAProfileMPEG4Simple:
+    case VAProfileMPEG4AdvancedSimple:
+    case VAProfileMPEG4Main:
+        if (type == VAPictureParameterBufferType &&
+            size >= sizeof(VAPictureParameterBufferMPEG4)) {
+            VAPictureParameterBufferMPEG4 * const pic_param = (gpointer)data;
+
+            stub_normalize_surface(ctx, &pic_param->forward_reference_picture);
+            stub_normalize_surface(ctx, &pic_param->backward_reference_picture);
+        }
+        break;
+    case VAProfileVC1Simple:
+    case VAProfileVC1Main:
+    case VAProfileVC1Advanced:
+        if (type == VAPictureParameterBufferType &&
+            size >= sizeof(VAPictureParameterBufferVC1)) {
+            VAPictureParameterBufferVC1 * const pic_param = (gpointer)data;
+
+            stub_normalize_surface(ctx, &pic_param->forward_reference_picture);
+            stub_normalize_surface(ctx, &pic_param->backward_reference_picture);
+            stub_normalize_surface(ctx, &pic_param->inloop_decoded_picture);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Accounts for a buffer submitted to vaRenderPicture() */
+static void
+stub_buffer_record(VADriverContextP ctx, VAProfile profile,
+    StubObject *object)
+{
+    StubDriverStats * const stats = &stub_drv_video_stats;
+    const guint32 type = object->u.buffer.type;
+    const guint size = object->u.buffer.size * object->u.buffer.num_elements;
+    guint8 *data;
+
+    if (object->u.buffer.type == VASliceDataBufferType)
+        return;
+
+    data = g_memdup(object->u.buffer.data, size);
+    stub_normalize_buffer(ctx, profile, object->u.buffer.type, data,
+        object->u.buffer.size, object->u.buffer.num_elements);
+
+    stats->num_param_buffers++;
+    stats->param_checksum = stub_checksum_update(stats->param_checksum,
+        &type, sizeof(type));
+    stats->param_checksum = stub_checksum_update(stats->param_checksum,
+        data, size);
+    g_free(data);
+}
+
+static VAStatus
+stub_Terminate(VADriverContextP ctx)
+{
+    StubDriverData * const data = STUB_DRIVER_DATA(ctx);
+
+    stub_drv_video_stats.num_calls++;
+
+    g_hash_table_destroy(data->objects);
+    g_slice_free(StubDriverData, data);
+    ctx->pDriverData = NULL;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryConfigProfiles(
+    VADriverContextP    ctx,
+    VAProfile          *profile_list,
+    int                *num_profiles
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    memcpy(profile_list, g_profiles, sizeof(g_profiles));
+    *num_profiles = G_N_ELEMENTS(g_profiles);
+    return VA_STATUS_SUCCESS;
+}
+
+static gboolean
+stub_has_profile(VAProfile profile)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(g_profiles); i++) {
+        if (g_profiles[i] == profile)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static VAStatus
+stub_QueryConfigEntrypoints(
+    VADriverContextP    ctx,
+    VAProfile           profile,
+    VAEntrypoint       *entrypoint_list,
+    int                *num_entrypoints
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_has_profile(profile))
+        return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+
+    entrypoint_list[0] = VAEntrypointVLD;
+    *num_entrypoints = 1;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_GetConfigAttributes(
+    VADriverContextP    ctx,
+    VAProfile           profile,
+    VAEntrypoint        entrypoint,
+    VAConfigAttrib     *attrib_list,
+    int                 num_attribs
+)
+{
+    int i;
+
+    stub_drv_video_stats.num_calls++;
+
+    for (i = 0; i < num_attribs; i++) {
+        switch (attrib_list[i].type) {
+        case VAConfigAttribRTFormat:
+            attrib_list[i].value = VA_RT_FORMAT_YUV420;
+            break;
+        default:
+            attrib_list[i].value = VA_ATTRIB_NOT_SUPPORTED;
+            break;
+        }
+    }
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateConfig(
+    VADriverContextP    ctx,
+    VAProfile           profile,
+    VAEntrypoint        entrypoint,
+    VAConfigAttrib     *attrib_list,
+    int                 num_attribs,
+    VAConfigID         *config_id
+)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_has_profile(profile))
+        return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+    if (entrypoint != VAEntrypointVLD)
+        return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+    object = stub_object_new(ctx, STUB_OBJECT_CONFIG, config_id);
+    object->u.config.profile    = profile;
+    object->u.config.entrypoint = entrypoint;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyConfig(VADriverContextP ctx, VAConfigID config_id)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_destroy(ctx, STUB_OBJECT_CONFIG, config_id))
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryConfigAttributes(
+    VADriverContextP    ctx,
+    VAConfigID          config_id,
+    VAProfile          *profile,
+    VAEntrypoint       *entrypoint,
+    VAConfigAttrib     *attrib_list,
+    int                *num_attribs
+)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_CONFIG, config_id);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    *profile    = object->u.config.profile;
+    *entrypoint = object->u.config.entrypoint;
+    attrib_list[0].type  = VAConfigAttribRTFormat;
+    attrib_list[0].value = VA_RT_FORMAT_YUV420;
+    *num_attribs = 1;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateSurfaces(
+    VADriverContextP    ctx,
+    int                 width,
+    int                 height,
+    int                 format,
+    int                 num_surfaces,
+    VASurfaceID        *surfaces
+)
+{
+    StubObject *object;
+    int i;
+
+    stub_drv_video_stats.num_calls++;
+
+    if (format != VA_RT_FORMAT_YUV420)
+        return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+
+    for (i = 0; i < num_surfaces; i++) {
+        object = stub_object_new(ctx, STUB_OBJECT_SURFACE, &surfaces[i]);
+        object->u.surface.width  = width;
+        object->u.surface.height = height;
+    }
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroySurfaces(
+    VADriverContextP    ctx,
+    VASurfaceID        *surface_list,
+    int                 num_surfaces
+)
+{
+    VAStatus status = VA_STATUS_SUCCESS;
+    int i;
+
+    stub_drv_video_stats.num_calls++;
+
+    for (i = 0; i < num_surfaces; i++) {
+        if (!stub_object_destroy(ctx, STUB_OBJECT_SURFACE, surface_list[i]))
+            status = VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+    return status;
+}
+
+static VAStatus
+stub_CreateContext(
+    VADriverContextP    ctx,
+    VAConfigID          config_id,
+    int                 picture_width,
+    int                 picture_height,
+    int                 flag,
+    VASurfaceID        *render_targets,
+    int                 num_render_targets,
+    VAContextID        *context
+)
+{
+    StubObject *object;
+    int i;
+
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_CONFIG, config_id))
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    for (i = 0; i < num_render_targets; i++) {
+        if (!stub_object_lookup(ctx, STUB_OBJECT_SURFACE, render_targets[i]))
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+
+    object = stub_object_new(ctx, STUB_OBJECT_CONTEXT, context);
+    object->u.context.config_id     = config_id;
+    object->u.context.render_target = VA_INVALID_SURFACE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyContext(VADriverContextP ctx, VAContextID context)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_destroy(ctx, STUB_OBJECT_CONTEXT, context))
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateBuffer(
+    VADriverContextP    ctx,
+    VAContextID         context,
+    VABufferType        type,
+    unsigned int        size,
+    unsigned int        num_elements,
+    void               *data,
+    VABufferID         *buf_id
+)
+{
+    STUB_CALL(num_create_buffer);
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_CONTEXT, context))
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    stub_buffer_new(ctx, type, size, num_elements, data, buf_id);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_BufferSetNumElements(
+    VADriverContextP    ctx,
+    VABufferID          buf_id,
+    unsigned int        num_elements
+)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_BUFFER, buf_id);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    if (num_elements > object->u.buffer.num_elements) {
+        object->u.buffer.data = g_realloc(object->u.buffer.data,
+            object->u.buffer.size * num_elements);
+    }
+    object->u.buffer.num_elements = num_elements;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_MapBuffer(VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+    StubObject *object;
+
+    STUB_CALL(num_map_buffer);
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_BUFFER, buf_id);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    *pbuf = object->u.buffer.data;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_UnmapBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    STUB_CALL(num_unmap_buffer);
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_BUFFER, buf_id))
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    STUB_CALL(num_destroy_buffer);
+
+    if (!stub_object_destroy(ctx, STUB_OBJECT_BUFFER, buf_id))
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_BeginPicture(
+    VADriverContextP    ctx,
+    VAContextID         context,
+    VASurfaceID         render_target
+)
+{
+    StubObject *object, *surface;
+
+    STUB_CALL(num_begin_picture);
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_CONTEXT, context);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+    surface = stub_object_lookup(ctx, STUB_OBJECT_SURFACE, render_target);
+    if (!surface)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    /* Pictures are numbered from 1 since the stats were reset */
+    surface->u.surface.picture_num = stub_drv_video_stats.num_begin_picture;
+    object->u.context.render_target = render_target;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_RenderPicture(
+    VADriverContextP    ctx,
+    VAContextID         context,
+    VABufferID         *buffers,
+    int                 num_buffers
+)
+{
+    StubObject *object, *config;
+    VAProfile profile;
+    int i;
+
+    STUB_CALL(num_render_picture);
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_CONTEXT, context);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+    if (object->u.context.render_target == VA_INVALID_SURFACE)
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    config = stub_object_lookup(ctx, STUB_OBJECT_CONFIG,
+        object->u.context.config_id);
+    profile = config ? config->u.config.profile : VAProfileNone;
+
+    for (i = 0; i < num_buffers; i++) {
+        if (!stub_object_lookup(ctx, STUB_OBJECT_BUFFER, buffers[i]))
+            return VA_STATUS_ERROR_INVALID_BUFFER;
+    }
+    for (i = 0; i < num_buffers; i++)
+        stub_buffer_record(ctx, profile, stub_object_lookup(ctx,
+            STUB_OBJECT_BUFFER, buffers[i]));
+    stub_drv_video_stats.num_render_buffers += num_buffers;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_EndPicture(VADriverContextP ctx, VAContextID context)
+{
+    StubObject *object;
+
+    STUB_CALL(num_end_picture);
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_CONTEXT, context);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+    if (object->u.context.render_target == VA_INVALID_SURFACE)
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    object->u.context.render_target = VA_INVALID_SURFACE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SyncSurface(VADriverContextP ctx, VASurfaceID render_target)
+{
+    STUB_CALL(num_sync_surface);
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SURFACE, render_target))
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QuerySurfaceStatus(
+    VADriverContextP    ctx,
+    VASurfaceID         render_target,
+    VASurfaceStatus    *status
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SURFACE, render_target))
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    *status = VASurfaceReady;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_PutSurface(
+    VADriverContextP    ctx,
+    VASurfaceID         surface,
+    void               *draw,
+    short               srcx,
+    short               srcy,
+    unsigned short      srcw,
+    unsigned short      srch,
+    short               destx,
+    short               desty,
+    unsigned short      destw,
+    unsigned short      desth,
+    VARectangle        *cliprects,
+    unsigned int        number_cliprects,
+    unsigned int        flags
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SURFACE, surface))
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryImageFormats(
+    VADriverContextP    ctx,
+    VAImageFormat      *format_list,
+    int                *num_formats
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    memcpy(format_list, g_image_formats, sizeof(g_image_formats));
+    *num_formats = G_N_ELEMENTS(g_image_formats);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateImage(
+    VADriverContextP    ctx,
+    VAImageFormat      *format,
+    int                 width,
+    int                 height,
+    VAImage            *image
+)
+{
+    StubObject *object;
+    VAImageID image_id;
+    guint width2, height2, size2;
+
+    stub_drv_video_stats.num_calls++;
+
+    memset(image, 0, sizeof(*image));
+    image->format = *format;
+    image->width  = width;
+    image->height = height;
+
+    width2  = (width  + 1) / 2;
+    height2 = (height + 1) / 2;
+    size2   = width2 * height2;
+
+    switch (format->fourcc) {
+    case VA_FOURCC('N','V','1','2'):
+        image->num_planes = 2;
+        image->pitches[0] = width;
+        image->offsets[0] = 0;
+        image->pitches[1] = width2 * 2;
+        image->offsets[1] = width * height;
+        image->data_size  = width * height + 2 * size2;
+        break;
+    case VA_FOURCC('Y','V','1','2'):
+    case VA_FOURCC('I','4','2','0'):
+        image->num_planes = 3;
+        image->pitches[0] = width;
+        image->offsets[0] = 0;
+        image->pitches[1] = width2;
+        image->offsets[1] = width * height;
+        image->pitches[2] = width2;
+        image->offsets[2] = width * height + size2;
+        image->data_size  = width * height + 2 * size2;
+        break;
+    case VA_FOURCC('B','G','R','A'):
+        image->num_planes = 1;
+        image->pitches[0] = width * 4;
+        image->offsets[0] = 0;
+        image->data_size  = width * height * 4;
+        break;
+    default:
+        return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+    }
+
+    stub_buffer_new(ctx, VAImageBufferType, image->data_size, 1, NULL,
+                    &image->buf);
+
+    object = stub_object_new(ctx, STUB_OBJECT_IMAGE, &image_id);
+    image->image_id = image_id;
+    object->u.image = *image;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DeriveImage(VADriverContextP ctx, VASurfaceID surface, VAImage *image)
+{
+    stub_drv_video_stats.num_calls++;
+
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+}
+
+static VAStatus
+stub_DestroyImage(VADriverContextP ctx, VAImageID image)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_IMAGE, image);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    stub_object_destroy(ctx, STUB_OBJECT_BUFFER, object->u.image.buf);
+    stub_object_destroy(ctx, STUB_OBJECT_IMAGE, image);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SetImagePalette(
+    VADriverContextP    ctx,
+    VAImageID           image,
+    unsigned char      *palette
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+stub_GetImage(
+    VADriverContextP    ctx,
+    VASurfaceID         surface,
+    int                 x,
+    int                 y,
+    unsigned int        width,
+    unsigned int        height,
+    VAImageID           image
+)
+{
+    StubDriverData * const data = STUB_DRIVER_DATA(ctx);
+    StubObject *surface_object, *image_object, *buffer_object;
+
+    STUB_CALL(num_get_image);
+
+    surface_object = stub_object_lookup(ctx, STUB_OBJECT_SURFACE, surface);
+    if (!surface_object)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+    image_object = stub_object_lookup(ctx, STUB_OBJECT_IMAGE, image);
+    if (!image_object)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+    buffer_object = stub_object_lookup(ctx, STUB_OBJECT_BUFFER,
+        image_object->u.image.buf);
+    if (!buffer_object)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    /* Stands for the wait for the GPU and the transfer */
+    if (data->get_image_delay > 0)
+        g_usleep(data->get_image_delay);
+
+    stub_surface_copy(surface_object, x, y, &image_object->u.image,
+        buffer_object->u.buffer.data, 0, 0, width, height, TRUE);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_PutImage(
+    VADriverContextP    ctx,
+    VASurfaceID         surface,
+    VAImageID           image,
+    int                 src_x,
+    int                 src_y,
+    unsigned int        src_width,
+    unsigned int        src_height,
+    int                 dest_x,
+    int                 dest_y,
+    unsigned int        dest_width,
+    unsigned int        dest_height
+)
+{
+    StubObject *surface_object, *image_object, *buffer_object;
+
+    stub_drv_video_stats.num_calls++;
+
+    surface_object = stub_object_lookup(ctx, STUB_OBJECT_SURFACE, surface);
+    if (!surface_object)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+    image_object = stub_object_lookup(ctx, STUB_OBJECT_IMAGE, image);
+    if (!image_object)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+    buffer_object = stub_object_lookup(ctx, STUB_OBJECT_BUFFER,
+        image_object->u.image.buf);
+    if (!buffer_object)
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    /* Scaling is not supported */
+    stub_surface_copy(surface_object, dest_x, dest_y, &image_object->u.image,
+        buffer_object->u.buffer.data, src_x, src_y,
+        MIN(src_width, dest_width), MIN(src_height, dest_height), FALSE);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QuerySubpictureFormats(
+    VADriverContextP    ctx,
+    VAImageFormat      *format_list,
+    unsigned int       *flags,
+    unsigned int       *num_formats
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    memcpy(format_list, g_subpicture_formats, sizeof(g_subpicture_formats));
+    if (flags)
+        memset(flags, 0, G_N_ELEMENTS(g_subpicture_formats) * sizeof(*flags));
+    *num_formats = G_N_ELEMENTS(g_subpicture_formats);
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateSubpicture(
+    VADriverContextP    ctx,
+    VAImageID           image,
+    VASubpictureID     *subpicture
+)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_IMAGE, image))
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    object = stub_object_new(ctx, STUB_OBJECT_SUBPICTURE, subpicture);
+    object->u.subpicture.image_id = image;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroySubpicture(VADriverContextP ctx, VASubpictureID subpicture)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_destroy(ctx, STUB_OBJECT_SUBPICTURE, subpicture))
+        return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SetSubpictureImage(
+    VADriverContextP    ctx,
+    VASubpictureID      subpicture,
+    VAImageID           image
+)
+{
+    StubObject *object;
+
+    stub_drv_video_stats.num_calls++;
+
+    object = stub_object_lookup(ctx, STUB_OBJECT_SUBPICTURE, subpicture);
+    if (!object)
+        return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+    if (!stub_object_lookup(ctx, STUB_OBJECT_IMAGE, image))
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    object->u.subpicture.image_id = image;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SetSubpictureChromakey(
+    VADriverContextP    ctx,
+    VASubpictureID      subpicture,
+    unsigned int        chromakey_min,
+    unsigned int        chromakey_max,
+    unsigned int        chromakey_mask
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+stub_SetSubpictureGlobalAlpha(
+    VADriverContextP    ctx,
+    VASubpictureID      subpicture,
+    float               global_alpha
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SUBPICTURE, subpicture))
+        return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_AssociateSubpicture(
+    VADriverContextP    ctx,
+    VASubpictureID      subpicture,
+    VASurfaceID        *target_surfaces,
+    int                 num_surfaces,
+    short               src_x,
+    short               src_y,
+    unsigned short      src_width,
+    unsigned short      src_height,
+    short               dest_x,
+    short               dest_y,
+    unsigned short      dest_width,
+    unsigned short      dest_height,
+    unsigned int        flags
+)
+{
+    int i;
+
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SUBPICTURE, subpicture))
+        return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+
+    for (i = 0; i < num_surfaces; i++) {
+        if (!stub_object_lookup(ctx, STUB_OBJECT_SURFACE, target_surfaces[i]))
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DeassociateSubpicture(
+    VADriverContextP    ctx,
+    VASubpictureID      subpicture,
+    VASurfaceID        *target_surfaces,
+    int                 num_surfaces
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    if (!stub_object_lookup(ctx, STUB_OBJECT_SUBPICTURE, subpicture))
+        return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryDisplayAttributes(
+    VADriverContextP    ctx,
+    VADisplayAttribute *attr_list,
+    int                *num_attributes
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    *num_attributes = 0;
+    return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_GetDisplayAttributes(
+    VADriverContextP    ctx,
+    VADisplayAttribute *attr_list,
+    int                 num_attributes
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+stub_SetDisplayAttributes(
+    VADriverContextP    ctx,
+    VADisplayAttribute *attr_list,
+    int                 num_attributes
+)
+{
+    stub_drv_video_stats.num_calls++;
+
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+VA_DRIVER_INIT_FUNC(VADriverContextP ctx);
+
+VAStatus
+VA_DRIVER_INIT_FUNC(VADriverContextP ctx)
+{
+    struct VADriverVTable * const vtable = ctx->vtable;
+    StubDriverData *data;
+    const gchar *delay;
+
+    data = g_slice_new0(StubDriverData);
+    data->objects = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+        NULL, (GDestroyNotify)stub_object_free);
+    ctx->pDriverData = data;
+
+    delay = g_getenv(STUB_GET_IMAGE_DELAY_ENV);
+    if (delay)
+        data->get_image_delay = strtoul(delay, NULL, 10);
+
+    ctx->version_major          = VA_MAJOR_VERSION;
+    ctx->version_minor          = VA_MINOR_VERSION;
+    ctx->max_profiles           = STUB_MAX_PROFILES;
+    ctx->max_entrypoints        = STUB_MAX_ENTRYPOINTS;
+    ctx->max_attributes         = STUB_MAX_ATTRIBUTES;
+    ctx->max_image_formats      = STUB_MAX_IMAGE_FORMATS;
+    ctx->max_subpic_formats     = STUB_MAX_SUBPIC_FORMATS;
+    ctx->max_display_attributes = STUB_MAX_DISPLAY_ATTRIBUTES;
+    ctx->str_vendor             = "gstreamer-vaapi stub driver";
+
+    vtable->vaTerminate                 = stub_Terminate;
+    vtable->vaQueryConfigProfiles       = stub_QueryConfigProfiles;
+    vtable->vaQueryConfigEntrypoints    = stub_QueryConfigEntrypoints;
+    vtable->vaGetConfigAttributes       = stub_GetConfigAttributes;
+    vtable->vaCreateConfig              = stub_CreateConfig;
+    vtable->vaDestroyConfig             = stub_DestroyConfig;
+    vtable->vaQueryConfigAttributes     = stub_QueryConfigAttributes;
+    vtable->vaCreateSurfaces            = stub_CreateSurfaces;
+    vtable->vaDestroySurfaces           = stub_DestroySurfaces;
+    vtable->vaCreateContext             = stub_CreateContext;
+    vtable->vaDestroyContext            = stub_DestroyContext;
+    vtable->vaCreateBuffer              = stub_CreateBuffer;
+    vtable->vaBufferSetNumElements      = stub_BufferSetNumElements;
+    vtable->vaMapBuffer                 = stub_MapBuffer;
+    vtable->vaUnmapBuffer               = stub_UnmapBuffer;
+    vtable->vaDestroyBuffer             = stub_DestroyBuffer;
+    vtable->vaBeginPicture              = stub_BeginPicture;
+    vtable->vaRenderPicture             = stub_RenderPicture;
+    vtable->vaEndPicture                = stub_EndPicture;
+    vtable->vaSyncSurface               = stub_SyncSurface;
+    vtable->vaQuerySurfaceStatus        = stub_QuerySurfaceStatus;
+    vtable->vaPutSurface                = stub_PutSurface;
+    vtable->vaQueryImageFormats         = stub_QueryImageFormats;
+    vtable->vaCreateImage               = stub_CreateImage;
+    vtable->vaDeriveImage               = stub_DeriveImage;
+    vtable->vaDestroyImage              = stub_DestroyImage;
+    vtable->vaSetImagePalette           = stub_SetImagePalette;
+    vtable->vaGetImage                  = stub_GetImage;
+    vtable->vaPutImage                  = stub_PutImage;
+    vtable->vaQuerySubpictureFormats    = stub_QuerySubpictureFormats;
+    vtable->vaCreateSubpicture          = stub_CreateSubpicture;
+    vtable->vaDestroySubpicture         = stub_DestroySubpicture;
+    vtable->vaSetSubpictureImage        = stub_SetSubpictureImage;
+    vtable->vaSetSubpictureChromakey    = stub_SetSubpictureChromakey;
+    vtable->vaSetSubpictureGlobalAlpha  = stub_SetSubpictureGlobalAlpha;
+    vtable->vaAssociateSubpicture       = stub_AssociateSubpicture;
+    vtable->vaDeassociateSubpicture     = stub_DeassociateSubpicture;
+    vtable->vaQueryDisplayAttributes    = stub_QueryDisplayAttributes;
+    vtable->vaGetDisplayAttributes      = stub_GetDisplayAttributes;
+    vtable->vaSetDisplayAttributes      = stub_SetDisplayAttributes;
+    return VA_STATUS_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ *  stub_drv_video.h - Call-counting stand-in VA driver
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef STUB_DRV_VIDEO_H
+#define STUB_DRV_VIDEO_H
+
+/* Name of the driver, as passed through LIBVA_DRIVER_NAME */
+#define STUB_DRIVER_NAME                "stub"
+
+/* Name of the exported StubDriverStats variable */
+#define STUB_DRIVER_STATS_SYMBOL        "stub_drv_video_stats"
+
+/* Environment variable holding the time vaGetImage() takes, in
+   microseconds, to stand for the latency of a real GPU */
+#define STUB_GET_IMAGE_DELAY_ENV        "STUB_DRV_VIDEO_GET_IMAGE_DELAY"
+
+typedef struct _StubDriverStats StubDriverStats;
+
+/**
+ * StubDriverStats:
+ * @num_calls: total number of driver entry points called
+ * @num_create_buffer: number of vaCreateBuffer() calls
+ * @num_destroy_buffer: number of vaDestroyBuffer() calls
+ * @num_map_buffer: number of vaMapBuffer() calls
+ * @num_unmap_buffer: number of vaUnmapBuffer() calls
+ * @num_begin_picture: number of vaBeginPicture() calls
+ * @num_render_picture: number of vaRenderPicture() calls
+ * @num_render_buffers: number of VA buffers submitted to vaRenderPicture()
+ * @num_end_picture: number of vaEndPicture() calls
+ * @num_sync_surface: number of vaSyncSurface() calls
+ * @num_get_image: number of vaGetImage() calls
+ * @num_live_buffers: number of VA buffers currently allocated
+ * @num_param_buffers: number of parameter buffers submitted
+ * @param_checksum: FNV-1a hash of the type and contents of all submitted
+ *   buffers but slice data, in submission order
+ *
+ * Counters maintained by the stub VA driver. The driver exports a
+ * single instance of this structure as %STUB_DRIVER_STATS_SYMBOL.
+ *
+ * Before they are hashed into @param_checksum, the surface IDs of the
+ * H.264, MPEG-2, MPEG-4 and VC-1 parameters are replaced with the
+ * number of the last picture decoded into each surface, counted from 1
+ * by vaBeginPicture() since the counters were reset. The checksum thus
+ * only depends on the stream and the decoder, not on the order in which
+ * surfaces were allocated or recycled.
+ */
+struct _StubDriverStats {
+    unsigned int        num_calls;
+    unsigned int        num_create_buffer;
+    unsigned int        num_destroy_buffer;
+    unsigned int        num_map_buffer;
+    unsigned int        num_unmap_buffer;
+    unsigned int        num_begin_picture;
+    unsigned int        num_render_picture;
+    unsigned int        num_render_buffers;
+    unsigned int        num_end_picture;
+    unsigned int        num_sync_surface;
+    unsigned int        num_get_image;
+    unsigned int        num_live_buffers;
+    unsigned int        num_param_buffers;
+    unsigned int        param_checksum;
+};
+
+/* Initial value of the FNV-1a hash in StubDriverStats.param_checksum */
+#define STUB_PARAM_CHECKSUM_INIT        2166136261u
+
+#endif /* STUB_DRV_VIDEO_H */
@@ -0,0 +1,242 @@
+/*
+ *  test-atlas.c - Test the packing of overlay rectangles into an atlas
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapiatlas.h>
+
+static gint g_atlas_width   = 1024;
+static gint g_atlas_height  = 1024;
+static gint g_num_steps     = 100000;
+static gint g_seed          = 1;
+
+static GOptionEntry g_options[] = {
+    { "width", 'W',
+      0,
+      G_OPTION_ARG_INT, &g_atlas_width,
+      "atlas width", NULL },
+    { "height", 'H',
+      0,
+      G_OPTION_ARG_INT, &g_atlas_height,
+      "atlas height", NULL },
+    { "steps", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_steps,
+      "number of random allocations and releases", NULL },
+    { "seed", 's',
+      0,
+      G_OPTION_ARG_INT, &g_seed,
+      "random seed", NULL },
+    { NULL, }
+};
+
+/* Owner of each atlas pixel, or -1 if the pixel is free */
+typedef struct {
+    gint                       *owners;
+    GArray                     *rects;
+} AtlasState;
+
+static gboolean
+mark_rect(AtlasState *state, const GstVaapiRectangle *rect, gint owner)
+{
+    guint x, y;
+    gint *row;
+
+    if (rect->x + rect->width > (guint)g_atlas_width ||
+        rect->y + rect->height > (guint)g_atlas_height) {
+        g_printerr("rectangle %ux%u+%u+%u is out of bounds\n",
+                   rect->width, rect->height, rect->x, rect->y);
+        return FALSE;
+    }
+
+    for (y = rect->y; y < rect->y + rect->height; y++) {
+        row = &state->owners[y * g_atlas_width];
+        for (x = rect->x; x < rect->x + rect->width; x++) {
+            if (owner >= 0 && row[x] >= 0) {
+                g_printerr("rectangle %ux%u+%u+%u overlaps another one\n",
+                           rect->width, rect->height, rect->x, rect->y);
+                return FALSE;
+            }
+            row[x] = owner;
+        }
+    }
+    return TRUE;
+}
+
+/* Subtitle lines and scoreboard digits */
+static void
+random_size(GRand *rand, guint *pwidth, guint *pheight)
+{
+    if (g_rand_boolean(rand)) {
+        *pwidth  = g_rand_int_range(rand, 64, 512);
+        *pheight = g_rand_int_range(rand, 24, 48);
+    }
+    else {
+        *pwidth  = g_rand_int_range(rand, 8, 32);
+        *pheight = g_rand_int_range(rand, 12, 32);
+    }
+}
+
+static gboolean
+run_check_test(void)
+{
+    GstVaapiAtlas *atlas;
+    GstVaapiRectangle rect;
+    AtlasState state;
+    GRand *rand;
+    gdouble efficiency, sum_efficiency = 0.0;
+    guint width, height, i, n, num_failed = 0, num_samples = 0;
+    gboolean success = FALSE;
+
+    atlas = gst_vaapi_atlas_new(g_atlas_width, g_atlas_height);
+    if (!atlas)
+        g_error("could not create atlas");
+
+    state.owners = g_new(gint, g_atlas_width * g_atlas_height);
+    memset(state.owners, 0xff, g_atlas_width * g_atlas_height * sizeof(gint));
+    state.rects  = g_array_new(FALSE, FALSE, sizeof(GstVaapiRectangle));
+    rand = g_rand_new_with_seed(g_seed);
+
+    for (i = 0; i < (guint)g_num_steps; i++) {
+        /* Grow while the atlas is less than half full, then churn */
+        if (state.rects->len > 0 &&
+            (g_rand_int_range(rand, 0, 100) < 40 ||
+             gst_vaapi_atlas_get_num_rects(atlas) > 200)) {
+            n = g_rand_int_range(rand, 0, state.rects->len);
+            rect = g_array_index(state.rects, GstVaapiRectangle, n);
+            g_array_remove_index_fast(state.rects, n);
+            gst_vaapi_atlas_release(atlas, &rect);
+            mark_rect(&state, &rect, -1);
+        }
+        else {
+            random_size(rand, &width, &height);
+            if (!gst_vaapi_atlas_alloc(atlas, width, height, &rect)) {
+                num_failed++;
+                continue;
+            }
+            if (rect.width != width || rect.height != height) {
+                g_printerr("got %ux%u for a %ux%u rectangle\n",
+                           rect.width, rect.height, width, height);
+                goto end;
+            }
+            if (!mark_rect(&state, &rect, i))
+                goto end;
+            g_array_append_val(state.rects, rect);
+        }
+
+        if (gst_vaapi_atlas_get_num_rects(atlas) != state.rects->len) {
+            g_printerr("atlas reports %u rectangles instead of %u\n",
+                       gst_vaapi_atlas_get_num_rects(atlas), state.rects->len);
+            goto end;
+        }
+        efficiency = gst_vaapi_atlas_get_efficiency(atlas);
+        if (efficiency < 0.0 || efficiency > 1.0) {
+            g_printerr("invalid packing efficiency %f\n", efficiency);
+            goto end;
+        }
+        if (state.rects->len > 0) {
+            sum_efficiency += efficiency;
+            num_samples++;
+        }
+    }
+
+    /* Everything is given back once all rectangles are released */
+    for (i = 0; i < state.rects->len; i++)
+        gst_vaapi_atlas_release(atlas,
+            &g_array_index(state.rects, GstVaapiRectangle, i));
+    if (gst_vaapi_atlas_get_num_rects(atlas) != 0 ||
+        gst_vaapi_atlas_get_used_height(atlas) != 0) {
+        g_printerr("atlas is not empty after releasing all rectangles\n");
+        goto end;
+    }
+
+    /* A full-size rectangle only fits in an empty atlas */
+    if (!gst_vaapi_atlas_alloc(atlas, g_atlas_width, g_atlas_height, &rect) ||
+        gst_vaapi_atlas_alloc(atlas, 1, 1, &rect)) {
+        g_printerr("full-size rectangle was not handled correctly\n");
+        goto end;
+    }
+    gst_vaapi_atlas_reset(atlas);
+    if (gst_vaapi_atlas_get_num_rects(atlas) != 0)
+        goto end;
+    success = TRUE;
+
+    g_print("check: %d steps, %u allocations failed, "
+            "%.1f%% average packing efficiency\n", g_num_steps, num_failed,
+            num_samples ? 100.0 * sum_efficiency / num_samples : 0.0);
+
+end:
+    g_rand_free(rand);
+    g_array_free(state.rects, TRUE);
+    g_free(state.owners);
+    gst_vaapi_atlas_free(atlas);
+    return success;
+}
+
+/* Packs rectangles until the atlas is full */
+static void
+run_fill_test(void)
+{
+    GstVaapiAtlas *atlas;
+    GstVaapiRectangle rect;
+    GRand *rand;
+    guint width, height, num_misses = 0;
+
+    atlas = gst_vaapi_atlas_new(g_atlas_width, g_atlas_height);
+    rand  = g_rand_new_with_seed(g_seed);
+
+    while (num_misses < 100) {
+        random_size(rand, &width, &height);
+        if (!gst_vaapi_atlas_alloc(atlas, width, height, &rect))
+            num_misses++;
+    }
+    g_print("fill: %u rectangles, %u rows used, %.1f%% packing efficiency\n",
+            gst_vaapi_atlas_get_num_rects(atlas),
+            gst_vaapi_atlas_get_used_height(atlas),
+            100.0 * gst_vaapi_atlas_get_efficiency(atlas));
+
+    g_rand_free(rand);
+    gst_vaapi_atlas_free(atlas);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    gboolean success;
+
+    ctx = g_option_context_new("- atlas packing test");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    if (g_atlas_width < 512)
+        g_atlas_width = 512;
+    if (g_atlas_height < 48)
+        g_atlas_height = 48;
+    if (g_num_steps < 1)
+        g_num_steps = 1;
+
+    success = run_check_test();
+    run_fill_test();
+    return success ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+/*
+ *  test-bitplane.c - Check and benchmark VC-1 bitplane packing
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include <gst/vaapi/gstvaapicpu.h>
+#include <gst/vaapi/gstvaapibitplane.h>
+
+/* Largest picture checked, in macroblocks, and guard bytes after the
+   packed bitplanes */
+#define MAX_CHECK_WIDTH 160
+#define MAX_CHECK_HEIGHT 12
+#define MAX_CHECK_SIZE  ((MAX_CHECK_WIDTH * MAX_CHECK_HEIGHT + 1) / 2)
+#define GUARD_SIZE      16
+
+static gint g_num_checks    = 2000;
+static gint g_width         = 1920;
+static gint g_height        = 1080;
+static gint g_num_pictures  = 20000;
+static gboolean g_benchmark = TRUE;
+
+static GOptionEntry g_options[] = {
+    { "checks", 'c',
+      0,
+      G_OPTION_ARG_INT, &g_num_checks,
+      "number of random pictures checked per implementation", NULL },
+    { "width", 'W',
+      0,
+      G_OPTION_ARG_INT, &g_width,
+      "picture width for the benchmark, in pixels", NULL },
+    { "height", 'H',
+      0,
+      G_OPTION_ARG_INT, &g_height,
+      "picture height for the benchmark, in pixels", NULL },
+    { "pictures", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_pictures,
+      "number of pictures packed per implementation", NULL },
+    { "no-benchmark", 0,
+      G_OPTION_FLAG_REVERSE,
+      G_OPTION_ARG_NONE, &g_benchmark,
+      "only check bit-exactness", NULL },
+    { NULL, }
+};
+
+/* The implementations to compare, from the generic C code up */
+static const guint g_cpu_flags_list[] = {
+    0,
+    GST_VAAPI_CPU_FLAG_SSE2,
+    GST_VAAPI_CPU_FLAG_NEON,
+};
+
+/* One macroblock at a time, as the VC-1 decoder used to */
+static void
+pack_per_macroblock(guint8 *dst, const guint8 *planes[3], guint width,
+    guint height, guint stride)
+{
+    guint x, y, n = 0;
+    guint8 v;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++, n++) {
+            v = 0;
+            if (planes[0])
+                v |= planes[0][y * stride + x];
+            if (planes[1])
+                v |= planes[1][y * stride + x] << 1;
+            if (planes[2])
+                v |= planes[2][y * stride + x] << 2;
+            dst[n / 2] = (dst[n / 2] << 4) | v;
+        }
+    }
+    if (n & 1)
+        dst[n / 2] <<= 4;
+}
+
+/* Mostly 0 and 1 flags, as the parser produces, with other values now
+   and then to check that the kernels do not mask them */
+static void
+fill_random(GRand *rand, guint8 *data, guint size)
+{
+    guint i;
+
+    for (i = 0; i < size; i++)
+        data[i] = g_rand_int_range(rand, 0, 16) ?
+            g_rand_int_range(rand, 0, 2) : g_rand_int_range(rand, 0, 256);
+}
+
+static gboolean
+check_funcs(const GstVaapiBitPlaneFuncs *funcs)
+{
+    const guint plane_size = MAX_CHECK_HEIGHT * (MAX_CHECK_WIDTH + 32);
+    const guint8 *planes[3];
+    guint8 *data[3], ref[MAX_CHECK_SIZE + GUARD_SIZE];
+    guint8 dst[MAX_CHECK_SIZE + GUARD_SIZE];
+    GRand *rand;
+    guint width, height, stride, size, j;
+    gint i;
+    gboolean success = TRUE;
+
+    rand = g_rand_new_with_seed(0xb17);
+    for (j = 0; j < 3; j++)
+        data[j] = g_malloc(plane_size);
+
+    for (i = 0; i < g_num_checks && success; i++) {
+        width  = g_rand_int_range(rand, 1, MAX_CHECK_WIDTH + 1);
+        height = g_rand_int_range(rand, 1, MAX_CHECK_HEIGHT + 1);
+        stride = width + g_rand_int_range(rand, 0, 32);
+        size   = (width * height + 1) / 2;
+
+        for (j = 0; j < 3; j++) {
+            fill_random(rand, data[j], plane_size);
+            planes[j] = g_rand_int_range(rand, 0, 4) ? data[j] : NULL;
+        }
+
+        /* The VA buffer is not cleared, any previous contents shall be
+           overwritten */
+        memset(ref, g_rand_int_range(rand, 0, 256), sizeof(ref));
+        memset(dst, 0x5a, sizeof(dst));
+        pack_per_macroblock(ref, planes, width, height, stride);
+        gst_vaapi_bitplane_pack(funcs, dst, planes, width, height, stride);
+
+        if (memcmp(dst, ref, size) != 0) {
+            g_printerr("%s: packed bitplanes differ (%ux%u macroblocks)\n",
+                       funcs->name, width, height);
+            success = FALSE;
+        }
+        else if (dst[size] != 0x5a) {
+            g_printerr("%s: wrote past the bitplanes (%ux%u macroblocks)\n",
+                       funcs->name, width, height);
+            success = FALSE;
+        }
+    }
+
+    for (j = 0; j < 3; j++)
+        g_free(data[j]);
+    g_rand_free(rand);
+    return success;
+}
+
+/* Packs pictures with three planes, as for P pictures with direct,
+   skipped and motion vector type flags */
+static void
+run_benchmark(const GstVaapiBitPlaneFuncs **impls, guint num_impls)
+{
+    const guint width  = (g_width + 15) / 16;
+    const guint height = (g_height + 15) / 16;
+    const guint8 *planes[3];
+    guint8 *data[3], *dst;
+    GRand *rand;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed;
+    guint i, j;
+    gint n;
+
+    rand = g_rand_new_with_seed(0x5eed);
+    for (j = 0; j < 3; j++) {
+        data[j] = g_malloc(width * height);
+        fill_random(rand, data[j], width * height);
+        planes[j] = data[j];
+    }
+    dst = g_malloc((width * height + 1) / 2);
+
+    g_print("bench: %ux%u macroblocks, %d pictures\n", width, height,
+            g_num_pictures);
+
+    timer = g_timer_new();
+    g_timer_start(timer);
+    for (n = 0; n < g_num_pictures; n++)
+        pack_per_macroblock(dst, planes, width, height, width);
+    ref_elapsed = g_timer_elapsed(timer, NULL);
+    g_print("bench: %-14s %8.2f us/picture\n", "per-macroblock",
+            ref_elapsed * 1e6 / g_num_pictures);
+
+    for (i = 0; i < num_impls; i++) {
+        g_timer_start(timer);
+        for (n = 0; n < g_num_pictures; n++)
+            gst_vaapi_bitplane_pack(impls[i], dst, planes, width, height,
+                width);
+        elapsed = g_timer_elapsed(timer, NULL);
+        g_print("bench: %-14s %8.2f us/picture (x%.2f)\n", impls[i]->name,
+                elapsed * 1e6 / g_num_pictures,
+                elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+    }
+    g_timer_destroy(timer);
+
+    g_free(dst);
+    for (j = 0; j < 3; j++)
+        g_free(data[j]);
+    g_rand_free(rand);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const GstVaapiBitPlaneFuncs *impls[G_N_ELEMENTS(g_cpu_flags_list)];
+    const GstVaapiBitPlaneFuncs *funcs;
+    GOptionContext *ctx;
+    guint i, cpu_flags, num_impls = 0;
+    gboolean success = TRUE;
+
+    ctx = g_option_context_new("- VC-1 bitplane packing test");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    g_width        = MAX(g_width, 16);
+    g_height       = MAX(g_height, 16);
+    g_num_pictures = MAX(g_num_pictures, 1);
+
+    cpu_flags = gst_vaapi_cpu_get_flags();
+    g_print("CPU flags: 0x%x, default kernels: %s\n", cpu_flags,
+            gst_vaapi_bitplane_get_funcs()->name);
+
+    /* Only test the implementations this CPU can run, once each */
+    for (i = 0; i < G_N_ELEMENTS(g_cpu_flags_list); i++) {
+        if ((g_cpu_flags_list[i] & cpu_flags) != g_cpu_flags_list[i])
+            continue;
+        funcs = gst_vaapi_bitplane_get_funcs_for_flags(g_cpu_flags_list[i]);
+        if (num_impls > 0 && funcs == impls[num_impls - 1])
+            continue;
+        impls[num_impls++] = funcs;
+    }
+
+    for (i = 0; i < num_impls; i++) {
+        if (!check_funcs(impls[i]))
+            success = FALSE;
+        else
+            g_print("check: %s kernels match the per-macroblock packing\n",
+                    impls[i]->name);
+    }
+
+    if (g_benchmark)
+        run_benchmark(impls, num_impls);
+    return success ? 0 : 1;
+}
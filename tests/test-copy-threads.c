@@ -0,0 +1,230 @@
+/*
+ *  test-copy-threads.c - Benchmark row-parallel image copies
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include "output.h"
+
+static gint g_num_frames    = 50;
+
+static GOptionEntry g_options[] = {
+    { "frames", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames copied per size, format and thread count", NULL },
+    { NULL, }
+};
+
+typedef struct _BenchSize BenchSize;
+struct _BenchSize {
+    const gchar        *name;
+    guint               width;
+    guint               height;
+};
+
+static const BenchSize g_sizes[] = {
+    { "1080p", 1920, 1080 },
+    { "1440p", 2560, 1440 },
+    { "4K",    3840, 2160 },
+    { "8K",    7680, 4320 },
+};
+
+static const guint g_num_threads_list[] = { 1, 2, 4, 8 };
+
+/* Destination formats, copied from an NV12 image */
+static const GstVaapiImageFormat g_formats[] = {
+    GST_VAAPI_IMAGE_NV12,       /* plain copy */
+    GST_VAAPI_IMAGE_I420,       /* deinterleaved chroma */
+};
+
+/* Allocates a raw 4:2:0 image, with 64-byte aligned rows */
+static guchar *
+raw_image_init(GstVaapiImageRaw *raw, GstVaapiImageFormat format,
+    guint width, guint height)
+{
+    const guint stride = GST_ROUND_UP_64(width);
+    const guint height2 = GST_ROUND_UP_2(height);
+    guchar *data;
+
+    data = g_malloc0(stride * height2 * 3 / 2);
+    raw->format     = format;
+    raw->width      = width;
+    raw->height     = height;
+    raw->pixels[0]  = data;
+    raw->stride[0]  = stride;
+    if (format == GST_VAAPI_IMAGE_NV12) {
+        raw->num_planes = 2;
+        raw->pixels[1]  = raw->pixels[0] + stride * height2;
+        raw->stride[1]  = stride;
+    }
+    else {
+        raw->num_planes = 3;
+        raw->pixels[1]  = raw->pixels[0] + stride * height2;
+        raw->stride[1]  = stride / 2;
+        raw->pixels[2]  = raw->pixels[1] + stride / 2 * height2 / 2;
+        raw->stride[2]  = stride / 2;
+    }
+    return data;
+}
+
+/* Compares the visible pixels of two raw images of the same layout */
+static gboolean
+raw_image_equal(const GstVaapiImageRaw *a, const GstVaapiImageRaw *b)
+{
+    guint i, y, width, height;
+
+    for (i = 0; i < a->num_planes; i++) {
+        width  = a->width;
+        height = a->height;
+        if (i > 0) {
+            if (a->num_planes == 3)
+                width /= 2;
+            height /= 2;
+        }
+        for (y = 0; y < height; y++) {
+            if (memcmp(a->pixels[i] + y * a->stride[i],
+                       b->pixels[i] + y * b->stride[i], width) != 0)
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean
+fill_image(GstVaapiImage *image)
+{
+    guchar *data;
+    guint i, x, y, pitch, height;
+
+    if (!gst_vaapi_image_map(image))
+        return FALSE;
+
+    for (i = 0; i < gst_vaapi_image_get_plane_count(image); i++) {
+        data   = gst_vaapi_image_get_plane(image, i);
+        pitch  = gst_vaapi_image_get_pitch(image, i);
+        height = gst_vaapi_image_get_height(image);
+        if (i > 0)
+            height /= 2;
+        for (y = 0; y < height; y++)
+            for (x = 0; x < pitch; x++)
+                data[y * pitch + x] = (x * 7 + y * 13 + i * 101) & 0xff;
+    }
+    return gst_vaapi_image_unmap(image);
+}
+
+static void
+run_benchmark(GstVaapiDisplay *display, const BenchSize *size)
+{
+    GstVaapiImage *image;
+    GstVaapiImageRaw ref_image, dst_image;
+    guchar *ref_data, *dst_data;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed, size_mb;
+    guint i, j;
+    gint n;
+
+    image = gst_vaapi_image_new(display, GST_VAAPI_IMAGE_NV12,
+        size->width, size->height);
+    if (!image || !fill_image(image)) {
+        g_print("%-6s could not create %ux%u image\n", size->name,
+                size->width, size->height);
+        g_clear_object(&image);
+        return;
+    }
+
+    size_mb = size->width * size->height * 3 / 2 / (1024.0 * 1024.0);
+    timer = g_timer_new();
+
+    for (i = 0; i < G_N_ELEMENTS(g_formats); i++) {
+        ref_data = raw_image_init(&ref_image, g_formats[i],
+            size->width, size->height);
+        dst_data = raw_image_init(&dst_image, g_formats[i],
+            size->width, size->height);
+
+        ref_elapsed = 0.0;
+        for (j = 0; j < G_N_ELEMENTS(g_num_threads_list); j++) {
+            const guint num_threads = g_num_threads_list[j];
+            GstVaapiImageRaw * const raw = j == 0 ? &ref_image : &dst_image;
+
+            gst_vaapi_image_set_copy_threads(num_threads);
+
+            g_timer_start(timer);
+            for (n = 0; n < g_num_frames; n++) {
+                if (!gst_vaapi_image_get_raw(image, raw, NULL))
+                    break;
+            }
+            elapsed = g_timer_elapsed(timer, NULL);
+            if (n < g_num_frames) {
+                g_print("%-6s NV12 -> %" GST_FOURCC_FORMAT " %u threads "
+                        "failed\n", size->name,
+                        GST_FOURCC_ARGS(g_formats[i]), num_threads);
+                continue;
+            }
+            if (j == 0)
+                ref_elapsed = elapsed;
+
+            g_print("%-6s NV12 -> %" GST_FOURCC_FORMAT " %u threads "
+                    "%8.1f fps %6.2f GB/s (x%.2f)%s\n", size->name,
+                    GST_FOURCC_ARGS(g_formats[i]), num_threads,
+                    elapsed > 0.0 ? g_num_frames / elapsed : 0.0,
+                    elapsed > 0.0 ?
+                    size_mb * g_num_frames / elapsed / 1024.0 : 0.0,
+                    elapsed > 0.0 ? ref_elapsed / elapsed : 0.0,
+                    j > 0 && !raw_image_equal(&ref_image, &dst_image) ?
+                    " MISMATCH" : "");
+        }
+        g_free(ref_data);
+        g_free(dst_data);
+    }
+    g_timer_destroy(timer);
+    g_object_unref(image);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    guint i;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    g_num_frames = MAX(g_num_frames, 1);
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    /* Split all sizes, to check where parallel copies pay off */
+    gst_vaapi_image_set_copy_threshold(1);
+
+    g_print("Benchmark image copies across threads, %d frames\n",
+            g_num_frames);
+    for (i = 0; i < G_N_ELEMENTS(g_sizes); i++)
+        run_benchmark(display, &g_sizes[i]);
+
+    gst_vaapi_image_set_copy_threshold(0);
+    gst_vaapi_image_set_copy_threads(0);
+    g_object_unref(display);
+    video_output_exit();
+    return 0;
+}
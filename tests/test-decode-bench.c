@@ -0,0 +1,418 @@
+/*
+ *  test-decode-bench.c - Decoder throughput benchmark with per-stage timing
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecoder_h264.h>
+#include <gst/vaapi/gstvaapidecoder_jpeg.h>
+#include <gst/vaapi/gstvaapidecoder_mpeg2.h>
+#include <gst/vaapi/gstvaapidecoder_mpeg4.h>
+#include <gst/vaapi/gstvaapidecoder_vc1.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include <gst/vaapi/gstvaapitrace.h>
+#include "test-h264.h"
+#include "test-jpeg.h"
+#include "test-mpeg2.h"
+#include "test-vc1.h"
+#include "output.h"
+
+typedef void (*GetVideoInfoFunc)(VideoDecodeInfo *info);
+
+typedef struct _CodecDefs CodecDefs;
+struct _CodecDefs {
+    const gchar        *codec_str;
+    GstVaapiProfile     profile;
+    GetVideoInfoFunc    get_video_info;
+};
+
+static const CodecDefs g_codec_defs[] = {
+    { "h264",  GST_VAAPI_PROFILE_H264_HIGH,     h264_get_video_info  },
+    { "jpeg",  GST_VAAPI_PROFILE_JPEG_BASELINE, jpeg_get_video_info  },
+    { "mpeg2", GST_VAAPI_PROFILE_MPEG2_MAIN,    mpeg2_get_video_info },
+    { "mpeg4", GST_VAAPI_PROFILE_MPEG4_ADVANCED_SIMPLE, NULL },
+    { "vc1",   GST_VAAPI_PROFILE_VC1_ADVANCED,  vc1_get_video_info   },
+    { NULL, }
+};
+
+static const gchar *g_stage_names[GST_VAAPI_DECODER_STAGE_COUNT] = {
+    "parse", "fill", "submit", "output"
+};
+
+static gchar   *g_codec_str;
+static gchar   *g_input_file;
+static gint     g_chunk_size;
+static gint     g_num_iterations = 10;
+static gchar   *g_json_file;
+static gchar   *g_trace_file;
+
+static GOptionEntry g_options[] = {
+    { "codec", 'c',
+      0,
+      G_OPTION_ARG_STRING, &g_codec_str,
+      "codec of the clip (h264, jpeg, mpeg2, mpeg4, vc1)", NULL },
+    { "input", 'i',
+      0,
+      G_OPTION_ARG_FILENAME, &g_input_file,
+      "bitstream file to decode instead of the embedded clip", NULL },
+    { "chunk-size", 's',
+      0,
+      G_OPTION_ARG_INT, &g_chunk_size,
+      "size of the buffers fed to the decoder, 0 for the whole clip", NULL },
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "number of times the clip is decoded", NULL },
+    { "json", 'j',
+      0,
+      G_OPTION_ARG_FILENAME, &g_json_file,
+      "also write the results as JSON to this file", NULL },
+    { "trace", 't',
+      0,
+      G_OPTION_ARG_FILENAME, &g_trace_file,
+      "record trace events to this file (Chrome trace format)", NULL },
+    { NULL, }
+};
+
+typedef struct _BenchResults BenchResults;
+struct _BenchResults {
+    guint                       num_frames;
+    gdouble                     elapsed;
+    GstVaapiDecoderStageStats   stages[GST_VAAPI_DECODER_STAGE_COUNT];
+    guint                       table_hits;
+    guint                       table_misses;
+    guint                       num_pictures;
+    guint                       num_va_calls;
+};
+
+static const CodecDefs *
+get_codec_defs(const gchar *codec_str)
+{
+    const CodecDefs *c;
+
+    for (c = g_codec_defs; c->codec_str; c++)
+        if (strcmp(codec_str, c->codec_str) == 0)
+            return c;
+    return NULL;
+}
+
+static GstVaapiDecoder *
+create_decoder(GstVaapiDisplay *display, VideoDecodeInfo *info)
+{
+    GstVaapiDecoder *decoder;
+    GstCaps *caps;
+
+    caps = gst_vaapi_profile_get_caps(info->profile);
+    if (!caps)
+        g_error("could not create decoder caps");
+
+    if (info->width > 0 && info->height > 0)
+        gst_caps_set_simple(
+            caps,
+            "width",  G_TYPE_INT, info->width,
+            "height", G_TYPE_INT, info->height,
+            NULL
+        );
+
+    switch (gst_vaapi_profile_get_codec(info->profile)) {
+    case GST_VAAPI_CODEC_H264:
+        decoder = gst_vaapi_decoder_h264_new(display, caps);
+        break;
+#if USE_JPEG_DECODER
+    case GST_VAAPI_CODEC_JPEG:
+        decoder = gst_vaapi_decoder_jpeg_new(display, caps);
+        break;
+#endif
+    case GST_VAAPI_CODEC_MPEG2:
+        decoder = gst_vaapi_decoder_mpeg2_new(display, caps);
+        break;
+    case GST_VAAPI_CODEC_MPEG4:
+        decoder = gst_vaapi_decoder_mpeg4_new(display, caps);
+        break;
+    case GST_VAAPI_CODEC_VC1:
+        decoder = gst_vaapi_decoder_vc1_new(display, caps);
+        break;
+    default:
+        decoder = NULL;
+        break;
+    }
+    if (!decoder)
+        g_error("could not create decoder");
+    gst_caps_unref(caps);
+    return decoder;
+}
+
+static guint
+release_surfaces(GstVaapiDecoder *decoder)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    guint num_surfaces = 0;
+
+    while ((proxy = gst_vaapi_decoder_get_surface(decoder, &status)) != NULL) {
+        g_object_unref(proxy);
+        num_surfaces++;
+    }
+    return num_surfaces;
+}
+
+static void
+merge_stage_stats(GstVaapiDecoderStageStats *dst,
+    const GstVaapiDecoderStageStats *src)
+{
+    guint i;
+
+    if (src->count == 0)
+        return;
+
+    dst->min_time    = dst->count ? MIN(dst->min_time, src->min_time) :
+        src->min_time;
+    dst->max_time    = MAX(dst->max_time, src->max_time);
+    dst->count      += src->count;
+    dst->total_time += src->total_time;
+    for (i = 0; i < GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS; i++)
+        dst->histogram[i] += src->histogram[i];
+}
+
+static void
+decode_clip(GstVaapiDisplay *display, VideoDecodeInfo *info,
+    BenchResults *results)
+{
+    GstVaapiDecoder *decoder;
+    GstVaapiDecoderStageStats stats;
+    GstBuffer *buffer;
+    guint i, ofs, size, num_pictures, num_va_calls;
+
+    decoder = create_decoder(display, info);
+    gst_vaapi_decoder_set_stage_timing(decoder, TRUE);
+
+    for (ofs = 0; ofs < info->data_size; ofs += size) {
+        size = g_chunk_size > 0 ?
+            MIN((guint)g_chunk_size, info->data_size - ofs) :
+            info->data_size;
+
+        buffer = gst_buffer_new();
+        if (!buffer)
+            g_error("could not create encoded data buffer");
+        gst_buffer_set_data(buffer, (guchar *)info->data + ofs, size);
+
+        if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
+            g_error("could not send video data to the decoder");
+        gst_buffer_unref(buffer);
+
+        results->num_frames += release_surfaces(decoder);
+    }
+
+    if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
+        g_error("could not send EOS to the decoder");
+    results->num_frames += release_surfaces(decoder);
+
+    for (i = 0; i < GST_VAAPI_DECODER_STAGE_COUNT; i++) {
+        if (gst_vaapi_decoder_get_stage_stats(decoder, i, &stats))
+            merge_stage_stats(&results->stages[i], &stats);
+    }
+
+    gst_vaapi_decoder_get_submit_stats(decoder, &num_pictures, &num_va_calls);
+    results->num_pictures += num_pictures;
+    results->num_va_calls += num_va_calls;
+
+#if USE_JPEG_DECODER
+    if (GST_VAAPI_IS_DECODER_JPEG(decoder)) {
+        guint num_hits, num_misses;
+
+        gst_vaapi_decoder_jpeg_get_table_stats(GST_VAAPI_DECODER_JPEG(decoder),
+            &num_hits, &num_misses);
+        results->table_hits   += num_hits;
+        results->table_misses += num_misses;
+    }
+#endif
+    g_object_unref(decoder);
+}
+
+static void
+print_results_text(const BenchResults *r)
+{
+    guint i, j, last;
+
+    g_print("%u frames, %.3f ms/iteration, %.1f fps\n",
+            r->num_frames / g_num_iterations,
+            r->elapsed * 1000.0 / g_num_iterations,
+            r->elapsed > 0.0 ? r->num_frames / r->elapsed : 0.0);
+    if (r->table_hits + r->table_misses > 0)
+        g_print("  tables %u reused, %u parsed\n",
+                r->table_hits, r->table_misses);
+    if (r->num_pictures > 0)
+        g_print("  %.2f VA submission calls per picture\n",
+                (gdouble)r->num_va_calls / r->num_pictures);
+
+    for (i = 0; i < GST_VAAPI_DECODER_STAGE_COUNT; i++) {
+        const GstVaapiDecoderStageStats * const s = &r->stages[i];
+
+        if (s->count == 0) {
+            g_print("  %-6s -\n", g_stage_names[i]);
+            continue;
+        }
+        g_print("  %-6s %8" G_GUINT64_FORMAT " runs, total %.3f ms, "
+                "mean %.2f us, min %.2f us, max %.2f us\n",
+                g_stage_names[i], s->count, s->total_time / 1e6,
+                s->total_time / 1e3 / s->count,
+                s->min_time / 1e3, s->max_time / 1e3);
+
+        for (last = GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS; last > 0; last--)
+            if (s->histogram[last - 1])
+                break;
+        for (j = 0; j < last; j++) {
+            if (!s->histogram[j])
+                continue;
+            g_print("         < %10" G_GUINT64_FORMAT " ns: %u\n",
+                    (guint64)1 << j, s->histogram[j]);
+        }
+    }
+}
+
+/* Writes the results as a JSON object, so that they can be tracked
+   across commits */
+static void
+write_results_json(const BenchResults *r, const gchar *clip,
+    const gchar *filename)
+{
+    GString * const str = g_string_new(NULL);
+    GError *error = NULL;
+    gchar *clip_str;
+    guint i, j;
+
+    clip_str = g_strescape(clip, NULL);
+    g_string_append_printf(str, "{\n");
+    g_string_append_printf(str, "  \"codec\": \"%s\",\n", g_codec_str);
+    g_string_append_printf(str, "  \"clip\": \"%s\",\n", clip_str);
+    g_string_append_printf(str, "  \"chunk_size\": %d,\n", g_chunk_size);
+    g_string_append_printf(str, "  \"iterations\": %d,\n", g_num_iterations);
+    g_string_append_printf(str, "  \"frames\": %u,\n", r->num_frames);
+    g_string_append_printf(str, "  \"elapsed_ns\": %" G_GUINT64_FORMAT ",\n",
+        (guint64)(r->elapsed * 1e9));
+    g_string_append_printf(str, "  \"fps\": %.3f,\n",
+        r->elapsed > 0.0 ? r->num_frames / r->elapsed : 0.0);
+    g_string_append_printf(str, "  \"pictures\": %u,\n", r->num_pictures);
+    g_string_append_printf(str, "  \"va_calls\": %u,\n", r->num_va_calls);
+    g_string_append_printf(str, "  \"stages\": {\n");
+    g_free(clip_str);
+    for (i = 0; i < GST_VAAPI_DECODER_STAGE_COUNT; i++) {
+        const GstVaapiDecoderStageStats * const s = &r->stages[i];
+
+        g_string_append_printf(str,
+            "    \"%s\": { \"count\": %" G_GUINT64_FORMAT
+            ", \"total_ns\": %" G_GUINT64_FORMAT
+            ", \"min_ns\": %" G_GUINT64_FORMAT
+            ", \"max_ns\": %" G_GUINT64_FORMAT ", \"histogram\": [",
+            g_stage_names[i], s->count, s->total_time,
+            s->min_time, s->max_time);
+        for (j = 0; j < GST_VAAPI_DECODER_STAGE_HISTOGRAM_BINS; j++)
+            g_string_append_printf(str, "%s%u", j ? ", " : "", s->histogram[j]);
+        g_string_append_printf(str, "] }%s\n",
+            i + 1 < GST_VAAPI_DECODER_STAGE_COUNT ? "," : "");
+    }
+    g_string_append_printf(str, "  }\n");
+    g_string_append_printf(str, "}\n");
+
+    if (!g_file_set_contents(filename, str->str, str->len, &error))
+        g_error("could not write %s: %s", filename, error->message);
+    g_string_free(str, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    const CodecDefs *codec;
+    VideoDecodeInfo info;
+    BenchResults results;
+    GError *error = NULL;
+    gchar *data = NULL, *clip;
+    gsize data_size;
+    GTimer *timer;
+    gint i;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (!g_codec_str)
+        g_codec_str = g_strdup("h264");
+    if (g_num_iterations < 1)
+        g_num_iterations = 1;
+
+    codec = get_codec_defs(g_codec_str);
+    if (!codec)
+        g_error("unsupported codec '%s'", g_codec_str);
+
+    memset(&info, 0, sizeof(info));
+    if (g_input_file) {
+        if (!g_file_get_contents(g_input_file, &data, &data_size, &error))
+            g_error("could not read %s: %s", g_input_file, error->message);
+        info.profile   = codec->profile;
+        info.data      = (const guchar *)data;
+        info.data_size = data_size;
+        clip = g_path_get_basename(g_input_file);
+    }
+    else {
+        if (!codec->get_video_info)
+            g_error("no embedded %s clip, use --input", g_codec_str);
+        codec->get_video_info(&info);
+        clip = g_strdup("embedded");
+    }
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    if (g_trace_file && !gst_vaapi_trace_start(1U << 20))
+        g_error("could not start tracing");
+
+    memset(&results, 0, sizeof(results));
+    timer = g_timer_new();
+    for (i = 0; i < g_num_iterations; i++)
+        decode_clip(display, &info, &results);
+    g_timer_stop(timer);
+    results.elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    if (g_trace_file) {
+        gst_vaapi_trace_stop();
+        if (!gst_vaapi_trace_write(g_trace_file))
+            g_error("could not write trace to %s", g_trace_file);
+    }
+
+    g_print("Benchmark %s decode of %s (%u bytes), chunk size %d, "
+            "%d iterations\n", g_codec_str, clip, info.data_size,
+            g_chunk_size, g_num_iterations);
+    print_results_text(&results);
+    if (g_json_file)
+        write_results_json(&results, clip, g_json_file);
+
+    g_object_unref(display);
+    g_free(clip);
+    g_free(data);
+    g_free(g_codec_str);
+    g_free(g_input_file);
+    g_free(g_json_file);
+    g_free(g_trace_file);
+    video_output_exit();
+    return 0;
+}
@@ -33,6 +33,7 @@
 #include "test-h264.h"
 #include "test-vc1.h"
 #include "output.h"
+#include "stub.h"
 
 /* Set to 1 to check display cache works (shared VA display) */
 #define CHECK_DISPLAY_CACHE 1
@@ -72,73 +73,51 @@ static inline void pause(void)
 }
 
 static gchar *g_codec_str;
+static gint   g_num_iterations;
+static gchar *g_params_file;
+static gboolean g_record_params;
 
 static GOptionEntry g_options[] = {
     { "codec", 'c',
       0,
       G_OPTION_ARG_STRING, &g_codec_str,
       "codec to test", NULL },
+    { "benchmark", 'b',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "decode the clip this many times and report the frame rate", NULL },
+    { "params", 'p',
+      0,
+      G_OPTION_ARG_FILENAME, &g_params_file,
+      "check the VA parameters against this file (stub output only)", NULL },
+    { "record-params", 0,
+      0,
+      G_OPTION_ARG_NONE, &g_record_params,
+      "record the VA parameters to the --params file instead", NULL },
     { NULL, }
 };
 
-int
-main(int argc, char *argv[])
+static GstVaapiDecoder *
+create_decoder(GstVaapiDisplay *display, VideoDecodeInfo *info)
 {
-    GstVaapiDisplay      *display, *display2;
-    GstVaapiWindow       *window;
     GstVaapiDecoder      *decoder;
     GstCaps              *decoder_caps;
     GstStructure         *structure;
-    GstVaapiDecoderStatus status;
-    const CodecDefs      *codec;
-    GstBuffer            *buffer;
-    GstVaapiSurfaceProxy *proxy;
-    VideoDecodeInfo       info;
-
-    static const guint win_width  = 640;
-    static const guint win_height = 480;
-
-    if (!video_output_init(&argc, argv, g_options))
-        g_error("failed to initialize video output subsystem");
-
-    if (!g_codec_str)
-        g_codec_str = g_strdup("h264");
-
-    g_print("Test %s decode\n", g_codec_str);
-    codec = get_codec_defs(g_codec_str);
-    if (!codec)
-        g_error("no %s codec data found", g_codec_str);
-
-    display = video_output_create_display(NULL);
-    if (!display)
-        g_error("could not create VA display");
 
-    if (CHECK_DISPLAY_CACHE)
-        display2 = video_output_create_display(NULL);
-    else
-        display2 = g_object_ref(display);
-    if (!display2)
-        g_error("could not create second VA display");
-
-    window = video_output_create_window(display, win_width, win_height);
-    if (!window)
-        g_error("could not create window");
-
-    codec->get_video_info(&info);
-    decoder_caps = gst_vaapi_profile_get_caps(info.profile);
+    decoder_caps = gst_vaapi_profile_get_caps(info->profile);
     if (!decoder_caps)
         g_error("could not create decoder caps");
 
     structure = gst_caps_get_structure(decoder_caps, 0);
-    if (info.width > 0 && info.height > 0)
+    if (info->width > 0 && info->height > 0)
         gst_structure_set(
             structure,
-            "width",  G_TYPE_INT, info.width,
-            "height", G_TYPE_INT, info.height,
+            "width",  G_TYPE_INT, info->width,
+            "height", G_TYPE_INT, info->height,
             NULL
         );
 
-    switch (gst_vaapi_profile_get_codec(info.profile)) {
+    switch (gst_vaapi_profile_get_codec(info->profile)) {
     case GST_VAAPI_CODEC_H264:
         decoder = gst_vaapi_decoder_h264_new(display, decoder_caps);
         break;
@@ -160,11 +139,18 @@ main(int argc, char *argv[])
     if (!decoder)
         g_error("could not create decoder");
     gst_caps_unref(decoder_caps);
+    return decoder;
+}
+
+static void
+put_clip(GstVaapiDecoder *decoder, VideoDecodeInfo *info)
+{
+    GstBuffer *buffer;
 
     buffer = gst_buffer_new();
     if (!buffer)
         g_error("could not create encoded data buffer");
-    gst_buffer_set_data(buffer, (guchar *)info.data, info.data_size);
+    gst_buffer_set_data(buffer, (guchar *)info->data, info->data_size);
 
     if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
         g_error("could not send video data to the decoder");
@@ -172,6 +158,161 @@ main(int argc, char *argv[])
 
     if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
         g_error("could not send EOS to the decoder");
+}
+
+/* Decodes the whole clip and returns the number of decoded frames */
+static guint
+decode_clip(GstVaapiDisplay *display, VideoDecodeInfo *info)
+{
+    GstVaapiDecoder      *decoder;
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    guint num_frames = 0;
+
+    decoder = create_decoder(display, info);
+    put_clip(decoder, info);
+    while ((proxy = gst_vaapi_decoder_get_surface(decoder, &status)) != NULL) {
+        g_object_unref(proxy);
+        num_frames++;
+    }
+    g_object_unref(decoder);
+    return num_frames;
+}
+
+static void
+run_benchmark(GstVaapiDisplay *display, VideoDecodeInfo *info)
+{
+    const StubDriverStats *stats;
+    GTimer *timer;
+    gdouble elapsed;
+    guint num_frames = 0;
+    gint i;
+
+    stub_driver_reset_stats();
+
+    timer = g_timer_new();
+    for (i = 0; i < g_num_iterations; i++)
+        num_frames += decode_clip(display, info);
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    g_print("%u frames, %.3f ms/iteration, %.1f fps\n",
+            num_frames / g_num_iterations,
+            elapsed * 1000.0 / g_num_iterations,
+            elapsed > 0.0 ? num_frames / elapsed : 0.0);
+
+    stats = stub_driver_get_stats();
+    if (stats && stats->num_end_picture > 0)
+        g_print("per picture: %.2f VA calls, %.2f parameter buffers\n",
+                (gdouble)stats->num_calls / stats->num_end_picture,
+                (gdouble)stats->num_param_buffers / stats->num_end_picture);
+}
+
+/* Compares the VA parameters submitted for the clip against the golden
+   values in @filename, or records them there with --record-params */
+static gboolean
+check_params(GstVaapiDisplay *display, VideoDecodeInfo *info,
+    const gchar *filename)
+{
+    const StubDriverStats *stats;
+    GError *error = NULL;
+    gchar *golden = NULL, *params;
+    guint num_frames;
+    gboolean success = TRUE;
+
+    stub_driver_reset_stats();
+    num_frames = decode_clip(display, info);
+
+    stats = stub_driver_get_stats();
+    if (!stats)
+        g_error("VA parameters can only be checked with the stub output");
+
+    params = g_strdup_printf("%s frames=%u pictures=%u buffers=%u "
+        "checksum=%08x\n", g_codec_str, num_frames, stats->num_end_picture,
+        stats->num_param_buffers, stats->param_checksum);
+
+    if (g_record_params) {
+        if (!g_file_set_contents(filename, params, -1, &error))
+            g_error("could not write %s: %s", filename, error->message);
+        g_print("recorded %s", params);
+    }
+    else {
+        /* A missing reference file is a failure, not a first run */
+        if (!g_file_get_contents(filename, &golden, NULL, &error))
+            g_error("could not read %s: %s", filename, error->message);
+        success = strcmp(golden, params) == 0;
+        if (success)
+            g_print("VA parameters match %s\n", filename);
+        else
+            g_printerr("VA parameters mismatch\n  expected: %s  got:      %s",
+                       golden, params);
+        g_free(golden);
+    }
+    g_free(params);
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay      *display, *display2;
+    GstVaapiWindow       *window;
+    GstVaapiDecoder      *decoder;
+    GstVaapiDecoderStatus status;
+    const CodecDefs      *codec;
+    GstVaapiSurfaceProxy *proxy;
+    VideoDecodeInfo       info;
+    gboolean              success;
+
+    static const guint win_width  = 640;
+    static const guint win_height = 480;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (!g_codec_str)
+        g_codec_str = g_strdup("h264");
+
+    g_print("Test %s decode\n", g_codec_str);
+    codec = get_codec_defs(g_codec_str);
+    if (!codec)
+        g_error("no %s codec data found", g_codec_str);
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    codec->get_video_info(&info);
+
+    /* Headless modes, usable with the stub output on machines without
+       a GPU */
+    if (g_params_file || g_num_iterations > 0) {
+        success = TRUE;
+        if (g_params_file)
+            success = check_params(display, &info, g_params_file);
+        if (g_num_iterations > 0)
+            run_benchmark(display, &info);
+        g_object_unref(display);
+        g_free(g_codec_str);
+        g_free(g_params_file);
+        video_output_exit();
+        return success ? 0 : 1;
+    }
+
+    if (CHECK_DISPLAY_CACHE)
+        display2 = video_output_create_display(NULL);
+    else
+        display2 = g_object_ref(display);
+    if (!display2)
+        g_error("could not create second VA display");
+
+    window = video_output_create_window(display, win_width, win_height);
+    if (!window)
+        g_error("could not create window");
+
+    decoder = create_decoder(display, &info);
+    put_clip(decoder, &info);
 
     proxy = gst_vaapi_decoder_get_surface(decoder, &status);
     if (!proxy)
@@ -0,0 +1,321 @@
+/*
+ *  test-display-cache.c - Test and benchmark the VA display cache
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapidisplaycache.h>
+
+static gint g_num_displays  = 64;
+static gint g_num_threads   = 8;
+static gint g_num_lookups   = 1000000;
+
+static GOptionEntry g_options[] = {
+    { "displays", 'd',
+      0,
+      G_OPTION_ARG_INT, &g_num_displays,
+      "number of cached displays", NULL },
+    { "threads", 't',
+      0,
+      G_OPTION_ARG_INT, &g_num_threads,
+      "maximum number of concurrent lookup threads", NULL },
+    { "lookups", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_lookups,
+      "number of lookups per thread in the benchmark", NULL },
+    { NULL, }
+};
+
+/* The cache never dereferences these, so fake handles are enough */
+#define FAKE_DISPLAY(i)         ((GstVaapiDisplay *)GSIZE_TO_POINTER(0x10000 + 16 * (i)))
+#define FAKE_VA_DISPLAY(i)      ((VADisplay)GSIZE_TO_POINTER(0x20000 + 16 * (i)))
+#define FAKE_NATIVE_DISPLAY(i)  GSIZE_TO_POINTER(0x30000 + 16 * (i))
+
+static gchar *
+make_display_name(guint i, guint screen)
+{
+    return g_strdup_printf("X11::%u.%u", i, screen);
+}
+
+/* Matches X11 display names regardless of the screen number */
+static gboolean
+compare_display_name(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const gchar * const cached_name = a, * const tested_name = b;
+    const gchar *end;
+
+    if (!cached_name)
+        return FALSE;
+    end = strrchr(tested_name, '.');
+    if (!end)
+        return strcmp(cached_name, tested_name) == 0;
+    return strncmp(cached_name, tested_name, end - tested_name + 1) == 0;
+}
+
+static gboolean
+add_display(GstVaapiDisplayCache *cache, guint i, guint id)
+{
+    GstVaapiDisplayInfo info;
+    gboolean success;
+
+    info.display        = FAKE_DISPLAY(id);
+    info.display_type   = GST_VAAPI_DISPLAY_TYPE_X11;
+    info.display_name   = make_display_name(i, 0);
+    info.va_display     = FAKE_VA_DISPLAY(i);
+    info.native_display = FAKE_NATIVE_DISPLAY(i);
+    success = gst_vaapi_display_cache_add(cache, &info);
+    g_free(info.display_name);
+    return success;
+}
+
+static GstVaapiDisplayCache *
+create_cache(void)
+{
+    GstVaapiDisplayCache *cache;
+    gint i;
+
+    cache = gst_vaapi_display_cache_new();
+    if (!cache)
+        g_error("could not create display cache");
+
+    for (i = 0; i < g_num_displays; i++) {
+        if (!add_display(cache, i, i))
+            g_error("could not add display %d to the cache", i);
+    }
+    return cache;
+}
+
+static gboolean
+check_lookups(GstVaapiDisplayCache *cache, guint i, GstVaapiDisplay *display)
+{
+    const GstVaapiDisplayInfo *info;
+    gchar *name;
+
+    if (gst_vaapi_display_cache_lookup_by_va_display(cache,
+            FAKE_VA_DISPLAY(i))->display != display)
+        return FALSE;
+    if (gst_vaapi_display_cache_lookup_by_native_display(cache,
+            FAKE_NATIVE_DISPLAY(i))->display != display)
+        return FALSE;
+
+    name = make_display_name(i, 0);
+    info = gst_vaapi_display_cache_lookup_by_name(cache, name, NULL, NULL);
+    g_free(name);
+    if (!info || info->display != display)
+        return FALSE;
+
+    name = make_display_name(i, 1);
+    info = gst_vaapi_display_cache_lookup_by_name(cache, name, NULL, NULL);
+    if (info) {
+        g_free(name);
+        return FALSE;
+    }
+    info = gst_vaapi_display_cache_lookup_by_name(cache, name,
+        compare_display_name, NULL);
+    g_free(name);
+    return info && info->display == display;
+}
+
+static gboolean
+run_check_test(void)
+{
+    GstVaapiDisplayCache *cache;
+    const GstVaapiDisplayInfo *info;
+    gboolean success = FALSE;
+    gint i;
+
+    cache = create_cache();
+    if (gst_vaapi_display_cache_get_size(cache) != (guint)g_num_displays)
+        goto end;
+
+    for (i = 0; i < g_num_displays; i++) {
+        info = gst_vaapi_display_cache_lookup(cache, FAKE_DISPLAY(i));
+        if (!info || info->va_display != FAKE_VA_DISPLAY(i))
+            goto end;
+        if (!check_lookups(cache, i, FAKE_DISPLAY(i)))
+            goto end;
+    }
+
+    /* A second display on the same VA display is found first, then the
+       first one again once it is removed */
+    if (!add_display(cache, 0, g_num_displays))
+        goto end;
+    if (!check_lookups(cache, 0, FAKE_DISPLAY(g_num_displays)))
+        goto end;
+    gst_vaapi_display_cache_remove(cache, FAKE_DISPLAY(g_num_displays));
+    if (!check_lookups(cache, 0, FAKE_DISPLAY(0)))
+        goto end;
+
+    for (i = 0; i < g_num_displays; i++)
+        gst_vaapi_display_cache_remove(cache, FAKE_DISPLAY(i));
+    if (gst_vaapi_display_cache_get_size(cache) != 0)
+        goto end;
+    if (gst_vaapi_display_cache_lookup_by_va_display(cache, FAKE_VA_DISPLAY(0)))
+        goto end;
+    success = TRUE;
+
+end:
+    if (!success)
+        g_printerr("display cache lookups returned wrong entries\n");
+    else
+        g_print("check: %d displays added, looked up and removed\n",
+                g_num_displays);
+    gst_vaapi_display_cache_free(cache);
+    return success;
+}
+
+typedef struct {
+    GstVaapiDisplayCache       *cache;
+    gchar                     **names;
+    guint                       seed;
+    guint                       num_found;
+} LookupThreadData;
+
+/* Mixes the lookups made when elements get their display */
+static gpointer
+lookup_thread(gpointer user_data)
+{
+    LookupThreadData * const data = user_data;
+    GRand * const rand = g_rand_new_with_seed(data->seed);
+    const GstVaapiDisplayInfo *info;
+    guint i, n;
+
+    for (i = 0; i < (guint)g_num_lookups; i++) {
+        n = g_rand_int_range(rand, 0, g_num_displays);
+        switch (i % 4) {
+        case 0:
+            info = gst_vaapi_display_cache_lookup(data->cache,
+                FAKE_DISPLAY(n));
+            break;
+        case 1:
+            info = gst_vaapi_display_cache_lookup_by_va_display(data->cache,
+                FAKE_VA_DISPLAY(n));
+            break;
+        case 2:
+            info = gst_vaapi_display_cache_lookup_by_native_display(
+                data->cache, FAKE_NATIVE_DISPLAY(n));
+            break;
+        default:
+            info = gst_vaapi_display_cache_lookup_by_name(data->cache,
+                data->names[n], compare_display_name, NULL);
+            break;
+        }
+        if (info)
+            data->num_found++;
+    }
+    g_rand_free(rand);
+    return NULL;
+}
+
+static void
+run_benchmark(void)
+{
+    GstVaapiDisplayCache *cache;
+    LookupThreadData *data;
+    GThread **threads;
+    gchar **names;
+    GTimer *timer;
+    gdouble elapsed;
+    gint i, num_threads;
+
+    cache = create_cache();
+    names = g_new(gchar *, g_num_displays);
+    for (i = 0; i < g_num_displays; i++)
+        names[i] = make_display_name(i, 0);
+
+    data    = g_new0(LookupThreadData, g_num_threads);
+    threads = g_new(GThread *, g_num_threads);
+    timer   = g_timer_new();
+
+    for (num_threads = 1; num_threads <= g_num_threads; num_threads *= 2) {
+        g_timer_start(timer);
+        for (i = 0; i < num_threads; i++) {
+            data[i].cache     = cache;
+            data[i].names     = names;
+            data[i].seed      = i;
+            data[i].num_found = 0;
+#if GLIB_CHECK_VERSION(2,31,0)
+            threads[i] = g_thread_new("lookup", lookup_thread, &data[i]);
+#else
+            threads[i] = g_thread_create(lookup_thread, &data[i], TRUE, NULL);
+#endif
+            if (!threads[i])
+                g_error("could not create lookup thread");
+        }
+        for (i = 0; i < num_threads; i++) {
+            g_thread_join(threads[i]);
+            if (data[i].num_found != (guint)g_num_lookups)
+                g_printerr("thread %d missed %u lookups\n", i,
+                           g_num_lookups - data[i].num_found);
+        }
+        g_timer_stop(timer);
+        elapsed = g_timer_elapsed(timer, NULL);
+
+        g_print("bench: %d displays, %2d threads: %.2f M lookups/s "
+                "(%.1f ns per lookup and thread)\n",
+                g_num_displays, num_threads,
+                num_threads * (gdouble)g_num_lookups / elapsed / 1e6,
+                elapsed * 1e9 / g_num_lookups);
+    }
+
+    g_timer_destroy(timer);
+    g_free(threads);
+    g_free(data);
+    for (i = 0; i < g_num_displays; i++)
+        g_free(names[i]);
+    g_free(names);
+    for (i = 0; i < g_num_displays; i++)
+        gst_vaapi_display_cache_remove(cache, FAKE_DISPLAY(i));
+    gst_vaapi_display_cache_free(cache);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    gboolean success = TRUE;
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+    if (!g_thread_supported())
+        g_thread_init(NULL);
+#endif
+
+    ctx = g_option_context_new("- display cache test");
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    if (g_num_displays < 1)
+        g_num_displays = 1;
+    if (g_num_threads < 1)
+        g_num_threads = 1;
+    if (g_num_lookups < 1)
+        g_num_lookups = 1;
+
+    if (!run_check_test())
+        success = FALSE;
+    run_benchmark();
+
+    gst_deinit();
+    return success ? 0 : 1;
+}
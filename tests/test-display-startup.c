@@ -0,0 +1,153 @@
+/*
+ *  test-display-startup.c - Benchmark VA display creation latency
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+/* The first display created in a process queries the VA driver, or
+ * reads the on-disk capabilities cache, and the next ones reuse these
+ * capabilities. Run this twice with the same --cache file to measure
+ * the cold start against a start from the on-disk cache.
+ */
+
+#include "config.h"
+#include <gst/gst.h>
+#if USE_DRM
+# include <gst/vaapi/gstvaapidisplay_drm.h>
+#endif
+#include "stub.h"
+
+static gint      g_num_displays = 100;
+static gchar    *g_cache_file;
+static gboolean  g_use_stub;
+
+static GOptionEntry g_options[] = {
+    { "displays", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_displays,
+      "number of displays to create", NULL },
+    { "cache", 'c',
+      0,
+      G_OPTION_ARG_FILENAME, &g_cache_file,
+      "on-disk capabilities cache, or an empty string to disable it", NULL },
+    { "stub", 's',
+      0,
+      G_OPTION_ARG_NONE, &g_use_stub,
+      "use the stub VA driver", NULL },
+    { NULL, }
+};
+
+static GstVaapiDisplay *
+create_display(void)
+{
+    if (g_use_stub)
+        return stub_display_new(NULL);
+#if USE_DRM
+    return gst_vaapi_display_drm_new(NULL);
+#else
+    return NULL;
+#endif
+}
+
+/* Creates a display and queries what elements need at negotiation time */
+static gdouble
+time_display(GTimer *timer, guint *num_driver_calls)
+{
+    GstVaapiDisplay *display;
+    GstCaps *caps;
+    gdouble elapsed;
+
+    if (g_use_stub)
+        stub_driver_reset_stats();
+
+    g_timer_start(timer);
+    display = create_display();
+    if (!display || !gst_vaapi_display_get_display(display))
+        g_error("could not create VA display");
+
+    caps = gst_vaapi_display_get_decode_caps(display);
+    if (caps)
+        gst_caps_unref(caps);
+    caps = gst_vaapi_display_get_image_caps(display);
+    if (caps)
+        gst_caps_unref(caps);
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+
+    if (g_use_stub && stub_driver_get_stats())
+        *num_driver_calls = stub_driver_get_stats()->num_calls;
+    else
+        *num_driver_calls = 0;
+
+    g_object_unref(display);
+    return elapsed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    GTimer *timer;
+    gdouble elapsed, total, min_elapsed, max_elapsed;
+    guint num_calls, total_calls;
+    gint i;
+
+    ctx = g_option_context_new("- display startup benchmark");
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    if (g_num_displays < 2)
+        g_num_displays = 2;
+    if (g_cache_file)
+        g_setenv("GST_VAAPI_DISPLAY_CACHE", g_cache_file, TRUE);
+
+    timer = g_timer_new();
+
+    elapsed = time_display(timer, &num_calls);
+    g_print("first display:  %8.3f ms", elapsed * 1e3);
+    if (g_use_stub)
+        g_print(", %u driver calls", num_calls);
+    g_print("\n");
+
+    total = 0.0;
+    total_calls = 0;
+    min_elapsed = G_MAXDOUBLE;
+    max_elapsed = 0.0;
+    for (i = 1; i < g_num_displays; i++) {
+        elapsed = time_display(timer, &num_calls);
+        total += elapsed;
+        total_calls += num_calls;
+        min_elapsed = MIN(min_elapsed, elapsed);
+        max_elapsed = MAX(max_elapsed, elapsed);
+    }
+    g_print("next displays:  %8.3f ms average (min %.3f ms, max %.3f ms)",
+            total * 1e3 / (g_num_displays - 1),
+            min_elapsed * 1e3, max_elapsed * 1e3);
+    if (g_use_stub)
+        g_print(", %.1f driver calls",
+                (gdouble)total_calls / (g_num_displays - 1));
+    g_print("\n");
+
+    g_timer_destroy(timer);
+    g_free(g_cache_file);
+    gst_deinit();
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ *  test-download-bench.c - Benchmark surface readback
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include "output.h"
+
+/* Surfaces read in turn, so that consecutive frames do not hit the
+   same memory */
+#define NUM_SURFACES    4
+
+static gint g_num_frames    = 100;
+
+static GOptionEntry g_options[] = {
+    { "frames", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames read back per mode and size", NULL },
+    { NULL, }
+};
+
+typedef struct _BenchSize BenchSize;
+struct _BenchSize {
+    const gchar        *name;
+    guint               width;
+    guint               height;
+};
+
+static const BenchSize g_sizes[] = {
+    { "1080p", 1920, 1080 },
+    { "4K",    3840, 2160 },
+};
+
+/* The same readback paths as vaapidownload */
+typedef enum {
+    MODE_GET_IMAGE = 0,         /* vaGetImage(), then copy to the buffer */
+    MODE_DERIVE_COPY,           /* copy from the derived image */
+    MODE_DERIVE_MAP,            /* map the derived image, no copy */
+    MODE_COUNT
+} BenchMode;
+
+static const gchar *g_mode_names[MODE_COUNT] = {
+    "get-image", "derive-copy", "zero-copy"
+};
+
+typedef struct _BenchContext BenchContext;
+struct _BenchContext {
+    GstVaapiSurface    *surfaces[NUM_SURFACES];
+    GstVaapiImage      *derived_images[NUM_SURFACES];
+    GstVaapiImage      *image;
+    GstBuffer          *buffer;
+    guint               width;
+    guint               height;
+};
+
+/* Downstream reads the frame at least once: touch each cache line, so
+   that uncached mappings are not measured for free */
+static guint
+consume(const guint8 *data, guint size)
+{
+    guint i, sum = 0;
+
+    for (i = 0; i < size; i += 64)
+        sum += data[i];
+    return sum;
+}
+
+/* Checks whether the derived image has the NV12 layout of a GStreamer
+   buffer, in which case vaapidownload can push it without a copy */
+static gboolean
+has_buffer_layout(GstVaapiImage *image, guint width, guint height)
+{
+    VAImage va_image;
+    const guint stride = GST_ROUND_UP_4(width);
+
+    if (!gst_vaapi_image_get_image(image, &va_image))
+        return FALSE;
+    return (va_image.num_planes == 2 &&
+            va_image.pitches[0] == stride &&
+            va_image.pitches[1] == stride &&
+            va_image.offsets[1] - va_image.offsets[0] ==
+            stride * GST_ROUND_UP_2(height));
+}
+
+static gboolean
+bench_context_init(BenchContext *ctx, GstVaapiDisplay *display,
+    guint width, guint height)
+{
+    GstCaps *caps;
+    guint i;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->width  = width;
+    ctx->height = height;
+
+    for (i = 0; i < NUM_SURFACES; i++) {
+        ctx->surfaces[i] = gst_vaapi_surface_new(display,
+            GST_VAAPI_CHROMA_TYPE_YUV420, width, height);
+        if (!ctx->surfaces[i])
+            return FALSE;
+        ctx->derived_images[i] = gst_vaapi_surface_derive_image(ctx->surfaces[i]);
+    }
+
+    ctx->image = gst_vaapi_image_new(display, GST_VAAPI_IMAGE_NV12,
+        width, height);
+    if (!ctx->image)
+        return FALSE;
+
+    caps = gst_vaapi_image_format_get_caps(GST_VAAPI_IMAGE_NV12);
+    if (!caps)
+        return FALSE;
+    gst_caps_set_simple(
+        caps,
+        "width",  G_TYPE_INT, width,
+        "height", G_TYPE_INT, height,
+        NULL
+    );
+    ctx->buffer = gst_buffer_new_and_alloc(
+        GST_ROUND_UP_4(width) * GST_ROUND_UP_2(height) * 3 / 2);
+    gst_buffer_set_caps(ctx->buffer, caps);
+    gst_caps_unref(caps);
+    return TRUE;
+}
+
+static void
+bench_context_clear(BenchContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < NUM_SURFACES; i++) {
+        g_clear_object(&ctx->derived_images[i]);
+        g_clear_object(&ctx->surfaces[i]);
+    }
+    g_clear_object(&ctx->image);
+    if (ctx->buffer) {
+        gst_buffer_unref(ctx->buffer);
+        ctx->buffer = NULL;
+    }
+}
+
+static gboolean
+read_frame(BenchContext *ctx, BenchMode mode, guint n, guint *sum)
+{
+    GstVaapiSurface * const surface = ctx->surfaces[n % NUM_SURFACES];
+    GstVaapiImage * const derived_image = ctx->derived_images[n % NUM_SURFACES];
+
+    switch (mode) {
+    case MODE_GET_IMAGE:
+        if (!gst_vaapi_surface_get_image(surface, ctx->image))
+            return FALSE;
+        if (!gst_vaapi_image_get_buffer(ctx->image, ctx->buffer, NULL))
+            return FALSE;
+        break;
+    case MODE_DERIVE_COPY:
+        if (!gst_vaapi_surface_sync(surface))
+            return FALSE;
+        if (!gst_vaapi_image_get_buffer(derived_image, ctx->buffer, NULL))
+            return FALSE;
+        break;
+    case MODE_DERIVE_MAP:
+        if (!gst_vaapi_surface_sync(surface))
+            return FALSE;
+        if (!gst_vaapi_image_map(derived_image))
+            return FALSE;
+        *sum += consume(gst_vaapi_image_get_plane(derived_image, 0),
+                        GST_BUFFER_SIZE(ctx->buffer));
+        return gst_vaapi_image_unmap(derived_image);
+    default:
+        return FALSE;
+    }
+    *sum += consume(GST_BUFFER_DATA(ctx->buffer), GST_BUFFER_SIZE(ctx->buffer));
+    return TRUE;
+}
+
+static void
+run_benchmark(GstVaapiDisplay *display, const BenchSize *size)
+{
+    BenchContext ctx;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed = 0.0;
+    guint i, sum = 0;
+    gint n;
+
+    if (!bench_context_init(&ctx, display, size->width, size->height)) {
+        g_print("%-6s could not create %ux%u surfaces\n", size->name,
+                size->width, size->height);
+        bench_context_clear(&ctx);
+        return;
+    }
+
+    if (!ctx.derived_images[0])
+        g_print("%-6s vaDeriveImage() is not supported\n", size->name);
+    else
+        g_print("%-6s derived image layout %s the buffer layout\n",
+                size->name,
+                has_buffer_layout(ctx.derived_images[0], size->width,
+                                  size->height) ? "matches" : "differs from");
+
+    timer = g_timer_new();
+    for (i = 0; i < MODE_COUNT; i++) {
+        if (i != MODE_GET_IMAGE && !ctx.derived_images[0])
+            break;
+
+        g_timer_start(timer);
+        for (n = 0; n < g_num_frames; n++) {
+            if (!read_frame(&ctx, i, n, &sum))
+                break;
+        }
+        elapsed = g_timer_elapsed(timer, NULL);
+        if (n < g_num_frames) {
+            g_print("%-6s %-12s failed\n", size->name, g_mode_names[i]);
+            continue;
+        }
+        if (i == MODE_GET_IMAGE)
+            ref_elapsed = elapsed;
+
+        g_print("%-6s %-12s %8.1f fps (x%.2f)\n", size->name, g_mode_names[i],
+                elapsed > 0.0 ? g_num_frames / elapsed : 0.0,
+                elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+    }
+    g_timer_destroy(timer);
+    bench_context_clear(&ctx);
+
+    /* Keeps the reads from being optimized out */
+    if (sum == 1)
+        g_print("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    guint i;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    g_num_frames = MAX(g_num_frames, 1);
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    g_print("Benchmark readback of NV12 surfaces, %d frames\n", g_num_frames);
+    for (i = 0; i < G_N_ELEMENTS(g_sizes); i++)
+        run_benchmark(display, &g_sizes[i]);
+
+    g_object_unref(display);
+    video_output_exit();
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ *  test-h264-chunks.c - Benchmark H.264 decoding of chunked input
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecoder_h264.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include "test-h264.h"
+#include "output.h"
+
+/* Chunk size used to feed whole access units */
+#define CHUNK_SIZE_AU 0
+
+static gint g_num_iterations = 20;
+
+static GOptionEntry g_options[] = {
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "number of times the clip is decoded per chunk size", NULL },
+    { NULL, }
+};
+
+/* Returns the size of the access unit starting at @ofs. An access unit
+   ends before the next AUD, SPS, PPS or SEI NAL unit, or before the
+   next slice that has first_mb_in_slice == 0 */
+static guint
+get_access_unit_size(const guchar *buf, guint buf_size, guint ofs)
+{
+    gboolean has_slice = FALSE;
+    guint i, nal_type;
+
+    for (i = ofs; i + 4 < buf_size; i++) {
+        if (buf[i] != 0 || buf[i + 1] != 0 || buf[i + 2] != 1)
+            continue;
+
+        nal_type = buf[i + 3] & 0x1f;
+        switch (nal_type) {
+        case 1: case 5:
+            /* first_mb_in_slice == 0 is coded as a single '1' bit */
+            if (has_slice && (buf[i + 4] & 0x80))
+                goto end;
+            has_slice = TRUE;
+            break;
+        case 6: case 7: case 8: case 9:
+            if (has_slice)
+                goto end;
+            break;
+        }
+        i += 2;
+    }
+    return buf_size - ofs;
+
+end:
+    /* Leave any zero_byte to the next access unit */
+    if (i > ofs && buf[i - 1] == 0)
+        i--;
+    return i - ofs;
+}
+
+static guint
+release_surfaces(GstVaapiDecoder *decoder)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    guint num_surfaces = 0;
+
+    while ((proxy = gst_vaapi_decoder_get_surface(decoder, &status)) != NULL) {
+        g_object_unref(proxy);
+        num_surfaces++;
+    }
+    return num_surfaces;
+}
+
+static guint
+decode_clip(GstVaapiDisplay *display, VideoDecodeInfo *info, guint chunk_size)
+{
+    GstVaapiDecoder *decoder;
+    GstCaps *caps;
+    GstBuffer *buffer;
+    guint ofs, size, num_surfaces = 0;
+
+    caps = gst_vaapi_profile_get_caps(info->profile);
+    if (!caps)
+        g_error("could not create decoder caps");
+
+    gst_caps_set_simple(
+        caps,
+        "width",  G_TYPE_INT, info->width,
+        "height", G_TYPE_INT, info->height,
+        NULL
+    );
+
+    decoder = gst_vaapi_decoder_h264_new(display, caps);
+    if (!decoder)
+        g_error("could not create decoder");
+    gst_caps_unref(caps);
+
+    for (ofs = 0; ofs < info->data_size; ofs += size) {
+        if (chunk_size == CHUNK_SIZE_AU)
+            size = get_access_unit_size(info->data, info->data_size, ofs);
+        else
+            size = MIN(chunk_size, info->data_size - ofs);
+
+        buffer = gst_buffer_new();
+        if (!buffer)
+            g_error("could not create encoded data buffer");
+        gst_buffer_set_data(buffer, (guchar *)info->data + ofs, size);
+
+        if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
+            g_error("could not send video data to the decoder");
+        gst_buffer_unref(buffer);
+
+        num_surfaces += release_surfaces(decoder);
+    }
+
+    if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
+        g_error("could not send EOS to the decoder");
+    num_surfaces += release_surfaces(decoder);
+
+    g_object_unref(decoder);
+    return num_surfaces;
+}
+
+/* Returns the number of frames decoded per iteration */
+static guint
+bench_chunk_size(GstVaapiDisplay *display, VideoDecodeInfo *info,
+    guint chunk_size)
+{
+    GTimer *timer;
+    gdouble elapsed;
+    guint num_surfaces = 0;
+    gint i;
+
+    timer = g_timer_new();
+    for (i = 0; i < g_num_iterations; i++)
+        num_surfaces += decode_clip(display, info, chunk_size);
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    if (chunk_size == CHUNK_SIZE_AU)
+        g_print("  chunk size: %-10s", "AU");
+    else
+        g_print("  chunk size: %-10u", chunk_size);
+    g_print(" %u frames, %.3f ms/iteration, %.1f fps\n",
+            num_surfaces / g_num_iterations,
+            elapsed * 1000.0 / g_num_iterations,
+            elapsed > 0.0 ? num_surfaces / elapsed : 0.0);
+    return num_surfaces / g_num_iterations;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    VideoDecodeInfo info;
+
+    static const guint chunk_sizes[] = { 188, 1400, CHUNK_SIZE_AU };
+    guint i, num_frames, ref_num_frames = 0;
+    gboolean success = TRUE;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_num_iterations < 1)
+        g_num_iterations = 1;
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    h264_get_video_info(&info);
+
+    g_print("Benchmark H.264 decode of %u bytes, %d iterations\n",
+            info.data_size, g_num_iterations);
+    for (i = 0; i < G_N_ELEMENTS(chunk_sizes); i++) {
+        num_frames = bench_chunk_size(display, &info, chunk_sizes[i]);
+        if (i == 0)
+            ref_num_frames = num_frames;
+
+        /* The framing must not depend on how the input is split */
+        if (num_frames == 0 || num_frames != ref_num_frames) {
+            g_printerr("chunk size %u: %u frames decoded, expected %u\n",
+                       chunk_sizes[i], num_frames, ref_num_frames);
+            success = FALSE;
+        }
+    }
+
+    g_object_unref(display);
+    video_output_exit();
+    return success ? 0 : 1;
+}
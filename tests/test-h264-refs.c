@@ -0,0 +1,365 @@
+/*
+ *  test-h264-refs.c - Benchmark H.264 reference picture list construction
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecoder_h264.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include "output.h"
+#include "stub.h"
+
+/* Synthetic stream parameters */
+#define LOG2_MAX_FRAME_NUM      8
+#define LOG2_MAX_POC_LSB        8
+#define NUM_REF_FRAMES          4
+
+static gint g_num_iterations = 10;
+static gint g_num_gops       = 32;
+static gint g_num_slices     = 8;
+
+static GOptionEntry g_options[] = {
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "number of times the stream is decoded", NULL },
+    { "gops", 'g',
+      0,
+      G_OPTION_ARG_INT, &g_num_gops,
+      "number of GOPs in the generated stream", NULL },
+    { "slices", 's',
+      0,
+      G_OPTION_ARG_INT, &g_num_slices,
+      "number of slices per picture", NULL },
+    { NULL, }
+};
+
+typedef struct _BitWriter BitWriter;
+struct _BitWriter {
+    GByteArray *rbsp;
+    guint8      cur;
+    guint       num_bits;
+};
+
+static void
+bit_writer_put_bits(BitWriter *bw, guint32 value, guint n)
+{
+    while (n-- > 0) {
+        bw->cur = (bw->cur << 1) | ((value >> n) & 1);
+        if (++bw->num_bits == 8) {
+            g_byte_array_append(bw->rbsp, &bw->cur, 1);
+            bw->cur      = 0;
+            bw->num_bits = 0;
+        }
+    }
+}
+
+static void
+bit_writer_put_ue(BitWriter *bw, guint32 value)
+{
+    guint n = g_bit_storage(value + 1);
+
+    bit_writer_put_bits(bw, 0, n - 1);
+    bit_writer_put_bits(bw, value + 1, n);
+}
+
+static void
+bit_writer_put_se(BitWriter *bw, gint32 value)
+{
+    bit_writer_put_ue(bw, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+/* Writes rbsp_trailing_bits() */
+static void
+bit_writer_put_trailing_bits(BitWriter *bw)
+{
+    bit_writer_put_bits(bw, 1, 1);
+    while (bw->num_bits != 0)
+        bit_writer_put_bits(bw, 0, 1);
+}
+
+/* Appends the NAL unit with a start code and emulation prevention bytes */
+static void
+put_nal_unit(GByteArray *stream, guint nal_ref_idc, guint nal_unit_type,
+    BitWriter *bw)
+{
+    static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+    guint8 header, epb = 0x03;
+    guint i, num_zeros = 0;
+
+    g_byte_array_append(stream, start_code, sizeof(start_code));
+    header = (nal_ref_idc << 5) | nal_unit_type;
+    g_byte_array_append(stream, &header, 1);
+
+    for (i = 0; i < bw->rbsp->len; i++) {
+        const guint8 byte = bw->rbsp->data[i];
+        if (num_zeros == 2 && byte <= 0x03) {
+            g_byte_array_append(stream, &epb, 1);
+            num_zeros = 0;
+        }
+        g_byte_array_append(stream, &byte, 1);
+        num_zeros = byte ? 0 : num_zeros + 1;
+    }
+    g_byte_array_set_size(bw->rbsp, 0);
+}
+
+static void
+put_sps(GByteArray *stream, BitWriter *bw, guint mb_width, guint mb_height)
+{
+    bit_writer_put_bits(bw, 77, 8);                     // profile_idc (Main)
+    bit_writer_put_bits(bw, 0, 8);                      // constraint_set flags
+    bit_writer_put_bits(bw, 41, 8);                     // level_idc
+    bit_writer_put_ue(bw, 0);                           // seq_parameter_set_id
+    bit_writer_put_ue(bw, LOG2_MAX_FRAME_NUM - 4);
+    bit_writer_put_ue(bw, 0);                           // pic_order_cnt_type
+    bit_writer_put_ue(bw, LOG2_MAX_POC_LSB - 4);
+    bit_writer_put_ue(bw, NUM_REF_FRAMES);
+    bit_writer_put_bits(bw, 0, 1);                      // gaps_in_frame_num_...
+    bit_writer_put_ue(bw, mb_width - 1);
+    bit_writer_put_ue(bw, mb_height - 1);
+    bit_writer_put_bits(bw, 1, 1);                      // frame_mbs_only_flag
+    bit_writer_put_bits(bw, 1, 1);                      // direct_8x8_inference
+    bit_writer_put_bits(bw, 0, 1);                      // frame_cropping_flag
+    bit_writer_put_bits(bw, 0, 1);                      // vui_parameters_present
+    bit_writer_put_trailing_bits(bw);
+    put_nal_unit(stream, 3, 7, bw);
+}
+
+static void
+put_pps(GByteArray *stream, BitWriter *bw)
+{
+    bit_writer_put_ue(bw, 0);                           // pic_parameter_set_id
+    bit_writer_put_ue(bw, 0);                           // seq_parameter_set_id
+    bit_writer_put_bits(bw, 0, 1);                      // entropy_coding_mode
+    bit_writer_put_bits(bw, 0, 1);                      // bottom_field_pic_order_...
+    bit_writer_put_ue(bw, 0);                           // num_slice_groups_minus1
+    bit_writer_put_ue(bw, 1);                           // num_ref_idx_l0_default_...
+    bit_writer_put_ue(bw, 0);                           // num_ref_idx_l1_default_...
+    bit_writer_put_bits(bw, 0, 1);                      // weighted_pred_flag
+    bit_writer_put_bits(bw, 0, 2);                      // weighted_bipred_idc
+    bit_writer_put_se(bw, 0);                           // pic_init_qp_minus26
+    bit_writer_put_se(bw, 0);                           // pic_init_qs_minus26
+    bit_writer_put_se(bw, 0);                           // chroma_qp_index_offset
+    bit_writer_put_bits(bw, 1, 1);                      // deblocking_filter_...
+    bit_writer_put_bits(bw, 0, 1);                      // constrained_intra_pred
+    bit_writer_put_bits(bw, 0, 1);                      // redundant_pic_cnt_...
+    bit_writer_put_trailing_bits(bw);
+    put_nal_unit(stream, 3, 8, bw);
+}
+
+/* Writes a slice header followed by a few bytes of dummy slice data.
+   The slice data is never parsed by the decoder */
+static void
+put_slice(GByteArray *stream, BitWriter *bw, guint first_mb, guint slice_type,
+    gboolean is_idr, gboolean is_ref, guint frame_num, guint poc)
+{
+    bit_writer_put_ue(bw, first_mb);
+    bit_writer_put_ue(bw, slice_type + 5);
+    bit_writer_put_ue(bw, 0);                           // pic_parameter_set_id
+    bit_writer_put_bits(bw, frame_num, LOG2_MAX_FRAME_NUM);
+    if (is_idr)
+        bit_writer_put_ue(bw, 0);                       // idr_pic_id
+    bit_writer_put_bits(bw, poc, LOG2_MAX_POC_LSB);
+
+    if (slice_type == 1)
+        bit_writer_put_bits(bw, 1, 1);                  // direct_spatial_mv_pred
+    if (slice_type != 2) {
+        bit_writer_put_bits(bw, 0, 1);                  // num_ref_idx_override
+        bit_writer_put_bits(bw, 0, 1);                  // ref_pic_list_mod_l0
+        if (slice_type == 1)
+            bit_writer_put_bits(bw, 0, 1);              // ref_pic_list_mod_l1
+    }
+
+    if (is_ref) {
+        if (is_idr) {
+            bit_writer_put_bits(bw, 0, 1);              // no_output_of_prior_pics
+            bit_writer_put_bits(bw, 0, 1);              // long_term_reference
+        }
+        else
+            bit_writer_put_bits(bw, 0, 1);              // adaptive_ref_pic_marking
+    }
+    bit_writer_put_se(bw, 0);                           // slice_qp_delta
+    bit_writer_put_ue(bw, 1);                           // disable_deblocking_...
+
+    bit_writer_put_bits(bw, 0x5a5a5a5a, 32);
+    bit_writer_put_trailing_bits(bw);
+    put_nal_unit(stream, is_ref ? 2 : 0, is_idr ? 5 : 1, bw);
+}
+
+/* Generates a stream of closed GOPs with a B-pyramid, in decode order:
+   I0 P8 B4 B2 b1 b3 B6 b5 b7, where uppercase B pictures are references */
+static GByteArray *
+generate_stream(guint mb_width, guint mb_height, guint *num_pictures_ptr)
+{
+    static const struct {
+        guint       slice_type;
+        guint       display_order;
+        gboolean    is_ref;
+    } pyramid[] = {
+        { 0, 8, TRUE  },
+        { 1, 4, TRUE  },
+        { 1, 2, TRUE  },
+        { 1, 1, FALSE },
+        { 1, 3, FALSE },
+        { 1, 6, TRUE  },
+        { 1, 5, FALSE },
+        { 1, 7, FALSE },
+    };
+    GByteArray * const stream = g_byte_array_new();
+    BitWriter bw = { g_byte_array_new(), 0, 0 };
+    const guint num_mbs = mb_width * mb_height;
+    guint g, i, s, frame_num, poc, num_pictures = 0;
+
+    put_sps(stream, &bw, mb_width, mb_height);
+    put_pps(stream, &bw);
+
+    for (g = 0; g < g_num_gops; g++) {
+        frame_num = 0;
+        for (s = 0; s < g_num_slices; s++)
+            put_slice(stream, &bw, s * num_mbs / g_num_slices, 2,
+                      TRUE, TRUE, frame_num, 0);
+        frame_num++;
+        num_pictures++;
+
+        for (i = 0; i < G_N_ELEMENTS(pyramid); i++) {
+            poc = (2 * pyramid[i].display_order) % (1 << LOG2_MAX_POC_LSB);
+            for (s = 0; s < g_num_slices; s++)
+                put_slice(stream, &bw, s * num_mbs / g_num_slices,
+                          pyramid[i].slice_type, FALSE, pyramid[i].is_ref,
+                          frame_num, poc);
+            if (pyramid[i].is_ref)
+                frame_num++;
+            num_pictures++;
+        }
+    }
+
+    g_byte_array_free(bw.rbsp, TRUE);
+    *num_pictures_ptr = num_pictures;
+    return stream;
+}
+
+static guint
+release_surfaces(GstVaapiDecoder *decoder)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    guint num_surfaces = 0;
+
+    while ((proxy = gst_vaapi_decoder_get_surface(decoder, &status)) != NULL) {
+        g_object_unref(proxy);
+        num_surfaces++;
+    }
+    return num_surfaces;
+}
+
+static guint
+decode_stream(GstVaapiDisplay *display, GByteArray *stream,
+    guint width, guint height)
+{
+    GstVaapiDecoder *decoder;
+    GstCaps *caps;
+    GstBuffer *buffer;
+    guint num_surfaces;
+
+    caps = gst_vaapi_profile_get_caps(GST_VAAPI_PROFILE_H264_MAIN);
+    if (!caps)
+        g_error("could not create decoder caps");
+
+    gst_caps_set_simple(
+        caps,
+        "width",  G_TYPE_INT, width,
+        "height", G_TYPE_INT, height,
+        NULL
+    );
+
+    decoder = gst_vaapi_decoder_h264_new(display, caps);
+    if (!decoder)
+        g_error("could not create decoder");
+    gst_caps_unref(caps);
+
+    buffer = gst_buffer_new();
+    if (!buffer)
+        g_error("could not create encoded data buffer");
+    gst_buffer_set_data(buffer, stream->data, stream->len);
+
+    if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
+        g_error("could not send video data to the decoder");
+    gst_buffer_unref(buffer);
+    num_surfaces = release_surfaces(decoder);
+
+    if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
+        g_error("could not send EOS to the decoder");
+    num_surfaces += release_surfaces(decoder);
+
+    g_object_unref(decoder);
+    return num_surfaces;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    GByteArray *stream;
+    GTimer *timer;
+    gdouble elapsed;
+    guint num_pictures, num_surfaces = 0, num_slices;
+    gint i;
+
+    static const guint mb_width = 80, mb_height = 45;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    g_num_iterations = MAX(g_num_iterations, 1);
+    g_num_gops       = MAX(g_num_gops, 1);
+    g_num_slices     = CLAMP(g_num_slices, 1, mb_width * mb_height);
+
+    /* Parse-only: the stub VA driver does not decode anything */
+    display = stub_display_new(NULL);
+    if (!display || !gst_vaapi_display_get_display(display))
+        g_error("could not create stub VA display");
+
+    stream = generate_stream(mb_width, mb_height, &num_pictures);
+    num_slices = num_pictures * g_num_slices;
+
+    g_print("Benchmark H.264 B-pyramid decode of %u pictures, "
+            "%d slices per picture, %d iterations\n",
+            num_pictures, g_num_slices, g_num_iterations);
+
+    timer = g_timer_new();
+    for (i = 0; i < g_num_iterations; i++)
+        num_surfaces += decode_stream(display, stream,
+                                      16 * mb_width, 16 * mb_height);
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    g_print("  %u frames, %.3f ms/iteration, %.2f us/slice, %.1f fps\n",
+            num_surfaces / g_num_iterations,
+            elapsed * 1000.0 / g_num_iterations,
+            elapsed * 1e6 / (num_slices * g_num_iterations),
+            elapsed > 0.0 ? num_surfaces / elapsed : 0.0);
+
+    g_byte_array_free(stream, TRUE);
+    g_object_unref(display);
+    video_output_exit();
+    return 0;
+}
@@ -0,0 +1,408 @@
+/*
+ *  test-image-copy.c - Check and benchmark image conversion kernels
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <glib.h>
+#include <gst/vaapi/gstvaapicpu.h>
+#include <gst/vaapi/gstvaapiimagecopy.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+# include <emmintrin.h>
+# define HAVE_CLFLUSH 1
+#endif
+
+/* Largest row checked, in pixels, and guard bytes around the rows */
+#define MAX_ROW_SIZE    300
+#define GUARD_SIZE      64
+#define BUFFER_SIZE     (4 * MAX_ROW_SIZE + 2 * GUARD_SIZE)
+
+static gint g_num_rows      = 2000;
+static gint g_width         = 1920;
+static gint g_height        = 1080;
+static gint g_num_frames    = 50;
+static gboolean g_benchmark = TRUE;
+
+static GOptionEntry g_options[] = {
+    { "rows", 'r',
+      0,
+      G_OPTION_ARG_INT, &g_num_rows,
+      "number of random rows checked per kernel", NULL },
+    { "width", 'W',
+      0,
+      G_OPTION_ARG_INT, &g_width,
+      "frame width for the benchmark", NULL },
+    { "height", 'H',
+      0,
+      G_OPTION_ARG_INT, &g_height,
+      "frame height for the benchmark", NULL },
+    { "frames", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames converted per kernel in the benchmark", NULL },
+    { "no-benchmark", 0,
+      G_OPTION_FLAG_REVERSE,
+      G_OPTION_ARG_NONE, &g_benchmark,
+      "only check bit-exactness", NULL },
+    { NULL, }
+};
+
+/* The implementations to compare, from the generic C code up */
+static const guint g_cpu_flags_list[] = {
+    0,
+    GST_VAAPI_CPU_FLAG_SSE2,
+    GST_VAAPI_CPU_FLAG_SSE2 | GST_VAAPI_CPU_FLAG_SSSE3,
+    GST_VAAPI_CPU_FLAG_SSE2 | GST_VAAPI_CPU_FLAG_SSSE3 |
+    GST_VAAPI_CPU_FLAG_SSE4_1,
+    GST_VAAPI_CPU_FLAG_SSE2 | GST_VAAPI_CPU_FLAG_SSSE3 |
+    GST_VAAPI_CPU_FLAG_SSE4_1 | GST_VAAPI_CPU_FLAG_AVX2,
+    GST_VAAPI_CPU_FLAG_NEON,
+};
+
+typedef struct {
+    guint8      src[3][BUFFER_SIZE];
+    guint8      dst[4][BUFFER_SIZE];
+} Buffers;
+
+static void
+fill_random(GRand *rand, guint8 *data, guint size)
+{
+    guint i;
+
+    for (i = 0; i < size; i++)
+        data[i] = g_rand_int_range(rand, 0, 256);
+}
+
+static void
+clear_buffers(Buffers *buffers)
+{
+    memset(buffers->dst, 0xa5, sizeof(buffers->dst));
+}
+
+/* Runs one kernel on rows of random length and alignment, and returns
+   the index of the kernel whose output differs from the C code */
+static gint
+check_row(
+    const GstVaapiImageCopyFuncs *funcs,
+    const GstVaapiImageCopyFuncs *ref_funcs,
+    Buffers                      *ref,
+    Buffers                      *out,
+    guint                         n,
+    guint                         src_ofs,
+    guint                         dst_ofs,
+    GRand                        *rand
+)
+{
+    const GstVaapiImageCopyFuncs * const impls[2] = { ref_funcs, funcs };
+    Buffers * const results[2] = { ref, out };
+    const gboolean is_uyvy = g_rand_boolean(rand);
+    guint8 map[4];
+    guint i, k;
+
+    for (k = 0; k < 4; k++)
+        map[k] = g_rand_int_range(rand, 0, 4);
+
+#define SRC(b, i) (&(b)->src[i][GUARD_SIZE + src_ofs])
+#define DST(b, i) (&(b)->dst[i][GUARD_SIZE + dst_ofs])
+
+    for (i = 0; i < 2; i++) {
+        clear_buffers(results[i]);
+        impls[i]->interleave_uv(DST(results[i], 0),
+            SRC(ref, 0), SRC(ref, 1), n);
+    }
+    if (memcmp(ref->dst, out->dst, sizeof(ref->dst)) != 0)
+        return 0;
+
+    for (i = 0; i < 2; i++) {
+        clear_buffers(results[i]);
+        impls[i]->deinterleave_uv(DST(results[i], 0), DST(results[i], 1),
+            SRC(ref, 0), n);
+    }
+    if (memcmp(ref->dst, out->dst, sizeof(ref->dst)) != 0)
+        return 1;
+
+    for (i = 0; i < 2; i++) {
+        clear_buffers(results[i]);
+        impls[i]->packed422_to_planar420(
+            DST(results[i], 0), DST(results[i], 1),
+            DST(results[i], 2), DST(results[i], 3),
+            SRC(ref, 0), SRC(ref, 1), n / 2, is_uyvy);
+    }
+    if (memcmp(ref->dst, out->dst, sizeof(ref->dst)) != 0)
+        return 2;
+
+    for (i = 0; i < 2; i++) {
+        clear_buffers(results[i]);
+        impls[i]->swizzle_rgba(DST(results[i], 0), SRC(ref, 0), n, map);
+    }
+    if (memcmp(ref->dst, out->dst, sizeof(ref->dst)) != 0)
+        return 3;
+
+    for (i = 0; i < 2; i++) {
+        clear_buffers(results[i]);
+        impls[i]->copy_uncached(DST(results[i], 0), SRC(ref, 0), 4 * n);
+    }
+    if (memcmp(ref->dst, out->dst, sizeof(ref->dst)) != 0)
+        return 4;
+
+#undef DST
+#undef SRC
+    return -1;
+}
+
+static gboolean
+check_funcs(
+    const GstVaapiImageCopyFuncs *funcs,
+    const GstVaapiImageCopyFuncs *ref_funcs
+)
+{
+    static const gchar *kernel_names[] = {
+        "interleave_uv", "deinterleave_uv",
+        "packed422_to_planar420", "swizzle_rgba", "copy_uncached"
+    };
+    Buffers *ref, *out;
+    GRand *rand;
+    guint n, src_ofs, dst_ofs;
+    gint i, kernel = -1;
+
+    ref  = g_new(Buffers, 1);
+    out  = g_new(Buffers, 1);
+    rand = g_rand_new_with_seed(0x5eed);
+
+    for (i = 0; i < 3; i++)
+        fill_random(rand, ref->src[i], BUFFER_SIZE);
+
+    for (i = 0; i < g_num_rows && kernel < 0; i++) {
+        n       = g_rand_int_range(rand, 0, MAX_ROW_SIZE + 1);
+        src_ofs = g_rand_int_range(rand, 0, 32);
+        dst_ofs = g_rand_int_range(rand, 0, 32);
+        kernel  = check_row(funcs, ref_funcs, ref, out, n, src_ofs, dst_ofs,
+                            rand);
+        if (kernel >= 0)
+            g_printerr("%s: %s differs from the C code "
+                       "(%u pixels, offsets %u/%u)\n", funcs->name,
+                       kernel_names[kernel], n, src_ofs, dst_ofs);
+    }
+
+    g_rand_free(rand);
+    g_free(out);
+    g_free(ref);
+    return kernel < 0;
+}
+
+static gdouble
+bench_funcs(const GstVaapiImageCopyFuncs *funcs, guint kernel,
+    guint8 *src, guint8 *dst)
+{
+    static const guint8 map[4] = { 2, 1, 0, 3 };
+    const guint w = g_width, h = g_height;
+    GTimer *timer;
+    gdouble elapsed;
+    guint8 *u, *v;
+    gint i;
+    guint y;
+
+    timer = g_timer_new();
+    for (i = 0; i < g_num_frames; i++) {
+        switch (kernel) {
+        case 0: /* I420 -> NV12 chroma */
+            for (y = 0; y < h / 2; y++)
+                funcs->interleave_uv(dst + y * w,
+                    src + y * (w / 2), src + (h + y) * (w / 2), w / 2);
+            break;
+        case 1: /* NV12 -> I420 chroma */
+            for (y = 0; y < h / 2; y++)
+                funcs->deinterleave_uv(dst + y * (w / 2),
+                    dst + (h + y) * (w / 2), src + y * w, w / 2);
+            break;
+        case 2: /* YUY2 -> I420 */
+            u = dst + w * h;
+            v = u + (w / 2) * (h / 2);
+            for (y = 0; y < h / 2; y++)
+                funcs->packed422_to_planar420(
+                    dst + 2 * y * w, dst + (2 * y + 1) * w,
+                    u + y * (w / 2), v + y * (w / 2),
+                    src + 4 * y * w, src + (4 * y + 2) * w,
+                    w / 2, FALSE);
+            break;
+        case 3: /* RGBA -> BGRA */
+            for (y = 0; y < h; y++)
+                funcs->swizzle_rgba(dst + 4 * y * w, src + 4 * y * w, w,
+                    map);
+            break;
+        }
+    }
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    return elapsed;
+}
+
+/* Evicts the frame from the CPU caches, so that it is read from memory
+   again, as mapped VA images in uncached or write-combining memory */
+static void
+flush_frame(const guint8 *data, guint size)
+{
+#ifdef HAVE_CLFLUSH
+    guint i;
+
+    for (i = 0; i < size; i += 64)
+        _mm_clflush(data + i);
+    _mm_mfence();
+#endif
+}
+
+/* Reads back NV12 frames from a mmap()ed buffer, standing for a mapped
+   VA image, as gst_vaapi_image_get_buffer() does for derived images */
+static void
+run_readback_benchmark(const GstVaapiImageCopyFuncs **impls, guint num_impls)
+{
+    const guint stride = (g_width + 63) & ~63;
+    const guint num_rows = g_height + g_height / 2;
+    const guint size = stride * num_rows;
+    guint8 *src, *dst;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed = 0.0, mbytes;
+    guint i, y;
+    gint n;
+
+    src = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+               -1, 0);
+    if (src == MAP_FAILED) {
+        g_printerr("failed to map %u bytes for the readback benchmark\n",
+                   size);
+        return;
+    }
+    memset(src, 0x80, size);
+    dst = g_malloc(g_width * num_rows);
+
+    timer = g_timer_new();
+    mbytes = (gdouble)g_width * num_rows * g_num_frames / (1024 * 1024);
+    for (i = 0; i < num_impls; i++) {
+        elapsed = 0.0;
+        for (n = 0; n < g_num_frames; n++) {
+            flush_frame(src, size);
+            g_timer_start(timer);
+            for (y = 0; y < num_rows; y++)
+                impls[i]->copy_uncached(dst + y * g_width, src + y * stride,
+                    g_width);
+            elapsed += g_timer_elapsed(timer, NULL);
+        }
+        if (i == 0)
+            ref_elapsed = elapsed;
+        g_print("bench: %-18s %-6s %8.1f MB/s (x%.2f)\n",
+                "NV12 readback", impls[i]->name,
+                elapsed > 0.0 ? mbytes / elapsed : 0.0,
+                elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+    }
+    g_timer_destroy(timer);
+    g_free(dst);
+    munmap(src, size);
+}
+
+static void
+run_benchmark(const GstVaapiImageCopyFuncs **impls, guint num_impls)
+{
+    static const struct {
+        const gchar    *name;
+        guint           bytes_per_pixel_x2;
+    } kernels[] = {
+        { "I420->NV12 chroma",  1 },
+        { "NV12->I420 chroma",  1 },
+        { "YUY2->I420",         4 },
+        { "RGBA->BGRA",         8 },
+    };
+    guint8 *src, *dst;
+    gdouble elapsed, ref_elapsed, mbytes;
+    guint i, k, size;
+
+    size = 4 * g_width * g_height;
+    src  = g_malloc(size);
+    dst  = g_malloc(size);
+    memset(src, 0x80, size);
+
+    for (k = 0; k < G_N_ELEMENTS(kernels); k++) {
+        mbytes = (gdouble)kernels[k].bytes_per_pixel_x2 / 2 *
+            g_width * g_height * g_num_frames / (1024 * 1024);
+        ref_elapsed = 0.0;
+        for (i = 0; i < num_impls; i++) {
+            elapsed = bench_funcs(impls[i], k, src, dst);
+            if (i == 0)
+                ref_elapsed = elapsed;
+            g_print("bench: %-18s %-6s %8.1f MB/s (x%.2f)\n",
+                    kernels[k].name, impls[i]->name,
+                    elapsed > 0.0 ? mbytes / elapsed : 0.0,
+                    elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+        }
+    }
+    g_free(dst);
+    g_free(src);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const GstVaapiImageCopyFuncs *impls[G_N_ELEMENTS(g_cpu_flags_list)];
+    const GstVaapiImageCopyFuncs *funcs;
+    GOptionContext *ctx;
+    guint i, cpu_flags, num_impls = 0;
+    gboolean success = TRUE;
+
+    ctx = g_option_context_new("- image conversion kernels test");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    if (g_width < 2)
+        g_width = 2;
+    if (g_height < 2)
+        g_height = 2;
+    g_width  &= ~1;
+    g_height &= ~1;
+
+    cpu_flags = gst_vaapi_cpu_get_flags();
+    g_print("CPU flags: 0x%x, default kernels: %s\n", cpu_flags,
+            gst_vaapi_image_copy_get_funcs()->name);
+
+    /* Only test the implementations this CPU can run, once each */
+    for (i = 0; i < G_N_ELEMENTS(g_cpu_flags_list); i++) {
+        if ((g_cpu_flags_list[i] & cpu_flags) != g_cpu_flags_list[i])
+            continue;
+        funcs = gst_vaapi_image_copy_get_funcs_for_flags(g_cpu_flags_list[i]);
+        if (num_impls > 0 && funcs == impls[num_impls - 1])
+            continue;
+        impls[num_impls++] = funcs;
+    }
+
+    for (i = 1; i < num_impls; i++) {
+        if (!check_funcs(impls[i], impls[0]))
+            success = FALSE;
+        else
+            g_print("check: %s kernels match the C code\n", impls[i]->name);
+    }
+
+    if (g_benchmark) {
+        run_benchmark(impls, num_impls);
+        run_readback_benchmark(impls, num_impls);
+    }
+    return success ? 0 : 1;
+}
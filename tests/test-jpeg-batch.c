@@ -0,0 +1,197 @@
+/*
+ *  test-jpeg-batch.c - Benchmark batch JPEG decoding
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecoder_jpeg.h>
+#include <gst/vaapi/gstvaapijpegbatch.h>
+#include <gst/vaapi/gstvaapiprofile.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include "test-jpeg.h"
+#include "output.h"
+
+static gint g_num_images     = 64;
+static gint g_num_contexts   = 2;
+static gint g_num_iterations = 5;
+
+static GOptionEntry g_options[] = {
+    { "images", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_images,
+      "number of images per batch, the input files are repeated", NULL },
+    { "contexts", 'c',
+      0,
+      G_OPTION_ARG_INT, &g_num_contexts,
+      "number of VA contexts of the batch decoder", NULL },
+    { "iterations", 'i',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "number of times the batch is decoded", NULL },
+    { NULL, }
+};
+
+static GstBuffer *
+make_buffer(const guchar *data, guint data_size)
+{
+    GstBuffer * const buffer = gst_buffer_new_and_alloc(data_size);
+
+    memcpy(GST_BUFFER_DATA(buffer), data, data_size);
+    return buffer;
+}
+
+/* One decoder, each image is waited for before the next one is
+   submitted, as a simple application would do */
+static guint
+decode_one_by_one(GstVaapiDisplay *display, GstBuffer **buffers,
+    guint num_buffers)
+{
+    GstVaapiDecoder *decoder;
+    GstVaapiSurfaceProxy *proxy;
+    GstCaps *caps;
+    guint i, num_decoded = 0;
+
+    caps = gst_vaapi_profile_get_caps(GST_VAAPI_PROFILE_JPEG_BASELINE);
+    if (!caps)
+        g_error("could not create decoder caps");
+    decoder = gst_vaapi_decoder_jpeg_new(display, caps);
+    if (!decoder)
+        g_error("could not create decoder");
+    gst_caps_unref(caps);
+
+    for (i = 0; i < num_buffers; i++) {
+        if (!gst_vaapi_decoder_put_buffer(decoder, buffers[i]))
+            break;
+        proxy = gst_vaapi_decoder_get_surface(decoder, NULL);
+        if (!proxy)
+            continue;
+        if (gst_vaapi_surface_sync(gst_vaapi_surface_proxy_get_surface(proxy)))
+            num_decoded++;
+        g_object_unref(proxy);
+    }
+    g_object_unref(decoder);
+    return num_decoded;
+}
+
+static void
+count_image(guint index, GstVaapiSurfaceProxy *proxy, gpointer user_data)
+{
+    guint * const num_images = user_data;
+
+    (*num_images)++;
+}
+
+static void
+print_result(const gchar *name, guint num_images, gdouble elapsed,
+    gdouble ref_elapsed)
+{
+    g_print("%-8s %8.1f images/s (x%.2f)\n", name,
+            elapsed > 0.0 ? num_images / elapsed : 0.0,
+            elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    GstVaapiJpegBatch *batch;
+    GstBuffer **inputs, **buffers;
+    VideoDecodeInfo info;
+    GError *error = NULL;
+    gchar *data;
+    gsize data_size;
+    GTimer *timer;
+    gdouble ref_elapsed, elapsed;
+    guint i, num_inputs, num_decoded, num_counted, num_resets, num_groups;
+    gint n;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    g_num_images     = MAX(g_num_images, 1);
+    g_num_contexts   = MAX(g_num_contexts, 1);
+    g_num_iterations = MAX(g_num_iterations, 1);
+
+    /* The files given on the command line, or the embedded image */
+    num_inputs = MAX(argc - 1, 1);
+    inputs = g_new(GstBuffer *, num_inputs);
+    if (argc > 1) {
+        for (i = 0; i < num_inputs; i++) {
+            if (!g_file_get_contents(argv[i + 1], &data, &data_size, &error))
+                g_error("could not read %s: %s", argv[i + 1], error->message);
+            inputs[i] = make_buffer((const guchar *)data, data_size);
+            g_free(data);
+        }
+    }
+    else {
+        jpeg_get_video_info(&info);
+        inputs[0] = make_buffer(info.data, info.data_size);
+    }
+
+    /* Interleave the inputs, so that consecutive images differ in size
+       when several files are given */
+    buffers = g_new(GstBuffer *, g_num_images);
+    for (n = 0; n < g_num_images; n++)
+        buffers[n] = inputs[n % num_inputs];
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    g_print("Benchmark decode of %d JPEG images (%u distinct), "
+            "%d iterations\n", g_num_images, num_inputs, g_num_iterations);
+
+    timer = g_timer_new();
+    num_decoded = 0;
+    for (n = 0; n < g_num_iterations; n++)
+        num_decoded += decode_one_by_one(display, buffers, g_num_images);
+    ref_elapsed = g_timer_elapsed(timer, NULL);
+    print_result("single", num_decoded, ref_elapsed, ref_elapsed);
+
+    batch = gst_vaapi_jpeg_batch_new(display, g_num_contexts);
+    if (!batch)
+        g_error("could not create batch decoder");
+
+    g_timer_start(timer);
+    num_decoded = num_counted = 0;
+    for (n = 0; n < g_num_iterations; n++)
+        num_decoded += gst_vaapi_jpeg_batch_decode(batch, buffers,
+            g_num_images, count_image, &num_counted);
+    elapsed = g_timer_elapsed(timer, NULL);
+    print_result("batch", num_decoded, elapsed, ref_elapsed);
+
+    gst_vaapi_jpeg_batch_get_stats(batch, &num_resets, &num_groups);
+    g_print("  %d contexts, %u groups, %u context resets\n",
+            g_num_contexts, num_groups, num_resets);
+    if (num_counted != num_decoded)
+        g_error("%u images reported instead of %u", num_counted, num_decoded);
+
+    gst_vaapi_jpeg_batch_free(batch);
+    g_timer_destroy(timer);
+    g_object_unref(display);
+    for (i = 0; i < num_inputs; i++)
+        gst_buffer_unref(inputs[i]);
+    g_free(inputs);
+    g_free(buffers);
+    video_output_exit();
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ *  test-jpeg-marker.c - Check and benchmark JPEG marker search
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <glib.h>
+#include <gst/vaapi/gstvaapicpu.h>
+#include <gst/vaapi/gstvaapijpegmarker.h>
+
+/* Largest buffer checked, in bytes */
+#define MAX_CHECK_SIZE  4096
+
+static gint g_num_checks    = 2000;
+static gint g_image_size    = 2048;
+static gint g_num_images    = 32;
+static gint g_restart_size  = 4;
+static gboolean g_benchmark = TRUE;
+
+static GOptionEntry g_options[] = {
+    { "checks", 'c',
+      0,
+      G_OPTION_ARG_INT, &g_num_checks,
+      "number of random buffers checked per implementation", NULL },
+    { "image-size", 's',
+      0,
+      G_OPTION_ARG_INT, &g_image_size,
+      "size of the benchmark images, in KB", NULL },
+    { "images", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_images,
+      "number of images scanned per implementation", NULL },
+    { "restart-size", 'r',
+      0,
+      G_OPTION_ARG_INT, &g_restart_size,
+      "average distance between two restart markers, in KB", NULL },
+    { "no-benchmark", 0,
+      G_OPTION_FLAG_REVERSE,
+      G_OPTION_ARG_NONE, &g_benchmark,
+      "only check the results", NULL },
+    { NULL, }
+};
+
+/* The implementations to compare, from the generic C code up */
+static const guint g_cpu_flags_list[] = {
+    0,
+    GST_VAAPI_CPU_FLAG_SSE2,
+    GST_VAAPI_CPU_FLAG_SSE2 | GST_VAAPI_CPU_FLAG_AVX2,
+    GST_VAAPI_CPU_FLAG_NEON,
+};
+
+/* Byte by byte search, as the JPEG parser does */
+static guint
+find_bytewise(const guint8 *buf, guint n)
+{
+    guint i;
+
+    for (i = 0; i + 1 < n; i++) {
+        if (buf[i] == 0xff && GST_VAAPI_JPEG_IS_MARKER(buf[i + 1]))
+            return i;
+    }
+    return n;
+}
+
+static const GstVaapiJpegMarkerFuncs g_bytewise_funcs = {
+    "bytewise",
+    find_bytewise,
+};
+
+/* Random data with lots of 0xff bytes and marker codes, so that
+   markers and near misses are frequent */
+static void
+fill_random(GRand *rand, guint8 *data, guint size)
+{
+    guint i;
+
+    for (i = 0; i < size; i++) {
+        switch (g_rand_int_range(rand, 0, 8)) {
+        case 0: case 1: case 2:
+            data[i] = 0xff;
+            break;
+        case 3: case 4:
+            data[i] = g_rand_int_range(rand, 0xc0, 0x100);
+            break;
+        case 5:
+            data[i] = 0x00;
+            break;
+        default:
+            data[i] = g_rand_int_range(rand, 0, 256);
+            break;
+        }
+    }
+}
+
+static gboolean
+check_funcs(const GstVaapiJpegMarkerFuncs *funcs)
+{
+    guint8 *data;
+    GRand *rand;
+    guint size, ofs;
+    gint i;
+    gboolean success = TRUE;
+
+    data = g_malloc(MAX_CHECK_SIZE + 32);
+    rand = g_rand_new_with_seed(0x5eed);
+
+    for (i = 0; i < g_num_checks && success; i++) {
+        size = g_rand_int_range(rand, 0, MAX_CHECK_SIZE + 1);
+        ofs  = g_rand_int_range(rand, 0, 32);
+        fill_random(rand, data + ofs, size);
+
+        if (funcs->find(data + ofs, size) !=
+            find_bytewise(data + ofs, size)) {
+            g_printerr("%s: find() differs from the byte by byte search "
+                       "(%u bytes, offset %u)\n", funcs->name, size, ofs);
+            success = FALSE;
+        }
+    }
+    g_rand_free(rand);
+    g_free(data);
+    return success;
+}
+
+/* Builds an entropy coded segment: random data with stuffed 0xff00
+   bytes, and a restart marker every @restart_size bytes on average.
+   It ends with an EOI marker */
+static guint8 *
+make_scan(guint size, guint restart_size)
+{
+    GRand * const rand = g_rand_new_with_seed(0x1e7a);
+    guint8 * const data = g_malloc(size);
+    guint i, next_restart, restart = 0;
+
+    next_restart = restart_size;
+    for (i = 0; i + 2 < size; i++) {
+        if (i >= next_restart) {
+            data[i++] = 0xff;
+            data[i]   = 0xd0 + (restart++ & 7);
+            next_restart = i + g_rand_int_range(rand, restart_size / 2,
+                                                3 * restart_size / 2 + 1);
+            continue;
+        }
+        data[i] = g_rand_int_range(rand, 0, 256);
+        if (data[i] == 0xff)
+            data[++i] = 0x00;
+    }
+    for (; i < size; i++)
+        data[i] = 0x00;
+    data[size - 2] = 0xff;
+    data[size - 1] = 0xd9;
+    g_rand_free(rand);
+    return data;
+}
+
+static gboolean
+run_benchmark(const GstVaapiJpegMarkerFuncs **impls, guint num_impls)
+{
+    const guint size = g_image_size * 1024;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed = 0.0, mbytes;
+    guint8 *data;
+    guint i, ofs = 0;
+    gint n;
+    gboolean success = TRUE;
+
+    data = make_scan(size, g_restart_size * 1024);
+    mbytes = (gdouble)size * g_num_images / (1024 * 1024);
+    g_print("bench: %d KB images, restart markers every %d KB\n",
+            g_image_size, g_restart_size);
+
+    timer = g_timer_new();
+    for (i = 0; i < num_impls; i++) {
+        g_timer_start(timer);
+        for (n = 0; n < g_num_images; n++)
+            ofs = impls[i]->find(data, size);
+        elapsed = g_timer_elapsed(timer, NULL);
+        if (i == 0)
+            ref_elapsed = elapsed;
+
+        g_print("bench: %-8s %8.1f MB/s (x%.2f)\n", impls[i]->name,
+                elapsed > 0.0 ? mbytes / elapsed : 0.0,
+                elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+        if (ofs != size - 2) {
+            g_printerr("%s: found a marker at offset %u instead of %u\n",
+                       impls[i]->name, ofs, size - 2);
+            success = FALSE;
+        }
+    }
+    g_timer_destroy(timer);
+    g_free(data);
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const GstVaapiJpegMarkerFuncs *impls[G_N_ELEMENTS(g_cpu_flags_list) + 1];
+    const GstVaapiJpegMarkerFuncs *funcs;
+    GOptionContext *ctx;
+    guint i, cpu_flags, num_impls = 0;
+    gboolean success = TRUE;
+
+    ctx = g_option_context_new("- JPEG marker search test");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    g_image_size   = CLAMP(g_image_size, 1, 256 * 1024);
+    g_num_images   = MAX(g_num_images, 1);
+    g_restart_size = MAX(g_restart_size, 1);
+
+    cpu_flags = gst_vaapi_cpu_get_flags();
+    g_print("CPU flags: 0x%x, default kernels: %s\n", cpu_flags,
+            gst_vaapi_jpeg_marker_get_funcs()->name);
+
+    /* Only test the implementations this CPU can run, once each */
+    impls[num_impls++] = &g_bytewise_funcs;
+    for (i = 0; i < G_N_ELEMENTS(g_cpu_flags_list); i++) {
+        if ((g_cpu_flags_list[i] & cpu_flags) != g_cpu_flags_list[i])
+            continue;
+        funcs = gst_vaapi_jpeg_marker_get_funcs_for_flags(g_cpu_flags_list[i]);
+        if (funcs == impls[num_impls - 1])
+            continue;
+        impls[num_impls++] = funcs;
+    }
+
+    for (i = 1; i < num_impls; i++) {
+        if (!check_funcs(impls[i]))
+            success = FALSE;
+        else
+            g_print("check: %s search matches the byte by byte search\n",
+                    impls[i]->name);
+    }
+
+    if (g_benchmark && !run_benchmark(impls, num_impls))
+        success = FALSE;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/*
+ *  test-overlay-composition.c - Benchmark overlay composition updates
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+/* Each frame carries N static rectangles, e.g. a logo, and M animated
+ * rectangles, e.g. a clock or live captions, that get new pixels on
+ * every frame. One static rectangle also moves every other frame. The
+ * compositions are applied incrementally, then again with a full
+ * rebuild on every frame for comparison. Use --output=stub to measure
+ * the library overhead alone.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapicontext.h>
+#include "output.h"
+
+static gint      g_num_static   = 4;
+static gint      g_num_animated = 1;
+static gint      g_num_frames   = 300;
+static gint      g_rect_size    = 64;
+static gboolean  g_use_atlas    = TRUE;
+
+static GOptionEntry g_options[] = {
+    { "static", 'N',
+      0,
+      G_OPTION_ARG_INT, &g_num_static,
+      "number of static rectangles", NULL },
+    { "animated", 'M',
+      0,
+      G_OPTION_ARG_INT, &g_num_animated,
+      "number of rectangles updated on every frame", NULL },
+    { "frames", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames", NULL },
+    { "size", 's',
+      0,
+      G_OPTION_ARG_INT, &g_rect_size,
+      "width and height of the rectangles", NULL },
+    { "no-atlas", 0,
+      G_OPTION_FLAG_REVERSE,
+      G_OPTION_ARG_NONE, &g_use_atlas,
+      "do not pack small rectangles into a shared image", NULL },
+    { NULL, }
+};
+
+static GstVideoOverlayRectangle *
+create_rectangle(guint index, guint frame, gint x, gint y)
+{
+    GstVideoOverlayRectangle *rect;
+    GstBuffer *buffer;
+    const guint stride = g_rect_size * 4;
+
+    buffer = gst_buffer_new_and_alloc(stride * g_rect_size);
+    if (!buffer)
+        return NULL;
+    memset(GST_BUFFER_DATA(buffer), (index * 31 + frame) & 0xff,
+           GST_BUFFER_SIZE(buffer));
+
+    rect = gst_video_overlay_rectangle_new_argb(buffer,
+        g_rect_size, g_rect_size, stride,
+        x, y, g_rect_size, g_rect_size,
+        GST_VIDEO_OVERLAY_FORMAT_FLAG_NONE);
+    gst_buffer_unref(buffer);
+    return rect;
+}
+
+static GstVideoOverlayComposition *
+create_composition(GstVideoOverlayRectangle **static_rects, guint frame)
+{
+    GstVideoOverlayComposition *composition = NULL;
+    GstVideoOverlayRectangle *rect;
+    gint i;
+
+    /* The first static rectangle moves, without new pixels */
+    if (g_num_static > 0)
+        gst_video_overlay_rectangle_set_render_rectangle(static_rects[0],
+            (frame / 2) % 16, 0, g_rect_size, g_rect_size);
+
+    for (i = 0; i < g_num_static + g_num_animated; i++) {
+        if (i < g_num_static)
+            rect = gst_video_overlay_rectangle_ref(static_rects[i]);
+        else
+            rect = create_rectangle(i, frame, i * g_rect_size, g_rect_size);
+        if (!rect)
+            g_error("could not create overlay rectangle");
+
+        if (!composition)
+            composition = gst_video_overlay_composition_new(rect);
+        else
+            gst_video_overlay_composition_add_rectangle(composition, rect);
+        gst_video_overlay_rectangle_unref(rect);
+    }
+    return composition;
+}
+
+static void
+run_benchmark(GstVaapiDisplay *display, gboolean full_rebuild)
+{
+    GstVaapiContext *context;
+    GstVideoOverlayRectangle **static_rects;
+    GstVideoOverlayComposition *composition;
+    GTimer *timer;
+    gdouble elapsed;
+    guint num_uploads, num_uploads_saved, num_moves, num_unchanged;
+    guint num_atlas_uploads, num_atlas_rects;
+    gdouble atlas_efficiency;
+    gint i;
+
+    context = gst_vaapi_context_new(display, GST_VAAPI_PROFILE_MPEG2_MAIN,
+        GST_VAAPI_ENTRYPOINT_VLD, 1920, 1080);
+    if (!context)
+        g_error("could not create VA context");
+    gst_vaapi_context_set_overlay_atlas(context, g_use_atlas);
+
+    static_rects = g_new(GstVideoOverlayRectangle *, MAX(g_num_static, 1));
+    for (i = 0; i < g_num_static; i++) {
+        static_rects[i] = create_rectangle(i, 0, i * g_rect_size, 0);
+        if (!static_rects[i])
+            g_error("could not create overlay rectangle");
+    }
+
+    timer = g_timer_new();
+    g_timer_stop(timer);
+    for (i = 0; i < g_num_frames; i++) {
+        composition = create_composition(static_rects, i);
+
+        g_timer_continue(timer);
+        if (full_rebuild)
+            gst_vaapi_context_apply_composition(context, NULL);
+        if (!gst_vaapi_context_apply_composition(context, composition))
+            g_error("could not apply composition of frame %d", i);
+        g_timer_stop(timer);
+
+        gst_video_overlay_composition_unref(composition);
+    }
+    elapsed = g_timer_elapsed(timer, NULL);
+
+    gst_vaapi_context_get_overlay_stats(context, &num_uploads,
+        &num_uploads_saved, &num_moves, &num_unchanged);
+    g_print("%-11s %d static + %d animated rectangles: %.3f ms per frame, "
+            "%u uploads, %u saved (%.0f saved/s), %u moves, "
+            "%u unchanged\n",
+            full_rebuild ? "rebuild:" : "incremental:",
+            g_num_static, g_num_animated,
+            elapsed * 1e3 / g_num_frames,
+            num_uploads, num_uploads_saved,
+            elapsed > 0.0 ? num_uploads_saved / elapsed : 0.0,
+            num_moves, num_unchanged);
+
+    num_atlas_uploads = gst_vaapi_context_get_overlay_atlas_stats(context,
+        &num_atlas_rects, &atlas_efficiency);
+    if (num_atlas_uploads > 0)
+        g_print("%-11s %u uploads into the atlas, %u rectangles left, "
+                "%.1f%% packing efficiency\n", "",
+                num_atlas_uploads, num_atlas_rects, 100.0 * atlas_efficiency);
+
+    g_timer_destroy(timer);
+    for (i = 0; i < g_num_static; i++)
+        gst_video_overlay_rectangle_unref(static_rects[i]);
+    g_free(static_rects);
+    g_object_unref(context);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_num_static < 0)
+        g_num_static = 0;
+    if (g_num_animated < 0)
+        g_num_animated = 0;
+    if (g_num_static + g_num_animated < 1)
+        g_num_animated = 1;
+    if (g_num_frames < 1)
+        g_num_frames = 1;
+    if (g_rect_size < 1)
+        g_rect_size = 1;
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    run_benchmark(display, FALSE);
+    run_benchmark(display, TRUE);
+
+    g_object_unref(display);
+    video_output_exit();
+    return 0;
+}
@@ -0,0 +1,393 @@
+/*
+ *  test-readback.c - Check and benchmark pipelined surface readback
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include <gst/vaapi/gstvaapiimagepool.h>
+#include <gst/vaapi/gstvaapireadback.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include "output.h"
+#include "stub.h"
+#include "stub_drv_video.h"
+
+/* Surfaces read in turn, each with its own pixel values, so that
+   frames output out of order are detected */
+#define NUM_SURFACES    8
+
+/* Duration of the frames, for the timestamps */
+#define FRAME_DURATION  (GST_SECOND / 30)
+
+static gint g_num_frames    = 60;
+static gint g_max_depth     = 3;
+static gint g_fetch_delay   = 4000;
+static gint g_process_time  = 4000;
+static gint g_width         = 1920;
+static gint g_height        = 1080;
+
+static GOptionEntry g_options[] = {
+    { "frames", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames read back per depth", NULL },
+    { "depth", 'd',
+      0,
+      G_OPTION_ARG_INT, &g_max_depth,
+      "largest readback depth tested", NULL },
+    { "fetch-delay", 'l',
+      0,
+      G_OPTION_ARG_INT, &g_fetch_delay,
+      "time the stub driver takes to fetch a surface, in microseconds", NULL },
+    { "process-time", 'p',
+      0,
+      G_OPTION_ARG_INT, &g_process_time,
+      "time downstream takes to process a frame, in microseconds", NULL },
+    { "width", 0,
+      0,
+      G_OPTION_ARG_INT, &g_width,
+      "width of the surfaces", NULL },
+    { "height", 0,
+      0,
+      G_OPTION_ARG_INT, &g_height,
+      "height of the surfaces", NULL },
+    { NULL, }
+};
+
+static const gchar *g_stage_names[GST_VAAPI_READBACK_STAGE_COUNT] = {
+    "queue", "fetch", "wait", "copy", "latency"
+};
+
+typedef struct _TestContext TestContext;
+struct _TestContext {
+    GstVaapiSurface    *surfaces[NUM_SURFACES];
+    GstVaapiVideoPool  *images;
+    GstBuffer          *buffer;
+    guint               num_frames;     /* frames output so far */
+    guint               num_errors;
+};
+
+/* Distinct pixel values for each surface */
+#define LUMA_VALUE(n)   (0x10 + 0x15 * ((n) % NUM_SURFACES))
+#define CHROMA_VALUE(n) (0xf0 - 0x11 * ((n) % NUM_SURFACES))
+
+static gboolean
+upload_surface(GstVaapiDisplay *display, GstVaapiSurface *surface, guint n)
+{
+    GstVaapiImage *image;
+    guint8 *pixels;
+    guint i, y;
+    gboolean success;
+
+    image = gst_vaapi_image_new(display, GST_VAAPI_IMAGE_NV12,
+        g_width, g_height);
+    if (!image)
+        return FALSE;
+    if (!gst_vaapi_image_map(image)) {
+        g_object_unref(image);
+        return FALSE;
+    }
+
+    for (i = 0; i < 2; i++) {
+        pixels = gst_vaapi_image_get_plane(image, i);
+        for (y = 0; y < (i ? (g_height + 1) / 2 : g_height); y++)
+            memset(pixels + y * gst_vaapi_image_get_pitch(image, i),
+                   i ? CHROMA_VALUE(n) : LUMA_VALUE(n),
+                   i ? 2 * ((g_width + 1) / 2) : g_width);
+    }
+    gst_vaapi_image_unmap(image);
+
+    success = gst_vaapi_surface_put_image(surface, image);
+    g_object_unref(image);
+    return success;
+}
+
+static gboolean
+test_context_init(TestContext *ctx, GstVaapiDisplay *display)
+{
+    GstCaps *caps;
+    guint i;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    for (i = 0; i < NUM_SURFACES; i++) {
+        ctx->surfaces[i] = gst_vaapi_surface_new(display,
+            GST_VAAPI_CHROMA_TYPE_YUV420, g_width, g_height);
+        if (!ctx->surfaces[i] || !upload_surface(display, ctx->surfaces[i], i))
+            return FALSE;
+    }
+
+    caps = gst_vaapi_image_format_get_caps(GST_VAAPI_IMAGE_NV12);
+    if (!caps)
+        return FALSE;
+    gst_caps_set_simple(
+        caps,
+        "width",  G_TYPE_INT, g_width,
+        "height", G_TYPE_INT, g_height,
+        NULL
+    );
+    ctx->images = gst_vaapi_image_pool_new(display, caps);
+    ctx->buffer = gst_buffer_new_and_alloc(
+        GST_ROUND_UP_4(g_width) * GST_ROUND_UP_2(g_height) * 3 / 2);
+    gst_buffer_set_caps(ctx->buffer, caps);
+    gst_caps_unref(caps);
+    return ctx->images != NULL;
+}
+
+static void
+test_context_clear(TestContext *ctx)
+{
+    guint i;
+
+    for (i = 0; i < NUM_SURFACES; i++)
+        g_clear_object(&ctx->surfaces[i]);
+    g_clear_object(&ctx->images);
+    if (ctx->buffer) {
+        gst_buffer_unref(ctx->buffer);
+        ctx->buffer = NULL;
+    }
+}
+
+/* Checks that the frames come out in order, with their timestamps and
+   the pixels of their surface */
+static void
+check_frame(TestContext *ctx, GstBuffer *meta)
+{
+    const guint n = ctx->num_frames++;
+    const guint8 * const data = GST_BUFFER_DATA(ctx->buffer);
+    const guint stride = GST_ROUND_UP_4(g_width);
+    const guint chroma_offset = stride * GST_ROUND_UP_2(g_height);
+
+    if (!meta || GST_BUFFER_OFFSET(meta) != n ||
+        GST_BUFFER_TIMESTAMP(meta) != n * FRAME_DURATION) {
+        if (ctx->num_errors++ == 0)
+            g_printerr("frame %u: got frame %" G_GUINT64_FORMAT " instead\n",
+                       n, meta ? GST_BUFFER_OFFSET(meta) : G_MAXUINT64);
+        return;
+    }
+
+    /* First pixels of the first and last rows of each plane */
+    if (data[0] != LUMA_VALUE(n) ||
+        data[(g_height - 1) * stride] != LUMA_VALUE(n) ||
+        data[chroma_offset] != CHROMA_VALUE(n) ||
+        data[chroma_offset + ((g_height + 1) / 2 - 1) * stride] !=
+        CHROMA_VALUE(n)) {
+        if (ctx->num_errors++ == 0)
+            g_printerr("frame %u: wrong pixels\n", n);
+    }
+}
+
+/* Checks the frame, then stands for the processing of the frame by
+   downstream elements in the streaming thread */
+static void
+output_frame(TestContext *ctx, GstBuffer *meta)
+{
+    check_frame(ctx, meta);
+    if (g_process_time > 0)
+        g_usleep(g_process_time);
+}
+
+/* Stands for the input buffer that holds the surface */
+static GstBuffer *
+make_meta(guint n)
+{
+    GstBuffer * const meta = gst_buffer_new();
+
+    GST_BUFFER_OFFSET(meta)    = n;
+    GST_BUFFER_TIMESTAMP(meta) = n * FRAME_DURATION;
+    GST_BUFFER_DURATION(meta)  = FRAME_DURATION;
+    return meta;
+}
+
+/* Each frame is read back before the next one, as vaapidownload does
+   with a readback depth of zero */
+static gboolean
+read_frames_sync(TestContext *ctx)
+{
+    GstVaapiImage *image;
+    GstBuffer *meta;
+    gboolean success;
+    gint n;
+
+    for (n = 0; n < g_num_frames; n++) {
+        image = gst_vaapi_video_pool_get_object(ctx->images);
+        if (!image)
+            return FALSE;
+        success = gst_vaapi_surface_get_image(ctx->surfaces[n % NUM_SURFACES],
+                                              image) &&
+            gst_vaapi_image_get_buffer(image, ctx->buffer, NULL);
+        gst_vaapi_video_pool_put_object(ctx->images, image);
+        if (!success)
+            return FALSE;
+
+        meta = make_meta(n);
+        output_frame(ctx, meta);
+        gst_buffer_unref(meta);
+    }
+    return TRUE;
+}
+
+static gboolean
+pop_frame(TestContext *ctx, GstVaapiReadback *readback)
+{
+    GstBuffer *meta;
+    gboolean success;
+
+    success = gst_vaapi_readback_pop(readback, ctx->buffer, (gpointer *)&meta);
+    if (success)
+        output_frame(ctx, meta);
+    if (meta)
+        gst_buffer_unref(meta);
+    return success;
+}
+
+static gboolean
+read_frames_pipelined(TestContext *ctx, GstVaapiReadback *readback)
+{
+    const guint depth = gst_vaapi_readback_get_depth(readback);
+    gint n;
+
+    for (n = 0; n < g_num_frames; n++) {
+        if (!gst_vaapi_readback_push(readback, ctx->surfaces[n % NUM_SURFACES],
+                                     NULL, make_meta(n)))
+            return FALSE;
+        if (gst_vaapi_readback_get_pending(readback) > depth &&
+            !pop_frame(ctx, readback))
+            return FALSE;
+    }
+
+    /* Drain, as on EOS */
+    while (gst_vaapi_readback_get_pending(readback) > 0) {
+        if (!pop_frame(ctx, readback))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+print_stage_stats(GstVaapiReadback *readback)
+{
+    GstVaapiReadbackStageStats stats;
+    guint i;
+
+    for (i = 0; i < GST_VAAPI_READBACK_STAGE_COUNT; i++) {
+        if (!gst_vaapi_readback_get_stage_stats(readback, i, &stats))
+            continue;
+        g_print("  %-8s avg %8.1f us, min %8.1f us, max %8.1f us\n",
+                g_stage_names[i],
+                stats.count > 0 ? stats.total_time / stats.count / 1000.0 : 0.0,
+                stats.min_time / 1000.0, stats.max_time / 1000.0);
+    }
+}
+
+static gboolean
+run_test(TestContext *ctx, guint depth, gdouble *ref_elapsed)
+{
+    GstVaapiReadback *readback = NULL;
+    GTimer *timer;
+    gdouble elapsed;
+    gboolean success;
+
+    if (depth > 0) {
+        readback = gst_vaapi_readback_new(ctx->images, depth,
+            (GDestroyNotify)gst_mini_object_unref);
+        if (!readback)
+            return FALSE;
+    }
+
+    ctx->num_frames = 0;
+    ctx->num_errors = 0;
+    timer = g_timer_new();
+    success = readback ?
+        read_frames_pipelined(ctx, readback) : read_frames_sync(ctx);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    if (depth == 0)
+        *ref_elapsed = elapsed;
+
+    if (success && ctx->num_frames != (guint)g_num_frames) {
+        g_printerr("depth %u: %u frames output instead of %d\n", depth,
+                   ctx->num_frames, g_num_frames);
+        success = FALSE;
+    }
+    if (ctx->num_errors > 0) {
+        g_printerr("depth %u: %u frames out of order or corrupted\n", depth,
+                   ctx->num_errors);
+        success = FALSE;
+    }
+
+    g_print("depth %u: %8.1f fps (x%.2f)%s\n", depth,
+            elapsed > 0.0 ? g_num_frames / elapsed : 0.0,
+            elapsed > 0.0 ? *ref_elapsed / elapsed : 0.0,
+            success ? "" : " FAILED");
+    if (readback) {
+        print_stage_stats(readback);
+        gst_vaapi_readback_free(readback);
+    }
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    TestContext ctx;
+    gchar *delay;
+    gdouble ref_elapsed = 0.0;
+    gint depth;
+    gboolean success = TRUE;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    g_num_frames   = MAX(g_num_frames, 1);
+    g_max_depth    = CLAMP(g_max_depth, 1, 16);
+    g_fetch_delay  = MAX(g_fetch_delay, 0);
+    g_process_time = MAX(g_process_time, 0);
+    g_width        = CLAMP(g_width, 2, 8192);
+    g_height       = CLAMP(g_height, 2, 8192);
+
+    /* The stub driver keeps surfaces in system memory, and its
+       vaGetImage() takes the time a GPU would */
+    delay = g_strdup_printf("%d", g_fetch_delay);
+    g_setenv(STUB_GET_IMAGE_DELAY_ENV, delay, TRUE);
+    g_free(delay);
+
+    display = stub_display_new(NULL);
+    if (!display || !gst_vaapi_display_get_display(display))
+        g_error("could not create stub VA display");
+
+    if (!test_context_init(&ctx, display))
+        g_error("could not create %dx%d surfaces", g_width, g_height);
+
+    g_print("Readback of %d %dx%d NV12 frames, %d us per fetch, "
+            "%d us per frame downstream\n", g_num_frames, g_width, g_height,
+            g_fetch_delay, g_process_time);
+    for (depth = 0; depth <= g_max_depth; depth++) {
+        if (!run_test(&ctx, depth, &ref_elapsed))
+            success = FALSE;
+    }
+
+    test_context_clear(&ctx);
+    g_object_unref(display);
+    video_output_exit();
+    return success ? 0 : 1;
+}
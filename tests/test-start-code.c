@@ -0,0 +1,329 @@
+/*
+ *  test-start-code.c - Check and benchmark start code scanning
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include <gst/vaapi/gstvaapicpu.h>
+#include <gst/vaapi/gstvaapistartcode.h>
+
+/* Largest buffer checked, in bytes */
+#define MAX_CHECK_SIZE  4096
+
+static gint g_num_checks    = 2000;
+static gint g_stream_size   = 64;
+static gint g_slice_size    = 64;
+static gint g_chunk_size    = 4096;
+static gint g_num_passes    = 5;
+static gboolean g_benchmark = TRUE;
+
+static GOptionEntry g_options[] = {
+    { "checks", 'c',
+      0,
+      G_OPTION_ARG_INT, &g_num_checks,
+      "number of random buffers checked per implementation", NULL },
+    { "size", 's',
+      0,
+      G_OPTION_ARG_INT, &g_stream_size,
+      "size of the benchmark stream, in MB", NULL },
+    { "slice-size", 'S',
+      0,
+      G_OPTION_ARG_INT, &g_slice_size,
+      "average distance between two start codes, in KB", NULL },
+    { "chunk-size", 'k',
+      0,
+      G_OPTION_ARG_INT, &g_chunk_size,
+      "size of the buffers the stream is fed in, in bytes", NULL },
+    { "passes", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_passes,
+      "number of times the stream is scanned per implementation", NULL },
+    { "no-benchmark", 0,
+      G_OPTION_FLAG_REVERSE,
+      G_OPTION_ARG_NONE, &g_benchmark,
+      "only check the results", NULL },
+    { NULL, }
+};
+
+/* The implementations to compare, from the generic C code up */
+static const guint g_cpu_flags_list[] = {
+    0,
+    GST_VAAPI_CPU_FLAG_SSE2,
+    GST_VAAPI_CPU_FLAG_SSE2 | GST_VAAPI_CPU_FLAG_AVX2,
+    GST_VAAPI_CPU_FLAG_NEON,
+};
+
+/* Byte by byte search, as the codec parsers do */
+static guint
+find_bytewise(const guint8 *buf, guint n)
+{
+    guint i;
+
+    for (i = 0; i + 2 < n; i++) {
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == 1)
+            return i;
+    }
+    return n;
+}
+
+static const GstVaapiStartCodeFuncs g_bytewise_funcs = {
+    "bytewise",
+    find_bytewise,
+};
+
+/* Random data with lots of zeros and ones, so that start codes and
+   near misses are frequent */
+static void
+fill_random(GRand *rand, guint8 *data, guint size)
+{
+    guint i;
+
+    for (i = 0; i < size; i++) {
+        switch (g_rand_int_range(rand, 0, 8)) {
+        case 0: case 1: case 2:
+            data[i] = 0;
+            break;
+        case 3: case 4:
+            data[i] = 1;
+            break;
+        default:
+            data[i] = g_rand_int_range(rand, 0, 256);
+            break;
+        }
+    }
+}
+
+/* Feeds @data in random pieces, flushing some of the data now and
+   then, and checks the positions found against the byte by byte
+   search */
+static gboolean
+check_scanner(
+    const GstVaapiStartCodeFuncs *funcs,
+    const guint8                 *data,
+    guint                         size,
+    GRand                        *rand
+)
+{
+    GstVaapiStartCodeScanner scanner;
+    guint pos, n, m, flushed, from, expected;
+    gint ofs;
+    gboolean success = TRUE;
+
+    gst_vaapi_start_code_scanner_init(&scanner, funcs);
+    for (pos = 0, flushed = 0; pos < size; pos += n) {
+        n = MIN((guint)g_rand_int_range(rand, 0, 64), size - pos);
+        gst_vaapi_start_code_scanner_push(&scanner, data + pos, n);
+        if (scanner.size > 2 && g_rand_int_range(rand, 0, 4) == 0) {
+            m = g_rand_int_range(rand, 0, scanner.size - 2);
+            gst_vaapi_start_code_scanner_flush(&scanner, m);
+            flushed += m;
+        }
+    }
+
+    for (from = flushed; success && from < size; from = expected + 3) {
+        expected = from + find_bytewise(data + from, size - from);
+        ofs = gst_vaapi_start_code_scanner_find(&scanner, from - flushed);
+        if (expected == size)
+            success = ofs < 0;
+        else
+            success = ofs >= 0 && flushed + ofs == expected;
+    }
+    gst_vaapi_start_code_scanner_clear(&scanner);
+    return success;
+}
+
+static gboolean
+check_funcs(const GstVaapiStartCodeFuncs *funcs)
+{
+    guint8 *data;
+    GRand *rand;
+    guint size, ofs;
+    gint i;
+    gboolean success = TRUE;
+
+    data = g_malloc(MAX_CHECK_SIZE + 32);
+    rand = g_rand_new_with_seed(0x5eed);
+
+    for (i = 0; i < g_num_checks && success; i++) {
+        size = g_rand_int_range(rand, 0, MAX_CHECK_SIZE + 1);
+        ofs  = g_rand_int_range(rand, 0, 32);
+        fill_random(rand, data + ofs, size);
+
+        if (funcs->find(data + ofs, size) !=
+            find_bytewise(data + ofs, size)) {
+            g_printerr("%s: find() differs from the byte by byte search "
+                       "(%u bytes, offset %u)\n", funcs->name, size, ofs);
+            success = FALSE;
+        }
+        else if (!check_scanner(funcs, data + ofs, size, rand)) {
+            g_printerr("%s: the scanner missed start codes "
+                       "(%u bytes, offset %u)\n", funcs->name, size, ofs);
+            success = FALSE;
+        }
+    }
+    g_rand_free(rand);
+    g_free(data);
+    return success;
+}
+
+/* Builds a stream that looks like high bitrate intra coded slices:
+   random data with emulation prevention bytes inserted, and a start
+   code every @slice_size bytes on average */
+static guint8 *
+make_stream(guint size, guint slice_size, guint *num_codes_ptr)
+{
+    GRand * const rand = g_rand_new_with_seed(0x1e7a);
+    guint8 * const data = g_malloc(size);
+    guint i, next_code, num_zeros = 0, num_codes = 0;
+
+    next_code = 0;
+    for (i = 0; i < size; i++) {
+        if (i == next_code && i + 4 <= size) {
+            data[i++] = 0x00;
+            data[i++] = 0x00;
+            data[i++] = 0x01;
+            data[i]   = g_rand_int_range(rand, 0x01, 0xb0);
+            next_code = i + g_rand_int_range(rand, slice_size / 2,
+                                             3 * slice_size / 2 + 1);
+            num_zeros = 0;
+            num_codes++;
+            continue;
+        }
+
+        data[i] = g_rand_int_range(rand, 0, 256);
+        if (num_zeros == 2 && data[i] <= 0x03)
+            data[i] = 0x03;
+        num_zeros = data[i] ? 0 : num_zeros + 1;
+    }
+    g_rand_free(rand);
+
+    *num_codes_ptr = num_codes;
+    return data;
+}
+
+/* Feeds the stream in chunks, as the decoders do, and consumes the
+   start codes as they are found */
+static guint
+scan_stream(const GstVaapiStartCodeFuncs *funcs, const guint8 *data,
+    guint size)
+{
+    GstVaapiStartCodeScanner scanner;
+    guint pos, n, num_codes = 0;
+
+    gst_vaapi_start_code_scanner_init(&scanner, funcs);
+    for (pos = 0; pos < size; pos += n) {
+        n = MIN((guint)g_chunk_size, size - pos);
+        gst_vaapi_start_code_scanner_push(&scanner, data + pos, n);
+        num_codes += scanner.positions->len;
+        if (scanner.size > 2)
+            gst_vaapi_start_code_scanner_flush(&scanner, scanner.size - 2);
+    }
+    gst_vaapi_start_code_scanner_clear(&scanner);
+    return num_codes;
+}
+
+static gboolean
+run_benchmark(const GstVaapiStartCodeFuncs **impls, guint num_impls)
+{
+    const guint size = g_stream_size * 1024 * 1024;
+    GTimer *timer;
+    gdouble elapsed, ref_elapsed = 0.0, mbytes;
+    guint8 *data;
+    guint i, num_codes, expected_num_codes;
+    gint n;
+    gboolean success = TRUE;
+
+    data = make_stream(size, g_slice_size * 1024, &expected_num_codes);
+    mbytes = (gdouble)size * g_num_passes / (1024 * 1024);
+    g_print("bench: %u MB stream, %u start codes, %d byte chunks\n",
+            g_stream_size, expected_num_codes, g_chunk_size);
+
+    timer = g_timer_new();
+    for (i = 0; i < num_impls; i++) {
+        num_codes = 0;
+        g_timer_start(timer);
+        for (n = 0; n < g_num_passes; n++)
+            num_codes = scan_stream(impls[i], data, size);
+        elapsed = g_timer_elapsed(timer, NULL);
+        if (i == 0)
+            ref_elapsed = elapsed;
+
+        g_print("bench: %-8s %8.1f MB/s (x%.2f)\n", impls[i]->name,
+                elapsed > 0.0 ? mbytes / elapsed : 0.0,
+                elapsed > 0.0 ? ref_elapsed / elapsed : 0.0);
+        if (num_codes != expected_num_codes) {
+            g_printerr("%s: found %u start codes instead of %u\n",
+                       impls[i]->name, num_codes, expected_num_codes);
+            success = FALSE;
+        }
+    }
+    g_timer_destroy(timer);
+    g_free(data);
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const GstVaapiStartCodeFuncs *impls[G_N_ELEMENTS(g_cpu_flags_list) + 1];
+    const GstVaapiStartCodeFuncs *funcs;
+    GOptionContext *ctx;
+    guint i, cpu_flags, num_impls = 0;
+    gboolean success = TRUE;
+
+    ctx = g_option_context_new("- start code scanner test");
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    g_stream_size = CLAMP(g_stream_size, 1, 1024);
+    g_slice_size  = MAX(g_slice_size, 1);
+    g_chunk_size  = MAX(g_chunk_size, 1);
+    g_num_passes  = MAX(g_num_passes, 1);
+
+    cpu_flags = gst_vaapi_cpu_get_flags();
+    g_print("CPU flags: 0x%x, default kernels: %s\n", cpu_flags,
+            gst_vaapi_start_code_get_funcs()->name);
+
+    /* Only test the implementations this CPU can run, once each */
+    impls[num_impls++] = &g_bytewise_funcs;
+    for (i = 0; i < G_N_ELEMENTS(g_cpu_flags_list); i++) {
+        if ((g_cpu_flags_list[i] & cpu_flags) != g_cpu_flags_list[i])
+            continue;
+        funcs = gst_vaapi_start_code_get_funcs_for_flags(g_cpu_flags_list[i]);
+        if (funcs == impls[num_impls - 1])
+            continue;
+        impls[num_impls++] = funcs;
+    }
+
+    for (i = 1; i < num_impls; i++) {
+        if (!check_funcs(impls[i]))
+            success = FALSE;
+        else
+            g_print("check: %s scanner matches the byte by byte search\n",
+                    impls[i]->name);
+    }
+
+    if (g_benchmark && !run_benchmark(impls, num_impls))
+        success = FALSE;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+/*
+ *  test-va-buffers.c - Count VA buffer and submission calls per frame
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapidecoder_h264.h>
+#include <gst/vaapi/gstvaapidecoder_mpeg2.h>
+#include <gst/vaapi/gstvaapidecoder_vc1.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include "test-h264.h"
+#include "test-mpeg2.h"
+#include "test-vc1.h"
+#include "output.h"
+#include "stub.h"
+
+typedef void (*GetVideoInfoFunc)(VideoDecodeInfo *info);
+
+static gint g_num_loops = 4;
+static gchar *g_input_file;
+static gchar *g_input_codec;
+
+static GOptionEntry g_options[] = {
+    { "loops", 'l',
+      0,
+      G_OPTION_ARG_INT, &g_num_loops,
+      "number of times the stream is fed to the decoder", NULL },
+    { "input", 'i',
+      0,
+      G_OPTION_ARG_FILENAME, &g_input_file,
+      "bitstream file to decode instead of the embedded clips", NULL },
+    { "codec", 'c',
+      0,
+      G_OPTION_ARG_STRING, &g_input_codec,
+      "codec of the input file (h264, mpeg2, vc1)", NULL },
+    { NULL, }
+};
+
+static GstVaapiDecoder *
+create_decoder(GstVaapiDisplay *display, VideoDecodeInfo *info)
+{
+    GstVaapiDecoder *decoder;
+    GstCaps *caps;
+
+    caps = gst_vaapi_profile_get_caps(info->profile);
+    if (!caps)
+        g_error("could not create decoder caps");
+
+    if (info->width > 0 && info->height > 0)
+        gst_caps_set_simple(
+            caps,
+            "width",  G_TYPE_INT, info->width,
+            "height", G_TYPE_INT, info->height,
+            NULL
+        );
+
+    switch (gst_vaapi_profile_get_codec(info->profile)) {
+    case GST_VAAPI_CODEC_H264:
+        decoder = gst_vaapi_decoder_h264_new(display, caps);
+        break;
+    case GST_VAAPI_CODEC_MPEG2:
+        decoder = gst_vaapi_decoder_mpeg2_new(display, caps);
+        break;
+    case GST_VAAPI_CODEC_VC1:
+        decoder = gst_vaapi_decoder_vc1_new(display, caps);
+        break;
+    default:
+        decoder = NULL;
+        break;
+    }
+    if (!decoder)
+        g_error("could not create decoder");
+    gst_caps_unref(caps);
+    return decoder;
+}
+
+static guint
+release_surfaces(GstVaapiDecoder *decoder)
+{
+    GstVaapiSurfaceProxy *proxy;
+    GstVaapiDecoderStatus status;
+    guint num_surfaces = 0;
+
+    while ((proxy = gst_vaapi_decoder_get_surface(decoder, &status)) != NULL) {
+        g_object_unref(proxy);
+        num_surfaces++;
+    }
+    return num_surfaces;
+}
+
+static gboolean
+decode_stream(GstVaapiDisplay *display, const gchar *name,
+    VideoDecodeInfo *info)
+{
+    GstVaapiDecoder *decoder;
+    GstBuffer *buffer;
+    const StubDriverStats *stats;
+    guint num_frames = 0, num_pictures;
+    gint i;
+
+    decoder = create_decoder(display, info);
+    stub_driver_reset_stats();
+
+    for (i = 0; i < g_num_loops; i++) {
+        buffer = gst_buffer_new();
+        if (!buffer)
+            g_error("could not create encoded data buffer");
+        gst_buffer_set_data(buffer, (guchar *)info->data, info->data_size);
+
+        if (!gst_vaapi_decoder_put_buffer(decoder, buffer))
+            g_error("could not send video data to the decoder");
+        gst_buffer_unref(buffer);
+
+        num_frames += release_surfaces(decoder);
+    }
+
+    if (!gst_vaapi_decoder_put_buffer(decoder, NULL))
+        g_error("could not send EOS to the decoder");
+    num_frames += release_surfaces(decoder);
+
+    stats = stub_driver_get_stats();
+    if (!stats) {
+        g_print("%-6s %u frames (no stub driver, call counts unavailable)\n",
+                name, num_frames);
+        g_object_unref(decoder);
+        return TRUE;
+    }
+
+    num_pictures = MAX(stats->num_end_picture, 1);
+    g_print("%-6s %u frames, per picture: %.2f VA calls, "
+            "%.2f vaCreateBuffer, %.2f vaDestroyBuffer, "
+            "%.2f vaRenderPicture, %.2f buffers\n",
+            name, num_frames,
+            (gdouble)stats->num_calls / num_pictures,
+            (gdouble)stats->num_create_buffer / num_pictures,
+            (gdouble)stats->num_destroy_buffer / num_pictures,
+            (gdouble)stats->num_render_picture / num_pictures,
+            (gdouble)stats->num_render_buffers / num_pictures);
+
+    g_object_unref(decoder);
+
+    /* Without recycling, every submitted VA buffer is a new one */
+    if (stats->num_end_picture > 1 &&
+        stats->num_create_buffer >= stats->num_render_buffers) {
+        g_printerr("%s: VA buffers are not recycled across pictures\n", name);
+        return FALSE;
+    }
+
+    /* The stub driver accepts all buffers of a picture at once */
+    if (stats->num_render_picture > stats->num_end_picture) {
+        g_printerr("%s: VA buffers are not submitted in a single batch\n",
+                   name);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+decode_file(GstVaapiDisplay *display, const gchar *filename,
+    const gchar *codec)
+{
+    VideoDecodeInfo info;
+    GError *error = NULL;
+    gchar *data;
+    gsize data_size;
+    gboolean success;
+
+    memset(&info, 0, sizeof(info));
+    if (g_strcmp0(codec, "h264") == 0)
+        info.profile = GST_VAAPI_PROFILE_H264_HIGH;
+    else if (g_strcmp0(codec, "mpeg2") == 0)
+        info.profile = GST_VAAPI_PROFILE_MPEG2_MAIN;
+    else if (g_strcmp0(codec, "vc1") == 0)
+        info.profile = GST_VAAPI_PROFILE_VC1_ADVANCED;
+    else
+        g_error("unsupported codec '%s'", codec ? codec : "<none>");
+
+    if (!g_file_get_contents(filename, &data, &data_size, &error))
+        g_error("could not read %s: %s", filename, error->message);
+
+    info.data      = (const guchar *)data;
+    info.data_size = data_size;
+    success = decode_stream(display, codec, &info);
+    g_free(data);
+    return success;
+}
+
+int
+main(int argc, char *argv[])
+{
+    GstVaapiDisplay *display;
+    VideoDecodeInfo info;
+    gboolean success = TRUE;
+
+    static const struct {
+        const gchar        *name;
+        GetVideoInfoFunc    get_video_info;
+    } clips[] = {
+        { "h264", h264_get_video_info },
+        { "vc1",  vc1_get_video_info  },
+    };
+    guint i;
+
+    if (!video_output_init(&argc, argv, g_options))
+        g_error("failed to initialize video output subsystem");
+
+    if (g_num_loops < 1)
+        g_num_loops = 1;
+
+    display = video_output_create_display(NULL);
+    if (!display)
+        g_error("could not create VA display");
+
+    if (g_input_file)
+        success = decode_file(display, g_input_file, g_input_codec);
+    else {
+        for (i = 0; i < G_N_ELEMENTS(clips); i++) {
+            clips[i].get_video_info(&info);
+            if (!decode_stream(display, clips[i].name, &info))
+                success = FALSE;
+        }
+    }
+
+    g_object_unref(display);
+    g_free(g_input_file);
+    g_free(g_input_codec);
+    video_output_exit();
+    return success ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+/*
+ *  test-video-pool.c - Multi-threaded stress test of GstVaapiVideoPool
+ *
+ *  Copyright (C) 2012 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+*/
+
+#include "config.h"
+#include <gst/gst.h>
+#include <gst/vaapi/gstvaapivideopool.h>
+
+/* A pool of plain GObjects, so that no VA display is needed */
+typedef GstVaapiVideoPool       TestPool;
+typedef GstVaapiVideoPoolClass  TestPoolClass;
+
+G_DEFINE_TYPE(TestPool, test_pool, GST_VAAPI_TYPE_VIDEO_POOL)
+
+static GQuark g_in_use_quark;
+static volatile gint g_num_allocated;
+
+static gpointer
+test_pool_alloc_object(GstVaapiVideoPool *pool, GstVaapiDisplay *display)
+{
+    g_atomic_int_inc(&g_num_allocated);
+    return g_object_new(G_TYPE_OBJECT, NULL);
+}
+
+static void
+test_pool_class_init(TestPoolClass *klass)
+{
+    klass->alloc_object = test_pool_alloc_object;
+}
+
+static void
+test_pool_init(TestPool *pool)
+{
+}
+
+static GstVaapiVideoPool *
+test_pool_new(guint capacity)
+{
+    GstVaapiVideoPool *pool;
+    GstCaps *caps;
+
+    caps = gst_caps_new_simple(
+        "video/x-raw-yuv",
+        "width",  G_TYPE_INT, 320,
+        "height", G_TYPE_INT, 240,
+        NULL
+    );
+
+    pool = g_object_new(test_pool_get_type(),
+                        "caps", caps,
+                        "capacity", capacity,
+                        NULL);
+    gst_caps_unref(caps);
+    return pool;
+}
+
+static gint g_num_threads    = 8;
+static gint g_num_iterations = 20000;
+static gint g_capacity       = 4;
+static gint g_num_objects    = 4096;
+
+static GOptionEntry g_options[] = {
+    { "threads", 't',
+      0,
+      G_OPTION_ARG_INT, &g_num_threads,
+      "number of threads churning objects", NULL },
+    { "iterations", 'n',
+      0,
+      G_OPTION_ARG_INT, &g_num_iterations,
+      "number of get/put cycles per thread", NULL },
+    { "capacity", 'c',
+      0,
+      G_OPTION_ARG_INT, &g_capacity,
+      "capacity of the pool in the stress test", NULL },
+    { "objects", 'o',
+      0,
+      G_OPTION_ARG_INT, &g_num_objects,
+      "number of objects checked out in the benchmark", NULL },
+    { NULL, }
+};
+
+typedef struct {
+    GstVaapiVideoPool  *pool;
+    volatile gint       num_used;
+    volatile gint       max_used;
+    volatile gint       num_misses;
+    volatile gint       num_errors;
+} StressData;
+
+static gpointer
+stress_thread(gpointer user_data)
+{
+    StressData * const data = user_data;
+    GObject *object;
+    gint i, num_used, max_used;
+
+    for (i = 0; i < g_num_iterations; i++) {
+        if (i % 4 == 0)
+            object = gst_vaapi_video_pool_try_get_object(data->pool);
+        else
+            object = gst_vaapi_video_pool_get_object_timeout(data->pool,
+                G_USEC_PER_SEC);
+        if (!object) {
+            g_atomic_int_inc(&data->num_misses);
+            continue;
+        }
+
+        /* Each object must be handed out to a single thread at a time */
+        if (g_object_get_qdata(object, g_in_use_quark))
+            g_atomic_int_inc(&data->num_errors);
+        g_object_set_qdata(object, g_in_use_quark, GINT_TO_POINTER(1));
+
+        num_used = g_atomic_int_exchange_and_add(&data->num_used, 1) + 1;
+        do {
+            max_used = g_atomic_int_get(&data->max_used);
+        } while (num_used > max_used &&
+                 !g_atomic_int_compare_and_exchange(&data->max_used,
+                                                    max_used, num_used));
+        if (i % 64 == 0)
+            g_thread_yield();
+
+        g_atomic_int_add(&data->num_used, -1);
+        g_object_set_qdata(object, g_in_use_quark, NULL);
+        gst_vaapi_video_pool_put_object(data->pool, object);
+        g_object_unref(object);
+    }
+    return NULL;
+}
+
+static gboolean
+run_stress_test(void)
+{
+    StressData data;
+    GThread **threads;
+    GTimer *timer;
+    gdouble elapsed;
+    gint i, num_ops;
+    gboolean success;
+
+    data.pool         = test_pool_new(g_capacity);
+    data.num_used     = 0;
+    data.max_used     = 0;
+    data.num_misses   = 0;
+    data.num_errors   = 0;
+    g_num_allocated   = 0;
+    if (!data.pool)
+        g_error("could not create pool");
+
+    threads = g_new(GThread *, g_num_threads);
+    timer = g_timer_new();
+    for (i = 0; i < g_num_threads; i++) {
+#if GLIB_CHECK_VERSION(2,31,0)
+        threads[i] = g_thread_new("stress", stress_thread, &data);
+#else
+        threads[i] = g_thread_create(stress_thread, &data, TRUE, NULL);
+#endif
+        if (!threads[i])
+            g_error("could not create thread");
+    }
+    for (i = 0; i < g_num_threads; i++)
+        g_thread_join(threads[i]);
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    g_free(threads);
+
+    num_ops = g_num_threads * g_num_iterations - data.num_misses;
+    g_print("stress: %d threads, capacity %d, %d get/put cycles in %.3f s "
+            "(%.0f cycles/s), %d misses, %d objects allocated\n",
+            g_num_threads, g_capacity, num_ops, elapsed,
+            elapsed > 0.0 ? num_ops / elapsed : 0.0,
+            data.num_misses, g_num_allocated);
+
+    success = TRUE;
+    if (data.num_errors > 0) {
+        g_printerr("stress: %d objects handed out twice\n", data.num_errors);
+        success = FALSE;
+    }
+    if (g_capacity > 0 && data.max_used > g_capacity) {
+        g_printerr("stress: %d objects in use, capacity is %d\n",
+                   data.max_used, g_capacity);
+        success = FALSE;
+    }
+    if (g_capacity > 0 && g_num_allocated > g_capacity) {
+        g_printerr("stress: %d objects allocated, capacity is %d\n",
+                   g_num_allocated, g_capacity);
+        success = FALSE;
+    }
+    if (gst_vaapi_video_pool_get_size(data.pool) != (guint)g_num_allocated) {
+        g_printerr("stress: objects were not all returned to the pool\n");
+        success = FALSE;
+    }
+    g_object_unref(data.pool);
+    return success;
+}
+
+typedef struct {
+    GstVaapiVideoPool  *pool;
+    gpointer            object;
+} ReleaseData;
+
+static gpointer
+release_thread(gpointer user_data)
+{
+    ReleaseData * const data = user_data;
+
+    g_usleep(G_USEC_PER_SEC / 50);
+    gst_vaapi_video_pool_put_object(data->pool, data->object);
+    return NULL;
+}
+
+/* Waiters must be woken up by the release, not by the timeout */
+static gboolean
+run_wait_test(void)
+{
+    GstVaapiVideoPool *pool;
+    ReleaseData data;
+    GThread *thread;
+    GTimer *timer;
+    gdouble elapsed;
+    gboolean success;
+
+    pool = test_pool_new(1);
+    if (!pool)
+        g_error("could not create pool");
+
+    data.pool   = pool;
+    data.object = gst_vaapi_video_pool_try_get_object(pool);
+    if (!data.object)
+        g_error("could not get object from pool");
+
+    if (gst_vaapi_video_pool_wait_object(pool, G_USEC_PER_SEC / 100))
+        g_error("wait succeeded while no object was free");
+
+    timer = g_timer_new();
+#if GLIB_CHECK_VERSION(2,31,0)
+    thread = g_thread_new("release", release_thread, &data);
+#else
+    thread = g_thread_create(release_thread, &data, TRUE, NULL);
+#endif
+    if (!thread)
+        g_error("could not create thread");
+    success = gst_vaapi_video_pool_wait_object(pool, 5 * G_USEC_PER_SEC);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    g_thread_join(thread);
+    g_object_unref(data.object);
+
+    g_print("wait: woken up after %.3f ms\n", elapsed * 1000.0);
+    if (!success || elapsed > 1.0) {
+        g_printerr("wait: waiter was not woken up by the release\n");
+        success = FALSE;
+    }
+    g_object_unref(pool);
+    return success;
+}
+
+static gboolean
+run_timeout_test(void)
+{
+    GstVaapiVideoPool *pool;
+    gpointer object, object2;
+    GTimer *timer;
+    gdouble elapsed;
+
+    pool = test_pool_new(1);
+    if (!pool)
+        g_error("could not create pool");
+
+    object = gst_vaapi_video_pool_try_get_object(pool);
+    if (!object)
+        g_error("could not get object from pool");
+
+    if (gst_vaapi_video_pool_try_get_object(pool))
+        g_error("try-get returned an object beyond capacity");
+
+    timer = g_timer_new();
+    object2 = gst_vaapi_video_pool_get_object_timeout(pool,
+        G_USEC_PER_SEC / 10);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+    if (object2)
+        g_error("blocking get returned an object beyond capacity");
+    if (elapsed < 0.05)
+        g_error("blocking get returned after %.3f s only", elapsed);
+
+    gst_vaapi_video_pool_put_object(pool, object);
+    g_object_unref(object);
+    g_object_unref(pool);
+    return TRUE;
+}
+
+static void
+run_benchmark(void)
+{
+    GstVaapiVideoPool *pool;
+    GObject **objects;
+    GTimer *timer;
+    gdouble elapsed;
+    gint i;
+
+    pool = test_pool_new(0);
+    if (!pool)
+        g_error("could not create pool");
+
+    objects = g_new(GObject *, g_num_objects);
+    for (i = 0; i < g_num_objects; i++)
+        objects[i] = gst_vaapi_video_pool_get_object(pool);
+    for (i = 0; i < g_num_objects; i++) {
+        gst_vaapi_video_pool_put_object(pool, objects[i]);
+        g_object_unref(objects[i]);
+    }
+
+    /* Objects are returned in checkout order, which used to be the
+       worst case of the linear used-object lookup */
+    timer = g_timer_new();
+    for (i = 0; i < g_num_objects; i++)
+        objects[i] = gst_vaapi_video_pool_get_object(pool);
+    for (i = 0; i < g_num_objects; i++) {
+        gst_vaapi_video_pool_put_object(pool, objects[i]);
+        g_object_unref(objects[i]);
+    }
+    g_timer_stop(timer);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    g_print("bench: %d objects checked out and returned in %.3f ms "
+            "(%.1f ns per get/put)\n",
+            g_num_objects, elapsed * 1000.0,
+            elapsed * 1e9 / g_num_objects);
+
+    g_free(objects);
+    g_object_unref(pool);
+}
+
+int
+main(int argc, char *argv[])
+{
+    GOptionContext *ctx;
+    gboolean success = TRUE;
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+    if (!g_thread_supported())
+        g_thread_init(NULL);
+#endif
+
+    ctx = g_option_context_new("- video pool stress test");
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    g_option_context_add_main_entries(ctx, g_options, NULL);
+    if (!g_option_context_parse(ctx, &argc, &argv, NULL))
+        g_error("could not parse options");
+    g_option_context_free(ctx);
+
+    if (g_num_threads < 1)
+        g_num_threads = 1;
+    if (g_num_objects < 1)
+        g_num_objects = 1;
+    if (g_capacity < 0)
+        g_capacity = 0;
+
+    g_in_use_quark = g_quark_from_static_string("test-video-pool-in-use");
+
+    if (!run_timeout_test())
+        success = FALSE;
+    if (!run_wait_test())
+        success = FALSE;
+    if (!run_stress_test())
+        success = FALSE;
+    run_benchmark();
+
+    gst_deinit();
+    return success ? 0 : 1;
+}